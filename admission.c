@@ -0,0 +1,165 @@
+#include "admission.h"
+#include "logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <malloc.h>
+
+// 每个工作线程的压力状态，按缓存行对齐避免伪共享
+typedef struct {
+    atomic_uint level;
+    atomic_uint headroom;
+    atomic_uint_fast64_t rejected;
+    atomic_uint_fast64_t shed;
+    atomic_uint_fast64_t paused;
+} __attribute__((aligned(64))) WorkerPressure;
+
+static WorkerPressure* pressures = NULL;
+static int worker_count = 0;
+static unsigned connection_limit = 0;
+static AdmissionConfig admission_config;
+static atomic_int open_connections;
+
+// 内存采样结果，由任一工作线程按周期刷新
+static atomic_uint_fast64_t memory_sample_ns;
+static atomic_uint memory_headroom;
+
+static const char* level_names[] = { "normal", "rejecting new connections", "shedding idle connections" };
+
+// 初始化准入控制
+int admission_init(int workers, unsigned max_connections, const AdmissionConfig* config) {
+    pressures = aligned_alloc(64, sizeof(WorkerPressure) * (size_t)workers);
+    if (!pressures) {
+        return -1;
+    }
+    for (int i = 0; i < workers; i++) {
+        atomic_init(&pressures[i].level, ADMISSION_NORMAL);
+        atomic_init(&pressures[i].headroom, 100);
+        atomic_init(&pressures[i].rejected, 0);
+        atomic_init(&pressures[i].shed, 0);
+        atomic_init(&pressures[i].paused, 0);
+    }
+    worker_count = workers;
+    connection_limit = max_connections ? max_connections : 1;
+    admission_config = *config;
+    if (admission_config.shed_headroom_pct > admission_config.reject_headroom_pct) {
+        admission_config.shed_headroom_pct = admission_config.reject_headroom_pct;
+    }
+    atomic_init(&open_connections, 0);
+    atomic_init(&memory_sample_ns, 0);
+    atomic_init(&memory_headroom, 100);
+    return 0;
+}
+
+// 释放准入控制
+void admission_destroy(void) {
+    free(pressures);
+    pressures = NULL;
+    worker_count = 0;
+}
+
+// 更新连接数
+void admission_connection_delta(int delta) {
+    atomic_fetch_add_explicit(&open_connections, delta, memory_order_relaxed);
+}
+
+// 连接数余量
+unsigned admission_connection_headroom(void) {
+    int open = atomic_load_explicit(&open_connections, memory_order_relaxed);
+    if (open <= 0) return 100;
+    if ((unsigned)open >= connection_limit) return 0;
+    return (unsigned)((uint64_t)(connection_limit - (unsigned)open) * 100 / connection_limit);
+}
+
+// 已分配的内存（字节）。glibc 下取分配器统计的使用量：释放的内存通常留在堆中，
+// 常驻内存不会随之下降，以它判断会在关闭连接后一直处于过载状态；其他 C 库读取常驻内存
+static uint64_t memory_in_use(void) {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    struct mallinfo2 info = mallinfo2();
+    return (uint64_t)info.uordblks + (uint64_t)info.hblkhd;
+#else
+    FILE* f = fopen("/proc/self/statm", "r");
+    if (!f) return 0;
+    unsigned long size = 0, resident = 0;
+    int n = fscanf(f, "%lu %lu", &size, &resident);
+    fclose(f);
+    return n == 2 ? (uint64_t)resident * (uint64_t)sysconf(_SC_PAGESIZE) : 0;
+#endif
+}
+
+// 内存余量
+unsigned admission_memory_headroom(uint64_t now_ns) {
+    if (admission_config.memory_limit_mb == 0) return 100;
+
+    uint64_t last = atomic_load_explicit(&memory_sample_ns, memory_order_relaxed);
+    if (now_ns - last >= (uint64_t)ADMISSION_MEMORY_SAMPLE_MS * 1000000ULL &&
+        atomic_compare_exchange_strong(&memory_sample_ns, &last, now_ns)) {
+        uint64_t limit = (uint64_t)admission_config.memory_limit_mb << 20;
+        uint64_t used = memory_in_use();
+        unsigned headroom = used >= limit ? 0 : (unsigned)((limit - used) * 100 / limit);
+        atomic_store_explicit(&memory_headroom, headroom, memory_order_relaxed);
+    }
+    return atomic_load_explicit(&memory_headroom, memory_order_relaxed);
+}
+
+// 更新压力等级
+AdmissionLevel admission_update(int worker, unsigned headroom_pct) {
+    AdmissionLevel level = ADMISSION_NORMAL;
+    if (headroom_pct <= admission_config.shed_headroom_pct) {
+        level = ADMISSION_SHED;
+    } else if (headroom_pct <= admission_config.reject_headroom_pct) {
+        level = ADMISSION_REJECT;
+    }
+    if (!pressures || worker < 0 || worker >= worker_count) return level;
+
+    WorkerPressure* p = &pressures[worker];
+    atomic_store_explicit(&p->headroom, headroom_pct, memory_order_relaxed);
+    unsigned previous = atomic_exchange_explicit(&p->level, level, memory_order_relaxed);
+    if (previous != (unsigned)level) {
+        log_warn("Worker %d: %s (headroom %u%%)", worker, level_names[level], headroom_pct);
+    }
+    return level;
+}
+
+// 记录准入控制事件
+void admission_record(int worker, AdmissionEvent event) {
+    if (!pressures || worker < 0 || worker >= worker_count) return;
+    WorkerPressure* p = &pressures[worker];
+    switch (event) {
+        case ADMISSION_EVENT_REJECTED:
+            atomic_fetch_add_explicit(&p->rejected, 1, memory_order_relaxed);
+            break;
+        case ADMISSION_EVENT_SHED:
+            atomic_fetch_add_explicit(&p->shed, 1, memory_order_relaxed);
+            break;
+        case ADMISSION_EVENT_PAUSED:
+            atomic_fetch_add_explicit(&p->paused, 1, memory_order_relaxed);
+            break;
+    }
+}
+
+// 每批最多关闭的空闲连接数
+unsigned admission_shed_batch(void) {
+    return admission_config.shed_batch;
+}
+
+// 汇总统计
+void admission_stats(AdmissionStats* stats) {
+    stats->level = ADMISSION_NORMAL;
+    stats->headroom_pct = 100;
+    stats->connections = (unsigned)atomic_load_explicit(&open_connections, memory_order_relaxed);
+    stats->rejected = 0;
+    stats->shed = 0;
+    stats->paused = 0;
+    for (int i = 0; i < worker_count; i++) {
+        WorkerPressure* p = &pressures[i];
+        unsigned level = atomic_load_explicit(&p->level, memory_order_relaxed);
+        unsigned headroom = atomic_load_explicit(&p->headroom, memory_order_relaxed);
+        if (level > stats->level) stats->level = level;
+        if (headroom < stats->headroom_pct) stats->headroom_pct = headroom;
+        stats->rejected += atomic_load_explicit(&p->rejected, memory_order_relaxed);
+        stats->shed += atomic_load_explicit(&p->shed, memory_order_relaxed);
+        stats->paused += atomic_load_explicit(&p->paused, memory_order_relaxed);
+    }
+}
\ No newline at end of file
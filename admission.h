@@ -0,0 +1,76 @@
+#ifndef ADMISSION_H
+#define ADMISSION_H
+
+#include <stdint.h>
+
+// 准入控制配置，余量为各项资源剩余比例中的最小值（百分比）
+typedef struct {
+    unsigned reject_headroom_pct;   // 余量不高于该比例时，新连接接受后立即关闭
+    unsigned shed_headroom_pct;     // 余量不高于该比例时，暂停接受连接并关闭最久未活动的空闲连接
+    unsigned memory_limit_mb;       // 进程已分配内存的上限，0 表示不检查内存余量
+    unsigned shed_batch;            // 每批最多关闭的空闲连接数
+} AdmissionConfig;
+
+// 默认配置
+#define ADMISSION_DEFAULT_REJECT_PCT 5
+#define ADMISSION_DEFAULT_SHED_PCT 1
+#define ADMISSION_DEFAULT_MEMORY_MB 0
+#define ADMISSION_DEFAULT_SHED_BATCH 16
+// 内存使用量的采样周期（毫秒）
+#define ADMISSION_MEMORY_SAMPLE_MS 100
+// 两批关闭之间的间隔（毫秒）：被关闭的连接异步释放资源，内存余量按周期采样，
+// 等待余量更新后再决定是否继续关闭，避免一次关闭全部空闲连接
+#define ADMISSION_SHED_INTERVAL_MS ADMISSION_MEMORY_SAMPLE_MS
+
+// 压力等级
+typedef enum {
+    ADMISSION_NORMAL,   // 正常接受连接
+    ADMISSION_REJECT,   // 拒绝新连接
+    ADMISSION_SHED      // 暂停接受连接并关闭空闲连接
+} AdmissionLevel;
+
+// 准入控制事件
+typedef enum {
+    ADMISSION_EVENT_REJECTED,   // 新连接被拒绝
+    ADMISSION_EVENT_SHED,       // 空闲连接被关闭
+    ADMISSION_EVENT_PAUSED      // 暂停接受连接
+} AdmissionEvent;
+
+// 准入控制统计（所有工作线程汇总）
+typedef struct {
+    unsigned level;             // 各工作线程中最高的压力等级
+    unsigned headroom_pct;      // 各工作线程中最低的余量
+    unsigned connections;       // 当前打开的连接数
+    uint64_t rejected;
+    uint64_t shed;
+    uint64_t paused;
+} AdmissionStats;
+
+// 初始化准入控制，workers 为工作线程数，max_connections 为整个进程的连接数上限
+int admission_init(int workers, unsigned max_connections, const AdmissionConfig* config);
+
+// 释放准入控制
+void admission_destroy(void);
+
+// 更新整个进程打开的连接数
+void admission_connection_delta(int delta);
+
+// 连接数余量（百分比）
+unsigned admission_connection_headroom(void);
+
+// 内存余量（百分比），按采样周期读取分配器统计；未设置上限时返回 100
+unsigned admission_memory_headroom(uint64_t now_ns);
+
+// 以工作线程当前的余量更新其压力等级并返回，等级变化时打印提示；只能由对应的工作线程调用
+AdmissionLevel admission_update(int worker, unsigned headroom_pct);
+
+// 记录准入控制事件
+void admission_record(int worker, AdmissionEvent event);
+
+// 每批最多关闭的空闲连接数
+unsigned admission_shed_batch(void);
+
+// 汇总所有工作线程的统计
+void admission_stats(AdmissionStats* stats);
+
+#endif // ADMISSION_H
\ No newline at end of file
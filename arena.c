@@ -0,0 +1,164 @@
+#define _GNU_SOURCE
+#include "arena.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+
+// mbind 的策略，与 <numaif.h> 一致（不依赖 libnuma）
+#define ARENA_MPOL_PREFERRED 1
+// 支持的最大 NUMA 节点数
+#define ARENA_MAX_NODES 1024
+
+static size_t round_up(size_t value, size_t align) {
+    return (value + align - 1) & ~(align - 1);
+}
+
+// 映射 2 MB 对齐的匿名内存：多映射一个大页，再裁掉首尾多余的部分
+static char* map_aligned(size_t size) {
+    size_t span = size + ARENA_HUGE_PAGE_SIZE;
+    char* raw = mmap(NULL, span, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) {
+        return NULL;
+    }
+    char* base = (char*)round_up((uintptr_t)raw, ARENA_HUGE_PAGE_SIZE);
+    size_t head = (size_t)(base - raw);
+    if (head) {
+        munmap(raw, head);
+    }
+    size_t tail = span - head - size;
+    if (tail) {
+        munmap(base + size, tail);
+    }
+    return base;
+}
+
+// 将区域优先绑定到当前 CPU 所在的节点，该节点内存不足时内核会从其他节点分配
+static int bind_local_node(char* base, size_t size) {
+    unsigned cpu = 0, node = 0;
+    if (syscall(SYS_getcpu, &cpu, &node, NULL) != 0 || node >= ARENA_MAX_NODES) {
+        return -1;
+    }
+    unsigned long mask[ARENA_MAX_NODES / (8 * sizeof(unsigned long))];
+    memset(mask, 0, sizeof(mask));
+    mask[node / (8 * sizeof(unsigned long))] = 1UL << (node % (8 * sizeof(unsigned long)));
+    // 内核按 maxnode - 1 位读取节点掩码
+    if (syscall(SYS_mbind, base, size, ARENA_MPOL_PREFERRED, mask, ARENA_MAX_NODES + 1, 0) != 0) {
+        return -1;
+    }
+    return (int)node;
+}
+
+// 读取 /proc/self/smaps 中包含 base 的映射由透明大页提供的字节数
+static size_t smaps_huge_bytes(const char* base) {
+    FILE* f = fopen("/proc/self/smaps", "r");
+    if (!f) return 0;
+    char line[256];
+    int inside = 0;
+    size_t huge = 0;
+    while (fgets(line, sizeof(line), f)) {
+        unsigned long start, end, kb;
+        // 映射的首行以 "起始-结束" 地址开头，其余行为 "名称: 值"
+        if (sscanf(line, "%lx-%lx ", &start, &end) == 2) {
+            inside = (uintptr_t)base >= start && (uintptr_t)base < end;
+        } else if (inside && sscanf(line, "AnonHugePages: %lu kB", &kb) == 1) {
+            huge = (size_t)kb << 10;
+            break;
+        }
+    }
+    fclose(f);
+    return huge;
+}
+
+// 创建区域
+int arena_init(Arena* arena, size_t size, int huge_pages) {
+    memset(arena, 0, sizeof(*arena));
+    arena->node = -1;
+    size = round_up(size, ARENA_HUGE_PAGE_SIZE);
+
+    char* base = NULL;
+    ArenaPages pages = ARENA_PAGES_SMALL;
+    if (huge_pages) {
+        base = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_HUGE_2MB, -1, 0);
+        if (base == MAP_FAILED) {
+            base = NULL;
+        } else {
+            pages = ARENA_PAGES_HUGETLB;
+        }
+    }
+    if (!base) {
+        base = map_aligned(size);
+        if (!base) {
+            return -1;
+        }
+        if (huge_pages && madvise(base, size, MADV_HUGEPAGE) == 0) {
+            pages = ARENA_PAGES_THP;
+        } else {
+#ifdef MADV_NOHUGEPAGE
+            // 关闭大页时即使系统设置为 always 也使用普通页，便于对比
+            madvise(base, size, MADV_NOHUGEPAGE);
+#endif
+        }
+    }
+
+    // 先绑定节点再缺页，页面才会分配在本地节点上
+    arena->node = bind_local_node(base, size);
+    long page = sysconf(_SC_PAGESIZE);
+    for (size_t off = 0; off < size; off += (size_t)page) {
+        base[off] = 0;
+    }
+
+    arena->base = base;
+    arena->size = size;
+    arena->used = 0;
+    arena->pages = pages;
+    if (pages == ARENA_PAGES_HUGETLB) {
+        arena->huge_bytes = size;
+    } else if (pages == ARENA_PAGES_THP) {
+        arena->huge_bytes = smaps_huge_bytes(base);
+    }
+    return 0;
+}
+
+// 从区域切分内存
+void* arena_alloc(Arena* arena, size_t size, size_t align) {
+    size_t offset = round_up(arena->used, align);
+    if (!arena->base || offset > arena->size || size > arena->size - offset) {
+        return NULL;
+    }
+    arena->used = offset + size;
+    return arena->base + offset;
+}
+
+// 判断指针是否属于区域
+int arena_contains(const Arena* arena, const void* ptr) {
+    return arena->base && (const char*)ptr >= arena->base && (const char*)ptr < arena->base + arena->size;
+}
+
+// 解除映射
+void arena_destroy(Arena* arena) {
+    if (arena->base) {
+        munmap(arena->base, arena->size);
+    }
+    memset(arena, 0, sizeof(*arena));
+    arena->node = -1;
+}
+
+// 页类型名称
+const char* arena_pages_name(ArenaPages pages) {
+    switch (pages) {
+        case ARENA_PAGES_HUGETLB: return "2 MB hugetlb";
+        case ARENA_PAGES_THP: return "transparent huge";
+        default: return "4 KB";
+    }
+}
\ No newline at end of file
@@ -0,0 +1,45 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// 大页大小（x86-64 和 arm64 默认配置下的 PMD 页）
+#define ARENA_HUGE_PAGE_SIZE (2UL << 20)
+
+// 区域实际使用的页类型
+typedef enum {
+    ARENA_PAGES_HUGETLB,    // 预留的 2 MB 大页（vm.nr_hugepages）
+    ARENA_PAGES_THP,        // 透明大页（madvise），由内核尽力提供
+    ARENA_PAGES_SMALL       // 普通 4 KB 页
+} ArenaPages;
+
+// 连续内存区域：启动时一次映射并预先缺页，之后按顺序切分，不单独释放
+// 注册缓冲区和内存池的初始块从同一区域切分，减少 TLB 缺失和固定缓冲区注册时锁定的页数
+typedef struct {
+    char* base;
+    size_t size;
+    size_t used;
+    ArenaPages pages;
+    int node;               // 绑定的 NUMA 节点，-1 表示未绑定
+    size_t huge_bytes;      // 预先缺页后由大页提供的字节数（透明大页为 /proc/self/smaps 中的统计）
+} Arena;
+
+// 创建区域，大小向上取整到大页大小。huge_pages 非 0 时依次尝试 hugetlb 大页和透明大页，
+// 否则只使用普通页。区域优先从调用线程当前所在 CPU 的 NUMA 节点分配，应在工作线程中调用
+// 返回: 成功返回 0，映射失败返回 -1
+int arena_init(Arena* arena, size_t size, int huge_pages);
+
+// 从区域切分 size 字节，按 align（2 的幂）对齐
+// 返回: 区域剩余空间不足时返回 NULL
+void* arena_alloc(Arena* arena, size_t size, size_t align);
+
+// 判断指针是否属于区域
+int arena_contains(const Arena* arena, const void* ptr);
+
+// 解除映射
+void arena_destroy(Arena* arena);
+
+// 页类型名称
+const char* arena_pages_name(ArenaPages pages);
+
+#endif // ARENA_H
\ No newline at end of file
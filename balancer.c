@@ -0,0 +1,136 @@
+#include "balancer.h"
+#include <stdlib.h>
+#include <stdatomic.h>
+
+// 每个工作线程的负载统计，按缓存行对齐避免伪共享
+typedef struct {
+    // 仅由所属工作线程访问
+    uint64_t window_start_ns;
+    uint64_t window_cqes;
+    uint64_t window_busy_ns;
+    uint64_t window_iterations;
+    unsigned hot_intervals;
+    unsigned budget;
+
+    // 其他工作线程读取
+    atomic_uint score;        // 上个统计周期的忙碌比例（千分比）
+    atomic_int overloaded;
+    atomic_int connections;
+} __attribute__((aligned(64))) WorkerLoad;
+
+static WorkerLoad* loads = NULL;
+static int worker_count = 0;
+static BalancerConfig balancer_config;
+
+// 初始化负载均衡器
+int balancer_init(int workers, const BalancerConfig* config) {
+    loads = aligned_alloc(64, sizeof(WorkerLoad) * (size_t)workers);
+    if (!loads) {
+        return -1;
+    }
+    for (int i = 0; i < workers; i++) {
+        WorkerLoad* load = &loads[i];
+        load->window_start_ns = 0;
+        load->window_cqes = 0;
+        load->window_busy_ns = 0;
+        load->window_iterations = 0;
+        load->hot_intervals = 0;
+        load->budget = 0;
+        atomic_init(&load->score, 0);
+        atomic_init(&load->overloaded, 0);
+        atomic_init(&load->connections, 0);
+    }
+    worker_count = workers;
+    balancer_config = *config;
+    if (balancer_config.interval_ms == 0) {
+        balancer_config.interval_ms = BALANCER_DEFAULT_INTERVAL_MS;
+    }
+    return 0;
+}
+
+// 释放负载均衡器
+void balancer_destroy(void) {
+    free(loads);
+    loads = NULL;
+    worker_count = 0;
+}
+
+// 结束一个统计周期，更新过载状态和迁移配额
+static void close_window(WorkerLoad* load, uint64_t now_ns) {
+    uint64_t iterations = load->window_iterations ? load->window_iterations : 1;
+    unsigned backlog = (unsigned)(load->window_cqes / iterations);
+    unsigned latency_us = (unsigned)(load->window_busy_ns / iterations / 1000);
+
+    int hot = (balancer_config.backlog_threshold && backlog > balancer_config.backlog_threshold) ||
+              (balancer_config.latency_threshold_us && latency_us > balancer_config.latency_threshold_us);
+    load->hot_intervals = hot ? load->hot_intervals + 1 : 0;
+
+    int overloaded = load->hot_intervals >= balancer_config.sustain_intervals && hot;
+    load->budget = overloaded ? balancer_config.max_migrations : 0;
+
+    uint64_t window_ns = now_ns - load->window_start_ns;
+    unsigned busy_permille = window_ns ? (unsigned)(load->window_busy_ns * 1000 / window_ns) : 0;
+    atomic_store_explicit(&load->score, busy_permille > 1000 ? 1000 : busy_permille, memory_order_relaxed);
+    atomic_store_explicit(&load->overloaded, overloaded, memory_order_relaxed);
+
+    load->window_start_ns = now_ns;
+    load->window_cqes = 0;
+    load->window_busy_ns = 0;
+    load->window_iterations = 0;
+}
+
+// 记录一轮事件循环
+void balancer_record(int worker, unsigned cqes, uint64_t now_ns, uint64_t elapsed_ns) {
+    if (!loads || worker < 0 || worker >= worker_count) return;
+
+    WorkerLoad* load = &loads[worker];
+    load->window_cqes += cqes;
+    load->window_busy_ns += elapsed_ns;
+    load->window_iterations++;
+
+    if (load->window_start_ns == 0) {
+        load->window_start_ns = now_ns;
+    } else if (now_ns - load->window_start_ns >= (uint64_t)balancer_config.interval_ms * 1000000ULL) {
+        close_window(load, now_ns);
+    }
+}
+
+// 更新连接数
+void balancer_connection_delta(int worker, int delta) {
+    if (!loads || worker < 0 || worker >= worker_count) return;
+    atomic_fetch_add_explicit(&loads[worker].connections, delta, memory_order_relaxed);
+}
+
+// 选择迁移目标：负载最低且明显低于本线程的非过载工作线程
+int balancer_migration_target(int worker) {
+    if (!loads || worker < 0 || worker >= worker_count || worker_count < 2) return -1;
+
+    WorkerLoad* self = &loads[worker];
+    if (self->budget == 0) return -1;
+
+    unsigned own_score = atomic_load_explicit(&self->score, memory_order_relaxed);
+    int best = -1;
+    unsigned best_score = 0;
+    int best_connections = 0;
+
+    for (int i = 0; i < worker_count; i++) {
+        if (i == worker || atomic_load_explicit(&loads[i].overloaded, memory_order_relaxed)) {
+            continue;
+        }
+        unsigned score = atomic_load_explicit(&loads[i].score, memory_order_relaxed);
+        int connections = atomic_load_explicit(&loads[i].connections, memory_order_relaxed);
+        if (best < 0 || score < best_score || (score == best_score && connections < best_connections)) {
+            best = i;
+            best_score = score;
+            best_connections = connections;
+        }
+    }
+
+    // 目标负载不足本线程一半时才迁移，避免来回抖动
+    if (best < 0 || best_score * 2 > own_score) {
+        return -1;
+    }
+
+    self->budget--;
+    return best;
+}
\ No newline at end of file
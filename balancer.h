@@ -0,0 +1,37 @@
+#ifndef BALANCER_H
+#define BALANCER_H
+
+#include <stdint.h>
+
+// 负载均衡器配置
+typedef struct {
+    unsigned backlog_threshold;     // 每轮事件循环平均待处理 CQE 数阈值
+    unsigned latency_threshold_us;  // 每轮事件循环平均处理耗时阈值（微秒）
+    unsigned sustain_intervals;     // 连续超过阈值多少个统计周期后开始迁移
+    unsigned interval_ms;           // 统计周期（毫秒）
+    unsigned max_migrations;        // 每个统计周期最多迁出的连接数
+} BalancerConfig;
+
+// 默认配置
+#define BALANCER_DEFAULT_BACKLOG 64
+#define BALANCER_DEFAULT_LATENCY_US 1000
+#define BALANCER_DEFAULT_SUSTAIN 3
+#define BALANCER_DEFAULT_INTERVAL_MS 100
+#define BALANCER_DEFAULT_MAX_MIGRATIONS 32
+
+// 初始化负载均衡器，workers 为工作线程数
+int balancer_init(int workers, const BalancerConfig* config);
+
+// 释放负载均衡器
+void balancer_destroy(void);
+
+// 记录一轮事件循环：处理的 CQE 数和耗时，只能由对应的工作线程调用
+void balancer_record(int worker, unsigned cqes, uint64_t now_ns, uint64_t elapsed_ns);
+
+// 更新工作线程持有的连接数
+void balancer_connection_delta(int worker, int delta);
+
+// 若 worker 持续过载，返回应迁入连接的工作线程编号并消耗一次迁移配额，否则返回 -1
+int balancer_migration_target(int worker);
+
+#endif // BALANCER_H
\ No newline at end of file
@@ -0,0 +1,737 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <dirent.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <poll.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+// 每次 sendmmsg/recvmmsg 的消息数和每个线程允许的在途数据报数
+#define BENCH_BURST 32
+#define BENCH_WINDOW 512
+// 往返延迟直方图：按微秒分桶，超出范围的计入最后一个桶
+#define BENCH_LATENCY_BUCKETS 100000
+// 被测服务器最多统计的线程数
+#define BENCH_MAX_SERVER_THREADS 256
+// 流式压测的最大消息长度（须不超过 SEQPACKET 模式下服务器的 buffer_size）
+#define BENCH_MAX_STREAM_SIZE (1 << 20)
+// 扇出压测：接收线程数、同时在途的发布消息数、等待一条消息送达所有订阅者的上限（秒）
+#define BENCH_FANOUT_THREADS 4
+#define BENCH_FANOUT_WINDOW 16
+#define BENCH_FANOUT_TIMEOUT 1.0
+// 扇出压测的延迟直方图精度（微秒），覆盖到 BENCH_FANOUT_TIMEOUT
+#define BENCH_FANOUT_RESOLUTION_US 10
+// 回环地址上每个源地址建立的连接数（不超过临时端口范围）
+#define BENCH_FANOUT_PER_SOURCE 20000
+// 重负载客户端每次发送的数据量
+#define BENCH_HEAVY_CHUNK 65536
+
+// 压测参数
+typedef struct {
+    const char *mode;
+    struct sockaddr_in addr;
+    struct sockaddr_un unix_addr;
+    int threads;
+    int seconds;
+    size_t size;
+} BenchConfig;
+
+static BenchConfig config;
+static atomic_ullong total_ops;
+static atomic_ullong total_lost;
+static atomic_ullong heavy_bytes;
+static atomic_int heavy_stop;
+static atomic_ullong latency_histogram[BENCH_LATENCY_BUCKETS];
+static atomic_ullong fanout_histogram[BENCH_LATENCY_BUCKETS];
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// UDP 回显压测：批量发送，窗口内等待回复，超时未回复的数据报计为丢失
+static void* udp_bench_thread(void *arg) {
+    (void)arg;
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr*)&config.addr, sizeof(config.addr)) < 0) {
+        perror("udp socket");
+        return NULL;
+    }
+    struct timeval tv = { .tv_sec = 0, .tv_usec = 100000 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    int rcvbuf = 4 << 20;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    char *send_buf = malloc(config.size);
+    char *recv_buf = malloc((size_t)BENCH_BURST * 2048);
+    memset(send_buf, 'x', config.size);
+    struct mmsghdr send_msgs[BENCH_BURST], recv_msgs[BENCH_BURST];
+    struct iovec send_iov[BENCH_BURST], recv_iov[BENCH_BURST];
+    memset(send_msgs, 0, sizeof(send_msgs));
+    memset(recv_msgs, 0, sizeof(recv_msgs));
+    for (int i = 0; i < BENCH_BURST; i++) {
+        send_iov[i].iov_base = send_buf;
+        send_iov[i].iov_len = config.size;
+        send_msgs[i].msg_hdr.msg_iov = &send_iov[i];
+        send_msgs[i].msg_hdr.msg_iovlen = 1;
+        recv_iov[i].iov_base = recv_buf + (size_t)i * 2048;
+        recv_iov[i].iov_len = 2048;
+        recv_msgs[i].msg_hdr.msg_iov = &recv_iov[i];
+        recv_msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    unsigned long long ops = 0, lost = 0;
+    int inflight = 0;
+    double deadline = now_seconds() + config.seconds;
+    while (now_seconds() < deadline) {
+        if (inflight + BENCH_BURST <= BENCH_WINDOW) {
+            int sent = sendmmsg(fd, send_msgs, BENCH_BURST, 0);
+            if (sent > 0) inflight += sent;
+        }
+        int flags = inflight + BENCH_BURST <= BENCH_WINDOW ? MSG_DONTWAIT : MSG_WAITFORONE;
+        int got = recvmmsg(fd, recv_msgs, BENCH_BURST, flags, NULL);
+        if (got > 0) {
+            ops += got;
+            inflight -= got;
+        } else if (got < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            perror("recvmmsg");
+            break;
+        } else if (got < 0 && flags == MSG_WAITFORONE) {
+            // 窗口已满且超时没有回复，剩余的在途数据报视为丢失
+            lost += inflight;
+            inflight = 0;
+        }
+    }
+
+    atomic_fetch_add(&total_ops, ops);
+    atomic_fetch_add(&total_lost, lost);
+    free(send_buf);
+    free(recv_buf);
+    close(fd);
+    return NULL;
+}
+
+// 建立到服务器的流式连接（tcp、fanout、unix 或 seqpacket 模式）
+static int bench_connect(void) {
+    int fd;
+    if (config.addr.sin_family == AF_INET) {
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd >= 0) {
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            if (connect(fd, (struct sockaddr*)&config.addr, sizeof(config.addr)) < 0) {
+                close(fd);
+                fd = -1;
+            }
+        }
+    } else {
+        int type = strcmp(config.mode, "seqpacket") == 0 ? SOCK_SEQPACKET : SOCK_STREAM;
+        fd = socket(AF_UNIX, type, 0);
+        if (fd >= 0 && connect(fd, (struct sockaddr*)&config.unix_addr, sizeof(config.unix_addr)) < 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    return fd;
+}
+
+// 回显往返压测：每个线程一个连接，发送一条消息并等待完整回显后再发下一条
+static void* stream_bench_thread(void *arg) {
+    (void)arg;
+    int fd = bench_connect();
+    if (fd < 0) {
+        perror("connect");
+        return NULL;
+    }
+
+    char *send_buf = malloc(config.size);
+    char *recv_buf = malloc(config.size);
+    memset(send_buf, 'x', config.size);
+    unsigned int *histogram = calloc(BENCH_LATENCY_BUCKETS, sizeof(unsigned int));
+
+    unsigned long long ops = 0;
+    double deadline = now_seconds() + config.seconds;
+    for (;;) {
+        double start = now_seconds();
+        if (start >= deadline) {
+            break;
+        }
+        if (send(fd, send_buf, config.size, MSG_NOSIGNAL) != (ssize_t)config.size) {
+            perror("send");
+            break;
+        }
+        size_t received = 0;
+        while (received < config.size) {
+            ssize_t n = recv(fd, recv_buf + received, config.size - received, 0);
+            if (n <= 0) {
+                if (n < 0) perror("recv");
+                goto out;
+            }
+            received += n;
+        }
+        size_t us = (size_t)((now_seconds() - start) * 1e6);
+        histogram[us < BENCH_LATENCY_BUCKETS ? us : BENCH_LATENCY_BUCKETS - 1]++;
+        ops++;
+    }
+
+out:
+    for (size_t i = 0; i < BENCH_LATENCY_BUCKETS; i++) {
+        if (histogram[i]) atomic_fetch_add(&latency_histogram[i], histogram[i]);
+    }
+    atomic_fetch_add(&total_ops, ops);
+    free(histogram);
+    free(send_buf);
+    free(recv_buf);
+    close(fd);
+    return NULL;
+}
+
+// 重负载客户端：不等待回显，持续以流水线方式发送，同时读取回显，直到压测结束
+static void* heavy_bench_thread(void *arg) {
+    (void)arg;
+    int fd = bench_connect();
+    if (fd < 0) {
+        perror("connect");
+        return NULL;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    char *send_buf = malloc(BENCH_HEAVY_CHUNK);
+    char *recv_buf = malloc(BENCH_HEAVY_CHUNK);
+    memset(send_buf, 'x', BENCH_HEAVY_CHUNK);
+
+    unsigned long long received = 0;
+    while (!atomic_load(&heavy_stop)) {
+        struct pollfd pfd = { .fd = fd, .events = POLLIN | POLLOUT };
+        if (poll(&pfd, 1, 100) < 0 && errno != EINTR) break;
+        if (pfd.revents & (POLLERR | POLLHUP)) break;
+        if (pfd.revents & POLLOUT) {
+            send(fd, send_buf, BENCH_HEAVY_CHUNK, MSG_NOSIGNAL | MSG_DONTWAIT);
+        }
+        ssize_t n;
+        while ((n = recv(fd, recv_buf, BENCH_HEAVY_CHUNK, MSG_DONTWAIT)) > 0) {
+            received += (unsigned long long)n;
+        }
+        if (n == 0) break;
+    }
+
+    atomic_fetch_add(&heavy_bytes, received);
+    free(send_buf);
+    free(recv_buf);
+    close(fd);
+    return NULL;
+}
+
+// 从合并后的直方图中取百分位延迟（微秒）
+static size_t histogram_percentile(atomic_ullong *histogram, unsigned long long count, double p) {
+    unsigned long long target = (unsigned long long)(count * p), seen = 0;
+    for (size_t i = 0; i < BENCH_LATENCY_BUCKETS; i++) {
+        seen += atomic_load(&histogram[i]);
+        if (seen > target) return i;
+    }
+    return BENCH_LATENCY_BUCKETS - 1;
+}
+
+static size_t latency_percentile(unsigned long long count, double p) {
+    return histogram_percentile(latency_histogram, count, p);
+}
+
+// 被测服务器的累计上下文切换次数（所有线程）和 CPU 时间（时钟滴答），读取失败时返回 -1
+static int server_stats(int pid, unsigned long long *switches, unsigned long long *cpu_ticks) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+    char line[512];
+    char *fields = fgets(line, sizeof(line), f) ? strrchr(line, ')') : NULL;
+    fclose(f);
+    // 进程名可能含空格，从最后一个 ')' 之后开始解析
+    unsigned long utime = 0, stime = 0;
+    if (!fields || sscanf(fields + 1, " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu",
+                          &utime, &stime) != 2) {
+        return -1;
+    }
+    *cpu_ticks = utime + stime;
+
+    snprintf(path, sizeof(path), "/proc/%d/task", pid);
+    DIR *dir = opendir(path);
+    if (!dir) return -1;
+    *switches = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.') continue;
+        char status[300];
+        snprintf(status, sizeof(status), "/proc/%d/task/%s/status", pid, entry->d_name);
+        FILE *sf = fopen(status, "r");
+        if (!sf) continue;
+        while (fgets(line, sizeof(line), sf)) {
+            unsigned long long value;
+            if (sscanf(line, "voluntary_ctxt_switches: %llu", &value) == 1 ||
+                sscanf(line, "nonvoluntary_ctxt_switches: %llu", &value) == 1) {
+                *switches += value;
+            }
+        }
+        fclose(sf);
+    }
+    closedir(dir);
+    return 0;
+}
+
+// 统计的被测服务器读缺失计数器
+static const struct {
+    const char *name;
+    unsigned long long cache;  // PERF_COUNT_HW_CACHE_*
+} server_counters[] = {
+    { "dTLB", PERF_COUNT_HW_CACHE_DTLB },
+    { "L1D", PERF_COUNT_HW_CACHE_L1D },
+    { "LLC", PERF_COUNT_HW_CACHE_LL },
+};
+#define SERVER_COUNTER_COUNT (sizeof(server_counters) / sizeof(server_counters[0]))
+
+// 为被测服务器的每个线程打开 cache 的读缺失计数器（需要硬件 PMU 和足够的 perf_event 权限）
+// 返回: 打开的计数器数，一个都打不开时返回 -errno
+static int open_miss_counters(int pid, unsigned long long cache, int *fds, int max) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.config = cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/task", pid);
+    DIR *dir = opendir(path);
+    if (!dir) return -errno;
+    int count = 0, err = ENOENT;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL && count < max) {
+        if (entry->d_name[0] == '.') continue;
+        int fd = (int)syscall(SYS_perf_event_open, &attr, atoi(entry->d_name), -1, -1, 0);
+        if (fd >= 0) {
+            fds[count++] = fd;
+        } else {
+            err = errno;
+        }
+    }
+    closedir(dir);
+    return count > 0 ? count : -err;
+}
+
+// 累加并关闭计数器
+static unsigned long long close_miss_counters(const int *fds, int count) {
+    unsigned long long total = 0;
+    for (int i = 0; i < count; i++) {
+        unsigned long long value;
+        if (read(fds[i], &value, sizeof(value)) == sizeof(value)) {
+            total += value;
+        }
+        close(fds[i]);
+    }
+    return total;
+}
+
+// 扇出压测：subscribers 个连接订阅同一主题，发布者每次发布一条 size 字节的消息（内含序号和发布时间），
+// 在途消息不超过 BENCH_FANOUT_WINDOW 条；统计送达延迟和一条消息送达所有订阅者的时间
+#define FANOUT_TOPIC "bench"
+#define FANOUT_SUBSCRIBED "SUBSCRIBED " FANOUT_TOPIC "\n"
+
+// 订阅者连接：只保留当前消息的开头（序号和时间戳）
+typedef struct {
+    int fd;
+    int ready;        // 已收到订阅确认为 1，确认之前被关闭为 -1
+    size_t pos;       // 当前消息（或订阅确认）已接收的字节数
+    char head[48];
+} FanoutConn;
+
+typedef struct {
+    pthread_t thread;
+    FanoutConn *conns;
+    int count;
+    int first;        // 第一个连接的全局编号，用于选择源地址
+    unsigned long long deliveries;
+} FanoutThread;
+
+static int fanout_subscribers;
+static atomic_int fanout_ready;
+static atomic_int fanout_failed;
+static atomic_int fanout_stop;
+static atomic_ullong fanout_slot_seq[BENCH_FANOUT_WINDOW];
+static atomic_int fanout_slot_count[BENCH_FANOUT_WINDOW];
+
+static unsigned long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + (unsigned long long)ts.tv_nsec;
+}
+
+// 连接并订阅；回环地址上按编号分散到多个源地址，突破单个源地址的临时端口数
+static int fanout_connect(int index) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if ((ntohl(config.addr.sin_addr.s_addr) >> 24) == 127) {
+        struct sockaddr_in src = { .sin_family = AF_INET };
+        src.sin_addr.s_addr = htonl(0x7f000001u + (uint32_t)(index / BENCH_FANOUT_PER_SOURCE));
+        int one = 1;
+        setsockopt(fd, IPPROTO_IP, IP_BIND_ADDRESS_NO_PORT, &one, sizeof(one));
+        bind(fd, (struct sockaddr*)&src, sizeof(src));
+    }
+    const char sub[] = "SUB " FANOUT_TOPIC "\n";
+    if (connect(fd, (struct sockaddr*)&config.addr, sizeof(config.addr)) < 0 ||
+        send(fd, sub, sizeof(sub) - 1, MSG_NOSIGNAL) != (ssize_t)(sizeof(sub) - 1)) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// 一条消息接收完整：记录送达延迟，最后一个订阅者收到时记录扇出时间
+static void fanout_record(const FanoutConn *c, unsigned long long now) {
+    unsigned long long seq, sent;
+    if (sscanf(c->head, FANOUT_TOPIC " %llu %llu", &seq, &sent) != 2) return;
+    size_t bucket = (size_t)((now - sent) / (1000 * BENCH_FANOUT_RESOLUTION_US));
+    if (bucket >= BENCH_LATENCY_BUCKETS) bucket = BENCH_LATENCY_BUCKETS - 1;
+    atomic_fetch_add_explicit(&latency_histogram[bucket], 1, memory_order_relaxed);
+    int slot = (int)(seq % BENCH_FANOUT_WINDOW);
+    if (atomic_load(&fanout_slot_seq[slot]) == seq &&
+        atomic_fetch_add(&fanout_slot_count[slot], 1) + 1 == fanout_subscribers) {
+        atomic_fetch_add(&fanout_histogram[bucket], 1);
+    }
+}
+
+// 处理一个连接上收到的数据：先是订阅确认，之后是固定长度的消息
+static unsigned long long fanout_consume(FanoutConn *c, const char *buf, size_t n) {
+    unsigned long long messages = 0;
+    unsigned long long now = 0;
+    while (n > 0) {
+        size_t total = c->ready ? config.size : sizeof(FANOUT_SUBSCRIBED) - 1;
+        size_t take = total - c->pos < n ? total - c->pos : n;
+        if (c->ready && c->pos < sizeof(c->head) - 1) {
+            size_t copy = sizeof(c->head) - 1 - c->pos < take ? sizeof(c->head) - 1 - c->pos : take;
+            memcpy(c->head + c->pos, buf, copy);
+            c->head[c->pos + copy] = '\0';
+        }
+        c->pos += take;
+        buf += take;
+        n -= take;
+        if (c->pos < total) break;
+        c->pos = 0;
+        if (!c->ready) {
+            c->ready = 1;
+            atomic_fetch_add(&fanout_ready, 1);
+        } else {
+            if (!now) now = now_ns();
+            fanout_record(c, now);
+            messages++;
+        }
+    }
+    return messages;
+}
+
+// 接收线程：建立分到的订阅连接，用 epoll 接收推送的消息直到压测结束
+static void* fanout_thread(void *arg) {
+    FanoutThread *t = arg;
+    int ep = epoll_create1(0);
+    for (int i = 0; i < t->count; i++) {
+        FanoutConn *c = &t->conns[i];
+        c->fd = fanout_connect(t->first + i);
+        if (c->fd < 0) {
+            atomic_fetch_add(&fanout_failed, 1);
+            continue;
+        }
+        fcntl(c->fd, F_SETFL, fcntl(c->fd, F_GETFL) | O_NONBLOCK);
+        struct epoll_event ev = { .events = EPOLLIN, .data.ptr = c };
+        epoll_ctl(ep, EPOLL_CTL_ADD, c->fd, &ev);
+    }
+
+    char *buf = malloc(65536);
+    struct epoll_event events[256];
+    while (!atomic_load(&fanout_stop)) {
+        int n = epoll_wait(ep, events, 256, 100);
+        for (int i = 0; i < n; i++) {
+            FanoutConn *c = events[i].data.ptr;
+            for (;;) {
+                ssize_t r = recv(c->fd, buf, 65536, 0);
+                if (r > 0) {
+                    t->deliveries += fanout_consume(c, buf, (size_t)r);
+                    continue;
+                }
+                if (r == 0 || (errno != EAGAIN && errno != EINTR)) {
+                    // 订阅确认之前被关闭（例如服务器拒绝连接）
+                    if (!c->ready) {
+                        c->ready = -1;
+                        atomic_fetch_add(&fanout_failed, 1);
+                    }
+                    epoll_ctl(ep, EPOLL_CTL_DEL, c->fd, NULL);
+                }
+                break;
+            }
+        }
+    }
+    for (int i = 0; i < t->count; i++) {
+        if (t->conns[i].fd >= 0) close(t->conns[i].fd);
+    }
+    free(buf);
+    close(ep);
+    return NULL;
+}
+
+// 等待第 slot 个窗口位置上的消息送达所有订阅者，超时返回未送达的数量
+static unsigned long long fanout_wait_slot(int slot) {
+    double deadline = now_seconds() + BENCH_FANOUT_TIMEOUT;
+    int count;
+    while ((count = atomic_load(&fanout_slot_count[slot])) < fanout_subscribers && now_seconds() < deadline) {
+        usleep(50);
+    }
+    return count < fanout_subscribers ? (unsigned long long)(fanout_subscribers - count) : 0;
+}
+
+static int run_fanout(int subscribers) {
+    // 每个订阅者一个文件描述符
+    struct rlimit limit;
+    getrlimit(RLIMIT_NOFILE, &limit);
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+    if ((rlim_t)subscribers + 64 > limit.rlim_cur) {
+        fprintf(stderr, "%d subscribers need more than the file descriptor limit (%llu)\n", subscribers,
+                (unsigned long long)limit.rlim_cur);
+        return 1;
+    }
+
+    fanout_subscribers = subscribers;
+    FanoutConn *conns = calloc((size_t)subscribers, sizeof(FanoutConn));
+    FanoutThread threads[BENCH_FANOUT_THREADS];
+    double setup = now_seconds();
+    int first = 0;
+    for (int i = 0; i < BENCH_FANOUT_THREADS; i++) {
+        threads[i].count = subscribers / BENCH_FANOUT_THREADS + (i < subscribers % BENCH_FANOUT_THREADS);
+        threads[i].first = first;
+        threads[i].conns = conns + first;
+        threads[i].deliveries = 0;
+        first += threads[i].count;
+        pthread_create(&threads[i].thread, NULL, fanout_thread, &threads[i]);
+    }
+
+    // 所有订阅确认后开始发布
+    while (atomic_load(&fanout_ready) + atomic_load(&fanout_failed) < subscribers && now_seconds() - setup < 60) {
+        usleep(1000);
+    }
+    int ready = atomic_load(&fanout_ready);
+    printf("fanout: %d of %d subscribers ready in %.1f s\n", ready, subscribers, now_seconds() - setup);
+
+    int pub = ready == subscribers ? bench_connect() : -1;
+    unsigned long long published = 0, lost = 0;
+    double start = now_seconds(), elapsed = 0;
+    if (pub >= 0) {
+        char *line = malloc(config.size + 4);
+        double deadline = start + config.seconds;
+        for (unsigned long long seq = 0; now_seconds() < deadline; seq++) {
+            int slot = (int)(seq % BENCH_FANOUT_WINDOW);
+            if (seq >= BENCH_FANOUT_WINDOW) {
+                lost += fanout_wait_slot(slot);
+            }
+            atomic_store(&fanout_slot_count[slot], 0);
+            atomic_store(&fanout_slot_seq[slot], seq);
+
+            // "PUB " 之后的部分（主题、序号、发布时间和填充）原样推送给订阅者
+            int n = snprintf(line, config.size + 4, "PUB " FANOUT_TOPIC " %llu %llu ", seq, now_ns());
+            memset(line + n, 'x', config.size + 4 - (size_t)n);
+            line[config.size + 3] = '\n';
+            if (send(pub, line, config.size + 4, MSG_NOSIGNAL) != (ssize_t)config.size + 4) {
+                perror("publish");
+                break;
+            }
+            published++;
+        }
+        for (unsigned long long seq = published > BENCH_FANOUT_WINDOW ? published - BENCH_FANOUT_WINDOW : 0;
+             seq < published; seq++) {
+            lost += fanout_wait_slot((int)(seq % BENCH_FANOUT_WINDOW));
+        }
+        elapsed = now_seconds() - start;
+        free(line);
+        close(pub);
+    }
+
+    atomic_store(&fanout_stop, 1);
+    unsigned long long deliveries = 0;
+    for (int i = 0; i < BENCH_FANOUT_THREADS; i++) {
+        pthread_join(threads[i].thread, NULL);
+        deliveries += threads[i].deliveries;
+    }
+    free(conns);
+    if (pub < 0) {
+        fprintf(stderr, "Not all subscribers connected\n");
+        return 1;
+    }
+
+    printf("  %llu messages published (%.0f/s), %llu deliveries (%.0f/s, %.1f MB/s), %llu lost\n", published,
+           published / elapsed, deliveries, deliveries / elapsed, deliveries * config.size / elapsed / 1e6, lost);
+    if (deliveries > 0) {
+        printf("  delivery latency p50 %zu us, p99 %zu us, p99.9 %zu us\n",
+               latency_percentile(deliveries, 0.5) * BENCH_FANOUT_RESOLUTION_US,
+               latency_percentile(deliveries, 0.99) * BENCH_FANOUT_RESOLUTION_US,
+               latency_percentile(deliveries, 0.999) * BENCH_FANOUT_RESOLUTION_US);
+    }
+    unsigned long long complete = 0;
+    for (size_t i = 0; i < BENCH_LATENCY_BUCKETS; i++) {
+        complete += atomic_load(&fanout_histogram[i]);
+    }
+    if (complete > 0) {
+        printf("  all %d subscribers reached: p50 %zu us, p99 %zu us (%llu of %llu messages)\n", subscribers,
+               histogram_percentile(fanout_histogram, complete, 0.5) * BENCH_FANOUT_RESOLUTION_US,
+               histogram_percentile(fanout_histogram, complete, 0.99) * BENCH_FANOUT_RESOLUTION_US, complete, published);
+    }
+    return 0;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s udp|tcp <host> <port> [threads] [seconds] [size]\n"
+                    "       %s unix|seqpacket <path> [threads] [seconds] [size]\n"
+                    "       %s fanout <host> <port> [subscribers] [seconds] [size]   (server in pubsub mode)\n"
+                    "Set BENCH_SERVER_PID to also report the server's context switches, CPU time and cache misses\n"
+                    "Set BENCH_HEAVY=<n> to add n stream clients that pipeline without waiting for replies\n",
+            prog, prog, prog);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        usage(argv[0]);
+        return 1;
+    }
+    config.mode = argv[1];
+    void* (*thread_fn)(void*) = NULL;
+    size_t max_size = BENCH_MAX_STREAM_SIZE;
+    int arg = 2;
+    int fanout = strcmp(config.mode, "fanout") == 0;
+    if (strcmp(config.mode, "udp") == 0 || strcmp(config.mode, "tcp") == 0 || fanout) {
+        if (argc < 4) {
+            usage(argv[0]);
+            return 1;
+        }
+        config.addr.sin_family = AF_INET;
+        config.addr.sin_port = htons(atoi(argv[3]));
+        if (inet_pton(AF_INET, argv[2], &config.addr.sin_addr) != 1) {
+            fprintf(stderr, "Invalid host: %s\n", argv[2]);
+            return 1;
+        }
+        arg = 4;
+        if (config.mode[0] == 'u') {
+            thread_fn = udp_bench_thread;
+            max_size = 1400;
+        } else if (fanout) {
+            max_size = 65536;
+        } else {
+            thread_fn = stream_bench_thread;
+        }
+    } else if (strcmp(config.mode, "unix") == 0 || strcmp(config.mode, "seqpacket") == 0) {
+        if (strlen(argv[2]) >= sizeof(config.unix_addr.sun_path)) {
+            fprintf(stderr, "Socket path too long: %s\n", argv[2]);
+            return 1;
+        }
+        config.unix_addr.sun_family = AF_UNIX;
+        strcpy(config.unix_addr.sun_path, argv[2]);
+        arg = 3;
+        thread_fn = stream_bench_thread;
+        if (config.mode[0] == 's') {
+            max_size = 1024;
+        }
+    } else {
+        fprintf(stderr, "Unknown mode: %s\n", config.mode);
+        return 1;
+    }
+    config.threads = argc > arg ? atoi(argv[arg]) : (fanout ? 1000 : 4);
+    config.seconds = argc > arg + 1 ? atoi(argv[arg + 1]) : 5;
+    config.size = argc > arg + 2 ? (size_t)atoi(argv[arg + 2]) : 64;
+    if (config.threads <= 0 || config.seconds <= 0 || config.size == 0 || config.size > max_size ||
+        (fanout && config.size < 64)) {
+        fprintf(stderr, "Invalid benchmark parameters\n");
+        return 1;
+    }
+    if (fanout) {
+        return run_fanout(config.threads);
+    }
+
+    // 可选：统计被测服务器在压测期间的上下文切换和 CPU 时间
+    const char *pid_env = getenv("BENCH_SERVER_PID");
+    int server_pid = pid_env ? atoi(pid_env) : 0;
+    unsigned long long switches_before = 0, ticks_before = 0;
+    if (server_pid > 0 && server_stats(server_pid, &switches_before, &ticks_before) < 0) {
+        fprintf(stderr, "Cannot read stats of process %d\n", server_pid);
+        server_pid = 0;
+    }
+    int counter_fds[SERVER_COUNTER_COUNT][BENCH_MAX_SERVER_THREADS];
+    int counter_count[SERVER_COUNTER_COUNT];
+    for (size_t i = 0; i < SERVER_COUNTER_COUNT; i++) {
+        counter_count[i] = server_pid > 0 ? open_miss_counters(server_pid, server_counters[i].cache, counter_fds[i],
+                                                               BENCH_MAX_SERVER_THREADS) : 0;
+    }
+
+    // 可选：与往返压测的连接同时运行的重负载客户端
+    const char *heavy_env = getenv("BENCH_HEAVY");
+    int heavy = heavy_env && thread_fn == stream_bench_thread ? atoi(heavy_env) : 0;
+    if (heavy < 0) heavy = 0;
+
+    pthread_t *threads = calloc((size_t)config.threads + (size_t)heavy, sizeof(pthread_t));
+    double start = now_seconds();
+    for (int i = 0; i < heavy; i++) {
+        pthread_create(&threads[config.threads + i], NULL, heavy_bench_thread, NULL);
+    }
+    for (int i = 0; i < config.threads; i++) {
+        pthread_create(&threads[i], NULL, thread_fn, NULL);
+    }
+    for (int i = 0; i < config.threads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    double elapsed = now_seconds() - start;
+    atomic_store(&heavy_stop, 1);
+    for (int i = 0; i < heavy; i++) {
+        pthread_join(threads[config.threads + i], NULL);
+    }
+
+    unsigned long long ops = atomic_load(&total_ops);
+    printf("%s: %d thread(s), %zu-byte messages, %.1f s\n", config.mode, config.threads, config.size, elapsed);
+    if (thread_fn == udp_bench_thread) {
+        printf("  %llu replies, %.0f ops/s, %llu lost\n", ops, ops / elapsed, atomic_load(&total_lost));
+    } else if (ops > 0) {
+        printf("  %llu round trips, %.0f ops/s, %.1f MB/s each way\n", ops, ops / elapsed,
+               ops * config.size / elapsed / 1e6);
+        printf("  latency p50 %zu us, p99 %zu us, p99.9 %zu us\n", latency_percentile(ops, 0.5),
+               latency_percentile(ops, 0.99), latency_percentile(ops, 0.999));
+    }
+    if (heavy > 0) {
+        printf("  %d heavy client(s): %.1f MB/s echoed\n", heavy, atomic_load(&heavy_bytes) / elapsed / 1e6);
+    }
+    unsigned long long switches_after, ticks_after;
+    if (server_pid > 0 && ops > 0 && server_stats(server_pid, &switches_after, &ticks_after) == 0) {
+        unsigned long long switches = switches_after - switches_before;
+        printf("  server: %llu context switches (%.3f per op), %.0f ms CPU\n", switches,
+               (double)switches / ops, (ticks_after - ticks_before) * 1000.0 / sysconf(_SC_CLK_TCK));
+    }
+    for (size_t i = 0; i < SERVER_COUNTER_COUNT; i++) {
+        if (counter_count[i] > 0) {
+            unsigned long long misses = close_miss_counters(counter_fds[i], counter_count[i]);
+            if (ops > 0) {
+                printf("  server: %llu %s load misses (%.2f per op)\n", misses, server_counters[i].name,
+                       (double)misses / ops);
+            }
+        } else if (counter_count[i] < 0) {
+            printf("  server: %s miss counter unavailable (%s)\n", server_counters[i].name,
+                   strerror(-counter_count[i]));
+        }
+    }
+    free(threads);
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,251 @@
+#include "capture.h"
+#include "resource_manager.h"
+#include "logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdatomic.h>
+
+struct Capture {
+    struct ResourceManager *rm;
+    int async;                          // 是否通过 ring 写出
+    int failed;                         // 写出失败后停止本工作线程的捕获
+    struct completion_handler write_handler;
+    char *buffers[2];                   // 每个缓冲区开头预留块头
+    size_t used[2];
+    uint32_t records[2];
+    int active;                         // 接收新记录的缓冲区
+    int in_flight;                      // 另一个缓冲区是否正在写入
+    uint64_t now_ns;                    // 当前批次的时间戳
+    uint64_t flushed_ns;                // 上次写出的时间
+};
+
+static int capture_fd = -1;
+static int capture_payload = 0;
+static uint64_t capture_start_ns = 0;
+static atomic_uint_fast64_t capture_records = 0;
+static atomic_uint_fast64_t capture_dropped = 0;
+static atomic_uint_fast64_t capture_bytes = 0;
+
+static uint64_t clock_ns(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// 写入全部数据，成功返回 0
+static int write_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -errno;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+// 创建捕获文件
+int capture_init(const char *path, int payload, int workers) {
+    capture_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+    if (capture_fd < 0) {
+        return -errno;
+    }
+    capture_payload = payload;
+    capture_start_ns = clock_ns(CLOCK_MONOTONIC);
+    atomic_store(&capture_records, 0);
+    atomic_store(&capture_dropped, 0);
+    atomic_store(&capture_bytes, 0);
+
+    CaptureFileHeader header = {
+        .magic = CAPTURE_MAGIC,
+        .version = CAPTURE_VERSION,
+        .record_size = sizeof(CaptureRecord),
+        .flags = payload ? CAPTURE_FLAG_PAYLOAD : 0,
+        .workers = (uint32_t)workers,
+        .realtime_ns = clock_ns(CLOCK_REALTIME)
+    };
+    int ret = write_all(capture_fd, (const char *)&header, sizeof(header));
+    if (ret < 0) {
+        close(capture_fd);
+        capture_fd = -1;
+    }
+    return ret;
+}
+
+// 关闭捕获文件
+void capture_shutdown(void) {
+    if (capture_fd >= 0) {
+        close(capture_fd);
+        capture_fd = -1;
+    }
+}
+
+// 汇总统计
+void capture_stats(CaptureStats *stats) {
+    stats->records = atomic_load(&capture_records);
+    stats->dropped = atomic_load(&capture_dropped);
+    stats->bytes = atomic_load(&capture_bytes);
+}
+
+// 缓冲区写出结束（成功或失败）后清空。写出的字节数在提交时计入，ring 退出时在途的写请求不再回调
+static void finish_buffer(Capture *capture, int index, int ret) {
+    if (ret < 0) {
+        atomic_fetch_sub_explicit(&capture_bytes, capture->used[index], memory_order_relaxed);
+        atomic_fetch_add_explicit(&capture_dropped, capture->records[index], memory_order_relaxed);
+        if (!capture->failed) {
+            log_warn("Traffic capture write failed: %s, capture stopped on this worker", strerror(-ret));
+            capture->failed = 1;
+        }
+    }
+    capture->used[index] = sizeof(CaptureBlockHeader);
+    capture->records[index] = 0;
+}
+
+// 填写块头
+static void seal_buffer(Capture *capture, int index) {
+    CaptureBlockHeader *header = (CaptureBlockHeader *)capture->buffers[index];
+    header->magic = CAPTURE_BLOCK_MAGIC;
+    header->worker = (uint32_t)capture->rm->worker_index;
+    header->bytes = (uint32_t)(capture->used[index] - sizeof(CaptureBlockHeader));
+    header->records = capture->records[index];
+}
+
+// 写请求完成。短写时块不完整，后续其他工作线程的块会接在其后，不再续写，停止本工作线程的捕获
+static void on_capture_written(struct completion_handler *handler, struct io_uring_cqe *cqe, ResourceManager *rm) {
+    (void)rm;
+    Capture *capture = (Capture *)((char *)handler - offsetof(Capture, write_handler));
+    int flight = capture->active ^ 1;
+    int ret = cqe->res < 0 ? cqe->res : (size_t)cqe->res < capture->used[flight] ? -EIO : 0;
+    finish_buffer(capture, flight, ret);
+    capture->in_flight = 0;
+}
+
+// 提交正在接收记录的缓冲区
+static void submit_buffer(Capture *capture) {
+    int active = capture->active;
+    seal_buffer(capture, active);
+    capture->flushed_ns = capture->now_ns;
+    atomic_fetch_add_explicit(&capture_bytes, capture->used[active], memory_order_relaxed);
+    if (!capture->async) {
+        finish_buffer(capture, active, write_all(capture_fd, capture->buffers[active], capture->used[active]));
+        return;
+    }
+    struct io_uring_sqe *sqe = io_uring_get_sqe(capture->rm->ring);
+    if (!sqe) {
+        atomic_fetch_sub_explicit(&capture_bytes, capture->used[active], memory_order_relaxed);
+        return;
+    }
+    // 以 O_APPEND 打开，每个块整体追加到文件末尾
+    io_uring_prep_write(sqe, capture_fd, capture->buffers[active], (unsigned)capture->used[active], (uint64_t)-1);
+    sqe_set_completion_handler(sqe, &capture->write_handler);
+    capture->in_flight = 1;
+    capture->active = active ^ 1;
+}
+
+// 按需写出
+void capture_flush(ResourceManager *rm) {
+    Capture *capture = rm->capture;
+    if (!capture || capture->in_flight) return;
+    size_t pending = capture->used[capture->active] - sizeof(CaptureBlockHeader);
+    if (pending == 0) return;
+    if (pending >= CAPTURE_FLUSH_BYTES ||
+        capture->now_ns - capture->flushed_ns >= (uint64_t)CAPTURE_FLUSH_MS * 1000000ULL) {
+        submit_buffer(capture);
+    }
+}
+
+// 追加一条记录，缓冲区空间不足时丢弃
+static void append_record(Capture *capture, CaptureRecordType type, uint64_t conn_id,
+                          const void *data, size_t len, size_t reply_len) {
+    if (capture->failed) return;
+    size_t payload = capture_payload && data ? (len + 7) & ~(size_t)7 : 0;
+    int active = capture->active;
+    if (capture->used[active] + sizeof(CaptureRecord) + payload > CAPTURE_BUFFER_SIZE) {
+        // 对方缓冲区空闲时立即写出，否则丢弃
+        if (capture->in_flight || capture->used[active] == sizeof(CaptureBlockHeader)) {
+            atomic_fetch_add_explicit(&capture_dropped, 1, memory_order_relaxed);
+            return;
+        }
+        submit_buffer(capture);
+        active = capture->active;
+        if (capture->used[active] + sizeof(CaptureRecord) + payload > CAPTURE_BUFFER_SIZE) {
+            atomic_fetch_add_explicit(&capture_dropped, 1, memory_order_relaxed);
+            return;
+        }
+    }
+
+    char *out = capture->buffers[active] + capture->used[active];
+    CaptureRecord *record = (CaptureRecord *)out;
+    record->ts_ns = capture->now_ns - capture_start_ns;
+    record->conn_id = conn_id;
+    record->len = (uint32_t)len;
+    record->reply_len = (uint32_t)reply_len;
+    record->type = (uint16_t)type;
+    record->flags = payload ? CAPTURE_FLAG_PAYLOAD : 0;
+    record->reserved = 0;
+    if (payload) {
+        memcpy(out + sizeof(CaptureRecord), data, len);
+        memset(out + sizeof(CaptureRecord) + len, 0, payload - len);
+    }
+    capture->used[active] += sizeof(CaptureRecord) + payload;
+    capture->records[active]++;
+    atomic_fetch_add_explicit(&capture_records, 1, memory_order_relaxed);
+}
+
+void capture_open(Capture *capture, uint64_t conn_id) {
+    append_record(capture, CAPTURE_OPEN, conn_id, NULL, 0, 0);
+}
+
+void capture_close(Capture *capture, uint64_t conn_id) {
+    append_record(capture, CAPTURE_CLOSE, conn_id, NULL, 0, 0);
+}
+
+void capture_data(Capture *capture, uint64_t conn_id, const void *data, size_t len, size_t reply_len) {
+    append_record(capture, CAPTURE_DATA, conn_id, data, len, reply_len);
+}
+
+// 设置当前批次的时间戳
+void capture_set_time(Capture *capture, uint64_t now_ns) {
+    capture->now_ns = now_ns;
+}
+
+// 创建工作线程的捕获缓冲区
+Capture* capture_worker_create(ResourceManager *rm) {
+    if (capture_fd < 0) return NULL;
+    Capture *capture = calloc(1, sizeof(Capture));
+    if (!capture) return NULL;
+    capture->rm = rm;
+    capture->async = (rm->ring->features & IORING_FEAT_RW_CUR_POS) != 0;
+    capture->write_handler.on_complete = on_capture_written;
+    capture->buffers[0] = malloc(CAPTURE_BUFFER_SIZE);
+    capture->buffers[1] = malloc(CAPTURE_BUFFER_SIZE);
+    if (!capture->buffers[0] || !capture->buffers[1]) {
+        capture_worker_destroy(capture);
+        return NULL;
+    }
+    capture->used[0] = capture->used[1] = sizeof(CaptureBlockHeader);
+    capture->now_ns = capture->flushed_ns = clock_ns(CLOCK_MONOTONIC);
+    return capture;
+}
+
+// 释放捕获缓冲区。ring 退出时等待在途的写请求结束，之后只需写出正在接收记录的缓冲区
+void capture_worker_destroy(Capture *capture) {
+    if (!capture) return;
+    if (capture->buffers[0] && capture->buffers[1] && !capture->failed &&
+        capture->used[capture->active] > sizeof(CaptureBlockHeader)) {
+        int active = capture->active;
+        seal_buffer(capture, active);
+        atomic_fetch_add_explicit(&capture_bytes, capture->used[active], memory_order_relaxed);
+        finish_buffer(capture, active, write_all(capture_fd, capture->buffers[active], capture->used[active]));
+    }
+    free(capture->buffers[0]);
+    free(capture->buffers[1]);
+    free(capture);
+}
\ No newline at end of file
@@ -0,0 +1,103 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// 流量捕获：记录每个连接的建立、关闭和 on_data 收到的每条消息的时间和大小（可选记录内容），
+// 写入紧凑的二进制文件，由 traffic_replay 按原有的时间间隔（或按比例加速）回放。
+// 每个工作线程把记录追加到自己的双缓冲区，由事件循环经 ring 批量写出；所有工作线程共用一个以
+// O_APPEND 打开的文件，每次写出一个带工作线程编号的块
+
+// 每个工作线程的缓冲区大小（双缓冲），对方缓冲区仍在写出而本缓冲区已满时丢弃新记录
+#define CAPTURE_BUFFER_SIZE (256 * 1024)
+// 缓冲区积累到此大小或距上次写出超过 CAPTURE_FLUSH_MS 时写出
+#define CAPTURE_FLUSH_BYTES (64 * 1024)
+#define CAPTURE_FLUSH_MS 100
+
+// 文件格式
+#define CAPTURE_MAGIC 0x43504d52u        // "RMPC"
+#define CAPTURE_BLOCK_MAGIC 0x4b4c4243u  // "CBLK"
+#define CAPTURE_VERSION 1
+
+// 记录类型
+typedef enum {
+    CAPTURE_OPEN = 1,       // 接受连接
+    CAPTURE_DATA,           // on_data 收到一条消息
+    CAPTURE_CLOSE           // 关闭连接
+} CaptureRecordType;
+
+// 记录标志：记录之后紧跟 len 字节的消息内容，补齐到 8 字节
+#define CAPTURE_FLAG_PAYLOAD 1
+
+// 文件头
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t record_size;
+    uint32_t flags;             // CAPTURE_FLAG_PAYLOAD：消息内容随记录保存
+    uint32_t workers;
+    uint64_t realtime_ns;       // 开始捕获时的 CLOCK_REALTIME
+} CaptureFileHeader;
+
+// 块头，之后是 bytes 字节的记录
+typedef struct {
+    uint32_t magic;
+    uint32_t worker;
+    uint32_t bytes;
+    uint32_t records;
+} CaptureBlockHeader;
+
+// 记录（32 字节）
+typedef struct {
+    uint64_t ts_ns;             // 相对于开始捕获的 CLOCK_MONOTONIC 时间，取所在批次开始处理的时间
+    uint64_t conn_id;           // 连接标识（struct connection 的 id，迁移后不变）
+    uint32_t len;               // CAPTURE_DATA：收到的字节数
+    uint32_t reply_len;         // CAPTURE_DATA：on_data 写入写缓冲区的回复字节数
+    uint16_t type;              // CaptureRecordType
+    uint16_t flags;             // CAPTURE_FLAG_PAYLOAD
+    uint32_t reserved;
+} CaptureRecord;
+
+// 统计
+typedef struct {
+    uint64_t records;           // 写入缓冲区的记录数
+    uint64_t dropped;           // 缓冲区已满或写出失败而丢弃的记录数
+    uint64_t bytes;             // 写入文件的字节数（不含文件头）
+} CaptureStats;
+
+struct ResourceManager;
+
+// 每个工作线程的捕获缓冲区
+typedef struct Capture Capture;
+
+// 创建捕获文件（已存在时截断）并写入文件头，payload 非 0 时同时记录消息内容
+// 返回: 成功返回 0，失败返回 -errno
+int capture_init(const char *path, int payload, int workers);
+
+// 关闭捕获文件（所有工作线程退出后调用）
+void capture_shutdown(void);
+
+// 汇总统计（工作线程退出后完整）
+void capture_stats(CaptureStats *stats);
+
+// 为工作线程创建捕获缓冲区，ring 不支持按文件当前位置写入（IORING_FEAT_RW_CUR_POS）时在 capture_flush 中同步写出
+Capture* capture_worker_create(struct ResourceManager *rm);
+
+// 释放工作线程的捕获缓冲区（在 ring 退出后调用），同步写出剩余的记录
+void capture_worker_destroy(Capture *capture);
+
+// 设置当前批次的时间戳（CLOCK_MONOTONIC），之后的记录使用该时间
+void capture_set_time(Capture *capture, uint64_t now_ns);
+
+// 记录连接的建立和关闭
+void capture_open(Capture *capture, uint64_t conn_id);
+void capture_close(Capture *capture, uint64_t conn_id);
+
+// 记录 on_data 收到的一条消息，reply_len 为回调写入写缓冲区的回复字节数
+void capture_data(Capture *capture, uint64_t conn_id, const void *data, size_t len, size_t reply_len);
+
+// 按需写出缓冲区中的记录（事件循环在每批完成事件处理后调用）。同一时间最多一个写请求在途
+void capture_flush(struct ResourceManager *rm);
+
+#endif // CAPTURE_H
\ No newline at end of file
@@ -7,13 +7,15 @@
 
 #define INITIAL_BUFFER_SIZE 1024
 
-// 全局连接池
+// 全局连接池（热记录）和冷记录池
 MemoryPool* connection_pool = NULL;
+static MemoryPool* connection_cold_pool = NULL;
 
 // 初始化连接池
 void init_connection_pool(size_t initial_size) {
     connection_pool = memory_pool_create(sizeof(struct connection), initial_size, 64);  // 64字节对齐
-    if (!connection_pool) {
+    connection_cold_pool = memory_pool_create(sizeof(struct connection_cold), initial_size, 16);
+    if (!connection_pool || !connection_cold_pool) {
         fprintf(stderr, "Failed to create connection pool\n");
         exit(1);
     }
@@ -27,30 +29,36 @@ struct connection* get_connection() {
     }
 
     struct connection* conn = memory_pool_alloc(connection_pool);
-    if (conn == NULL) {
+    struct connection_cold* cold = conn ? memory_pool_alloc(connection_cold_pool) : NULL;
+    if (cold == NULL) {
         fprintf(stderr, "Failed to allocate new connection from pool\n");
+        if (conn) memory_pool_free(connection_pool, conn);
         return NULL;
     }
 
     // 初始化连接结构体
     memset(conn, 0, sizeof(struct connection));
+    memset(cold, 0, sizeof(struct connection_cold));
     conn->fd = -1;
     conn->state = CONN_STATE_READING;
     conn->buffer_id = -1;  // 初始化 buffer_id 为 -1
+    conn->cold = cold;
 
     // 初始化读缓冲区
-    ring_buffer_init(&conn->read_buffer, INITIAL_BUFFER_SIZE);
-    if (conn->read_buffer.buffer == NULL) {
+    ring_buffer_init(&cold->read_buffer, INITIAL_BUFFER_SIZE);
+    if (cold->read_buffer.buffer == NULL) {
         fprintf(stderr, "Failed to initialize read buffer\n");
+        memory_pool_free(connection_cold_pool, cold);
         memory_pool_free(connection_pool, conn);
         return NULL;
     }
 
     // 初始化写缓冲区
-    ring_buffer_init(&conn->write_buffer, INITIAL_BUFFER_SIZE);
-    if (conn->write_buffer.buffer == NULL) {
+    ring_buffer_init(&cold->write_buffer, INITIAL_BUFFER_SIZE);
+    if (cold->write_buffer.buffer == NULL) {
         fprintf(stderr, "Failed to initialize write buffer\n");
-        ring_buffer_destroy(&conn->read_buffer);  // 清理读缓冲区
+        ring_buffer_destroy(&cold->read_buffer);  // 清理读缓冲区
+        memory_pool_free(connection_cold_pool, cold);
         memory_pool_free(connection_pool, conn);
         return NULL;
     }
@@ -71,15 +79,14 @@ void put_connection(struct connection* conn) {
         close(conn->fd);
     }
     // 销毁缓冲区
-    ring_buffer_destroy(&conn->read_buffer);
-    ring_buffer_destroy(&conn->write_buffer);
+    ring_buffer_destroy(&conn->cold->read_buffer);
+    ring_buffer_destroy(&conn->cold->write_buffer);
 
-    // 重置连接结构体
+    // 将冷记录和连接归还到内存池
+    memory_pool_free(connection_cold_pool, conn->cold);
     memset(conn, 0, sizeof(struct connection));
     conn->fd = -1;
     conn->buffer_id = -1;  // 重置 buffer_id 为 -1
-
-    // 将连接归还到内存池
     memory_pool_free(connection_pool, conn);
 }
 
@@ -89,4 +96,8 @@ void clean_connection_pool() {
         memory_pool_destroy(connection_pool);
         connection_pool = NULL;
     }
+    if (connection_cold_pool) {
+        memory_pool_destroy(connection_cold_pool);
+        connection_cold_pool = NULL;
+    }
 }
\ No newline at end of file
@@ -0,0 +1,226 @@
+#include "coroutine.h"
+#include "resource_manager.h"
+#include "memory_pool.h"
+#include "error.h"
+#include "logger.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+// 进行中的操作带有链接的超时，被取消时结果改为 -ETIMEDOUT
+#define CO_FLAG_TIMED 1
+// 进行中的操作是 co_sleep，到期（-ETIME）时结果改为 0
+#define CO_FLAG_SLEEP 2
+
+struct CoroutineScheduler {
+    coroutine_fn fn;
+    size_t frame_size;
+    MemoryPool *frames;     // 帧只在事件循环线程中分配和释放
+    int stopped;
+};
+
+// 链接超时的完成事件无需处理（结果由被链接的请求带回）
+static void on_link_timeout(struct completion_handler *handler, struct io_uring_cqe *cqe, ResourceManager *rm) {
+    (void)handler;
+    (void)cqe;
+    (void)rm;
+}
+
+static struct completion_handler link_timeout_handler = { on_link_timeout };
+
+// 创建调度器
+CoroutineScheduler* coroutine_scheduler_create(coroutine_fn fn, size_t frame_size) {
+    CoroutineScheduler *sched = calloc(1, sizeof(CoroutineScheduler));
+    if (!sched) {
+        return NULL;
+    }
+    sched->fn = fn;
+    sched->frame_size = frame_size < sizeof(Coroutine) ? sizeof(Coroutine) : frame_size;
+    sched->frames = memory_pool_create(sched->frame_size, 1024, 16);
+    if (!sched->frames) {
+        free(sched);
+        return NULL;
+    }
+    return sched;
+}
+
+// 停止调度器
+void coroutine_scheduler_stop(CoroutineScheduler *sched) {
+    sched->stopped = 1;
+}
+
+// 释放调度器
+void coroutine_scheduler_destroy(CoroutineScheduler *sched) {
+    if (!sched) return;
+    memory_pool_destroy(sched->frames);
+    free(sched);
+}
+
+// 执行协程直到下一个等待点，结束时关闭连接并释放帧
+static void coroutine_run(Coroutine *co) {
+    ResourceManager *rm = co->rm;
+    CoroutineScheduler *sched = rm->coroutines;
+    if (sched->fn(co) == CO_SUSPENDED) {
+        return;
+    }
+    close_connection(rm, co->conn);
+    memory_pool_free(sched->frames, co);
+}
+
+// 协程等待的操作完成：记录结果并从等待点继续
+static void coroutine_resume(Coroutine *co, int result) {
+    if (co->rm->coroutines->stopped) {
+        return;
+    }
+    if ((co->flags & CO_FLAG_TIMED) && result == -ECANCELED) {
+        result = -ETIMEDOUT;
+    } else if ((co->flags & CO_FLAG_SLEEP) && result == -ETIME) {
+        result = 0;
+    }
+    co->flags = 0;
+    co->result = result;
+    coroutine_run(co);
+}
+
+static void on_coroutine_complete(struct completion_handler *handler, struct io_uring_cqe *cqe, ResourceManager *rm) {
+    (void)rm;
+    coroutine_resume((Coroutine *)((char *)handler - offsetof(Coroutine, handler)), cqe->res);
+}
+
+// 启动协程
+int coroutine_start(ResourceManager *rm, struct connection *conn) {
+    CoroutineScheduler *sched = rm->coroutines;
+    Coroutine *co = memory_pool_alloc(sched->frames);
+    if (!co) {
+        log_error("Failed to allocate coroutine frame");
+        return -1;
+    }
+    memset(co, 0, sched->frame_size);
+    co->handler.on_complete = on_coroutine_complete;
+    co->rm = rm;
+    co->conn = conn;
+    coroutine_run(co);
+    return 0;
+}
+
+// 获取 SQE，SQ 已满时先提交
+static struct io_uring_sqe* get_sqe(struct io_uring *ring) {
+    struct io_uring_sqe *sqe = io_uring_get_sqe(ring);
+    if (!sqe) {
+        io_uring_submit(ring);
+        sqe = io_uring_get_sqe(ring);
+    }
+    return sqe;
+}
+
+static void set_timeout(Coroutine *co, unsigned ms) {
+    co->timeout.tv_sec = ms / 1000;
+    co->timeout.tv_nsec = (long long)(ms % 1000) * 1000000LL;
+}
+
+int co_recv(Coroutine *co, void *buf, size_t len) {
+    struct io_uring_sqe *sqe = get_sqe(co->rm->ring);
+    if (!sqe) return -EAGAIN;
+    io_uring_prep_recv(sqe, co->conn->fd, buf, len, 0);
+    sqe_set_completion_handler(sqe, &co->handler);
+    return 0;
+}
+
+int co_recv_timeout(Coroutine *co, void *buf, size_t len, unsigned timeout_ms) {
+    struct io_uring *ring = co->rm->ring;
+    // 接收和链接的超时必须连续取得
+    if (io_uring_sq_space_left(ring) < 2) {
+        io_uring_submit(ring);
+        if (io_uring_sq_space_left(ring) < 2) return -EAGAIN;
+    }
+    struct io_uring_sqe *sqe = io_uring_get_sqe(ring);
+    io_uring_prep_recv(sqe, co->conn->fd, buf, len, 0);
+    sqe_set_completion_handler(sqe, &co->handler);
+    io_uring_sqe_set_flags(sqe, IOSQE_IO_LINK);
+
+    set_timeout(co, timeout_ms);
+    sqe = io_uring_get_sqe(ring);
+    io_uring_prep_link_timeout(sqe, &co->timeout, 0);
+    sqe_set_completion_handler(sqe, &link_timeout_handler);
+    co->flags |= CO_FLAG_TIMED;
+    return 0;
+}
+
+int co_send(Coroutine *co, const void *buf, size_t len) {
+    struct io_uring_sqe *sqe = get_sqe(co->rm->ring);
+    if (!sqe) return -EAGAIN;
+    // MSG_WAITALL：短写由内核继续发送，只有出错才提前完成
+    io_uring_prep_send(sqe, co->conn->fd, buf, len, MSG_WAITALL);
+    sqe_set_completion_handler(sqe, &co->handler);
+    return 0;
+}
+
+int co_sleep(Coroutine *co, unsigned ms) {
+    struct io_uring_sqe *sqe = get_sqe(co->rm->ring);
+    if (!sqe) return -EAGAIN;
+    set_timeout(co, ms);
+    io_uring_prep_timeout(sqe, &co->timeout, 0, 0);
+    sqe_set_completion_handler(sqe, &co->handler);
+    co->flags |= CO_FLAG_SLEEP;
+    return 0;
+}
+
+int co_yield(Coroutine *co) {
+    struct io_uring_sqe *sqe = get_sqe(co->rm->ring);
+    if (!sqe) return -EAGAIN;
+    io_uring_prep_nop(sqe);
+    sqe_set_completion_handler(sqe, &co->handler);
+    return 0;
+}
+
+// 文件操作完成，读取的数据只在回调期间有效，复制到协程的目标缓冲区
+static void on_file_done(struct connection *conn, ssize_t res, const char *data, void *arg, ResourceManager *rm) {
+    (void)conn;
+    (void)rm;
+    Coroutine *co = arg;
+    if (data && res > 0 && co->op.read.buf) {
+        memcpy(co->op.read.buf, data, (size_t)res < co->op.read.len ? (size_t)res : co->op.read.len);
+    }
+    co->op.read.buf = NULL;
+    coroutine_resume(co, (int)res);
+}
+
+int co_file_read(Coroutine *co, AsyncFile *file, off_t offset, void *buf, size_t len) {
+    co->op.read.buf = buf;
+    co->op.read.len = len;
+    return async_file_read(co->rm, file, NULL, offset, len, on_file_done, co);
+}
+
+int co_file_write(Coroutine *co, AsyncFile *file, off_t offset, const void *data, size_t len) {
+    co->op.read.buf = NULL;
+    return async_file_write(co->rm, file, NULL, offset, data, len, on_file_done, co);
+}
+
+int co_file_fsync(Coroutine *co, AsyncFile *file, int datasync) {
+    co->op.read.buf = NULL;
+    return async_file_fsync(co->rm, file, NULL, datasync, on_file_done, co);
+}
+
+int co_file_append(Coroutine *co, AsyncFile *file, const void *data, size_t len) {
+    co->op.read.buf = NULL;
+    return async_file_append(co->rm, file, NULL, data, len, on_file_done, co);
+}
+
+// 在卸载线程中执行协程的任务
+static void offload_work(void *arg) {
+    Coroutine *co = arg;
+    co->op.work.fn(co->op.work.arg);
+}
+
+static void offload_done(struct connection *conn, void *arg, ResourceManager *rm) {
+    (void)conn;
+    (void)rm;
+    coroutine_resume(arg, 0);
+}
+
+int co_offload(Coroutine *co, offload_work_fn work, void *arg) {
+    if (!co->rm->offload_pool) return -ENOSYS;
+    co->op.work.fn = work;
+    co->op.work.arg = arg;
+    return offload_submit(co->rm, NULL, offload_work, offload_done, co) == 0 ? 0 : -ENOMEM;
+}
\ No newline at end of file
@@ -0,0 +1,119 @@
+#ifndef COROUTINE_H
+#define COROUTINE_H
+
+#include <sys/types.h>
+#include <linux/time_types.h>
+#include "iouring_server.h"
+#include "offload.h"
+#include "file_io.h"
+
+// 无栈协程：处理器写成顺序代码，在等待点（CO_AWAIT）提交 ring 请求后返回，请求完成时从等待点继续执行。
+// 协程不保存栈，局部变量在等待点之后失效，需要跨等待点保存的状态放在帧结构体中：
+//
+//     typedef struct {
+//         Coroutine co;       // 必须是第一个成员
+//         char buf[256];
+//     } EchoFrame;
+//
+//     static int echo(Coroutine *co) {
+//         EchoFrame *f = (EchoFrame *)co;
+//         CO_BEGIN(co);
+//         for (;;) {
+//             CO_AWAIT(co, co_recv(co, f->buf, sizeof(f->buf)));
+//             if (co->result <= 0) CO_RETURN(co);
+//             CO_AWAIT(co, co_send(co, f->buf, (size_t)co->result));
+//             if (co->result < 0) CO_RETURN(co);
+//         }
+//         CO_END(co);
+//     }
+//
+// 每个连接一个协程，连接就绪时从头开始执行，返回（CO_RETURN 或执行到 CO_END）后连接被关闭。
+// 帧从工作线程的内存池分配并清零；协程不使用连接的固定缓冲区，挂起时只占用连接结构体和帧
+// 协程内不能使用 switch 语句跨越 CO_AWAIT（CO_BEGIN 本身是一个 switch）
+
+// 协程函数的返回值
+#define CO_SUSPENDED 0   // 已提交请求，等待完成后恢复
+#define CO_DONE 1        // 执行结束，关闭连接
+
+// 协程状态，嵌入在帧结构体开头
+typedef struct Coroutine {
+    struct completion_handler handler;   // 等待的请求完成时恢复协程
+    struct ResourceManager *rm;
+    struct connection *conn;             // 协程所属的连接
+    int line;                            // 恢复点（CO_AWAIT 所在的行号），0 为开始
+    int result;                          // 最近一次等待的结果：字节数或 -errno
+    int flags;                           // 进行中的操作的附加信息，由调度器使用
+    union {
+        struct { void *buf; size_t len; } read;          // co_file_read 的目标缓冲区
+        struct { offload_work_fn fn; void *arg; } work;  // co_offload 的任务
+    } op;
+    struct __kernel_timespec timeout;    // co_sleep 和 co_recv_timeout 的超时
+} Coroutine;
+
+// 协程调度器类型（每个工作线程一个）
+typedef struct CoroutineScheduler CoroutineScheduler;
+
+#define CO_BEGIN(co) switch ((co)->line) { case 0:
+#define CO_END(co) } (co)->line = -1; return CO_DONE
+
+// 发起操作 op（以下 co_* 函数之一），成功提交时挂起，完成后 co->result 为操作结果；
+// 提交失败时不挂起，co->result 为 op 返回的 -errno
+#define CO_AWAIT(co, op) \
+    do { \
+        (co)->line = __LINE__; \
+        if (((co)->result = (op)) == 0) return CO_SUSPENDED; \
+        __attribute__((fallthrough)); \
+        case __LINE__:; \
+    } while (0)
+
+// 结束协程，关闭连接
+#define CO_RETURN(co) do { (co)->line = -1; return CO_DONE; } while (0)
+
+// 创建调度器，每个协程的帧为 frame_size 字节（不小于 sizeof(Coroutine)）
+CoroutineScheduler* coroutine_scheduler_create(coroutine_fn fn, size_t frame_size);
+
+// 停止调度器：此后完成的请求不再恢复协程（在 ring 退出前调用，之后的清理回调不会再提交请求）
+void coroutine_scheduler_stop(CoroutineScheduler *sched);
+
+// 释放调度器和所有帧（在卸载线程池和异步文件清理之后调用）
+void coroutine_scheduler_destroy(CoroutineScheduler *sched);
+
+// 为就绪的连接启动协程
+// 返回: 成功返回 0（协程可能已经执行结束并关闭了连接），失败返回 -1（连接未关闭）
+int coroutine_start(struct ResourceManager *rm, struct connection *conn);
+
+// 以下操作在工作线程的 ring 上异步执行，完成时恢复协程，配合 CO_AWAIT 使用
+// 缓冲区在操作完成前必须保持有效（通常放在帧中）
+// 返回: 成功提交返回 0，失败返回 -errno
+
+// 接收最多 len 字节，结果为接收的字节数，0 表示对端已关闭
+int co_recv(Coroutine *co, void *buf, size_t len);
+
+// 同 co_recv，timeout_ms 毫秒内没有数据时结果为 -ETIMEDOUT
+int co_recv_timeout(Coroutine *co, void *buf, size_t len, unsigned timeout_ms);
+
+// 发送 len 字节（内核发送完全部数据或出错才完成），结果为发送的字节数
+int co_send(Coroutine *co, const void *buf, size_t len);
+
+// 等待 ms 毫秒，结果为 0
+int co_sleep(Coroutine *co, unsigned ms);
+
+// 让出执行，本轮其他完成事件处理后继续，结果为 0
+int co_yield(Coroutine *co);
+
+// 读取文件 offset 处的 len 字节到 buf，结果为读取的字节数（见 async_file_read）
+int co_file_read(Coroutine *co, AsyncFile *file, off_t offset, void *buf, size_t len);
+
+// 把 data 写入文件 offset 处，调用返回后 data 即可复用（见 async_file_write）
+int co_file_write(Coroutine *co, AsyncFile *file, off_t offset, const void *data, size_t len);
+
+// 将文件数据刷到存储设备（见 async_file_fsync）
+int co_file_fsync(Coroutine *co, AsyncFile *file, int datasync);
+
+// 组提交追加，数据持久化后恢复（见 async_file_append）
+int co_file_append(Coroutine *co, AsyncFile *file, const void *data, size_t len);
+
+// 在卸载线程池中执行 work(arg)，完成后恢复，结果为 0（线程池未启用时返回 -ENOSYS）
+int co_offload(Coroutine *co, offload_work_fn work, void *arg);
+
+#endif // COROUTINE_H
\ No newline at end of file
@@ -1,11 +1,12 @@
 #include "error.h"
+#include "logger.h"
 #include <stdio.h>
 #include <stdlib.h>
 
 // 处理错误的函数
 void handle_error(ErrorCode code, const char* message) {
-    // 输出错误信息到标准错误流
-    fprintf(stderr, "Error: %s (Code: %d)\n", message, code);
+    // 输出错误信息，工作线程中经日志缓冲区异步写出；以消息作为调用点限速
+    log_write(LOG_ERROR, message, "%s (Code: %d)", message, code);
 
     // 根据错误代码决定处理方式
     switch (code) {
@@ -13,7 +14,8 @@ void handle_error(ErrorCode code, const char* message) {
         case ERR_SOCKET_CREATE_FAILED:
         case ERR_URING_INIT_FAILED:
         case ERR_RESOURCE_INIT_FAILED:
-            // 这些错误被认为是致命错误，程序将退出
+            // 这些错误被认为是致命错误，程序将退出，退出前写出缓冲区中的日志
+            log_flush_sync();
             exit(EXIT_FAILURE);
         default:
             // 对于其他错误，让调用者决定如何处理
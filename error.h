@@ -12,7 +12,8 @@ typedef enum {
     ERR_URING_QUEUE_FULL,          // io_uring 队列已满
     ERR_CONNECTION_LIMIT_REACHED,  // 达到连接数限制
     ERR_INVALID_ARGUMENT,          // 无效参数
-    ERR_RESOURCE_INIT_FAILED       // 资源初始化失败
+    ERR_RESOURCE_INIT_FAILED,      // 资源初始化失败
+    ERR_RESOURCE_EXHAUSTED         // 运行中资源耗尽（缓冲区、连接池等），由调用者拒绝或关闭相应连接
 } ErrorCode;
 
 // 错误处理函数声明
@@ -0,0 +1,633 @@
+#define _GNU_SOURCE
+#include "file_io.h"
+#include "resource_manager.h"
+#include "memory_pool.h"
+#include "logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+typedef enum {
+    FILE_OP_READ,
+    FILE_OP_WRITE,
+    FILE_OP_FSYNC,
+    FILE_OP_APPEND
+} FileOpType;
+
+// 一次文件操作，追加操作在组提交完成前挂在批次的等待链表上
+typedef struct FileOp {
+    struct completion_handler handler;
+    AsyncFile *file;
+    FileOpType type;
+    file_io_done_fn done;
+    void *arg;
+    struct connection *conn;
+    uint64_t conn_id;
+    int conn_fd;
+    int io_buffer;
+    size_t len;
+    struct FileOp *prev;         // 文件的未完成操作链表
+    struct FileOp *next;
+    struct FileOp *next_waiter;  // 同一批次的追加操作
+} FileOp;
+
+// 进行中的组提交：链接的若干 WRITE_FIXED 加一个 FSYNC
+typedef struct {
+    struct completion_handler write_done;
+    struct completion_handler sync_done;
+    int buffers[FILE_COMMIT_MAX_BUFFERS];
+    int buffer_count;
+    FileOp *waiters;
+    size_t expected;   // 应写入的字节数（O_DIRECT 含块尾填充）
+    size_t written;
+    int pending;       // 尚未返回的 CQE 数
+    int result;
+} FileCommit;
+
+struct AsyncFile {
+    ResourceManager *rm;
+    int fd;
+    int slot;          // 固定文件槽位，-1 表示使用普通 fd
+    int direct;
+    off_t size;        // 逻辑大小，即下一次追加的位置
+    int error;         // 组提交失败后不再接受追加
+    int inflight;      // 进行中的读、写和 fsync 数
+    int busy;          // 正在执行回调，期间不能释放
+    int closing;
+    MemoryPool *op_pool;
+    FileOp *ops;
+
+    // 正在累积的批次
+    int batch_buffers[FILE_COMMIT_MAX_BUFFERS];
+    int batch_count;
+    size_t batch_len;  // O_DIRECT 时包含开头重写的不完整块
+    FileOp *batch_head;
+    FileOp *batch_tail;
+    int kick_pending;  // 已提交 NOP，本轮事件处理结束后开始提交
+    struct completion_handler kick;
+
+    FileCommit commit;
+    int committing;
+
+    char *tail;        // O_DIRECT：文件最后一个不完整块的内容，下次提交时重写该块
+    size_t tail_len;
+
+    struct AsyncFile *next;
+};
+
+static size_t align_up(size_t value) {
+    return (value + FILE_IO_ALIGN - 1) & ~((size_t)FILE_IO_ALIGN - 1);
+}
+
+static char* io_buffer_data(ResourceManager *rm, int index) {
+    return rm->buffers[index].iov_base;
+}
+
+// 设置请求的目标文件，已注册时使用固定文件槽位
+static void sqe_set_file(struct io_uring_sqe *sqe, AsyncFile *file) {
+    if (file->slot >= 0) {
+        sqe->fd = file->slot;
+        sqe->flags |= IOSQE_FIXED_FILE;
+    } else {
+        sqe->fd = file->fd;
+    }
+}
+
+// 确保 SQ 中有 count 个空位，不足时先提交已准备的请求
+static int reserve_sqes(struct io_uring *ring, unsigned count) {
+    if (io_uring_sq_space_left(ring) < count) {
+        io_uring_submit(ring);
+    }
+    return io_uring_sq_space_left(ring) >= count ? 0 : -EAGAIN;
+}
+
+static FileOp* op_create(AsyncFile *file, struct connection *conn, FileOpType type,
+                         file_io_done_fn done, void *arg) {
+    FileOp *op = memory_pool_alloc(file->op_pool);
+    if (!op) {
+        return NULL;
+    }
+    memset(op, 0, sizeof(FileOp));
+    op->file = file;
+    op->type = type;
+    op->done = done;
+    op->arg = arg;
+    op->io_buffer = -1;
+    if (conn) {
+        op->conn = conn;
+        op->conn_id = conn->id;
+        op->conn_fd = conn->fd;
+    }
+    op->next = file->ops;
+    if (file->ops) file->ops->prev = op;
+    file->ops = op;
+    return op;
+}
+
+static void op_unlink(AsyncFile *file, FileOp *op) {
+    if (op->prev) op->prev->next = op->next;
+    else file->ops = op->next;
+    if (op->next) op->next->prev = op->prev;
+    if (op->io_buffer >= 0) {
+        release_io_buffer(file->rm, op->io_buffer);
+    }
+}
+
+// 放弃尚未提交的操作（提交失败时使用，不回调 done）
+static void op_discard(AsyncFile *file, FileOp *op) {
+    op_unlink(file, op);
+    memory_pool_free(file->op_pool, op);
+}
+
+// 操作完成：回调 done，并恢复发起操作的连接
+static void op_complete(AsyncFile *file, FileOp *op, ssize_t res, const char *data) {
+    ResourceManager *rm = file->rm;
+    struct connection *conn = op->conn ? connection_alive(rm, op->conn, op->conn_fd, op->conn_id) : NULL;
+
+    if (op->done) {
+        op->done(conn, res, data, op->arg, rm);
+    }
+    op_unlink(file, op);
+    memory_pool_free(file->op_pool, op);
+
+    if (conn && --conn->pending_jobs == 0) {
+        resume_connection(rm, conn);
+    }
+}
+
+// 发起操作的连接在操作完成前暂停收发
+static void park_connection(struct connection *conn) {
+    if (conn) {
+        conn->pending_jobs++;
+    }
+}
+
+// 关闭文件并释放内存，ring_alive 为 0 时 ring 已退出，不再注销固定文件槽位
+static void file_release(AsyncFile *file, int ring_alive) {
+    ResourceManager *rm = file->rm;
+    AsyncFile **link = &rm->async_files;
+    while (*link && *link != file) {
+        link = &(*link)->next;
+    }
+    if (*link) {
+        *link = file->next;
+    }
+
+    // O_DIRECT 写入按块填充，关闭时截断到逻辑大小
+    if (file->direct && ftruncate(file->fd, file->size) != 0) {
+        log_error("Failed to truncate file: %s", strerror(errno));
+    }
+    if (file->slot >= 0 && ring_alive) {
+        release_file_slot(rm, file->slot);
+    }
+    close(file->fd);
+    memory_pool_destroy(file->op_pool);
+    free(file->tail);
+    free(file);
+}
+
+static void start_commit(AsyncFile *file);
+
+// 回调结束后检查：关闭中的文件先提交剩余批次，所有操作完成后释放
+static void file_settle(AsyncFile *file) {
+    if (file->busy > 0) {
+        return;
+    }
+    if (file->closing && file->batch_head && !file->committing) {
+        start_commit(file);
+    }
+    if (file->closing && file->inflight == 0 && !file->committing && !file->kick_pending &&
+        !file->batch_head) {
+        file_release(file, 1);
+    }
+}
+
+// 以 res 完成一批追加操作
+static void complete_waiters(AsyncFile *file, FileOp *waiters, int result) {
+    while (waiters) {
+        FileOp *op = waiters;
+        waiters = op->next_waiter;
+        op_complete(file, op, result < 0 ? result : (ssize_t)op->len, NULL);
+    }
+}
+
+// 组提交完成
+static void finish_commit(AsyncFile *file) {
+    FileCommit *c = &file->commit;
+    int result = c->result;
+    if (c->written != c->expected && (result == 0 || result == -ECANCELED)) {
+        result = -EIO;
+    }
+    if (result < 0) {
+        // 写入或 fdatasync 失败后无法确定哪些数据已落盘，之后的追加一律失败
+        log_error("Group commit failed: %s", strerror(-result));
+        file->error = result;
+    }
+
+    for (int i = 0; i < c->buffer_count; i++) {
+        release_io_buffer(file->rm, c->buffers[i]);
+    }
+    FileOp *waiters = c->waiters;
+    c->waiters = NULL;
+    c->buffer_count = 0;
+    file->committing = 0;
+
+    file->busy++;
+    complete_waiters(file, waiters, result);
+    file->busy--;
+
+    // 提交期间累积的追加立即开始下一次提交
+    if (file->batch_head) {
+        start_commit(file);
+    }
+    file_settle(file);
+}
+
+static void record_commit_result(FileCommit *c, int res) {
+    // 链接中断导致的 ECANCELED 不掩盖真正的错误
+    if (res < 0 && (c->result == 0 || c->result == -ECANCELED)) {
+        c->result = res;
+    }
+}
+
+static void on_commit_write(struct completion_handler *handler, struct io_uring_cqe *cqe, ResourceManager *rm) {
+    (void)rm;
+    FileCommit *c = (FileCommit*)((char*)handler - offsetof(FileCommit, write_done));
+    AsyncFile *file = (AsyncFile*)((char*)c - offsetof(AsyncFile, commit));
+    if (cqe->res < 0) {
+        record_commit_result(c, cqe->res);
+    } else {
+        c->written += cqe->res;
+    }
+    if (--c->pending == 0) {
+        finish_commit(file);
+    }
+}
+
+static void on_commit_sync(struct completion_handler *handler, struct io_uring_cqe *cqe, ResourceManager *rm) {
+    (void)rm;
+    FileCommit *c = (FileCommit*)((char*)handler - offsetof(FileCommit, sync_done));
+    AsyncFile *file = (AsyncFile*)((char*)c - offsetof(AsyncFile, commit));
+    record_commit_result(c, cqe->res);
+    if (--c->pending == 0) {
+        finish_commit(file);
+    }
+}
+
+// 把当前批次作为一次组提交：每个缓冲区一个 WRITE_FIXED，以 IOSQE_IO_LINK 串联，最后是 fdatasync
+static void start_commit(AsyncFile *file) {
+    ResourceManager *rm = file->rm;
+    FileCommit *c = &file->commit;
+
+    FileOp *waiters = file->batch_head;
+    int count = file->batch_count;
+    size_t len = file->batch_len;
+    file->batch_head = file->batch_tail = NULL;
+    file->batch_count = 0;
+    file->batch_len = 0;
+    memcpy(c->buffers, file->batch_buffers, sizeof(int) * count);
+    c->buffer_count = count;
+    c->waiters = waiters;
+
+    int result = file->error;
+    if (result == 0) {
+        result = reserve_sqes(rm->ring, count + 1);
+    }
+    if (result < 0) {
+        file->committing = 1;
+        c->result = result;
+        c->written = c->expected = 0;
+        finish_commit(file);
+        return;
+    }
+
+    off_t base = file->size - (off_t)file->tail_len;
+    size_t total = len;
+    if (file->direct) {
+        // 块尾填充 0，下次提交会重写这个块，关闭时截断
+        total = align_up(len);
+        char *last = io_buffer_data(rm, c->buffers[count - 1]);
+        size_t used = len - (size_t)(count - 1) * IO_BUFFER_SIZE;
+        memset(last + used, 0, total - len);
+    } else {
+        base = file->size;
+    }
+
+    for (int i = 0; i < count; i++) {
+        size_t chunk = total - (size_t)i * IO_BUFFER_SIZE;
+        if (chunk > IO_BUFFER_SIZE) chunk = IO_BUFFER_SIZE;
+        struct io_uring_sqe *sqe = io_uring_get_sqe(rm->ring);
+        io_uring_prep_write_fixed(sqe, 0, io_buffer_data(rm, c->buffers[i]), (unsigned)chunk,
+                                  base + (off_t)i * IO_BUFFER_SIZE, c->buffers[i]);
+        sqe_set_file(sqe, file);
+        sqe->flags |= IOSQE_IO_LINK;
+        sqe_set_completion_handler(sqe, &c->write_done);
+    }
+    struct io_uring_sqe *sqe = io_uring_get_sqe(rm->ring);
+    io_uring_prep_fsync(sqe, 0, IORING_FSYNC_DATASYNC);
+    sqe_set_file(sqe, file);
+    sqe_set_completion_handler(sqe, &c->sync_done);
+
+    c->expected = total;
+    c->written = 0;
+    c->result = 0;
+    c->pending = count + 1;
+    file->committing = 1;
+
+    // 提交开始时即推进逻辑大小，之后的追加接在本批次之后
+    size_t data_len = len - (file->direct ? file->tail_len : 0);
+    file->size += (off_t)data_len;
+    if (file->direct) {
+        file->tail_len = (size_t)(file->size % FILE_IO_ALIGN);
+        if (file->tail_len > 0) {
+            size_t start = len - file->tail_len;
+            memcpy(file->tail, io_buffer_data(rm, c->buffers[start / IO_BUFFER_SIZE]) + start % IO_BUFFER_SIZE,
+                   file->tail_len);
+        }
+    }
+}
+
+// NOP 完成时本轮事件已全部处理，期间到达的追加合并为一批
+static void on_commit_kick(struct completion_handler *handler, struct io_uring_cqe *cqe, ResourceManager *rm) {
+    (void)cqe;
+    (void)rm;
+    AsyncFile *file = (AsyncFile*)((char*)handler - offsetof(AsyncFile, kick));
+    file->kick_pending = 0;
+    if (file->batch_head && !file->committing) {
+        start_commit(file);
+    }
+    file_settle(file);
+}
+
+static void schedule_commit(AsyncFile *file) {
+    if (file->committing || file->kick_pending) {
+        return;
+    }
+    struct io_uring_sqe *sqe = reserve_sqes(file->rm->ring, 1) == 0 ? io_uring_get_sqe(file->rm->ring) : NULL;
+    if (!sqe) {
+        start_commit(file);
+        return;
+    }
+    io_uring_prep_nop(sqe);
+    sqe_set_completion_handler(sqe, &file->kick);
+    file->kick_pending = 1;
+}
+
+// 单个读、写、fsync 操作完成
+static void on_op_complete(struct completion_handler *handler, struct io_uring_cqe *cqe, ResourceManager *rm) {
+    FileOp *op = (FileOp*)((char*)handler - offsetof(FileOp, handler));
+    AsyncFile *file = op->file;
+    const char *data = NULL;
+    if (op->type == FILE_OP_READ && cqe->res >= 0) {
+        data = io_buffer_data(rm, op->io_buffer);
+    }
+
+    file->inflight--;
+    file->busy++;
+    op_complete(file, op, cqe->res, data);
+    file->busy--;
+    file_settle(file);
+}
+
+// 打开文件
+AsyncFile* async_file_open(ResourceManager *rm, const char *path, int flags, mode_t mode) {
+    // O_DIRECT 追加需要读回最后一个不完整的块
+    if ((flags & O_DIRECT) && (flags & O_ACCMODE) == O_WRONLY) {
+        flags = (flags & ~O_ACCMODE) | O_RDWR;
+    }
+    int fd = open(path, flags | O_CLOEXEC, mode);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        int err = errno;
+        close(fd);
+        errno = err;
+        return NULL;
+    }
+
+    AsyncFile *file = calloc(1, sizeof(AsyncFile));
+    if (file) {
+        file->tail = aligned_alloc(FILE_IO_ALIGN, FILE_IO_ALIGN);
+        file->op_pool = memory_pool_create(sizeof(FileOp), 64, 64);
+    }
+    if (!file || !file->tail || !file->op_pool) {
+        if (file) {
+            free(file->tail);
+            if (file->op_pool) memory_pool_destroy(file->op_pool);
+            free(file);
+        }
+        close(fd);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    file->rm = rm;
+    file->fd = fd;
+    file->direct = (flags & O_DIRECT) != 0;
+    file->size = st.st_size;
+    file->commit.write_done.on_complete = on_commit_write;
+    file->commit.sync_done.on_complete = on_commit_sync;
+    file->kick.on_complete = on_commit_kick;
+
+    // O_DIRECT 追加需要重写最后一个不完整的块，打开时读入其内容
+    if (file->direct) {
+        file->tail_len = (size_t)(file->size % FILE_IO_ALIGN);
+        if (file->tail_len > 0 &&
+            pread(fd, file->tail, FILE_IO_ALIGN, file->size - (off_t)file->tail_len) < (ssize_t)file->tail_len) {
+            int err = errno ? errno : EIO;
+            memory_pool_destroy(file->op_pool);
+            free(file->tail);
+            free(file);
+            close(fd);
+            errno = err;
+            return NULL;
+        }
+    }
+
+    file->slot = acquire_file_slot(rm, fd);
+    file->next = rm->async_files;
+    rm->async_files = file;
+    return file;
+}
+
+// 关闭文件
+void async_file_close(ResourceManager *rm, AsyncFile *file) {
+    (void)rm;
+    if (!file || file->closing) {
+        return;
+    }
+    file->closing = 1;
+    file_settle(file);
+}
+
+off_t async_file_size(const AsyncFile *file) {
+    return file->size;
+}
+
+// 检查 O_DIRECT 的对齐要求
+static int check_request(AsyncFile *file, off_t offset, size_t len) {
+    if (file->closing || offset < 0 || len == 0 || len > IO_BUFFER_SIZE) {
+        return -EINVAL;
+    }
+    if (file->direct && (offset % FILE_IO_ALIGN != 0 || len % FILE_IO_ALIGN != 0)) {
+        return -EINVAL;
+    }
+    return 0;
+}
+
+// 读取
+int async_file_read(ResourceManager *rm, AsyncFile *file, struct connection *conn,
+                    off_t offset, size_t len, file_io_done_fn done, void *arg) {
+    int ret = check_request(file, offset, len);
+    if (ret < 0) return ret;
+    if (reserve_sqes(rm->ring, 1) < 0) return -EAGAIN;
+
+    FileOp *op = op_create(file, conn, FILE_OP_READ, done, arg);
+    if (!op) return -ENOMEM;
+    op->io_buffer = acquire_io_buffer(rm);
+    if (op->io_buffer < 0) {
+        op_discard(file, op);
+        return -EAGAIN;
+    }
+
+    struct io_uring_sqe *sqe = io_uring_get_sqe(rm->ring);
+    io_uring_prep_read_fixed(sqe, 0, io_buffer_data(rm, op->io_buffer), (unsigned)len, offset, op->io_buffer);
+    sqe_set_file(sqe, file);
+    op->handler.on_complete = on_op_complete;
+    sqe_set_completion_handler(sqe, &op->handler);
+    file->inflight++;
+    park_connection(conn);
+    return 0;
+}
+
+// 写入
+int async_file_write(ResourceManager *rm, AsyncFile *file, struct connection *conn,
+                     off_t offset, const void *data, size_t len, file_io_done_fn done, void *arg) {
+    int ret = check_request(file, offset, len);
+    if (ret < 0) return ret;
+    if (reserve_sqes(rm->ring, 1) < 0) return -EAGAIN;
+
+    FileOp *op = op_create(file, conn, FILE_OP_WRITE, done, arg);
+    if (!op) return -ENOMEM;
+    op->io_buffer = acquire_io_buffer(rm);
+    if (op->io_buffer < 0) {
+        op_discard(file, op);
+        return -EAGAIN;
+    }
+    memcpy(io_buffer_data(rm, op->io_buffer), data, len);
+
+    struct io_uring_sqe *sqe = io_uring_get_sqe(rm->ring);
+    io_uring_prep_write_fixed(sqe, 0, io_buffer_data(rm, op->io_buffer), (unsigned)len, offset, op->io_buffer);
+    sqe_set_file(sqe, file);
+    op->handler.on_complete = on_op_complete;
+    sqe_set_completion_handler(sqe, &op->handler);
+    file->inflight++;
+    park_connection(conn);
+    return 0;
+}
+
+// 刷盘
+int async_file_fsync(ResourceManager *rm, AsyncFile *file, struct connection *conn,
+                     int datasync, file_io_done_fn done, void *arg) {
+    if (file->closing) return -EINVAL;
+    if (reserve_sqes(rm->ring, 1) < 0) return -EAGAIN;
+
+    FileOp *op = op_create(file, conn, FILE_OP_FSYNC, done, arg);
+    if (!op) return -ENOMEM;
+
+    struct io_uring_sqe *sqe = io_uring_get_sqe(rm->ring);
+    io_uring_prep_fsync(sqe, 0, datasync ? IORING_FSYNC_DATASYNC : 0);
+    sqe_set_file(sqe, file);
+    op->handler.on_complete = on_op_complete;
+    sqe_set_completion_handler(sqe, &op->handler);
+    file->inflight++;
+    park_connection(conn);
+    return 0;
+}
+
+// 组提交追加
+int async_file_append(ResourceManager *rm, AsyncFile *file, struct connection *conn,
+                      const void *data, size_t len, file_io_done_fn done, void *arg) {
+    if (file->error) return file->error;
+    if (file->closing || len == 0) return -EINVAL;
+
+    // 新批次在 O_DIRECT 下从最后一个不完整块的开头写起
+    size_t prefix = file->batch_count == 0 && file->direct ? file->tail_len : 0;
+    size_t capacity = (size_t)FILE_COMMIT_MAX_BUFFERS * IO_BUFFER_SIZE;
+    size_t end = (file->batch_count == 0 ? prefix : file->batch_len) + len;
+    if (file->direct) end = align_up(end);
+    if (end > capacity) return -EAGAIN;
+
+    // 按需取得固定缓冲区，取不到时撤销本次取得的缓冲区
+    int needed = (int)((end + IO_BUFFER_SIZE - 1) / IO_BUFFER_SIZE);
+    int had = file->batch_count;
+    while (file->batch_count < needed) {
+        int index = acquire_io_buffer(rm);
+        if (index < 0) {
+            while (file->batch_count > had) {
+                release_io_buffer(rm, file->batch_buffers[--file->batch_count]);
+            }
+            return -EAGAIN;
+        }
+        file->batch_buffers[file->batch_count++] = index;
+    }
+
+    FileOp *op = op_create(file, conn, FILE_OP_APPEND, done, arg);
+    if (!op) {
+        while (file->batch_count > had) {
+            release_io_buffer(rm, file->batch_buffers[--file->batch_count]);
+        }
+        return -ENOMEM;
+    }
+    op->len = len;
+
+    if (had == 0) {
+        if (prefix > 0) {
+            memcpy(io_buffer_data(rm, file->batch_buffers[0]), file->tail, prefix);
+        }
+        file->batch_len = prefix;
+    }
+
+    // 复制数据，记录可以跨越缓冲区边界
+    const char *src = data;
+    size_t remaining = len;
+    while (remaining > 0) {
+        size_t pos = file->batch_len % IO_BUFFER_SIZE;
+        size_t n = IO_BUFFER_SIZE - pos;
+        if (n > remaining) n = remaining;
+        memcpy(io_buffer_data(rm, file->batch_buffers[file->batch_len / IO_BUFFER_SIZE]) + pos, src, n);
+        file->batch_len += n;
+        src += n;
+        remaining -= n;
+    }
+
+    if (file->batch_tail) file->batch_tail->next_waiter = op;
+    else file->batch_head = op;
+    file->batch_tail = op;
+    park_connection(conn);
+
+    schedule_commit(file);
+    return 0;
+}
+
+// ring 退出后释放所有文件
+void async_file_cleanup(ResourceManager *rm) {
+    while (rm->async_files) {
+        AsyncFile *file = rm->async_files;
+        // 内核已不再访问缓冲区，未完成的操作以 ECANCELED 通知调用者释放参数
+        while (file->ops) {
+            FileOp *op = file->ops;
+            op->conn = NULL;
+            op->io_buffer = -1;
+            op_complete(file, op, -ECANCELED, NULL);
+        }
+        file_release(file, 0);
+    }
+}
\ No newline at end of file
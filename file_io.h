@@ -0,0 +1,58 @@
+#ifndef FILE_IO_H
+#define FILE_IO_H
+
+#include <sys/types.h>
+#include "iouring_server.h"
+
+// O_DIRECT 要求的偏移、长度和内存对齐
+#define FILE_IO_ALIGN 4096
+// 一次组提交最多使用的固定缓冲区数（每个 IO_BUFFER_SIZE 字节）
+#define FILE_COMMIT_MAX_BUFFERS 8
+
+// 异步文件类型，属于打开它的工作线程的 ring
+typedef struct AsyncFile AsyncFile;
+
+// 文件操作完成回调，在事件循环线程中执行
+// res 为传输的字节数（fsync 为 0）或 -errno；data 仅对读操作有效，且只在回调期间有效
+// 发起操作时传入了连接而连接已在期间关闭时，conn 为 NULL，此时只需释放 arg
+typedef void (*file_io_done_fn)(struct connection *conn, ssize_t res, const char *data, void *arg,
+                                struct ResourceManager *rm);
+
+// 打开文件并注册为固定文件，flags 可包含 O_DIRECT
+// 返回: 成功返回文件对象，失败返回 NULL 并设置 errno
+AsyncFile* async_file_open(struct ResourceManager *rm, const char *path, int flags, mode_t mode);
+
+// 关闭文件：先提交尚未提交的追加数据，所有操作完成后才真正关闭
+void async_file_close(struct ResourceManager *rm, AsyncFile *file);
+
+// 文件的逻辑大小，即下一次追加的位置
+off_t async_file_size(const AsyncFile *file);
+
+// 以下操作均在当前 ring 上异步执行，conn 不为 NULL 时连接在操作完成前暂停收发，
+// 完成后自动发送写缓冲区中的数据并继续读取（与 offload_submit 相同）
+// O_DIRECT 文件的 offset 和 len 必须按 FILE_IO_ALIGN 对齐，len 不能超过 IO_BUFFER_SIZE
+// 返回: 成功提交返回 0，失败返回 -errno（不会调用 done）
+
+// 读取 offset 处的 len 字节，数据经固定缓冲区交给回调
+int async_file_read(struct ResourceManager *rm, AsyncFile *file, struct connection *conn,
+                    off_t offset, size_t len, file_io_done_fn done, void *arg);
+
+// 把 data 写入 offset 处（数据先复制到固定缓冲区，调用返回后即可复用）
+int async_file_write(struct ResourceManager *rm, AsyncFile *file, struct connection *conn,
+                     off_t offset, const void *data, size_t len, file_io_done_fn done, void *arg);
+
+// 将文件数据刷到存储设备，datasync 非 0 时使用 fdatasync 语义
+int async_file_fsync(struct ResourceManager *rm, AsyncFile *file, struct connection *conn,
+                     int datasync, file_io_done_fn done, void *arg);
+
+// 组提交追加：数据追加到文件末尾，回调在数据持久化（write + fdatasync）后执行
+// 同一轮事件循环中来自不同连接的追加合并为一次写入和一次 fdatasync；
+// 前一次提交进行期间到达的追加在其完成后一起提交。O_DIRECT 文件不要求对齐
+// 返回: 成功返回 0；批次已满返回 -EAGAIN；之前的提交失败后返回该错误
+int async_file_append(struct ResourceManager *rm, AsyncFile *file, struct connection *conn,
+                      const void *data, size_t len, file_io_done_fn done, void *arg);
+
+// 释放工作线程的所有文件（ring 退出后由资源管理器调用，未完成的操作以 -ECANCELED 回调）
+void async_file_cleanup(struct ResourceManager *rm);
+
+#endif // FILE_IO_H
\ No newline at end of file
@@ -0,0 +1,647 @@
+#define _GNU_SOURCE
+#include "file_server.h"
+#include "resource_manager.h"
+#include "error.h"
+#include "logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/openat2.h>
+
+#define FILE_CACHE_BUCKETS 512
+
+// 文件缓存项，以数组下标互相链接
+typedef struct {
+    char *path;
+    size_t hash;
+    int fd;
+    int slot;               // 固定文件槽位，-1 表示使用普通 fd
+    int refs;               // 正在使用此文件的传输数
+    int stale;              // 文件已变化，不再参与查找，引用归零后关闭
+    dev_t dev;
+    ino_t ino;
+    FileInfo info;
+    uint64_t validated_ms;  // 上次校验元数据的时间
+    int hash_next;
+    int lru_prev;
+    int lru_next;
+} FileCacheEntry;
+
+// 一次文件发送
+typedef struct FileTransfer {
+    struct completion_handler source_done;  // 文件 -> 管道/固定缓冲区完成
+    struct completion_handler sink_done;    // 管道/固定缓冲区/写缓冲区 -> 套接字完成
+    struct completion_handler writable;     // 等待套接字可写完成
+    FileServer *fs;
+    struct connection *conn;
+    int entry;
+    off_t offset;
+    size_t remaining;      // 尚未从文件读出的字节数
+    size_t staged;         // 已读出但尚未发送的字节数
+    size_t staged_pos;     // 固定缓冲区中待发送数据的起点
+    int pipe_fds[2];
+    int io_buffer;         // 固定缓冲区模式使用的缓冲区索引
+    int inflight;          // 尚未返回的请求数
+    int flushing;          // 正在发送连接写缓冲区中的数据
+    int wait_writable;     // 上次 splice 到套接字返回 EAGAIN
+    int failed;
+    struct FileTransfer *prev;
+    struct FileTransfer *next;
+} FileTransfer;
+
+struct FileServer {
+    ResourceManager *rm;
+    FileCacheEntry entries[FILE_CACHE_SIZE];
+    int buckets[FILE_CACHE_BUCKETS];
+    int lru_head;           // 最近使用
+    int lru_tail;           // 最久未使用
+    int free_head;          // 空闲项链表，复用 hash_next
+    int use_splice;
+    int root_fd;            // 文档根目录（创建时的当前目录），路径都相对于它解析
+    int pipes[FILE_PIPE_POOL_SIZE][2];
+    int pipe_count;
+    FileTransfer *transfers;  // 进行中的传输，销毁时释放
+};
+
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+// FNV-1a 哈希
+static size_t hash_path(const char *path) {
+    size_t hash = 14695981039346656037ULL;
+    for (const unsigned char *p = (const unsigned char*)path; *p; p++) {
+        hash ^= *p;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static void lru_unlink(FileServer *fs, int index) {
+    FileCacheEntry *e = &fs->entries[index];
+    if (e->lru_prev >= 0) fs->entries[e->lru_prev].lru_next = e->lru_next;
+    else fs->lru_head = e->lru_next;
+    if (e->lru_next >= 0) fs->entries[e->lru_next].lru_prev = e->lru_prev;
+    else fs->lru_tail = e->lru_prev;
+    e->lru_prev = e->lru_next = -1;
+}
+
+static void lru_push_front(FileServer *fs, int index) {
+    FileCacheEntry *e = &fs->entries[index];
+    e->lru_prev = -1;
+    e->lru_next = fs->lru_head;
+    if (fs->lru_head >= 0) fs->entries[fs->lru_head].lru_prev = index;
+    fs->lru_head = index;
+    if (fs->lru_tail < 0) fs->lru_tail = index;
+}
+
+static void hash_unlink(FileServer *fs, int index) {
+    int *link = &fs->buckets[fs->entries[index].hash % FILE_CACHE_BUCKETS];
+    while (*link >= 0) {
+        if (*link == index) {
+            *link = fs->entries[index].hash_next;
+            return;
+        }
+        link = &fs->entries[*link].hash_next;
+    }
+}
+
+// 关闭缓存项并放回空闲链表（调用前已从哈希表和 LRU 链表中移除）
+static void entry_release(FileServer *fs, int index) {
+    FileCacheEntry *e = &fs->entries[index];
+    if (e->slot >= 0) {
+        release_file_slot(fs->rm, e->slot);
+    }
+    close(e->fd);
+    free(e->path);
+    e->path = NULL;
+    e->fd = -1;
+    e->slot = -1;
+    e->stale = 0;
+    e->hash_next = fs->free_head;
+    fs->free_head = index;
+}
+
+// 将缓存项移出查找结构，无人使用时立即关闭，否则等最后一个传输结束
+static void entry_retire(FileServer *fs, int index) {
+    FileCacheEntry *e = &fs->entries[index];
+    hash_unlink(fs, index);
+    lru_unlink(fs, index);
+    if (e->refs == 0) {
+        entry_release(fs, index);
+    } else {
+        e->stale = 1;
+    }
+}
+
+static void entry_put(FileServer *fs, int index) {
+    FileCacheEntry *e = &fs->entries[index];
+    if (--e->refs == 0 && e->stale) {
+        entry_release(fs, index);
+    }
+}
+
+static void fill_info(FileCacheEntry *e, const struct stat *st) {
+    e->dev = st->st_dev;
+    e->ino = st->st_ino;
+    e->info.size = st->st_size;
+    e->info.mtime = st->st_mtime;
+}
+
+// 内核不支持 openat2 时逐个路径组成部分打开，拒绝 ".." 和符号链接
+static int open_beneath_walk(int root_fd, const char *path) {
+    char buf[PATH_MAX];
+    if (strlen(path) >= sizeof(buf)) {
+        return -ENAMETOOLONG;
+    }
+    strcpy(buf, path);
+    int dir = root_fd;
+    char *save = NULL;
+    char *part = strtok_r(buf, "/", &save);
+    while (part) {
+        char *next = strtok_r(NULL, "/", &save);
+        if (strcmp(part, "..") == 0) {
+            if (dir != root_fd) close(dir);
+            return -EXDEV;
+        }
+        int flags = next ? O_PATH | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC : O_RDONLY | O_NOFOLLOW | O_CLOEXEC;
+        int fd = openat(dir, part, flags);
+        int err = errno;
+        if (dir != root_fd) close(dir);
+        if (fd < 0) {
+            return err == ELOOP ? -EXDEV : -err;
+        }
+        if (!next) {
+            return fd;
+        }
+        dir = fd;
+        part = next;
+    }
+    return -ENOENT;
+}
+
+// 在文档根目录下只读打开 path：绝对路径、跳出根目录的 ".." 和任何符号链接都被拒绝
+static int open_beneath(int root_fd, const char *path) {
+    if (path[0] == '/') {
+        return -EXDEV;
+    }
+    struct open_how how = {
+        .flags = O_RDONLY | O_CLOEXEC,
+        .resolve = RESOLVE_BENEATH | RESOLVE_NO_SYMLINKS
+    };
+    int fd = (int)syscall(SYS_openat2, root_fd, path, &how, sizeof(how));
+    if (fd >= 0) {
+        return fd;
+    }
+    if (errno == ENOSYS) {
+        return open_beneath_walk(root_fd, path);
+    }
+    return errno == ELOOP ? -EXDEV : -errno;
+}
+
+// 查找或打开文件，返回缓存项下标或 -errno
+// 未命中时同步 open/fstat：文件元数据通常已在内核缓存中，且响应头需要立即得到文件大小
+static int cache_lookup(FileServer *fs, const char *path) {
+    size_t hash = hash_path(path);
+    uint64_t now = now_ms();
+
+    for (int i = fs->buckets[hash % FILE_CACHE_BUCKETS]; i >= 0; i = fs->entries[i].hash_next) {
+        FileCacheEntry *e = &fs->entries[i];
+        if (e->hash != hash || strcmp(e->path, path) != 0) {
+            continue;
+        }
+        // 超过校验间隔时重新 stat，文件被替换或修改后重新打开
+        if (now - e->validated_ms >= FILE_CACHE_REVALIDATE_MS) {
+            struct stat st;
+            if (fstatat(fs->root_fd, path, &st, AT_SYMLINK_NOFOLLOW) != 0 || st.st_ino != e->ino || st.st_dev != e->dev ||
+                st.st_mtime != e->info.mtime || st.st_size != e->info.size) {
+                entry_retire(fs, i);
+                break;
+            }
+            e->validated_ms = now;
+        }
+        lru_unlink(fs, i);
+        lru_push_front(fs, i);
+        return i;
+    }
+
+    int fd = open_beneath(fs->root_fd, path);
+    if (fd < 0) {
+        return fd;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        int err = errno;
+        close(fd);
+        return -err;
+    }
+    if (!S_ISREG(st.st_mode)) {
+        close(fd);
+        return S_ISDIR(st.st_mode) ? -EISDIR : -EINVAL;
+    }
+
+    // 缓存已满时从最久未使用的一端淘汰一个空闲项
+    if (fs->free_head < 0) {
+        for (int i = fs->lru_tail; i >= 0; i = fs->entries[i].lru_prev) {
+            if (fs->entries[i].refs == 0) {
+                entry_retire(fs, i);
+                break;
+            }
+        }
+        if (fs->free_head < 0) {
+            close(fd);
+            return -EBUSY;
+        }
+    }
+
+    int index = fs->free_head;
+    FileCacheEntry *e = &fs->entries[index];
+    e->path = strdup(path);
+    if (!e->path) {
+        close(fd);
+        return -ENOMEM;
+    }
+    fs->free_head = e->hash_next;
+    e->hash = hash;
+    e->fd = fd;
+    e->slot = acquire_file_slot(fs->rm, fd);
+    e->refs = 0;
+    e->stale = 0;
+    fill_info(e, &st);
+    e->validated_ms = now;
+    e->hash_next = fs->buckets[hash % FILE_CACHE_BUCKETS];
+    fs->buckets[hash % FILE_CACHE_BUCKETS] = index;
+    lru_push_front(fs, index);
+    return index;
+}
+
+// 从管道池取出一个管道，池空时新建
+static int pipe_get(FileServer *fs, int fds[2]) {
+    if (fs->pipe_count > 0) {
+        fs->pipe_count--;
+        fds[0] = fs->pipes[fs->pipe_count][0];
+        fds[1] = fs->pipes[fs->pipe_count][1];
+        return 0;
+    }
+    if (pipe2(fds, O_CLOEXEC) != 0) {
+        return -errno;
+    }
+    fcntl(fds[1], F_SETPIPE_SZ, FILE_CHUNK_SIZE);
+    return 0;
+}
+
+// 归还管道；管道中残留数据（传输出错时）或池已满时直接关闭
+static void pipe_put(FileServer *fs, int fds[2], int dirty) {
+    if (dirty || fs->pipe_count >= FILE_PIPE_POOL_SIZE) {
+        close(fds[0]);
+        close(fds[1]);
+        return;
+    }
+    fs->pipes[fs->pipe_count][0] = fds[0];
+    fs->pipes[fs->pipe_count][1] = fds[1];
+    fs->pipe_count++;
+}
+
+// 创建文件服务器
+FileServer* file_server_create(ResourceManager *rm) {
+    FileServer *fs = calloc(1, sizeof(FileServer));
+    if (!fs) {
+        return NULL;
+    }
+    fs->rm = rm;
+    for (int i = 0; i < FILE_CACHE_BUCKETS; i++) {
+        fs->buckets[i] = -1;
+    }
+    for (int i = 0; i < FILE_CACHE_SIZE; i++) {
+        fs->entries[i].fd = -1;
+        fs->entries[i].slot = -1;
+        fs->entries[i].lru_prev = fs->entries[i].lru_next = -1;
+        fs->entries[i].hash_next = i + 1 < FILE_CACHE_SIZE ? i + 1 : -1;
+    }
+    fs->free_head = 0;
+    fs->lru_head = fs->lru_tail = -1;
+    fs->root_fd = open(".", O_PATH | O_DIRECTORY | O_CLOEXEC);
+    if (fs->root_fd < 0) {
+        free(fs);
+        return NULL;
+    }
+
+    // 探测 splice 支持，不支持时改用固定缓冲区读取后发送
+    struct io_uring_probe *probe = io_uring_get_probe_ring(rm->ring);
+    if (probe) {
+        fs->use_splice = io_uring_opcode_supported(probe, IORING_OP_SPLICE);
+        io_uring_free_probe(probe);
+    }
+    return fs;
+}
+
+// 销毁文件服务器（在 ring 退出前调用，进行中的传输直接丢弃）
+void file_server_destroy(FileServer *fs) {
+    if (!fs) return;
+
+    while (fs->transfers) {
+        FileTransfer *t = fs->transfers;
+        fs->transfers = t->next;
+        if (t->pipe_fds[0] >= 0) {
+            pipe_put(fs, t->pipe_fds, 1);
+        }
+        free(t);
+    }
+    for (int i = 0; i < FILE_CACHE_SIZE; i++) {
+        if (fs->entries[i].path) {
+            if (fs->entries[i].slot >= 0) {
+                release_file_slot(fs->rm, fs->entries[i].slot);
+            }
+            close(fs->entries[i].fd);
+            free(fs->entries[i].path);
+        }
+    }
+    for (int i = 0; i < fs->pipe_count; i++) {
+        close(fs->pipes[i][0]);
+        close(fs->pipes[i][1]);
+    }
+    close(fs->root_fd);
+    free(fs);
+}
+
+// 查询文件元数据
+int file_server_stat(ResourceManager *rm, const char *path, FileInfo *info) {
+    FileServer *fs = rm->file_server;
+    if (!fs || !path || !info) {
+        return -EINVAL;
+    }
+    int index = cache_lookup(fs, path);
+    if (index < 0) {
+        return index;
+    }
+    *info = fs->entries[index].info;
+    return 0;
+}
+
+static void advance_transfer(FileTransfer *t);
+
+// 结束传输：释放资源并恢复或关闭连接
+static void finish_transfer(FileTransfer *t) {
+    FileServer *fs = t->fs;
+    ResourceManager *rm = fs->rm;
+    struct connection *conn = t->conn;
+
+    if (t->pipe_fds[0] >= 0) {
+        pipe_put(fs, t->pipe_fds, t->failed || t->staged > 0);
+    }
+    if (t->io_buffer >= 0) {
+        release_io_buffer(rm, t->io_buffer);
+    }
+    entry_put(fs, t->entry);
+
+    if (t->prev) t->prev->next = t->next;
+    else fs->transfers = t->next;
+    if (t->next) t->next->prev = t->prev;
+    int failed = t->failed;
+    free(t);
+
+    conn->pending_jobs--;
+    if (failed) {
+        // 响应头已承诺了长度，无法在连接上报告错误，只能关闭
+        close_connection(rm, conn);
+    } else if (conn->pending_jobs == 0) {
+        resume_connection(rm, conn);
+    }
+}
+
+// 文件读取（splice 到管道或读入固定缓冲区）完成
+static void on_source_complete(struct completion_handler *handler, struct io_uring_cqe *cqe, ResourceManager *rm) {
+    (void)rm;
+    FileTransfer *t = (FileTransfer*)((char*)handler - offsetof(FileTransfer, source_done));
+    t->inflight--;
+
+    if (cqe->res <= 0) {
+        // 读到 0 表示文件在发送期间被截断
+        if (cqe->res < 0) {
+            log_error("File read failed: %s", strerror(-cqe->res));
+        }
+        t->failed = 1;
+    } else {
+        t->staged += cqe->res;
+        t->offset += cqe->res;
+        t->remaining -= cqe->res;
+    }
+
+    if (t->inflight == 0) {
+        advance_transfer(t);
+    }
+}
+
+// 发送到套接字完成
+static void on_sink_complete(struct completion_handler *handler, struct io_uring_cqe *cqe, ResourceManager *rm) {
+    (void)rm;
+    FileTransfer *t = (FileTransfer*)((char*)handler - offsetof(FileTransfer, sink_done));
+    int flushing = t->flushing;
+    t->inflight--;
+    t->flushing = 0;
+
+    if (cqe->res == -ECANCELED) {
+        // 链接的文件读取不足一个块，发送被取消，已读出的数据由 advance_transfer 补发
+    } else if (cqe->res == -EAGAIN) {
+        // 客户端套接字是非阻塞的，splice 在发送缓冲区满时不会等待，补发前先等待可写
+        t->wait_writable = 1;
+    } else if (cqe->res <= 0) {
+        t->failed = 1;
+    } else if (flushing) {
+        ring_buffer_skip(&t->conn->cold->write_buffer, cqe->res);
+    } else {
+        t->staged -= cqe->res;
+        t->staged_pos += cqe->res;
+    }
+
+    if (t->inflight == 0) {
+        advance_transfer(t);
+    }
+}
+
+// 套接字可写等待完成，链接的补发请求随后执行
+static void on_writable(struct completion_handler *handler, struct io_uring_cqe *cqe, ResourceManager *rm) {
+    (void)rm;
+    FileTransfer *t = (FileTransfer*)((char*)handler - offsetof(FileTransfer, writable));
+    t->inflight--;
+    if (cqe->res < 0) {
+        t->failed = 1;
+    }
+    if (t->inflight == 0) {
+        advance_transfer(t);
+    }
+}
+
+// 准备把已读出的数据发送到套接字
+static void prep_sink(FileTransfer *t, struct io_uring_sqe *sqe, size_t len) {
+    ResourceManager *rm = t->fs->rm;
+    if (t->fs->use_splice) {
+        io_uring_prep_splice(sqe, t->pipe_fds[0], -1, t->conn->fd, -1, (unsigned)len, 0);
+    } else {
+        char *buf = (char*)rm->buffers[t->io_buffer].iov_base + t->staged_pos;
+        io_uring_prep_send(sqe, t->conn->fd, buf, len, 0);
+    }
+    sqe_set_completion_handler(sqe, &t->sink_done);
+}
+
+// 提交下一步：写缓冲区 -> 已读出未发送的数据 -> 下一个文件块
+// 返回: 已提交返回 1，传输完成返回 0，无法获取 SQE 返回 -1
+static int submit_next(FileTransfer *t) {
+    ResourceManager *rm = t->fs->rm;
+    struct connection *conn = t->conn;
+
+    // 链接的请求需要一次取得两个 SQE
+    if (io_uring_sq_space_left(rm->ring) < 2) {
+        io_uring_submit(rm->ring);
+        if (io_uring_sq_space_left(rm->ring) < 2) {
+            return -1;
+        }
+    }
+
+    // 先发送回调写入的响应头
+    size_t pending = ring_buffer_used_space(&conn->cold->write_buffer);
+    if (pending > 0) {
+        struct io_uring_sqe *sqe = io_uring_get_sqe(rm->ring);
+        size_t read_index = atomic_load(&conn->cold->write_buffer.read_index) % conn->cold->write_buffer.capacity;
+        if (pending > conn->cold->write_buffer.capacity - read_index) {
+            pending = conn->cold->write_buffer.capacity - read_index;
+        }
+        io_uring_prep_send(sqe, conn->fd, &conn->cold->write_buffer.buffer[read_index], pending, 0);
+        sqe_set_completion_handler(sqe, &t->sink_done);
+        t->flushing = 1;
+        t->inflight = 1;
+        return 1;
+    }
+
+    // 补发上一块未发完的部分
+    if (t->staged > 0) {
+        t->inflight = 1;
+        if (t->wait_writable) {
+            struct io_uring_sqe *poll = io_uring_get_sqe(rm->ring);
+            io_uring_prep_poll_add(poll, conn->fd, POLLOUT);
+            poll->flags |= IOSQE_IO_LINK;
+            sqe_set_completion_handler(poll, &t->writable);
+            t->wait_writable = 0;
+            t->inflight = 2;
+        }
+        prep_sink(t, io_uring_get_sqe(rm->ring), t->staged);
+        return 1;
+    }
+
+    if (t->remaining == 0) {
+        return 0;
+    }
+
+    // 读取下一块并以 IOSQE_IO_LINK 链接发送，一次提交完成文件到套接字的搬运
+    struct io_uring_sqe *source = io_uring_get_sqe(rm->ring);
+    struct io_uring_sqe *sink = io_uring_get_sqe(rm->ring);
+    FileCacheEntry *e = &t->fs->entries[t->entry];
+    int file = e->slot >= 0 ? e->slot : e->fd;
+    size_t chunk = t->remaining < FILE_CHUNK_SIZE ? t->remaining : FILE_CHUNK_SIZE;
+
+    if (t->fs->use_splice) {
+        io_uring_prep_splice(source, file, t->offset, t->pipe_fds[1], -1, (unsigned)chunk,
+                             e->slot >= 0 ? SPLICE_F_FD_IN_FIXED : 0);
+    } else {
+        io_uring_prep_read_fixed(source, file, rm->buffers[t->io_buffer].iov_base, (unsigned)chunk,
+                                 t->offset, t->io_buffer);
+        if (e->slot >= 0) {
+            source->flags |= IOSQE_FIXED_FILE;
+        }
+        t->staged_pos = 0;
+    }
+    source->flags |= IOSQE_IO_LINK;
+    sqe_set_completion_handler(source, &t->source_done);
+    prep_sink(t, sink, chunk);
+    t->inflight = 2;
+    return 1;
+}
+
+// 所有请求返回后推进传输，出错或完成时结束
+static void advance_transfer(FileTransfer *t) {
+    if (!t->failed && submit_next(t) > 0) {
+        return;
+    }
+    if (t->remaining > 0 || t->staged > 0) {
+        t->failed = 1;
+    }
+    finish_transfer(t);
+}
+
+// 发送文件
+int serve_file(ResourceManager *rm, struct connection *conn, const char *path, off_t offset, size_t length) {
+    FileServer *fs = rm->file_server;
+    if (!fs || !conn || !path || offset < 0) {
+        return -EINVAL;
+    }
+
+    int index = cache_lookup(fs, path);
+    if (index < 0) {
+        return index;
+    }
+    FileCacheEntry *e = &fs->entries[index];
+    if (offset > e->info.size) {
+        return -EINVAL;
+    }
+    size_t available = (size_t)(e->info.size - offset);
+    if (length == 0 || length > available) {
+        length = available;
+    }
+
+    FileTransfer *t = calloc(1, sizeof(FileTransfer));
+    if (!t) {
+        return -ENOMEM;
+    }
+    t->source_done.on_complete = on_source_complete;
+    t->sink_done.on_complete = on_sink_complete;
+    t->writable.on_complete = on_writable;
+    t->fs = fs;
+    t->conn = conn;
+    t->entry = index;
+    t->offset = offset;
+    t->remaining = length;
+    t->pipe_fds[0] = t->pipe_fds[1] = -1;
+    t->io_buffer = -1;
+
+    int ret = 0;
+    if (length > 0) {
+        if (fs->use_splice) {
+            ret = pipe_get(fs, t->pipe_fds);
+        } else if ((t->io_buffer = acquire_io_buffer(rm)) < 0) {
+            ret = -EBUSY;
+        }
+    }
+    if (ret < 0) {
+        free(t);
+        return ret;
+    }
+
+    // 在暂停连接前提交第一步，失败时连接状态保持不变
+    ret = submit_next(t);
+    if (ret <= 0) {
+        if (t->pipe_fds[0] >= 0) pipe_put(fs, t->pipe_fds, 0);
+        if (t->io_buffer >= 0) release_io_buffer(rm, t->io_buffer);
+        free(t);
+        // 没有需要发送的内容（空文件且写缓冲区为空），由事件循环照常继续
+        return ret == 0 ? 0 : -EBUSY;
+    }
+
+    e->refs++;
+    t->next = fs->transfers;
+    if (fs->transfers) fs->transfers->prev = t;
+    fs->transfers = t;
+
+    // 与卸载任务相同，以 pending_jobs 暂停连接，传输结束后恢复
+    conn->pending_jobs++;
+    return 0;
+}
\ No newline at end of file
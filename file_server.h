@@ -0,0 +1,44 @@
+#ifndef FILE_SERVER_H
+#define FILE_SERVER_H
+
+#include <sys/types.h>
+#include <time.h>
+#include "iouring_server.h"
+
+// 文件缓存容量，每个缓存项占用一个固定文件槽位
+#define FILE_CACHE_SIZE 256
+// 文件缓存项的元数据重新校验间隔（毫秒）
+#define FILE_CACHE_REVALIDATE_MS 1000
+// 每次 splice 或读取的最大字节数
+#define FILE_CHUNK_SIZE 65536
+// 每个工作线程保留的空闲管道数
+#define FILE_PIPE_POOL_SIZE 64
+
+// 文件服务器类型（每个工作线程一个）
+typedef struct FileServer FileServer;
+
+// 文件元数据
+typedef struct {
+    off_t size;
+    time_t mtime;
+} FileInfo;
+
+// 创建文件服务器，并探测内核是否支持 splice。当前目录作为文档根目录：
+// 文件路径相对于它解析，绝对路径、跳出根目录的 ".." 和符号链接都被拒绝（-EXDEV）
+FileServer* file_server_create(struct ResourceManager *rm);
+
+// 销毁文件服务器，关闭缓存的文件和管道
+void file_server_destroy(FileServer *fs);
+
+// 查询文件元数据（经由 LRU 缓存），用于在发送文件前写入响应头
+// 返回: 成功返回 0，失败返回 -errno
+int file_server_stat(struct ResourceManager *rm, const char *path, FileInfo *info);
+
+// 从 on_data 回调中发送文件 path 从 offset 开始的 length 字节（length 为 0 表示到文件末尾）
+// 先发送连接写缓冲区中已有的数据（例如响应头），再通过 splice 经管道将页缓存直接送入套接字；
+// 内核不支持 splice 时改为读入已注册的固定缓冲区后发送。文件内容不会经过写缓冲区。
+// 发送期间连接暂停收发，完成后继续读取；发送出错时关闭连接
+// 返回: 成功返回 0，失败返回 -errno（连接状态不变，调用者可自行回复错误）
+int serve_file(struct ResourceManager *rm, struct connection *conn, const char *path, off_t offset, size_t length);
+
+#endif // FILE_SERVER_H
\ No newline at end of file
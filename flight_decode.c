@@ -0,0 +1,156 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "recorder.h"
+
+// 解码后的事件及其所属工作线程
+typedef struct {
+    RecorderEvent event;
+    uint64_t seq;
+    uint32_t worker;
+} DecodedEvent;
+
+// 按时间排序，同一时间按工作线程和序号排序
+static int compare_events(const void *a, const void *b) {
+    const DecodedEvent *x = a, *y = b;
+    if (x->event.ts_ns != y->event.ts_ns) return x->event.ts_ns < y->event.ts_ns ? -1 : 1;
+    if (x->worker != y->worker) return x->worker < y->worker ? -1 : 1;
+    return x->seq < y->seq ? -1 : (x->seq > y->seq);
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s <dump-file> [--conn=<id>] [--fd=<fd>] [--last=<n>]\n", prog);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        usage(argv[0]);
+        return 1;
+    }
+    long long conn_filter = -1, fd_filter = -1;
+    size_t last = 0;
+    for (int i = 2; i < argc; i++) {
+        if (strncmp(argv[i], "--conn=", 7) == 0) {
+            conn_filter = strtoll(argv[i] + 7, NULL, 10);
+        } else if (strncmp(argv[i], "--fd=", 5) == 0) {
+            fd_filter = strtoll(argv[i] + 5, NULL, 10);
+        } else if (strncmp(argv[i], "--last=", 7) == 0) {
+            last = strtoull(argv[i] + 7, NULL, 10);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    FILE *f = fopen(argv[1], "rb");
+    if (!f) {
+        perror(argv[1]);
+        return 1;
+    }
+    RecorderFileHeader header;
+    if (fread(&header, sizeof(header), 1, f) != 1 || header.magic != RECORDER_MAGIC) {
+        fprintf(stderr, "%s: not a flight recorder dump\n", argv[1]);
+        fclose(f);
+        return 1;
+    }
+    if (header.version != RECORDER_VERSION || header.event_size != sizeof(RecorderEvent)) {
+        fprintf(stderr, "%s: unsupported version %u (event size %u)\n", argv[1], header.version, header.event_size);
+        fclose(f);
+        return 1;
+    }
+
+    size_t total = (size_t)header.workers * header.capacity;
+    DecodedEvent *decoded = malloc(sizeof(DecodedEvent) * (total ? total : 1));
+    RecorderEvent *ring = malloc(sizeof(RecorderEvent) * (header.capacity ? header.capacity : 1));
+    if (!decoded || !ring) {
+        fprintf(stderr, "Out of memory\n");
+        fclose(f);
+        return 1;
+    }
+
+    size_t count = 0;
+    unsigned long long dropped = 0;
+    for (uint32_t w = 0; w < header.workers; w++) {
+        RecorderWorkerHeader worker;
+        if (fread(&worker, sizeof(worker), 1, f) != 1 || worker.capacity != header.capacity ||
+            fread(ring, sizeof(RecorderEvent), worker.capacity, f) != worker.capacity) {
+            fprintf(stderr, "%s: truncated dump (worker %u)\n", argv[1], w);
+            break;
+        }
+        // 复制期间写入的事件可能覆盖了最旧的若干项，只保留确定未被覆盖的范围
+        uint64_t first = worker.head_after > worker.capacity ? worker.head_after - worker.capacity + 1 : 0;
+        if (worker.head_before > worker.capacity) {
+            dropped += worker.head_before - worker.capacity;
+        }
+        for (uint64_t seq = first; seq < worker.head_before; seq++) {
+            const RecorderEvent *e = &ring[seq & (worker.capacity - 1)];
+            if (e->seq != (uint32_t)seq) continue;
+            decoded[count].event = *e;
+            decoded[count].seq = seq;
+            decoded[count].worker = worker.worker;
+            count++;
+        }
+    }
+    fclose(f);
+    free(ring);
+
+    qsort(decoded, count, sizeof(DecodedEvent), compare_events);
+
+    // 过滤后只输出最后 last 个事件
+    size_t matched = 0;
+    for (size_t i = 0; i < count; i++) {
+        const RecorderEvent *e = &decoded[i].event;
+        if ((conn_filter >= 0 && e->conn_id != (uint64_t)conn_filter) || (fd_filter >= 0 && e->fd != fd_filter)) {
+            decoded[i].worker = UINT32_MAX;
+            continue;
+        }
+        matched++;
+    }
+    size_t skip = last && matched > last ? matched - last : 0;
+
+    time_t wall = (time_t)(header.realtime_ns / 1000000000ULL);
+    char when[64];
+    strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", localtime(&wall));
+    printf("# pid %d, %u worker(s) x %u events, dumped at %s.%03u (%s)\n", header.pid, header.workers,
+           header.capacity, when, (unsigned)(header.realtime_ns / 1000000ULL % 1000),
+           header.reason ? strsignal(header.reason) : "on request");
+    printf("# %zu events, %llu older events overwritten; times are seconds before the dump\n", count, dropped);
+
+    for (size_t i = 0; i < count; i++) {
+        if (decoded[i].worker == UINT32_MAX) continue;
+        if (skip) {
+            skip--;
+            continue;
+        }
+        const RecorderEvent *e = &decoded[i].event;
+        double ago = ((double)header.monotonic_ns - (double)e->ts_ns) / 1e9;
+        printf("-%.6f w%u #%llu %-14s conn=%llu fd=%d", ago, decoded[i].worker,
+               (unsigned long long)decoded[i].seq, recorder_event_name(e->type),
+               (unsigned long long)e->conn_id, e->fd);
+        switch (e->type) {
+            case RECORDER_REJECT:
+                printf(" level=%u", e->aux);
+                break;
+            case RECORDER_MIGRATE_OUT:
+                printf(" to=w%u", e->aux);
+                break;
+            case RECORDER_CLOSE:
+            case RECORDER_SHED:
+            case RECORDER_MIGRATE_IN:
+                break;
+            default:
+                if (e->res < 0) {
+                    printf(" res=%d (%s)", e->res, strerror(-e->res));
+                } else {
+                    printf(" res=%d", e->res);
+                }
+                break;
+        }
+        printf("\n");
+    }
+
+    free(decoded);
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,325 @@
+#define _GNU_SOURCE
+#include "hot_restart.h"
+#include "logger.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+#define HOT_RESTART_MAGIC 0x524d4852u   // "RHMR"
+#define HOT_RESTART_VERSION 2
+#define HOT_RESTART_MAX_FDS (HOT_RESTART_MAX_LISTENERS * 2 + 1)
+
+// 新进程发出的请求
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    int32_t port;
+} HandoffRequest;
+
+// 旧进程的应答，随附 SCM_RIGHTS 控制消息：tcp_count 个 TCP 套接字，udp_count 个 UDP 套接字，最后是 Unix 域套接字
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    int32_t port;
+    int32_t tcp_count;
+    int32_t udp_count;
+    int32_t has_unix;
+    int32_t unix_type;
+} HandoffHeader;
+
+// 新进程的确认，旧进程收到后原样回送，新进程收到回送才算接管成功
+typedef struct {
+    uint32_t magic;
+} HandoffAck;
+
+// 设置收发超时，避免对端异常时永久阻塞
+static void set_timeout(int fd, int timeout_ms) {
+    struct timeval tv = { .tv_sec = timeout_ms / 1000, .tv_usec = (timeout_ms % 1000) * 1000 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+static int fill_address(struct sockaddr_un *addr, const char *path) {
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr->sun_path)) {
+        log_error("Hot restart socket path too long: %s", path);
+        return -1;
+    }
+    strcpy(addr->sun_path, path);
+    return 0;
+}
+
+// 完整接收定长消息，被信号中断时继续
+static int recv_exact(int fd, void *data, size_t len) {
+    char *p = data;
+    while (len > 0) {
+        ssize_t n = recv(fd, p, len, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static int send_exact(int fd, const void *data, size_t len) {
+    const char *p = data;
+    while (len > 0) {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+// 连接正在运行的进程并接收监听套接字
+int hot_restart_receive(const char *path, int port, HandoffSockets *sockets, int *conn) {
+    memset(sockets, 0, sizeof(*sockets));
+    sockets->unix_fd = -1;
+    *conn = -1;
+
+    struct sockaddr_un addr;
+    if (fill_address(&addr, path) < 0) {
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        log_error("Hot restart socket failed: %s", strerror(errno));
+        return -1;
+    }
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        // 没有文件或没有进程在监听：冷启动
+        int err = errno;
+        close(fd);
+        if (err == ENOENT || err == ECONNREFUSED) {
+            return 0;
+        }
+        log_error("Hot restart connect to %s failed: %s", path, strerror(err));
+        return -1;
+    }
+    set_timeout(fd, HOT_RESTART_TIMEOUT_MS);
+
+    HandoffRequest request = { HOT_RESTART_MAGIC, HOT_RESTART_VERSION, port };
+    if (send_exact(fd, &request, sizeof(request)) < 0) {
+        log_error("Hot restart request failed: %s", strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    HandoffHeader header;
+    union {
+        char buf[CMSG_SPACE(sizeof(int) * HOT_RESTART_MAX_FDS)];
+        struct cmsghdr align;
+    } control;
+    struct iovec iov = { .iov_base = &header, .iov_len = sizeof(header) };
+    struct msghdr msg = {0};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    ssize_t n;
+    do {
+        n = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC | MSG_WAITALL);
+    } while (n < 0 && errno == EINTR);
+    if (n != (ssize_t)sizeof(header)) {
+        log_error("Hot restart: no reply from running process: %s", n < 0 ? strerror(errno) : "short read");
+        close(fd);
+        return -1;
+    }
+
+    int fds[HOT_RESTART_MAX_FDS];
+    int fd_count = 0;
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            int count = (int)((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+            if (count > HOT_RESTART_MAX_FDS - fd_count) count = HOT_RESTART_MAX_FDS - fd_count;
+            memcpy(&fds[fd_count], CMSG_DATA(cmsg), sizeof(int) * (size_t)count);
+            fd_count += count;
+        }
+    }
+
+    int expected = header.tcp_count + header.udp_count + (header.has_unix ? 1 : 0);
+    if (header.magic != HOT_RESTART_MAGIC || header.version != HOT_RESTART_VERSION ||
+        header.tcp_count < 0 || header.tcp_count > HOT_RESTART_MAX_LISTENERS ||
+        header.udp_count < 0 || header.udp_count > HOT_RESTART_MAX_LISTENERS ||
+        (msg.msg_flags & MSG_CTRUNC) || fd_count != expected) {
+        log_error("Hot restart: malformed reply from running process");
+        for (int i = 0; i < fd_count; i++) close(fds[i]);
+        close(fd);
+        return -1;
+    }
+    if (header.port != port) {
+        log_error("Hot restart: running process listens on port %d, not %d", header.port, port);
+        for (int i = 0; i < fd_count; i++) close(fds[i]);
+        close(fd);
+        return -1;
+    }
+
+    sockets->port = header.port;
+    sockets->tcp_count = header.tcp_count;
+    memcpy(sockets->tcp, fds, sizeof(int) * (size_t)header.tcp_count);
+    sockets->udp_count = header.udp_count;
+    memcpy(sockets->udp, fds + header.tcp_count, sizeof(int) * (size_t)header.udp_count);
+    if (header.has_unix) {
+        sockets->unix_fd = fds[expected - 1];
+        sockets->unix_type = header.unix_type;
+    }
+    *conn = fd;
+    return 1;
+}
+
+// 确认接管。旧进程等待确认超时后会关闭连接，此时收不到回送
+int hot_restart_confirm(int conn) {
+    HandoffAck ack = { HOT_RESTART_MAGIC };
+    int ret = send_exact(conn, &ack, sizeof(ack));
+    if (ret < 0) {
+        log_error("Hot restart confirm failed: %s", strerror(errno));
+    } else {
+        HandoffAck echo;
+        ret = recv_exact(conn, &echo, sizeof(echo));
+        if (ret < 0 || echo.magic != HOT_RESTART_MAGIC) {
+            log_error("Hot restart: running process did not acknowledge the takeover");
+            ret = -1;
+        }
+    }
+    close(conn);
+    return ret;
+}
+
+// 创建控制套接字
+int hot_restart_listen(const char *path) {
+    struct sockaddr_un addr;
+    if (fill_address(&addr, path) < 0) {
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        log_error("Hot restart socket failed: %s", strerror(errno));
+        return -1;
+    }
+    // 新进程已接管（或旧进程已退出）时替换旧文件
+    unlink(path);
+    mode_t old_mask = umask(0077);
+    int ret = bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+    umask(old_mask);
+    if (ret < 0 || listen(fd, 1) < 0) {
+        log_error("Hot restart bind %s failed: %s", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// 发送监听套接字并等待确认
+int hot_restart_serve(int control, const HandoffSockets *sockets) {
+    int fd;
+    do {
+        fd = accept4(control, NULL, NULL, SOCK_CLOEXEC);
+    } while (fd < 0 && errno == EINTR);
+    if (fd < 0) {
+        return -1;
+    }
+    set_timeout(fd, HOT_RESTART_TIMEOUT_MS);
+
+    // 只把监听套接字交给同一用户的进程
+    struct ucred cred;
+    socklen_t cred_len = sizeof(cred);
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &cred_len) < 0 ||
+        (cred.uid != getuid() && cred.uid != 0)) {
+        log_warn("Hot restart: rejected connection from another user");
+        close(fd);
+        return 1;
+    }
+
+    HandoffRequest request;
+    if (recv_exact(fd, &request, sizeof(request)) < 0 ||
+        request.magic != HOT_RESTART_MAGIC || request.version != HOT_RESTART_VERSION) {
+        log_warn("Hot restart: malformed request from pid %d", (int)cred.pid);
+        close(fd);
+        return 1;
+    }
+
+    HandoffHeader header = {0};
+    header.magic = HOT_RESTART_MAGIC;
+    header.version = HOT_RESTART_VERSION;
+    header.port = sockets->port;
+    header.tcp_count = sockets->tcp_count;
+    header.udp_count = sockets->udp_count;
+    header.has_unix = sockets->unix_fd >= 0;
+    header.unix_type = sockets->unix_type;
+
+    int fds[HOT_RESTART_MAX_FDS];
+    int fd_count = 0;
+    for (int i = 0; i < sockets->tcp_count; i++) fds[fd_count++] = sockets->tcp[i];
+    for (int i = 0; i < sockets->udp_count; i++) fds[fd_count++] = sockets->udp[i];
+    if (sockets->unix_fd >= 0) fds[fd_count++] = sockets->unix_fd;
+
+    union {
+        char buf[CMSG_SPACE(sizeof(int) * HOT_RESTART_MAX_FDS)];
+        struct cmsghdr align;
+    } control_buf;
+    memset(&control_buf, 0, sizeof(control_buf));
+    struct iovec iov = { .iov_base = &header, .iov_len = sizeof(header) };
+    struct msghdr msg = {0};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    if (fd_count > 0) {
+        msg.msg_control = control_buf.buf;
+        msg.msg_controllen = CMSG_SPACE(sizeof(int) * (size_t)fd_count);
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int) * (size_t)fd_count);
+        memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * (size_t)fd_count);
+    }
+
+    ssize_t n;
+    do {
+        n = sendmsg(fd, &msg, MSG_NOSIGNAL);
+    } while (n < 0 && errno == EINTR);
+    if (n != (ssize_t)sizeof(header)) {
+        log_warn("Hot restart: sending listeners to pid %d failed: %s", (int)cred.pid, strerror(errno));
+        close(fd);
+        return 1;
+    }
+
+    // 新进程的工作线程全部启动后才确认；没有确认说明新进程启动失败，继续服务
+    HandoffAck ack;
+    if (recv_exact(fd, &ack, sizeof(ack)) < 0 || ack.magic != HOT_RESTART_MAGIC) {
+        log_warn("Hot restart: pid %d did not take over, continuing to serve", (int)cred.pid);
+        close(fd);
+        return 1;
+    }
+    if (send_exact(fd, &ack, sizeof(ack)) < 0) {
+        log_warn("Hot restart: pid %d went away before the takeover completed, continuing to serve", (int)cred.pid);
+        close(fd);
+        return 1;
+    }
+    log_info("Hot restart: listeners handed over to pid %d", (int)cred.pid);
+    close(fd);
+    return 0;
+}
+
+// 关闭收到的监听套接字
+void hot_restart_close(HandoffSockets *sockets) {
+    for (int i = 0; i < sockets->tcp_count; i++) {
+        if (sockets->tcp[i] >= 0) close(sockets->tcp[i]);
+    }
+    for (int i = 0; i < sockets->udp_count; i++) {
+        if (sockets->udp[i] >= 0) close(sockets->udp[i]);
+    }
+    if (sockets->unix_fd >= 0) close(sockets->unix_fd);
+    sockets->tcp_count = 0;
+    sockets->udp_count = 0;
+    sockets->unix_fd = -1;
+}
\ No newline at end of file
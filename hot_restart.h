@@ -0,0 +1,47 @@
+#ifndef HOT_RESTART_H
+#define HOT_RESTART_H
+
+// 热重启：新进程通过 Unix 域控制套接字从正在运行的进程接收监听套接字（SCM_RIGHTS），
+// 确认接管后旧进程停止接受新连接，在后台处理完已有的连接再退出。
+// 监听套接字在两个进程间不关闭，内核监听队列中等待接受的连接不会丢失
+
+// 默认配置
+#define HOT_RESTART_DEFAULT_DRAIN_MS 30000   // 旧进程等待已有连接结束的上限，超时后关闭剩余连接
+// 每种套接字最多传递的数量（一次 sendmsg 最多携带 253 个文件描述符），工作线程更多时不交接
+#define HOT_RESTART_MAX_LISTENERS 64
+// 等待对端应答和新进程各工作线程启动的上限（毫秒）
+#define HOT_RESTART_TIMEOUT_MS 10000
+
+// 在进程间传递的监听套接字
+typedef struct {
+    int port;
+    int tcp[HOT_RESTART_MAX_LISTENERS];     // 各工作线程的 TCP 监听套接字（SO_REUSEPORT 组）
+    int tcp_count;
+    int udp[HOT_RESTART_MAX_LISTENERS];     // 各工作线程的 UDP 套接字
+    int udp_count;
+    int unix_fd;                            // 共享的 Unix 域监听套接字，-1 表示没有
+    int unix_type;
+} HandoffSockets;
+
+// 新进程：连接 path 上的控制套接字，接收正在运行的进程的监听套接字。
+// 成功时 *conn 为控制连接，接管后调用 hot_restart_confirm
+// 返回: 收到监听套接字返回 1，没有正在运行的进程返回 0，出错返回 -1
+int hot_restart_receive(const char *path, int port, HandoffSockets *sockets, int *conn);
+
+// 新进程：所有工作线程开始接受连接后确认接管，旧进程收到确认后回送确认并开始排空。关闭控制连接
+// 返回: 收到旧进程的回送返回 0；发送失败或旧进程已放弃（等待超过 HOT_RESTART_TIMEOUT_MS）返回 -1，
+// 此时旧进程继续服务，新进程应退出
+int hot_restart_confirm(int conn);
+
+// 在 path 上创建控制套接字（替换已存在的文件，只允许同一用户连接）
+// 返回: 成功返回监听套接字，失败返回 -1
+int hot_restart_listen(const char *path);
+
+// 旧进程：接受一个新进程的连接，发送监听套接字，等待确认并回送。监听套接字关闭后返回 -1
+// 返回: 新进程已确认接管返回 0，本次交接失败返回 1（可以继续等待下一个连接），出错返回 -1
+int hot_restart_serve(int control, const HandoffSockets *sockets);
+
+// 关闭收到的监听套接字
+void hot_restart_close(HandoffSockets *sockets);
+
+#endif // HOT_RESTART_H
\ No newline at end of file
@@ -1,6 +1,19 @@
+#define _GNU_SOURCE
 #include "iouring_server.h"
 #include "error.h"
 #include "resource_manager.h"
+#include "balancer.h"
+#include "admission.h"
+#include "udp.h"
+#include "proxy.h"
+#include "tls.h"
+#include "wait_strategy.h"
+#include "recorder.h"
+#include "logger.h"
+#include "hot_restart.h"
+#include "coroutine.h"
+#include "pubsub.h"
+#include "capture.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -8,162 +21,334 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <liburing.h>
 #include <signal.h>
-#include <sys/resource.h>
 #include <limits.h>
-
-#define BITMAP_SIZE ((BUFFER_COUNT + CHAR_BIT - 1) / CHAR_BIT)
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <sched.h>
+#include <linux/filter.h>
+
+#ifndef SO_ATTACH_REUSEPORT_CBPF
+#define SO_ATTACH_REUSEPORT_CBPF 51
+#endif
+
+// 提交队列剩余空间低于此值时在处理完成事件的过程中提前提交
+#define SQ_LOW_WATERMARK 64
+
+// 连续这么多次读取都能放进更小的规格时，连接改用更小规格的接收缓冲区；
+// 较大规格的缓冲区数量少，离开得更快
+#define BUFFER_SHRINK_READS 16
+#define LARGE_BUFFER_SHRINK_READS 2
 
 // 用于控制服务器运行的标志
 static volatile sig_atomic_t keep_running = 1;
 
 static int add_accept_request(struct io_uring *ring, int server_socket);
-static int add_read_request(struct io_uring *ring, struct connection *conn);
-static int add_write_request(struct io_uring *ring, struct connection *conn);
+static int add_read_request(ResourceManager *rm, struct connection *conn);
+static int add_write_request(ResourceManager *rm, struct connection *conn);
+static int try_migrate_connection(ResourceManager *rm, struct connection *conn);
 
 // 回调函数指针
 static on_connect_cb on_connect = NULL;
 static on_disconnect_cb on_disconnect = NULL;
 static on_data_cb on_data = NULL;
+static on_datagram_cb on_datagram = NULL;
+static coroutine_fn coroutine_handler = NULL;
+static size_t coroutine_frame_size = 0;
+
+// 卸载任务线程数
+static int offload_threads = 0;
+
+// 发布订阅配置，未启用时不创建主题表
+static PubsubConfig pubsub_config;
+static int pubsub_enabled = 0;
+
+// 连接唯一标识计数器
+static atomic_uint_fast64_t next_connection_id = 1;
+
+// 工作线程（事件循环）数量及负载均衡配置
+static int worker_count = 1;
+static BalancerConfig balancer_config = {
+    BALANCER_DEFAULT_BACKLOG,
+    BALANCER_DEFAULT_LATENCY_US,
+    BALANCER_DEFAULT_SUSTAIN,
+    BALANCER_DEFAULT_INTERVAL_MS,
+    BALANCER_DEFAULT_MAX_MIGRATIONS
+};
+
+// 各工作线程的资源管理器，就绪后发布，供连接迁移查找目标 ring
+static _Atomic(ResourceManager*) *workers = NULL;
+
+// 内核是否支持 IORING_OP_MSG_RING
+static int msg_ring_supported = 0;
+
+// 关闭通知 eventfd，所有工作线程在其上挂起 poll 请求
+static int shutdown_fd = -1;
+
+// 可选的 Unix 域监听套接字，所有工作线程在同一个套接字上接受连接
+static char unix_path[sizeof(((struct sockaddr_un*)0)->sun_path)];
+static int unix_type = SOCK_STREAM;
+static int unix_socket = -1;
+static void on_unix_accept(struct completion_handler *handler, struct io_uring_cqe *cqe, ResourceManager *rm);
+static struct completion_handler unix_accept_handler = { on_unix_accept };
+static void on_accept_timer(struct completion_handler *handler, struct io_uring_cqe *cqe, ResourceManager *rm);
+static struct completion_handler accept_timer_handler = { on_accept_timer };
+
+// 代理模式配置，所有工作线程共用
+static ProxyConfig proxy_config;
+static int proxy_enabled = 0;
+
+// TLS 证书和私钥路径，以及由其创建的共享配置
+static char tls_cert_file[PATH_MAX];
+static char tls_key_file[PATH_MAX];
+static TlsContext *tls_context = NULL;
+
+// 过载控制配置
+static AdmissionConfig admission_config = {
+    ADMISSION_DEFAULT_REJECT_PCT, ADMISSION_DEFAULT_SHED_PCT,
+    ADMISSION_DEFAULT_MEMORY_MB, ADMISSION_DEFAULT_SHED_BATCH
+};
+
+// 过载时暂停的接受请求
+#define ACCEPT_PAUSED_TCP 1
+#define ACCEPT_PAUSED_UNIX 2
+// 接受失败（文件描述符或内存耗尽）后暂停接受的时间（毫秒）
+#define ACCEPT_RETRY_MS 10
+
+// 是否将发送和下一次读取链接提交
+static int link_send_recv = 0;
+
+// 公平调度预算
+static unsigned sched_byte_budget = SCHED_DEFAULT_BYTE_BUDGET;
+static unsigned sched_op_budget = SCHED_DEFAULT_OP_BUDGET;
+// 因超出预算延后的读取次数（所有工作线程）
+static atomic_uint_fast64_t reads_deferred = 0;
+// 连接改用更大、更小规格接收缓冲区的次数（所有工作线程）
+static atomic_uint_fast64_t buffer_grows = 0;
+static atomic_uint_fast64_t buffer_shrinks = 0;
+
+// 流量捕获文件（为空表示不捕获）和是否记录消息内容
+static char capture_path[PATH_MAX];
+static int capture_payload = 0;
+
+// 工作线程的 CPU 绑定和新连接引导
+static CpuSteering cpu_steering = CPU_STEER_OFF;
+// 工作线程 i 绑定的 CPU，启动时按进程可用的 CPU 依次分配（不绑定时为 NULL）
+static int *worker_cpus = NULL;
+// 进程原有的 CPU 集合，创建卸载任务线程时恢复
+static cpu_set_t process_cpus;
+// 启用 CPU 引导时统计接受的连接数，以及其中接收 CPU 与接受它的工作线程所在 CPU 不同的连接数
+static atomic_uint_fast64_t accepts_sampled = 0;
+static atomic_uint_fast64_t accepts_cross_cpu = 0;
+
+// ring 和缓冲区的大小
+static ServerConfig server_config = {
+    SERVER_DEFAULT_QUEUE_DEPTH, 0, SERVER_DEFAULT_BUFFER_SIZE, SERVER_DEFAULT_BUFFER_COUNT,
+    SERVER_DEFAULT_SMALL_BUFFER_SIZE, SERVER_DEFAULT_SMALL_BUFFER_COUNT,
+    SERVER_DEFAULT_LARGE_BUFFER_SIZE, SERVER_DEFAULT_LARGE_BUFFER_COUNT,
+    0, SERVER_DEFAULT_POOL_BLOCKS, 0, 0, 0
+};
+
+// 注册缓冲区和连接池所在的区域是否使用大页
+static int huge_pages = 1;
+
+// 链接发送的 user_data 标记（连接结构体按缓存行对齐，低位可用）
+#define LINKED_SEND_TAG ((uintptr_t)2)
+
+// 是否探测并使用新的 ring 设置标志
+static int ring_flags_probe = 1;
+
+// 事件循环的等待策略，所有工作线程共用
+static WaitConfig wait_config = {
+    WAIT_DEFAULT_SPIN_US, WAIT_DEFAULT_NAPI_US, WAIT_DEFAULT_MAX_SLEEP_MS
+};
+
+// 事件记录器：每个工作线程保留的事件数（0 表示关闭）和转储文件
+static unsigned recorder_events = RECORDER_DEFAULT_EVENTS;
+static char recorder_file[PATH_MAX];
+
+// 热重启：控制套接字路径（为空表示不启用）和交接后等待已有连接结束的上限
+static char hot_restart_path[sizeof(((struct sockaddr_un*)0)->sun_path)];
+static unsigned drain_timeout_ms = HOT_RESTART_DEFAULT_DRAIN_MS;
+// 通知工作线程开始排空的 eventfd，只在启用热重启时创建
+static int drain_fd = -1;
+// 已停止接受连接的工作线程数
+static atomic_int drained_workers = 0;
+// 监听套接字已交给新进程：退出时不删除 Unix 域套接字文件和控制套接字文件
+static atomic_int handed_off = 0;
+// 新进程未能完成接管（旧进程没有回送确认）：旧进程继续服务，本进程退出且不删除这些文件
+static atomic_int takeover_failed = 0;
+// 新进程与旧进程的控制连接，所有工作线程启动后确认接管
+static int restart_conn = -1;
 
 // 设置回调函数
 void set_on_connect(on_connect_cb cb) { on_connect = cb; }
 void set_on_disconnect(on_disconnect_cb cb) { on_disconnect = cb; }
 void set_on_data(on_data_cb cb) { on_data = cb; }
+void set_on_datagram(on_datagram_cb cb) { on_datagram = cb; }
 
-// SIGINT 信号处理函数
-static void sigint_handler(int sig) {
-    (void)sig;
-    keep_running = 0;
+// 设置协程处理器
+void set_coroutine_handler(coroutine_fn fn, size_t frame_size) {
+    coroutine_handler = fn;
+    coroutine_frame_size = frame_size;
 }
 
-// 将文件描述符设置为非阻塞模式
-static int set_non_blocking(int fd) {
-    int flags = fcntl(fd, F_GETFL, 0);
-    if (flags == -1) return -1;
-    return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+// 设置发布订阅
+void set_pubsub(const PubsubConfig *config) {
+    pubsub_enabled = config != NULL;
+    if (config) {
+        pubsub_config = *config;
+    }
 }
 
-// 全局变量声明
-static struct iovec *bufs;
-static char *buf_base;
-static unsigned char buffer_bitmap[BITMAP_SIZE];
+// 设置代理上游
+void set_proxy_upstream(const struct sockaddr_in *upstream, unsigned connect_timeout_ms, int copy) {
+    proxy_enabled = upstream != NULL;
+    if (upstream) {
+        proxy_config.upstream = *upstream;
+        proxy_config.connect_timeout_ms = connect_timeout_ms;
+        proxy_config.copy = copy;
+    }
+}
 
-// 缓冲区池相关定义
-typedef struct {
-    char* buffer;
-    int is_used;
-} BufferPoolItem;
+// 设置 TLS 证书和私钥
+void set_tls(const char *cert_file, const char *key_file) {
+    snprintf(tls_cert_file, sizeof(tls_cert_file), "%s", cert_file ? cert_file : "");
+    snprintf(tls_key_file, sizeof(tls_key_file), "%s", key_file ? key_file : "");
+}
 
-static BufferPoolItem *buffer_pool = NULL;
-static int buffer_pool_size = 0;
+// 设置 Unix 域套接字监听路径，type 为 SOCK_STREAM 或 SOCK_SEQPACKET
+void set_unix_listener(const char *path, int type) {
+    snprintf(unix_path, sizeof(unix_path), "%s", path ? path : "");
+    unix_type = type;
+}
 
-// 修改初始化缓冲区池的函数
-static int init_buffer_pool(int size) {
-    buffer_pool = calloc(size, sizeof(BufferPoolItem));
-    if (!buffer_pool) {
-        return -1;
-    }
-    buffer_pool_size = size;
-    for (int i = 0; i < size; i++) {
-        buffer_pool[i].buffer = malloc(BUFFER_SIZE);
-        if (!buffer_pool[i].buffer) {
-            // 清理已分配的内存并返回错误
-            for (int j = 0; j < i; j++) {
-                free(buffer_pool[j].buffer);
-            }
-            free(buffer_pool);
-            buffer_pool = NULL;
-            return -1;
-        }
-        buffer_pool[i].is_used = 0;
-    }
-    return 0;
+// 设置事件循环的等待策略
+void set_wait_strategy(unsigned spin_us, unsigned napi_busy_poll_us, unsigned max_sleep_ms) {
+    wait_config.spin_us = spin_us;
+    wait_config.napi_busy_poll_us = napi_busy_poll_us;
+    wait_config.max_sleep_ms = max_sleep_ms;
 }
 
-// 修改获取缓冲区的函数
-static char* get_buffer_from_pool() {
-    for (int i = 0; i < buffer_pool_size; i++) {
-        if (!buffer_pool[i].is_used) {
-            buffer_pool[i].is_used = 1;
-            return buffer_pool[i].buffer;
-        }
-    }
-    return NULL;
+// 设置是否使用新的 ring 设置标志
+void set_ring_flags_probe(int enabled) { ring_flags_probe = enabled; }
+
+// 设置过载控制阈值
+void set_overload_limits(unsigned reject_pct, unsigned shed_pct, unsigned memory_limit_mb) {
+    admission_config.reject_headroom_pct = reject_pct;
+    admission_config.shed_headroom_pct = shed_pct;
+    admission_config.memory_limit_mb = memory_limit_mb;
 }
 
-// 修改清理缓冲区池的函数
-static void cleanup_buffer_pool() {
-    if (buffer_pool) {
-        for (int i = 0; i < buffer_pool_size; i++) {
-            free(buffer_pool[i].buffer);
-        }
-        free(buffer_pool);
-        buffer_pool = NULL;
-    }
+// 设置是否将发送和下一次读取链接提交
+void set_link_send_recv(int enabled) { link_send_recv = enabled; }
+
+// 设置公平调度预算
+void set_fair_budgets(unsigned byte_budget, unsigned op_budget) {
+    sched_byte_budget = byte_budget;
+    sched_op_budget = op_budget;
 }
 
-// 设置 io_uring 缓冲区
-static int setup_buffers(struct io_uring *ring) {
-    if (init_buffer_pool(BUFFER_COUNT) < 0) {
-        handle_error(ERR_MEMORY_ALLOC_FAILED, "Failed to initialize buffer pool");
-        return -1;
-    }
+// 设置 ring 和缓冲区的大小
+void set_server_config(const ServerConfig *config) { server_config = *config; }
 
-    // 分配 iovec 数组
-    bufs = calloc(BUFFER_COUNT, sizeof(struct iovec));
-    if (!bufs) {
-        handle_error(ERR_MEMORY_ALLOC_FAILED, "Failed to allocate buffers");
-        return -1;
-    }
+// 设置缓冲区区域是否使用大页
+void set_huge_pages(int enabled) { huge_pages = enabled; }
 
-    // 从缓冲区池中获取缓冲区并初始化 iovec
-    for (int i = 0; i < BUFFER_COUNT; i++) {
-        bufs[i].iov_base = get_buffer_from_pool();
-        if (!bufs[i].iov_base) {
-            handle_error(ERR_MEMORY_ALLOC_FAILED, "Failed to get buffer from pool");
-            return -1;
-        }
-        bufs[i].iov_len = BUFFER_SIZE;
-    }
+// 设置事件记录器
+void set_flight_recorder(unsigned events, const char *path) {
+    recorder_events = events;
+    snprintf(recorder_file, sizeof(recorder_file), "%s", path ? path : "");
+}
 
-    // 注册缓冲区到 io_uring
-    int ret = io_uring_register_buffers(ring, bufs, BUFFER_COUNT);
-    if (ret) {
-        handle_error(ERR_URING_INIT_FAILED, "Failed to register buffers");
-        return -1;
-    }
+// 转储事件记录器
+int dump_flight_recorder(void) { return recorder_dump(0); }
+
+// 设置热重启
+void set_hot_restart(const char *path, unsigned drain_timeout) {
+    snprintf(hot_restart_path, sizeof(hot_restart_path), "%s", path ? path : "");
+    drain_timeout_ms = drain_timeout;
+}
 
-    // 初始化缓冲区位图
-    memset(buffer_bitmap, 0, BITMAP_SIZE);
+// 设置卸载任务线程数
+void set_offload_threads(int threads) { offload_threads = threads; }
 
-    return 0;
+// 设置工作线程数
+void set_worker_count(int count) { worker_count = count > 0 ? count : 1; }
+
+// 设置流量捕获
+void set_traffic_capture(const char *path, int payload) {
+    snprintf(capture_path, sizeof(capture_path), "%s", path ? path : "");
+    capture_payload = payload;
 }
 
-// 获取空闲缓冲区ID
-static int get_free_buffer_id() {
-    for (int i = 0; i < BUFFER_COUNT; i++) {
-        int byte_index = i / CHAR_BIT;
-        int bit_index = i % CHAR_BIT;
-        if (!(buffer_bitmap[byte_index] & (1 << bit_index))) {
-            buffer_bitmap[byte_index] |= (1 << bit_index);
-            return i;
-        }
+// 设置工作线程的 CPU 绑定和新连接引导
+void set_cpu_steering(CpuSteering mode) { cpu_steering = mode; }
+
+// 设置连接迁移阈值，两个阈值均为 0 时禁用迁移
+void set_migration_thresholds(unsigned backlog, unsigned latency_us) {
+    balancer_config.backlog_threshold = backlog;
+    balancer_config.latency_threshold_us = latency_us;
+}
+
+// 唤醒所有工作线程（可在信号处理函数中调用）
+static void wake_workers(void) {
+    if (shutdown_fd >= 0) {
+        uint64_t one = 1;
+        ssize_t ret = write(shutdown_fd, &one, sizeof(one));
+        (void)ret;
     }
-    return -1;
 }
 
-// 释放缓冲区ID
-static void release_buffer_id(int id) {
-    if (id >= 0 && id < BUFFER_COUNT) {
-        int byte_index = id / CHAR_BIT;
-        int bit_index = id % CHAR_BIT;
-        buffer_bitmap[byte_index] &= ~(1 << bit_index);
+// SIGINT 信号处理函数
+static void sigint_handler(int sig) {
+    (void)sig;
+    keep_running = 0;
+    wake_workers();
+}
+
+// SIGUSR1 信号处理函数：转储事件记录器，服务器继续运行
+static void dump_signal_handler(int sig) {
+    recorder_dump(sig);
+}
+
+// 崩溃信号处理函数：转储事件记录器后以默认动作重新触发信号（处理函数安装时带 SA_RESETHAND）
+static void crash_signal_handler(int sig) {
+    recorder_dump(sig);
+    raise(sig);
+}
+
+static const int crash_signals[] = { SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT };
+
+// 安装或恢复转储信号的处理函数
+static void install_recorder_signals(int enabled) {
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sigemptyset(&sa.sa_mask);
+    sa.sa_handler = enabled ? dump_signal_handler : SIG_IGN;
+    sa.sa_flags = SA_RESTART;
+    sigaction(SIGUSR1, &sa, NULL);
+    for (size_t i = 0; i < sizeof(crash_signals) / sizeof(crash_signals[0]); i++) {
+        sa.sa_handler = enabled ? crash_signal_handler : SIG_DFL;
+        sa.sa_flags = enabled ? SA_RESETHAND | SA_NODEFER : 0;
+        sigaction(crash_signals[i], &sa, NULL);
     }
 }
 
+// 将文件描述符设置为非阻塞模式
+static int set_non_blocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags == -1) return -1;
+    return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
 // 添加接受连接请求到 io_uring
 static int add_accept_request(struct io_uring *ring, int server_socket) {
     struct io_uring_sqe *sqe = io_uring_get_sqe(ring);
@@ -180,28 +365,97 @@ static int add_accept_request(struct io_uring *ring, int server_socket) {
 // 创建新的连接
 static struct connection* create_connection(ResourceManager *rm, int fd) {
     struct connection* conn = memory_pool_alloc(rm->connection_pool);
-    if (!conn) {
-        handle_error(ERR_MEMORY_ALLOC_FAILED, "Failed to allocate connection from pool");
+    struct connection_cold* cold = conn ? memory_pool_alloc(rm->connection_cold_pool) : NULL;
+    if (!cold) {
+        handle_error(ERR_RESOURCE_EXHAUSTED, "Failed to allocate connection from pool");
+        if (conn) memory_pool_free(rm->connection_pool, conn);
         return NULL;
     }
 
     // 初始化连接结构
     memset(conn, 0, sizeof(struct connection));
+    memset(cold, 0, sizeof(struct connection_cold));
     conn->fd = fd;
     conn->state = CONN_STATE_READING;
+    conn->buffer_class = BUFFER_CLASS_DEFAULT;
     conn->buffer_id = -1;
+    conn->id = atomic_fetch_add(&next_connection_id, 1);
+    conn->cold = cold;
 
-    // 初始化读写缓冲区
-    ring_buffer_init(&conn->read_buffer, BUFFER_SIZE);
-    ring_buffer_init(&conn->write_buffer, BUFFER_SIZE);
+    // 读写缓冲区在第一次写入时才分配，空闲连接和协程连接（在自己的帧中收发）不占用缓冲区内存
+    ring_buffer_init(&cold->read_buffer, 0);
+    ring_buffer_init(&cold->write_buffer, 0);
+    return conn;
+}
 
-    if (conn->read_buffer.buffer == NULL || conn->write_buffer.buffer == NULL) {
-        handle_error(ERR_MEMORY_ALLOC_FAILED, "Failed to initialize buffers");
-        memory_pool_free(rm->connection_pool, conn);
-        return NULL;
+// 获取单调时钟（纳秒）
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// 将连接移到活动链表的最近一端
+static void lru_touch(ResourceManager *rm, struct connection *conn) {
+    if (rm->lru_tail == conn) return;
+    if (conn->lru_prev || rm->lru_head == conn) {
+        if (conn->lru_prev) conn->lru_prev->lru_next = conn->lru_next;
+        else rm->lru_head = conn->lru_next;
+        conn->lru_next->lru_prev = conn->lru_prev;
     }
+    conn->lru_prev = rm->lru_tail;
+    conn->lru_next = NULL;
+    if (rm->lru_tail) rm->lru_tail->lru_next = conn;
+    else rm->lru_head = conn;
+    rm->lru_tail = conn;
+}
 
-    return conn;
+// 从活动链表摘除连接（不在链表中时无操作）
+static void lru_unlink(ResourceManager *rm, struct connection *conn) {
+    if (!conn->lru_prev && rm->lru_head != conn) return;
+    if (conn->lru_prev) conn->lru_prev->lru_next = conn->lru_next;
+    else rm->lru_head = conn->lru_next;
+    if (conn->lru_next) conn->lru_next->lru_prev = conn->lru_prev;
+    else rm->lru_tail = conn->lru_prev;
+    conn->lru_prev = conn->lru_next = NULL;
+}
+
+// 按经过的轮次抵扣连接超出的字节，进入新的一轮时清零读取次数
+static void sched_settle(struct connection *conn, uint32_t round) {
+    uint32_t elapsed = round - conn->sched_round;
+    if (elapsed == 0) return;
+    uint64_t credit = (uint64_t)elapsed * sched_byte_budget;
+    conn->sched_bytes = conn->sched_bytes > credit ? (uint32_t)(conn->sched_bytes - credit) : 0;
+    conn->sched_ops = 0;
+    conn->sched_round = round;
+}
+
+// 连接在 round 轮的读取是否已用完预算
+static int sched_over_budget(struct connection *conn, uint32_t round) {
+    sched_settle(conn, round);
+    return (sched_byte_budget && conn->sched_bytes >= sched_byte_budget) ||
+           (sched_op_budget && conn->sched_ops >= sched_op_budget);
+}
+
+// 将连接放入延后读取队列的末尾
+static void sched_defer(ResourceManager *rm, struct connection *conn) {
+    conn->state = CONN_STATE_DEFERRED;
+    conn->cold->sched_prev = rm->deferred_tail;
+    conn->cold->sched_next = NULL;
+    if (rm->deferred_tail) rm->deferred_tail->cold->sched_next = conn;
+    else rm->deferred_head = conn;
+    rm->deferred_tail = conn;
+    atomic_fetch_add_explicit(&reads_deferred, 1, memory_order_relaxed);
+}
+
+// 从延后读取队列摘除连接
+static void sched_unlink(ResourceManager *rm, struct connection *conn) {
+    if (conn->cold->sched_prev) conn->cold->sched_prev->cold->sched_next = conn->cold->sched_next;
+    else rm->deferred_head = conn->cold->sched_next;
+    if (conn->cold->sched_next) conn->cold->sched_next->cold->sched_prev = conn->cold->sched_prev;
+    else rm->deferred_tail = conn->cold->sched_prev;
+    conn->cold->sched_prev = conn->cold->sched_next = NULL;
+    conn->state = CONN_STATE_READING;
 }
 
 // 关闭并释放连接
@@ -212,9 +466,17 @@ static void close_and_free_connection(ResourceManager *rm, struct connection *co
     if (fd >= 0 && fd < rm->max_connections) {
         if (rm->connections[fd] == conn) {
             rm->connections[fd] = NULL;
+            lru_unlink(rm, conn);
+            if (conn->state == CONN_STATE_DEFERRED) {
+                sched_unlink(rm, conn);
+            }
             close(fd);
+            recorder_record(rm->recorder, RECORDER_CLOSE, conn->id, fd, 0, 0);
+            if (rm->capture) {
+                capture_close(rm->capture, conn->id);
+            }
 
-            struct sockaddr_in client_addr = conn->addr;
+            struct sockaddr_in client_addr = conn->cold->addr;
 
             int saved_errno = errno;
 
@@ -226,56 +488,175 @@ static void close_and_free_connection(ResourceManager *rm, struct connection *co
             errno = saved_errno;
 
             // 清理资源
-            ring_buffer_destroy(&conn->read_buffer);
-            ring_buffer_destroy(&conn->write_buffer);
+            if (conn->cold->subscriber) {
+                pubsub_connection_closed(rm, conn);
+            }
+            ring_buffer_destroy(&conn->cold->read_buffer);
+            ring_buffer_destroy(&conn->cold->write_buffer);
             if (conn->buffer_id >= 0) {
-                release_buffer_id(conn->buffer_id);
+                release_buffer_id(rm, conn->buffer_id);
             }
+            memory_pool_free(rm->connection_cold_pool, conn->cold);
             memory_pool_free(rm->connection_pool, conn);
+            balancer_connection_delta(rm->worker_index, -1);
+            admission_connection_delta(-1);
+        }
+    }
+}
+
+// 连接可以使用的最小规格：SOCK_SEQPACKET 的消息超出缓冲区会被截断，此时不低于默认规格
+static int lowest_buffer_class(void) {
+    return unix_path[0] && unix_type == SOCK_SEQPACKET ? BUFFER_CLASS_DEFAULT : BUFFER_CLASS_SMALL;
+}
+
+// 为连接取得接收缓冲区：优先使用连接当前的规格，该规格已用完时依次尝试更大的规格，
+// 最后是不低于 lowest_buffer_class 的更小规格
+static int acquire_connection_buffer(ResourceManager *rm, struct connection *conn) {
+    for (int c = conn->buffer_class; c < BUFFER_CLASS_COUNT; c++) {
+        int id = acquire_buffer_in_class(rm, c);
+        if (id != -1) return id;
+    }
+    for (int c = conn->buffer_class - 1; c >= lowest_buffer_class(); c--) {
+        int id = acquire_buffer_in_class(rm, c);
+        if (id != -1) return id;
+    }
+    return -1;
+}
+
+// 按最近的读取大小调整连接的接收缓冲区规格，在下一次读取时生效：读满缓冲区说明还有数据等待读取，
+// 立即升一级；连续多次读取都能放进更小的规格时降一级，但不低于 lowest_buffer_class
+static void adapt_buffer_class(ResourceManager *rm, struct connection *conn, size_t bytes) {
+    const BufferClass *classes = rm->buffer_classes;
+    int current = buffer_class_of(rm, conn->buffer_id);
+    if (bytes >= classes[current].size) {
+        conn->buffer_shrink = 0;
+        for (int c = current + 1; c < BUFFER_CLASS_COUNT; c++) {
+            if (classes[c].count == 0) continue;
+            if (conn->buffer_class != c) {
+                conn->buffer_class = (uint8_t)c;
+                atomic_fetch_add_explicit(&buffer_grows, 1, memory_order_relaxed);
+            }
+            break;
+        }
+        return;
+    }
+
+    int lowest = lowest_buffer_class();
+    int smaller = -1;
+    for (int c = current - 1; c >= lowest; c--) {
+        if (classes[c].count) {
+            smaller = c;
+            break;
+        }
+    }
+    if (smaller < 0 || bytes > classes[smaller].size) {
+        conn->buffer_shrink = 0;
+        return;
+    }
+    unsigned reads = current == BUFFER_CLASS_LARGE ? LARGE_BUFFER_SHRINK_READS : BUFFER_SHRINK_READS;
+    if (++conn->buffer_shrink >= reads) {
+        conn->buffer_shrink = 0;
+        if (conn->buffer_class != smaller) {
+            conn->buffer_class = (uint8_t)smaller;
+            atomic_fetch_add_explicit(&buffer_shrinks, 1, memory_order_relaxed);
         }
     }
 }
 
 // 添加读请求到 io_uring
-static int add_read_request(struct io_uring *ring, struct connection *conn) {
-    struct io_uring_sqe *sqe = io_uring_get_sqe(ring);
-    if (!sqe) {
-        handle_error(ERR_URING_QUEUE_FULL, "Could not get SQE for read");
-        return -1;
+static int add_read_request(ResourceManager *rm, struct connection *conn) {
+    // 本轮已用完预算：延后到本轮其他连接处理之后，超出的字节抵扣完后再读取
+    if (sched_over_budget(conn, rm->sched_round)) {
+        sched_defer(rm, conn);
+        return 0;
     }
 
     int buf_index = conn->buffer_id;
+    // 连接的规格已调整：换用该规格的缓冲区，该规格已用完时继续使用当前的缓冲区
+    if (buf_index != -1 && buffer_class_of(rm, buf_index) != conn->buffer_class) {
+        int swapped = acquire_buffer_in_class(rm, conn->buffer_class);
+        if (swapped != -1) {
+            release_buffer_id(rm, buf_index);
+            buf_index = conn->buffer_id = swapped;
+        }
+    }
     if (buf_index == -1) {
-        buf_index = get_free_buffer_id();
+        buf_index = acquire_connection_buffer(rm, conn);
         if (buf_index == -1) {
-            handle_error(ERR_RESOURCE_INIT_FAILED, "No available buffer");
+            handle_error(ERR_RESOURCE_EXHAUSTED, "No available buffer");
             return -1;
         }
         conn->buffer_id = buf_index;
     }
 
-    // 准备读操作
-    io_uring_prep_read_fixed(sqe, conn->fd, bufs[buf_index].iov_base, BUFFER_SIZE, 0, buf_index);
+    struct io_uring_sqe *sqe = io_uring_get_sqe(rm->ring);
+    if (!sqe) {
+        handle_error(ERR_URING_QUEUE_FULL, "Could not get SQE for read");
+        return -1;
+    }
+
+    // 准备读操作，读取长度为所用规格的缓冲区大小
+    io_uring_prep_read_fixed(sqe, conn->fd, rm->buffers[buf_index].iov_base, (unsigned)rm->buffers[buf_index].iov_len,
+                             0, buf_index);
     io_uring_sqe_set_data(sqe, conn);
     conn->state = CONN_STATE_READING;
     return 0;
 }
 
-// 添加写请求到 io_uring
-static int add_write_request(struct io_uring *ring, struct connection *conn) {
-    struct io_uring_sqe *sqe = io_uring_get_sqe(ring);
-    if (!sqe) {
-        fprintf(stderr, "Could not get SQE for write\n");
-        return -1;
+// 将发送和下一次读取作为一条 SQE 链提交：发送成功时不产生完成事件，读取完成时两者都已完成
+static int add_linked_request(ResourceManager *rm, struct connection *conn, const char *buf, size_t len) {
+    // 两个 SQE 必须连续取得，否则链接标志会把发送和无关的请求连在一起
+    if (io_uring_sq_space_left(rm->ring) < 2) {
+        io_uring_submit(rm->ring);
+        if (io_uring_sq_space_left(rm->ring) < 2) {
+            log_error("Could not get SQEs for linked write");
+            return -1;
+        }
+    }
+    if (conn->buffer_id == -1) {
+        conn->buffer_id = acquire_connection_buffer(rm, conn);
+        if (conn->buffer_id == -1) {
+            handle_error(ERR_RESOURCE_EXHAUSTED, "No available buffer");
+            return -1;
+        }
     }
 
-    size_t data_size = ring_buffer_used_space(&conn->write_buffer);
+    // MSG_WAITALL：短写由内核继续发送，只有出错才中断链接
+    struct io_uring_sqe *sqe = io_uring_get_sqe(rm->ring);
+    io_uring_prep_send(sqe, conn->fd, buf, len, MSG_WAITALL);
+    io_uring_sqe_set_data(sqe, (void*)((uintptr_t)conn | LINKED_SEND_TAG));
+    io_uring_sqe_set_flags(sqe, IOSQE_IO_LINK | IOSQE_CQE_SKIP_SUCCESS);
+    conn->linked_send = (int)len;
+
+    return add_read_request(rm, conn);
+}
+
+// 添加写请求到 io_uring
+static int add_write_request(ResourceManager *rm, struct connection *conn) {
+    size_t data_size = ring_buffer_used_space(&conn->cold->write_buffer);
     if (data_size == 0) {
-        return add_read_request(ring, conn);
+        return add_read_request(rm, conn);
+    }
+
+    size_t read_index = atomic_load(&conn->cold->write_buffer.read_index) % conn->cold->write_buffer.capacity;
+    char* buf = &conn->cold->write_buffer.buffer[read_index];
+
+    // 数据环绕时只发送到缓冲区末尾的连续部分，剩余部分在写完成后继续发送
+    if (data_size > conn->cold->write_buffer.capacity - read_index) {
+        data_size = conn->cold->write_buffer.capacity - read_index;
+    }
+
+    // 待发送的数据是连续的一段时，发送和下一次读取链接提交（读取需要延后时不链接）
+    if (rm->link_send_recv && data_size == ring_buffer_used_space(&conn->cold->write_buffer) &&
+        !sched_over_budget(conn, rm->sched_round)) {
+        return add_linked_request(rm, conn, buf, data_size);
     }
 
-    size_t read_index = atomic_load(&conn->write_buffer.read_index) % conn->write_buffer.capacity;
-    char* buf = &conn->write_buffer.buffer[read_index];
+    struct io_uring_sqe *sqe = io_uring_get_sqe(rm->ring);
+    if (!sqe) {
+        log_error("Could not get SQE for write");
+        return -1;
+    }
 
     // 准备写操作
     io_uring_prep_send(sqe, conn->fd, buf, data_size, 0);
@@ -291,14 +672,211 @@ static void handle_client_data(ResourceManager *rm, struct connection *conn, ssi
         return;
     }
 
+    lru_touch(rm, conn);
+    sched_settle(conn, rm->sched_round);
+    conn->sched_bytes += (uint32_t)bytes_read;
+    conn->sched_ops++;
+    adapt_buffer_class(rm, conn, (size_t)bytes_read);
+
     // 调用数据处理回调
     if (on_data) {
-        on_data(conn, bufs[conn->buffer_id].iov_base, bytes_read, rm);
+        const char *data = rm->buffers[conn->buffer_id].iov_base;
+        if (rm->capture) {
+            // 回调写入写缓冲区的字节数即这条消息的回复大小
+            size_t queued = ring_buffer_used_space(&conn->cold->write_buffer);
+            on_data(conn, data, bytes_read, rm);
+            size_t used = ring_buffer_used_space(&conn->cold->write_buffer);
+            capture_data(rm->capture, conn->id, data, (size_t)bytes_read, used > queued ? used - queued : 0);
+        } else {
+            on_data(conn, data, bytes_read, rm);
+        }
+    }
+
+    // 回调提交了卸载任务：暂停收发，任务完成后由 resume_connection 恢复
+    if (conn->pending_jobs > 0) {
+        return;
+    }
+
+    // 链接模式下发送完成后读取已经挂起，只有此时连接上没有进行中的操作，在这里检查迁移
+    if (rm->link_send_recv && try_migrate_connection(rm, conn)) {
+        return;
     }
 
     // 添加写请求
-    if (add_write_request(rm->ring, conn) != 0) {
-        fprintf(stderr, "Failed to add write request\n");
+    if (add_write_request(rm, conn) != 0) {
+        log_error("Failed to add write request");
+        close_and_free_connection(rm, conn);
+    }
+}
+
+// 恢复被卸载任务暂停的连接
+void resume_connection(ResourceManager *rm, struct connection *conn) {
+    // 暂停时读缓冲区中可能还有回调未处理的请求（例如文件之后管线化的 GET），
+    // 以空数据再次调用回调处理它们，而不是等到下一次收到数据
+    if (on_data && ring_buffer_used_space(&conn->cold->read_buffer) > 0) {
+        on_data(conn, "", 0, rm);
+        if (conn->pending_jobs > 0) {
+            return;
+        }
+    }
+    if (add_write_request(rm, conn) != 0) {
+        log_error("Failed to resume connection");
+        close_and_free_connection(rm, conn);
+    }
+}
+
+// 关闭连接
+void close_connection(ResourceManager *rm, struct connection *conn) {
+    close_and_free_connection(rm, conn);
+}
+
+// 判断连接是否仍然存活（连接结构体可能已被关闭并复用）
+struct connection* connection_alive(ResourceManager *rm, struct connection *conn, int fd, uint64_t id) {
+    if (fd < 0 || fd >= rm->max_connections) {
+        return NULL;
+    }
+    struct connection *current = rm->connections[fd];
+    if (current != conn || current->id != id) {
+        return NULL;
+    }
+    return current;
+}
+
+// 连接迁移消息，通过 IORING_OP_MSG_RING 投递到目标工作线程的 ring
+struct migration_message {
+    struct completion_handler deliver;  // 目标 ring 收到消息时回调
+    struct completion_handler failed;   // 投递失败时在源 ring 上回调
+    struct connection state;            // 迁移中的连接状态，state.cold 指向 cold
+    struct connection_cold cold;
+};
+
+// 转移连接状态（读写缓冲区的数据所有权一并转移），dst 使用冷记录 dst_cold
+static int transfer_connection_state(struct connection *dst, struct connection_cold *dst_cold,
+                                     struct connection *src) {
+    memset(dst, 0, sizeof(struct connection));
+    memset(dst_cold, 0, sizeof(struct connection_cold));
+    dst->fd = src->fd;
+    dst->state = CONN_STATE_READING;
+    dst->buffer_class = src->buffer_class;
+    dst->buffer_id = -1;
+    dst->id = src->id;
+    dst->cold = dst_cold;
+    dst_cold->addr = src->cold->addr;
+    dst_cold->user_data = src->cold->user_data;
+    if (ring_buffer_move(&dst_cold->read_buffer, &src->cold->read_buffer) != 0 ||
+        ring_buffer_move(&dst_cold->write_buffer, &src->cold->write_buffer) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+// 在当前工作线程上接管迁移来的连接并继续读取
+static void adopt_connection(ResourceManager *rm, struct connection *state) {
+    struct connection *conn = memory_pool_alloc(rm->connection_pool);
+    struct connection_cold *cold = conn ? memory_pool_alloc(rm->connection_cold_pool) : NULL;
+    if (!cold || transfer_connection_state(conn, cold, state) != 0) {
+        log_error("Failed to adopt migrated connection");
+        if (cold) memory_pool_free(rm->connection_cold_pool, cold);
+        if (conn) memory_pool_free(rm->connection_pool, conn);
+        close(state->fd);
+        ring_buffer_destroy(&state->cold->read_buffer);
+        ring_buffer_destroy(&state->cold->write_buffer);
+        return;
+    }
+
+    rm->connections[conn->fd] = conn;
+    balancer_connection_delta(rm->worker_index, 1);
+    recorder_record(rm->recorder, RECORDER_MIGRATE_IN, conn->id, conn->fd, 0, 0);
+    lru_touch(rm, conn);
+    if (add_write_request(rm, conn) != 0) {
+        close_and_free_connection(rm, conn);
+    }
+}
+
+// 目标 ring 收到迁移消息
+static void on_migration_delivered(struct completion_handler *handler, struct io_uring_cqe *cqe, ResourceManager *rm) {
+    (void)cqe;
+    struct migration_message *msg =
+        (struct migration_message *)((char *)handler - offsetof(struct migration_message, deliver));
+    adopt_connection(rm, &msg->state);
+    free(msg);
+}
+
+// 迁移消息投递失败（例如目标 CQ 溢出），连接留在源工作线程
+static void on_migration_failed(struct completion_handler *handler, struct io_uring_cqe *cqe, ResourceManager *rm) {
+    struct migration_message *msg =
+        (struct migration_message *)((char *)handler - offsetof(struct migration_message, failed));
+    recorder_record(rm->recorder, RECORDER_MIGRATE_FAILED, msg->state.id, msg->state.fd, cqe->res, 0);
+    log_warn("Connection migration failed: %s", strerror(-cqe->res));
+    adopt_connection(rm, &msg->state);
+    free(msg);
+}
+
+// 若当前工作线程持续过载，将空闲的连接迁移到负载较低的工作线程
+// 返回: 已迁移返回 1（conn 已释放），否则返回 0
+static int try_migrate_connection(ResourceManager *rm, struct connection *conn) {
+    // 订阅和发送队列属于当前工作线程，订阅者不迁移
+    if (!msg_ring_supported || worker_count < 2 || !keep_running || conn->pending_jobs > 0 ||
+        conn->cold->subscriber) {
+        return 0;
+    }
+
+    int target = balancer_migration_target(rm->worker_index);
+    if (target < 0) {
+        return 0;
+    }
+    ResourceManager *dst = atomic_load(&workers[target]);
+    if (!dst) {
+        return 0;
+    }
+
+    struct migration_message *msg = malloc(sizeof(struct migration_message));
+    if (!msg) {
+        return 0;
+    }
+    struct io_uring_sqe *sqe = io_uring_get_sqe(rm->ring);
+    if (!sqe) {
+        free(msg);
+        return 0;
+    }
+
+    msg->deliver.on_complete = on_migration_delivered;
+    msg->failed.on_complete = on_migration_failed;
+    transfer_connection_state(&msg->state, &msg->cold, conn);
+
+    // 从源工作线程摘除连接，文件描述符保持打开
+    recorder_record(rm->recorder, RECORDER_MIGRATE_OUT, conn->id, conn->fd, 0, (unsigned)target);
+    rm->connections[conn->fd] = NULL;
+    lru_unlink(rm, conn);
+    if (conn->buffer_id >= 0) {
+        release_buffer_id(rm, conn->buffer_id);
+    }
+    memory_pool_free(rm->connection_cold_pool, conn->cold);
+    memory_pool_free(rm->connection_pool, conn);
+    balancer_connection_delta(rm->worker_index, -1);
+
+    // 成功时只在目标 ring 上产生 CQE，失败时源 ring 收到 CQE 并收回连接
+    io_uring_prep_msg_ring(sqe, dst->ring->ring_fd, 0,
+                           (uint64_t)((uintptr_t)&msg->deliver | COMPLETION_HANDLER_TAG), 0);
+    sqe_set_completion_handler(sqe, &msg->failed);
+    io_uring_sqe_set_flags(sqe, IOSQE_CQE_SKIP_SUCCESS);
+    return 1;
+}
+
+// 链接发送只在未完整发送时产生完成事件（出错，或内核不支持 MSG_WAITALL 续传时的短写）
+// 带 IOSQE_CQE_SKIP_SUCCESS 的请求失败时，被取消的链接读取不产生完成事件，连接上已没有进行中的操作
+static void handle_linked_send(ResourceManager *rm, struct connection *conn, struct io_uring_cqe *cqe) {
+    recorder_record(rm->recorder, RECORDER_LINKED_SEND, conn->id, conn->fd, cqe->res, 0);
+    conn->linked_send = 0;
+    if (cqe->res <= 0) {
+        log_warn("Client IO error: %s", strerror(-cqe->res));
+        close_and_free_connection(rm, conn);
+        return;
+    }
+
+    // 短写：继续发送剩余数据
+    ring_buffer_skip(&conn->cold->write_buffer, cqe->res);
+    if (add_write_request(rm, conn) != 0) {
         close_and_free_connection(rm, conn);
     }
 }
@@ -311,9 +889,18 @@ static void handle_client_io(ResourceManager *rm, struct io_uring_cqe *cqe) {
         return;
     }
 
+    recorder_record(rm->recorder, conn->state == CONN_STATE_WRITING ? RECORDER_WRITE : RECORDER_READ,
+                    conn->id, conn->fd, cqe->res, 0);
+
+    // 链接的读取只在发送全部完成后才开始
+    if (conn->linked_send > 0) {
+        ring_buffer_skip(&conn->cold->write_buffer, conn->linked_send);
+        conn->linked_send = 0;
+    }
+
     if (cqe->res <= 0) {
         if (cqe->res < 0) {
-            fprintf(stderr, "Client IO error: %s\n", strerror(-cqe->res));
+            log_warn("Client IO error: %s", strerror(-cqe->res));
         }
         close_and_free_connection(rm, conn);
         return;
@@ -322,19 +909,22 @@ static void handle_client_io(ResourceManager *rm, struct io_uring_cqe *cqe) {
     if (conn->state == CONN_STATE_READING) {
         handle_client_data(rm, conn, cqe->res);
     } else if (conn->state == CONN_STATE_WRITING) {
-        atomic_fetch_add(&conn->write_buffer.read_index, cqe->res);
-        add_read_request(rm->ring, conn);
-    }
-}
+        ring_buffer_skip(&conn->cold->write_buffer, cqe->res);
 
-// 处理新的连接
-static void handle_accept(ResourceManager *rm, struct io_uring_cqe *cqe) {
-    int client_socket = cqe->res;
-    if (client_socket < 0) {
-        fprintf(stderr, "Accept failed: %s\n", strerror(-client_socket));
-        return;
+        // 写缓冲区已清空时连接上没有进行中的操作，是迁移到其他工作线程的时机
+        if (ring_buffer_used_space(&conn->cold->write_buffer) == 0 && try_migrate_connection(rm, conn)) {
+            return;
+        }
+
+        // 短写或环绕时继续发送剩余数据，全部发送完毕后 add_write_request 会转为读请求
+        if (add_write_request(rm, conn) != 0) {
+            close_and_free_connection(rm, conn);
+        }
     }
+}
 
+// 接管新接受的客户端套接字（TCP 和 Unix 域套接字共用）
+static void accept_client(ResourceManager *rm, int client_socket) {
     if (client_socket >= rm->max_connections) {
         handle_error(ERR_CONNECTION_LIMIT_REACHED, "Client socket is out of range");
         close(client_socket);
@@ -353,103 +943,531 @@ static void handle_accept(ResourceManager *rm, struct io_uring_cqe *cqe) {
         return;
     }
 
-    socklen_t addr_len = sizeof(conn->addr);
-    getpeername(client_socket, (struct sockaddr*)&conn->addr, &addr_len);
+    socklen_t addr_len = sizeof(conn->cold->addr);
+    getpeername(client_socket, (struct sockaddr*)&conn->cold->addr, &addr_len);
 
     rm->connections[client_socket] = conn;
+    balancer_connection_delta(rm->worker_index, 1);
+    admission_connection_delta(1);
+    recorder_record(rm->recorder, RECORDER_ACCEPT, conn->id, client_socket, client_socket, 0);
+    if (rm->capture) {
+        capture_open(rm->capture, conn->id);
+    }
 
     // 调用连接建立回调
     if (on_connect) {
-        on_connect(&conn->addr);
+        on_connect(&conn->cold->addr);
     }
 
-    add_read_request(rm->ring, conn);
-    add_accept_request(rm->ring, rm->server_socket);
-}
-
-// 处理完成事件
-static void handle_completion_event(ResourceManager *rm, struct io_uring_cqe *cqe) {
-    void *user_data = io_uring_cqe_get_data(cqe);
-    if (user_data == (void*)(intptr_t)-1) {
-        handle_accept(rm, cqe);
-    } else {
-        handle_client_io(rm, cqe);
+    // TCP 连接先完成 TLS 握手，密钥装入内核后再进入常规流程
+    if (rm->tls && conn->cold->addr.sin_family == AF_INET) {
+        int ret = tls_attach(rm, conn);
+        if (ret != 0) {
+            log_error("Failed to start TLS handshake: %s", strerror(-ret));
+            close_and_free_connection(rm, conn);
+        }
+        return;
     }
-}
 
-// 优雅关闭服务器
-void graceful_shutdown(void) {
-    keep_running = 0;
+    connection_ready(rm, conn);
 }
 
-// 清理资源
-void cleanup_resources(ResourceManager* rm) {
-    cleanup_resource_manager(rm);
-    free(bufs);
-    cleanup_buffer_pool();
-}
+// 连接就绪：代理模式下交给代理，否则开始读取
+void connection_ready(ResourceManager *rm, struct connection *conn) {
+    // 代理模式下连接由代理接管，不进入常规的收发流程
+    if (rm->proxy) {
+        int ret = proxy_attach(rm, conn);
+        if (ret != 0) {
+            log_error("Failed to proxy connection: %s", strerror(-ret));
+            close_and_free_connection(rm, conn);
+        }
+        return;
+    }
 
-// 启动服务器
-int start_server(int port) {
-    printf("Starting server on port %d\n", port);
+    lru_touch(rm, conn);
 
-    // 设置信号处理
-    struct sigaction sa;
-    sa.sa_handler = sigint_handler;
-    sigemptyset(&sa.sa_mask);
-    sa.sa_flags = 0;
-    if (sigaction(SIGINT, &sa, NULL) == -1) {
-        handle_error(ERR_RESOURCE_INIT_FAILED, "Failed to set up signal handler");
-        return 1;
+    // 协程处理器自行收发，不占用固定缓冲区
+    if (rm->coroutines) {
+        if (coroutine_start(rm, conn) != 0) {
+            close_and_free_connection(rm, conn);
+        }
+        return;
     }
 
-    // 获取文件描述符限制
-    struct rlimit rl;
-    int max_connections;
-    if (getrlimit(RLIMIT_NOFILE, &rl) == 0) {
-        printf("Current file descriptor limit: %llu\n", (unsigned long long)rl.rlim_cur);
-        max_connections = rl.rlim_cur > 1000 ? rl.rlim_cur - 1000 : rl.rlim_cur / 2;
-        printf("Setting max connections to: %d\n", max_connections);
-    } else {
-        handle_error(ERR_RESOURCE_INIT_FAILED, "Unable to get file descriptor limit");
-        max_connections = 1000;
-        printf("Unable to get file descriptor limit. Setting max connections to: %d\n", max_connections);
+    if (add_read_request(rm, conn) != 0) {
+        close_and_free_connection(rm, conn);
     }
+}
 
-    // 初始化资源管理器
-    ResourceManager rm;
-    init_resource_manager(&rm, port, max_connections);
+// 当前工作线程的资源余量：固定缓冲区、整个进程的连接数、SQ 空位和内存中剩余比例的最小值（百分比）
+static unsigned worker_headroom(ResourceManager *rm, uint64_t now_ns) {
+    unsigned headroom = (rm->receive_buffer_count - rm->buffers_in_use) * 100 / rm->receive_buffer_count;
+    unsigned sq = io_uring_sq_space_left(rm->ring) * 100 / *rm->ring->sq.kring_entries;
+    unsigned connections = admission_connection_headroom();
+    unsigned memory = admission_memory_headroom(now_ns);
+    if (sq < headroom) headroom = sq;
+    if (connections < headroom) headroom = connections;
+    if (memory < headroom) headroom = memory;
+    return headroom;
+}
 
-    // 分配资源
-    if (allocate_resource(&rm, RESOURCE_SERVER_SOCKET) < 0 ||
-        allocate_resource(&rm, RESOURCE_IO_URING) < 0 ||
-        allocate_resource(&rm, RESOURCE_CONNECTION_POOL) < 0 ||
-        allocate_resource(&rm, RESOURCE_CONNECTIONS_ARRAY) < 0) {
-        cleanup_resource_manager(&rm);
-        return 1;
+// 准入检查：过载时拒绝新接受的连接（关闭套接字，不分配任何资源）
+// 返回: 当前压力等级
+static AdmissionLevel admit_client(ResourceManager *rm, int *client_socket) {
+    AdmissionLevel level = admission_update(rm->worker_index, worker_headroom(rm, monotonic_ns()));
+    if (level != ADMISSION_NORMAL && *client_socket >= 0) {
+        // 以 RST 关闭，客户端立即得到失败而不是等待超时
+        struct linger rst = { 1, 0 };
+        setsockopt(*client_socket, SOL_SOCKET, SO_LINGER, &rst, sizeof(rst));
+        close(*client_socket);
+        recorder_record(rm->recorder, RECORDER_REJECT, 0, *client_socket, 0, level);
+        *client_socket = -1;
+        admission_record(rm->worker_index, ADMISSION_EVENT_REJECTED);
     }
+    return level;
+}
 
-    if (setup_buffers(rm.ring) < 0) {
-        cleanup_resources(&rm);
-        return 1;
+// 接受失败：文件描述符或内存耗尽时暂停接受一段时间，避免失败的接受请求反复完成
+static int accept_error_is_pressure(int err) {
+    return err == EMFILE || err == ENFILE || err == ENOBUFS || err == ENOMEM;
+}
+
+// 暂停接受请求，由 admission_tick 在压力缓解后恢复
+static void pause_accept(ResourceManager *rm, int which) {
+    if (!(rm->accepts_paused & which)) {
+        rm->accepts_paused |= which;
+        admission_record(rm->worker_index, ADMISSION_EVENT_PAUSED);
+    }
+}
+
+// 记录连接的接收 CPU（最近处理其数据包的软中断所在 CPU）是否与工作线程绑定的 CPU 不同
+static void sample_incoming_cpu(int client_socket, int worker_cpu) {
+    int cpu = -1;
+    socklen_t len = sizeof(cpu);
+    if (getsockopt(client_socket, SOL_SOCKET, SO_INCOMING_CPU, &cpu, &len) < 0 || cpu < 0) {
+        return;
+    }
+    atomic_fetch_add_explicit(&accepts_sampled, 1, memory_order_relaxed);
+    if (cpu != worker_cpu) {
+        atomic_fetch_add_explicit(&accepts_cross_cpu, 1, memory_order_relaxed);
+    }
+}
+
+// 处理新的连接
+static void handle_accept(ResourceManager *rm, struct io_uring_cqe *cqe) {
+    int client_socket = cqe->res;
+    if (client_socket < 0) {
+        // 排空时接受请求被取消
+        if (rm->draining) return;
+        recorder_record(rm->recorder, RECORDER_ACCEPT_ERROR, 0, rm->server_socket, client_socket, 0);
+        log_warn("Accept failed: %s", strerror(-client_socket));
+        if (accept_error_is_pressure(-client_socket)) {
+            rm->accept_resume_ns = monotonic_ns() + ACCEPT_RETRY_MS * 1000000ULL;
+            pause_accept(rm, ACCEPT_PAUSED_TCP);
+        } else {
+            add_accept_request(rm->ring, rm->server_socket);
+        }
+        return;
+    }
+
+    AdmissionLevel level = admit_client(rm, &client_socket);
+    if (client_socket >= 0) {
+        // 请求-响应式的小包回复不等待 Nagle 合并，避免与对端延迟确认叠加产生约 40ms 的停顿
+        int one = 1;
+        setsockopt(client_socket, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        // 只在启用 CPU 引导（工作线程已绑定）时检查，默认的接受路径不多一次系统调用
+        if (worker_cpus) {
+            sample_incoming_cpu(client_socket, worker_cpus[rm->worker_index]);
+        }
+        accept_client(rm, client_socket);
+    }
+
+    // 取消之前已接受的连接照常处理，之后的连接由新进程接受
+    if (rm->draining) {
+        return;
+    }
+    // 严重过载时不再接受，新连接留在内核的监听队列中
+    if (level == ADMISSION_SHED) {
+        pause_accept(rm, ACCEPT_PAUSED_TCP);
+    } else {
+        add_accept_request(rm->ring, rm->server_socket);
+    }
+}
+
+// 在共享的 Unix 域监听套接字上挂起接受请求
+static int add_unix_accept_request(ResourceManager *rm) {
+    struct io_uring_sqe *sqe = io_uring_get_sqe(rm->ring);
+    if (!sqe) {
+        handle_error(ERR_URING_QUEUE_FULL, "Could not get SQE for unix accept");
+        return -1;
+    }
+    io_uring_prep_accept(sqe, unix_socket, NULL, NULL, 0);
+    sqe_set_completion_handler(sqe, &unix_accept_handler);
+    return 0;
+}
+
+// Unix 域套接字上的新连接，进入与 TCP 连接相同的收发流程
+static void on_unix_accept(struct completion_handler *handler, struct io_uring_cqe *cqe, ResourceManager *rm) {
+    (void)handler;
+    if (cqe->res < 0) {
+        if (rm->draining) return;
+        recorder_record(rm->recorder, RECORDER_ACCEPT_ERROR, 0, unix_socket, cqe->res, 0);
+        log_warn("Unix accept failed: %s", strerror(-cqe->res));
+        if (accept_error_is_pressure(-cqe->res)) {
+            rm->accept_resume_ns = monotonic_ns() + ACCEPT_RETRY_MS * 1000000ULL;
+            pause_accept(rm, ACCEPT_PAUSED_UNIX);
+        } else {
+            add_unix_accept_request(rm);
+        }
+        return;
+    }
+
+    int client_socket = cqe->res;
+    AdmissionLevel level = admit_client(rm, &client_socket);
+    if (client_socket >= 0) {
+        accept_client(rm, client_socket);
+    }
+
+    if (rm->draining) {
+        return;
+    }
+    if (level == ADMISSION_SHED) {
+        pause_accept(rm, ACCEPT_PAUSED_UNIX);
+    } else {
+        add_unix_accept_request(rm);
+    }
+}
+
+// 处理完成事件
+static void handle_completion_event(ResourceManager *rm, struct io_uring_cqe *cqe) {
+    void *user_data = io_uring_cqe_get_data(cqe);
+    if (user_data == (void*)(intptr_t)-1) {
+        handle_accept(rm, cqe);
+    } else if ((uintptr_t)user_data & COMPLETION_HANDLER_TAG) {
+        struct completion_handler *handler =
+            (struct completion_handler *)((uintptr_t)user_data & ~COMPLETION_HANDLER_TAG);
+        handler->on_complete(handler, cqe, rm);
+    } else if ((uintptr_t)user_data & LINKED_SEND_TAG) {
+        handle_linked_send(rm, (struct connection *)((uintptr_t)user_data & ~LINKED_SEND_TAG), cqe);
+    } else {
+        handle_client_io(rm, cqe);
+    }
+}
+
+// 优雅关闭服务器
+void graceful_shutdown(void) {
+    keep_running = 0;
+    wake_workers();
+}
+
+// 关闭通知到达，事件循环会在本轮结束后检查 keep_running
+static void on_shutdown_notified(struct completion_handler *handler, struct io_uring_cqe *cqe, ResourceManager *rm) {
+    (void)handler;
+    (void)cqe;
+    (void)rm;
+}
+
+static struct completion_handler shutdown_handler = { on_shutdown_notified };
+
+// 在关闭通知 eventfd 上挂起 poll 请求
+static int arm_shutdown_poll(ResourceManager *rm) {
+    if (shutdown_fd < 0) {
+        return 0;
+    }
+    struct io_uring_sqe *sqe = io_uring_get_sqe(rm->ring);
+    if (!sqe) {
+        handle_error(ERR_URING_QUEUE_FULL, "Could not get SQE for shutdown poll");
+        return -1;
+    }
+    io_uring_prep_poll_add(sqe, shutdown_fd, POLLIN);
+    sqe_set_completion_handler(sqe, &shutdown_handler);
+    return 0;
+}
+
+// Unix 域接受请求的取消结果无需处理
+static void on_cancel_complete(struct completion_handler *handler, struct io_uring_cqe *cqe, ResourceManager *rm) {
+    (void)handler;
+    (void)cqe;
+    (void)rm;
+}
+
+// TCP 接受请求的取消完成：此前完成的接受已按顺序处理，之后本线程不再接受新连接
+static void on_accept_cancelled(struct completion_handler *handler, struct io_uring_cqe *cqe, ResourceManager *rm) {
+    (void)handler;
+    (void)cqe;
+    (void)rm;
+    atomic_fetch_add(&drained_workers, 1);
+}
+
+static struct completion_handler cancel_handler = { on_cancel_complete };
+static struct completion_handler accept_cancel_handler = { on_accept_cancelled };
+
+// 提交取消请求，SQ 已满时先提交
+static int add_cancel_request(ResourceManager *rm, uint64_t user_data, struct completion_handler *handler) {
+    struct io_uring_sqe *sqe = io_uring_get_sqe(rm->ring);
+    if (!sqe) {
+        io_uring_submit(rm->ring);
+        sqe = io_uring_get_sqe(rm->ring);
+    }
+    if (!sqe) {
+        handle_error(ERR_URING_QUEUE_FULL, "Could not get SQE for cancel");
+        return -1;
+    }
+    io_uring_prep_cancel64(sqe, user_data, 0);
+    sqe_set_completion_handler(sqe, handler);
+    return 0;
+}
+
+// 监听套接字已交给新进程：取消接受请求和数据报接收，已有连接照常收发直到关闭
+static void on_drain_notified(struct completion_handler *handler, struct io_uring_cqe *cqe, ResourceManager *rm) {
+    (void)handler;
+    (void)cqe;
+    rm->draining = 1;
+    rm->accepts_paused = 0;
+    if (rm->udp_server) {
+        udp_server_stop(rm->udp_server);
+    }
+    if (unix_socket >= 0) {
+        add_cancel_request(rm, (uintptr_t)&unix_accept_handler | COMPLETION_HANDLER_TAG, &cancel_handler);
+    }
+    if (add_cancel_request(rm, (uint64_t)(intptr_t)-1, &accept_cancel_handler) < 0) {
+        atomic_fetch_add(&drained_workers, 1);
+    }
+}
+
+static struct completion_handler drain_handler = { on_drain_notified };
+
+// 在排空通知 eventfd 上挂起 poll 请求
+static int arm_drain_poll(ResourceManager *rm) {
+    if (drain_fd < 0) {
+        return 0;
+    }
+    struct io_uring_sqe *sqe = io_uring_get_sqe(rm->ring);
+    if (!sqe) {
+        handle_error(ERR_URING_QUEUE_FULL, "Could not get SQE for drain poll");
+        return -1;
+    }
+    io_uring_prep_poll_add(sqe, drain_fd, POLLIN);
+    sqe_set_completion_handler(sqe, &drain_handler);
+    return 0;
+}
+
+// 把当前线程绑定到工作线程 index 的 CPU
+static void pin_worker(int index) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(worker_cpus[index], &set);
+    int ret = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (ret != 0) {
+        log_warn("Failed to pin worker %d to CPU %d: %s", index, worker_cpus[index], strerror(ret));
+    }
+}
+
+// 分配工作线程的资源并挂起初始请求
+static int setup_worker(ResourceManager *rm) {
+    // 区域在工作线程中映射和缺页，页面分配在线程所在的 NUMA 节点上
+    rm->huge_pages = huge_pages;
+    if (allocate_resource(rm, RESOURCE_SERVER_SOCKET) < 0 ||
+        allocate_resource(rm, RESOURCE_IO_URING) < 0 ||
+        allocate_resource(rm, RESOURCE_LOGGER) < 0 ||
+        allocate_resource(rm, RESOURCE_ARENA) < 0 ||
+        allocate_resource(rm, RESOURCE_CONNECTION_POOL) < 0 ||
+        allocate_resource(rm, RESOURCE_CONNECTIONS_ARRAY) < 0 ||
+        allocate_resource(rm, RESOURCE_FIXED_BUFFERS) < 0 ||
+        allocate_resource(rm, RESOURCE_FIXED_FILES) < 0 ||
+        allocate_resource(rm, RESOURCE_FILE_SERVER) < 0) {
+        return -1;
+    }
+
+    printf("Worker %d: %zu MB buffer arena, %s pages (%zu MB huge), NUMA node %d\n", rm->worker_index,
+           rm->arena.size >> 20, arena_pages_name(rm->arena.pages), rm->arena.huge_bytes >> 20, rm->arena.node);
+
+    // 按需启动卸载任务线程池：线程总数在各工作线程之间平分，每个工作线程至少一个
+    if (offload_threads > 0) {
+        rm->offload_threads = offload_threads / worker_count > 0 ? offload_threads / worker_count : 1;
+        // 线程继承创建者的 CPU 绑定，创建期间恢复进程原有的 CPU 集合，卸载任务不与工作线程争用同一个 CPU
+        if (worker_cpus) {
+            pthread_setaffinity_np(pthread_self(), sizeof(process_cpus), &process_cpus);
+        }
+        int ret = allocate_resource(rm, RESOURCE_OFFLOAD_POOL);
+        if (worker_cpus) {
+            pin_worker(rm->worker_index);
+        }
+        if (ret < 0) {
+            return -1;
+        }
+    }
+
+    // 按需为每个连接启动协程
+    if (coroutine_handler) {
+        rm->coroutine_fn = coroutine_handler;
+        rm->coroutine_frame_size = coroutine_frame_size;
+        if (allocate_resource(rm, RESOURCE_COROUTINES) < 0) {
+            return -1;
+        }
+    }
+
+    // 按需创建主题表，接收其他工作线程发布的消息
+    if (pubsub_enabled && allocate_resource(rm, RESOURCE_PUBSUB) < 0) {
+        return -1;
+    }
+
+    // 按需记录 on_data 收到的消息
+    if (capture_path[0] && allocate_resource(rm, RESOURCE_CAPTURE) < 0) {
+        return -1;
+    }
+
+    // 按需在同一端口上监听 UDP
+    if (on_datagram) {
+        rm->on_datagram = on_datagram;
+        if (allocate_resource(rm, RESOURCE_UDP_SERVER) < 0 || udp_server_start(rm->udp_server) < 0) {
+            return -1;
+        }
+    }
+
+    // 按需把连接转发到上游
+    if (proxy_enabled) {
+        rm->proxy_config = &proxy_config;
+        if (allocate_resource(rm, RESOURCE_PROXY) < 0) {
+            return -1;
+        }
     }
 
-    if (add_accept_request(rm.ring, rm.server_socket) < 0) {
+    // 按需为 TCP 连接进行 TLS 握手
+    if (tls_context) {
+        rm->tls_context = tls_context;
+        if (allocate_resource(rm, RESOURCE_TLS) < 0) {
+            return -1;
+        }
+    }
+
+    // 链接发送依赖 IOSQE_CQE_SKIP_SUCCESS
+    rm->link_send_recv = link_send_recv && (rm->ring->features & IORING_FEAT_CQE_SKIP);
+    if (link_send_recv && !rm->link_send_recv && rm->worker_index == 0) {
+        printf("IOSQE_CQE_SKIP_SUCCESS not supported, send and recv are not linked\n");
+    }
+
+    // NAPI 忙轮询只是优化，内核不支持时照常运行
+    int napi = wait_register_napi(rm->ring, &wait_config);
+    if (napi < 0 && rm->worker_index == 0) {
+        log_warn("NAPI busy polling unavailable: %s", strerror(-napi));
+    }
+
+    if (add_accept_request(rm->ring, rm->server_socket) < 0) {
         handle_error(ERR_RESOURCE_INIT_FAILED, "Failed to add initial accept request");
-        cleanup_resource_manager(&rm);
-        return 1;
+        return -1;
+    }
+    if (unix_socket >= 0 && add_unix_accept_request(rm) < 0) {
+        return -1;
+    }
+
+    if (arm_drain_poll(rm) < 0) {
+        return -1;
+    }
+    return arm_shutdown_poll(rm);
+}
+
+// 暂停接受的定时器到期：只需唤醒事件循环，是否恢复由本轮结束时的 admission_tick 判断
+static void on_accept_timer(struct completion_handler *handler, struct io_uring_cqe *cqe, ResourceManager *rm) {
+    (void)handler;
+    (void)cqe;
+    rm->accept_timer_armed = 0;
+}
+
+// 接受请求暂停期间保持一个定时器，空闲的服务器没有其他完成事件、等待也没有上限时同样能按时恢复；
+// 恢复时间未到时等到该时间，否则（严重过载暂停）每 ACCEPT_RETRY_MS 重新检查一次压力
+static void arm_accept_timer(ResourceManager *rm, uint64_t now) {
+    if (!rm->accepts_paused || rm->accept_timer_armed) return;
+    struct io_uring_sqe *sqe = io_uring_get_sqe(rm->ring);
+    if (!sqe) return;  // 提交队列已满说明仍有其他事件，下一轮再试
+    uint64_t delay = rm->accept_resume_ns > now ? rm->accept_resume_ns - now : ACCEPT_RETRY_MS * 1000000ULL;
+    rm->accept_timeout.tv_sec = (long long)(delay / 1000000000ULL);
+    rm->accept_timeout.tv_nsec = (long long)(delay % 1000000000ULL);
+    io_uring_prep_timeout(sqe, &rm->accept_timeout, 0, 0);
+    sqe_set_completion_handler(sqe, &accept_timer_handler);
+    rm->accept_timer_armed = 1;
+}
+
+// 每轮事件循环结束时检查压力：压力缓解后恢复暂停的接受请求；
+// 严重过载时从最久未活动的一端分批关闭空闲连接（无待发送数据和进行中的任务），
+// shutdown 后挂起的读取以 0 完成，连接按正常路径关闭和释放
+static void admission_tick(ResourceManager *rm) {
+    if (!rm->accepts_paused && !rm->lru_head) return;
+
+    uint64_t now = monotonic_ns();
+    AdmissionLevel level = admission_update(rm->worker_index, worker_headroom(rm, now));
+
+    if (level != ADMISSION_SHED) {
+        if (rm->accepts_paused && now >= rm->accept_resume_ns) {
+            if (rm->accepts_paused & ACCEPT_PAUSED_TCP) {
+                add_accept_request(rm->ring, rm->server_socket);
+            }
+            if (rm->accepts_paused & ACCEPT_PAUSED_UNIX) {
+                add_unix_accept_request(rm);
+            }
+            rm->accepts_paused = 0;
+        }
+        arm_accept_timer(rm, now);
+        return;
     }
 
-    printf("Server started. Press Ctrl+C to stop.\n");
+    arm_accept_timer(rm, now);
+    if (now < rm->shed_next_ns) return;
+    unsigned shed = 0;
+    struct connection *conn = rm->lru_head;
+    while (conn && shed < admission_shed_batch()) {
+        struct connection *next = conn->lru_next;
+        // 订阅者在等待读取时仍在接收发布的消息，不算空闲
+        if (conn->state == CONN_STATE_READING && conn->pending_jobs == 0 && conn->linked_send == 0 &&
+            conn->cold->subscriber == NULL && ring_buffer_used_space(&conn->cold->write_buffer) == 0) {
+            lru_unlink(rm, conn);
+            shutdown(conn->fd, SHUT_RDWR);
+            recorder_record(rm->recorder, RECORDER_SHED, conn->id, conn->fd, 0, 0);
+            admission_record(rm->worker_index, ADMISSION_EVENT_SHED);
+            shed++;
+        }
+        conn = next;
+    }
+    if (shed) {
+        rm->shed_next_ns = now + ADMISSION_SHED_INTERVAL_MS * 1000000ULL;
+    }
+}
+
+// 进入下一轮并恢复预算已抵扣完的延后连接的读取（按延后的先后顺序），SQ 已满时留到下一轮
+static void resume_deferred_reads(ResourceManager *rm) {
+    rm->sched_round++;
+    struct connection *conn = rm->deferred_head;
+    while (conn && io_uring_sq_space_left(rm->ring) > 0) {
+        struct connection *next = conn->cold->sched_next;
+        if (!sched_over_budget(conn, rm->sched_round)) {
+            sched_unlink(rm, conn);
+            if (add_read_request(rm, conn) != 0) {
+                close_and_free_connection(rm, conn);
+            }
+        }
+        conn = next;
+    }
+}
+
+// 事件循环：每轮等待至少一个完成事件（按等待策略先自旋再阻塞），然后批量处理所有已就绪的事件
+// 阻塞达到上限时以空轮结束，负载统计照常更新
+static void run_event_loop(ResourceManager *rm) {
+    WaitState wait;
+    wait_state_init(&wait, &wait_config, rm->ring);
 
-    // 主事件循环
     while (keep_running) {
-        io_uring_submit(rm.ring);
+        io_uring_submit(rm->ring);
 
         struct io_uring_cqe *cqe;
-        int ret = io_uring_wait_cqe(rm.ring, &cqe);
+        int ret = 0;
+        if (rm->deferred_head) {
+            // 有延后读取的连接时不阻塞：没有完成事件也结束本轮，延后的连接按轮次恢复
+            io_uring_get_events(rm->ring);
+        } else {
+            ret = wait_for_completion(rm->ring, &wait);
+        }
 
-        if (ret < 0) {
+        if (ret < 0 && ret != -ETIME) {
             if (ret == -EINTR) {
                 continue;
             }
@@ -457,17 +1475,569 @@ int start_server(int port) {
             break;
         }
 
-        handle_completion_event(&rm, cqe);
-        io_uring_cqe_seen(rm.ring, cqe);
+        uint64_t start = monotonic_ns();
+        recorder_set_time(rm->recorder, start);
+        if (rm->capture) {
+            capture_set_time(rm->capture, start);
+        }
+        unsigned head;
+        unsigned count = 0;
+        io_uring_for_each_cqe(rm->ring, head, cqe) {
+            handle_completion_event(rm, cqe);
+            count++;
+
+            // 提交队列将满时先提交，保证后续处理能获取到 SQE
+            if (io_uring_sq_space_left(rm->ring) < SQ_LOW_WATERMARK) {
+                io_uring_submit(rm->ring);
+            }
+        }
+        io_uring_cq_advance(rm->ring, count);
+
+        // 本轮超出预算的连接在其他连接的请求都处理之后才重新读取
+        resume_deferred_reads(rm);
+
+        // 本轮产生的数据报回复合并后一次提交
+        udp_flush(rm);
+
+        // 本轮发布的消息按订阅者合并，每个订阅者一次发送
+        pubsub_flush(rm);
+
+        admission_tick(rm);
+
+        // 本轮产生的日志记录合并为一次写请求
+        log_flush(rm);
+        capture_flush(rm);
+
+        uint64_t end = monotonic_ns();
+        balancer_record(rm->worker_index, count, end, end - start);
+    }
+}
+
+// 在 SO_REUSEPORT 组上挂载 cBPF 程序：读取处理 SYN 的 CPU，返回绑定在该 CPU 上的工作线程的监听套接字在组中的位置。
+// 没有工作线程绑定的 CPU 返回超出组大小的位置，内核退回按哈希选择
+static int attach_reuseport_cbpf(int sock) {
+    unsigned len = 2 * (unsigned)worker_count + 2;
+    if (len > BPF_MAXINSNS) {
+        return -E2BIG;
+    }
+    struct sock_filter *code = calloc(len, sizeof(*code));
+    if (!code) {
+        return -ENOMEM;
+    }
+    code[0] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_W | BPF_ABS, (uint32_t)(SKF_AD_OFF + SKF_AD_CPU));
+    for (int i = 0; i < worker_count; i++) {
+        code[1 + 2 * i] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, (uint32_t)worker_cpus[i], 0, 1);
+        code[2 + 2 * i] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, (uint32_t)i);
+    }
+    code[len - 1] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, (uint32_t)worker_count);
+    struct sock_fprog prog = { .len = (unsigned short)len, .filter = code };
+    int ret = setsockopt(sock, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) < 0 ? -errno : 0;
+    free(code);
+    return ret;
+}
 
-        if (!keep_running) {
+// 为工作线程分配 CPU，启用引导时挂载 cBPF 程序（监听套接字已按工作线程顺序创建）
+static int setup_cpu_steering(ResourceManager *rms) {
+    if (sched_getaffinity(0, sizeof(process_cpus), &process_cpus) < 0) {
+        log_warn("sched_getaffinity failed: %s, CPU pinning disabled", strerror(errno));
+        return 0;
+    }
+    int cpus = CPU_COUNT(&process_cpus);
+    worker_cpus = malloc((size_t)worker_count * sizeof(int));
+    if (!worker_cpus || cpus == 0) {
+        free(worker_cpus);
+        worker_cpus = NULL;
+        return -1;
+    }
+    // 工作线程 i 使用第 i 个可用 CPU，工作线程多于 CPU 时循环分配
+    for (int i = 0, cpu = -1; i < worker_count; i++) {
+        do {
+            cpu = (cpu + 1) % CPU_SETSIZE;
+        } while (!CPU_ISSET(cpu, &process_cpus));
+        worker_cpus[i] = cpu;
+    }
+
+    if (cpu_steering == CPU_STEER_CBPF && worker_count > cpus) {
+        printf("CPU steering: %d workers but %d CPUs, connections stay hash-distributed\n", worker_count, cpus);
+        cpu_steering = CPU_STEER_PIN;
+    }
+    if (cpu_steering == CPU_STEER_CBPF) {
+        // 程序作用于整个组，挂载到任一监听套接字即可
+        int ret = attach_reuseport_cbpf(rms[0].server_socket);
+        if (ret < 0) {
+            log_warn("SO_ATTACH_REUSEPORT_CBPF failed: %s, connections stay hash-distributed", strerror(-ret));
+            cpu_steering = CPU_STEER_PIN;
+        }
+    }
+    printf("CPU steering: workers pinned to CPUs %d", worker_cpus[0]);
+    for (int i = 1; i < worker_count; i++) {
+        printf(",%d", worker_cpus[i]);
+    }
+    printf(", connections %s\n", cpu_steering == CPU_STEER_CBPF ? "steered to the receiving CPU's worker" : "hash-distributed");
+    return 0;
+}
+
+// 工作线程入口：每个工作线程拥有独立的监听套接字（SO_REUSEPORT）、ring 和连接池
+static void* worker_main(void *arg) {
+    ResourceManager *rm = arg;
+
+    // 先绑定 CPU，区域按绑定后所在的 NUMA 节点分配
+    if (worker_cpus) {
+        pin_worker(rm->worker_index);
+    }
+
+    if (setup_worker(rm) == 0) {
+        atomic_store(&workers[rm->worker_index], rm);
+        run_event_loop(rm);
+        atomic_store(&workers[rm->worker_index], NULL);
+    } else {
+        // 任一工作线程启动失败时停止整个服务器
+        keep_running = 0;
+        wake_workers();
+        rm->port = -1;
+    }
+
+    cleanup_resource_manager(rm);
+    return NULL;
+}
+
+// 探测内核是否支持连接迁移所需的 IORING_OP_MSG_RING
+static int probe_msg_ring(void) {
+    struct io_uring_probe *probe = io_uring_get_probe();
+    if (!probe) {
+        return 0;
+    }
+    int supported = io_uring_opcode_supported(probe, IORING_OP_MSG_RING);
+    io_uring_free_probe(probe);
+    return supported;
+}
+
+// 等待关闭通知，最多 timeout_ms 毫秒（-1 表示一直等待）
+// 返回: 收到关闭通知返回 1，否则返回 0
+static int wait_shutdown(int timeout_ms) {
+    struct pollfd pfd = { .fd = shutdown_fd, .events = POLLIN };
+    return poll(&pfd, 1, timeout_ms) > 0 || !keep_running;
+}
+
+// 等待所有工作线程完成初始化并开始接受连接
+// 返回: 全部就绪返回 1，服务器已停止返回 0
+static int wait_workers_ready(void) {
+    for (;;) {
+        int ready = 0;
+        for (int i = 0; i < worker_count; i++) {
+            ready += atomic_load(&workers[i]) != NULL;
+        }
+        if (ready == worker_count) return 1;
+        if (wait_shutdown(10)) return 0;
+    }
+}
+
+// 收集本进程的监听套接字。工作线程多于一次能交接的监听套接字时返回 -1：
+// 新进程收不到的监听套接字在旧进程退出时关闭，其队列中的连接会被重置
+static int collect_listeners(HandoffSockets *sockets, int port) {
+    if (worker_count > HOT_RESTART_MAX_LISTENERS) {
+        return -1;
+    }
+    memset(sockets, 0, sizeof(*sockets));
+    sockets->port = port;
+    sockets->unix_fd = unix_socket;
+    sockets->unix_type = unix_type;
+    for (int i = 0; i < worker_count; i++) {
+        ResourceManager *rm = atomic_load(&workers[i]);
+        if (!rm) continue;
+        sockets->tcp[sockets->tcp_count++] = rm->server_socket;
+        if (rm->udp_server) {
+            sockets->udp[sockets->udp_count++] = udp_server_fd(rm->udp_server);
+        }
+    }
+    return 0;
+}
+
+// 交接后排空：各工作线程停止接受连接后，等待已有连接全部关闭或超时，然后停止服务器
+static void drain_and_shutdown(void) {
+    uint64_t one = 1;
+    ssize_t ret = write(drain_fd, &one, sizeof(one));
+    (void)ret;
+
+    uint64_t deadline = monotonic_ns() + (uint64_t)drain_timeout_ms * 1000000ULL;
+    while (atomic_load(&drained_workers) < worker_count && monotonic_ns() < deadline) {
+        if (wait_shutdown(10)) return;
+    }
+
+    AdmissionStats stats;
+    admission_stats(&stats);
+    printf("Hot restart: draining %u connection(s), timeout %u ms\n", stats.connections, drain_timeout_ms);
+    for (;;) {
+        admission_stats(&stats);
+        if (stats.connections == 0) {
+            printf("Hot restart: all connections closed\n");
+            break;
+        }
+        if (monotonic_ns() >= deadline) {
+            printf("Hot restart: drain timeout, closing %u connection(s)\n", stats.connections);
+            break;
+        }
+        if (wait_shutdown(100)) return;
+    }
+    graceful_shutdown();
+}
+
+// 热重启线程：确认接管旧进程（如果有），然后在控制套接字上等待下一个新进程
+static void* restart_main(void *arg) {
+    int port = *(int *)arg;
+
+    if (!wait_workers_ready()) {
+        if (restart_conn >= 0) {
+            close(restart_conn);
+            restart_conn = -1;
+            atomic_store(&takeover_failed, 1);
+        }
+        return NULL;
+    }
+    if (restart_conn >= 0) {
+        int ret = hot_restart_confirm(restart_conn);
+        restart_conn = -1;
+        // 旧进程已放弃交接并继续在共享的监听套接字上服务：本进程退出，不接管控制套接字
+        if (ret < 0) {
+            log_error("Hot restart: takeover failed, shutting down");
+            atomic_store(&takeover_failed, 1);
+            graceful_shutdown();
+            return NULL;
+        }
+    }
+
+    HandoffSockets sockets;
+    if (collect_listeners(&sockets, port) < 0) {
+        log_warn("Hot restart: %d workers exceed the %d listeners that can be handed over, hot restart disabled",
+                 worker_count, HOT_RESTART_MAX_LISTENERS);
+        return NULL;
+    }
+    // 旧进程已不再使用控制套接字文件，替换为本进程的
+    int control = hot_restart_listen(hot_restart_path);
+    if (control < 0) {
+        return NULL;
+    }
+
+    while (keep_running) {
+        struct pollfd fds[2] = {
+            { .fd = control, .events = POLLIN },
+            { .fd = shutdown_fd, .events = POLLIN }
+        };
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
             break;
         }
+        if (fds[1].revents || !keep_running) break;
+        int ret = hot_restart_serve(control, &sockets);
+        if (ret == 0) {
+            atomic_store(&handed_off, 1);
+            break;
+        }
+        if (ret < 0) break;
+    }
+    close(control);
+
+    if (atomic_load(&handed_off)) {
+        drain_and_shutdown();
+    } else {
+        unlink(hot_restart_path);
+    }
+    return NULL;
+}
+
+// 启动服务器
+int start_server(int port) {
+    printf("Starting server on port %d\n", port);
+
+    // 设置信号处理
+    struct sigaction sa;
+    sa.sa_handler = sigint_handler;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = 0;
+    if (sigaction(SIGINT, &sa, NULL) == -1) {
+        handle_error(ERR_RESOURCE_INIT_FAILED, "Failed to set up signal handler");
+        return 1;
+    }
+    // 对端关闭后继续发送（包括 splice 到套接字）时返回 EPIPE，而不是终止进程
+    signal(SIGPIPE, SIG_IGN);
+
+    // 热重启：从正在运行的进程接收监听套接字。旧进程的每个 TCP 监听套接字都需要一个工作线程接受，
+    // 否则关闭时其队列中的连接会被重置
+    HandoffSockets inherited = { .unix_fd = -1 };
+    if (hot_restart_path[0]) {
+        int ret = hot_restart_receive(hot_restart_path, port, &inherited, &restart_conn);
+        if (ret < 0) {
+            return 1;
+        }
+        if (ret > 0) {
+            printf("Hot restart: received %d TCP and %d UDP listener(s)%s from running process\n",
+                   inherited.tcp_count, inherited.udp_count, inherited.unix_fd >= 0 ? " and a unix listener" : "");
+            if (inherited.tcp_count > worker_count) {
+                printf("Hot restart: using %d workers, one per inherited listener\n", inherited.tcp_count);
+                worker_count = inherited.tcp_count;
+            }
+        }
+    }
+
+    // 确定 ring 和缓冲区的大小，连接数上限默认由文件描述符限制推导
+    server_config_resolve(&server_config, worker_count);
+    server_config_print(&server_config);
+    int max_connections = (int)server_config.max_connections;
+
+    // 证书和私钥由所有工作线程共享，启动前加载
+    if (tls_cert_file[0]) {
+        tls_context = tls_context_create(tls_cert_file, tls_key_file);
+        if (!tls_context) {
+            return 1;
+        }
+        printf("TLS enabled (kernel TLS after handshake)\n");
+    }
+
+    // Unix 域套接字不支持 SO_REUSEPORT 负载分担，由各工作线程共享同一个监听套接字
+    if (unix_path[0] && inherited.unix_fd >= 0 && inherited.unix_type == unix_type) {
+        unix_socket = inherited.unix_fd;
+        printf("Listening on inherited unix socket %s\n", unix_path);
+    } else if (unix_path[0]) {
+        // 交接来的套接字类型不同：旧进程已交出同一路径（不再删除它），换成新类型的套接字
+        if (inherited.unix_fd >= 0) {
+            struct sockaddr_un bound;
+            socklen_t len = sizeof(bound);
+            if (getsockname(inherited.unix_fd, (struct sockaddr *)&bound, &len) == 0 &&
+                len > offsetof(struct sockaddr_un, sun_path) &&
+                strncmp(bound.sun_path, unix_path, sizeof(bound.sun_path)) == 0) {
+                unlink(unix_path);
+            }
+            close(inherited.unix_fd);
+        }
+        unix_socket = setup_unix_socket(unix_path, unix_type);
+        if (unix_socket < 0) {
+            return 1;
+        }
+        printf("Listening on unix socket %s (%s)\n", unix_path,
+               unix_type == SOCK_SEQPACKET ? "seqpacket" : "stream");
+    } else if (inherited.unix_fd >= 0) {
+        close(inherited.unix_fd);
+    }
+
+    shutdown_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (hot_restart_path[0]) {
+        drain_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (drain_fd < 0) {
+            handle_error(ERR_RESOURCE_INIT_FAILED, "Failed to create drain eventfd");
+            return 1;
+        }
+    }
+    workers = calloc(worker_count, sizeof(*workers));
+    ResourceManager *rms = calloc(worker_count, sizeof(ResourceManager));
+    pthread_t *threads = calloc(worker_count, sizeof(pthread_t));
+    if (shutdown_fd < 0 || !workers || !rms || !threads) {
+        handle_error(ERR_MEMORY_ALLOC_FAILED, "Failed to allocate worker state");
+        return 1;
+    }
+
+    // 多个工作线程时启用负载均衡和连接迁移
+    if (worker_count > 1) {
+        msg_ring_supported = probe_msg_ring();
+        if (!msg_ring_supported) {
+            printf("IORING_OP_MSG_RING not supported, connection migration disabled\n");
+        }
+        if (balancer_init(worker_count, &balancer_config) < 0) {
+            handle_error(ERR_MEMORY_ALLOC_FAILED, "Failed to initialize load balancer");
+            return 1;
+        }
+    }
+
+    if (pubsub_enabled && pubsub_init(worker_count, &pubsub_config) < 0) {
+        handle_error(ERR_MEMORY_ALLOC_FAILED, "Failed to initialize pub/sub");
+        return 1;
+    }
+
+    if (capture_path[0]) {
+        int ret = capture_init(capture_path, capture_payload, worker_count);
+        if (ret < 0) {
+            fprintf(stderr, "Failed to create capture file %s: %s\n", capture_path, strerror(-ret));
+            return 1;
+        }
+        printf("Traffic capture: recording message %s to %s\n",
+               capture_payload ? "timing, sizes and contents" : "timing and sizes", capture_path);
+    }
+
+    if (admission_init(worker_count, (unsigned)max_connections, &admission_config) < 0) {
+        handle_error(ERR_MEMORY_ALLOC_FAILED, "Failed to initialize admission control");
+        return 1;
+    }
+
+    // 事件记录器始终开启，收到 SIGUSR1 或崩溃时转储
+    if (recorder_events > 0) {
+        if (recorder_init(worker_count, recorder_events, recorder_file) < 0) {
+            handle_error(ERR_MEMORY_ALLOC_FAILED, "Failed to initialize flight recorder");
+            return 1;
+        }
+        install_recorder_signals(1);
+        printf("Flight recorder: %u events per worker, dump with SIGUSR1 to %s\n",
+               recorder_get(0)->mask + 1, recorder_path());
+    }
+
+    // 各工作线程的 ring 在各自线程中创建，满足 SINGLE_ISSUER 的要求
+    unsigned ring_flags = ring_flags_probe ? probe_ring_flags() : 0;
+    printf("io_uring setup flags:%s%s%s%s%s\n",
+           ring_flags & IORING_SETUP_SINGLE_ISSUER ? " SINGLE_ISSUER" : "",
+           ring_flags & IORING_SETUP_DEFER_TASKRUN ? " DEFER_TASKRUN" : "",
+           ring_flags & IORING_SETUP_COOP_TASKRUN ? " COOP_TASKRUN" : "",
+           ring_flags & IORING_SETUP_SUBMIT_ALL ? " SUBMIT_ALL" : "",
+           ring_flags & IORING_SETUP_CQSIZE ? " CQSIZE" : (ring_flags ? "" : " none"));
+
+    for (int i = 0; i < worker_count; i++) {
+        init_resource_manager(&rms[i], port, max_connections);
+        rms[i].worker_index = i;
+        rms[i].ring_flags = ring_flags;
+        rms[i].config = server_config;
+        rms[i].recorder = recorder_get(i);
+        // 使用旧进程交接的监听套接字，未启用 UDP 时继承的数据报套接字随资源管理器关闭
+        if (i < inherited.tcp_count) {
+            rms[i].server_socket = inherited.tcp[i];
+        }
+        if (i < inherited.udp_count) {
+            rms[i].udp_socket = inherited.udp[i];
+        }
+    }
+    for (int i = worker_count; i < inherited.udp_count; i++) {
+        close(inherited.udp[i]);
+    }
+
+    // 监听套接字在主线程中按工作线程顺序创建（继承的套接字已在组中的前面），在 SO_REUSEPORT 组中的位置与工作线程编号一致
+    for (int i = 0; i < worker_count; i++) {
+        if (allocate_resource(&rms[i], RESOURCE_SERVER_SOCKET) < 0) {
+            return 1;
+        }
+    }
+    if (cpu_steering != CPU_STEER_OFF && worker_count > 1 && setup_cpu_steering(rms) < 0) {
+        handle_error(ERR_MEMORY_ALLOC_FAILED, "Failed to set up CPU steering");
+        return 1;
+    }
+
+    // 热重启线程屏蔽 SIGINT，由主线程处理信号
+    pthread_t restart_thread;
+    int restart_started = 0;
+    if (hot_restart_path[0]) {
+        sigset_t block, old;
+        sigemptyset(&block);
+        sigaddset(&block, SIGINT);
+        pthread_sigmask(SIG_BLOCK, &block, &old);
+        restart_started = pthread_create(&restart_thread, NULL, restart_main, &port) == 0;
+        pthread_sigmask(SIG_SETMASK, &old, NULL);
+        if (!restart_started) {
+            log_warn("Failed to create hot restart thread, hot restart disabled");
+            if (restart_conn >= 0) {
+                close(restart_conn);
+                restart_conn = -1;
+            }
+        }
+    }
+
+    printf("Server started with %d worker(s). Press Ctrl+C to stop.\n", worker_count);
+
+    int failed = 0;
+    if (worker_count == 1) {
+        worker_main(&rms[0]);
+        failed = rms[0].port < 0;
+    } else {
+        // 工作线程屏蔽 SIGINT，由主线程处理信号并唤醒各工作线程
+        sigset_t block, old;
+        sigemptyset(&block);
+        sigaddset(&block, SIGINT);
+        pthread_sigmask(SIG_BLOCK, &block, &old);
+        int started = 0;
+        for (; started < worker_count; started++) {
+            if (pthread_create(&threads[started], NULL, worker_main, &rms[started]) != 0) {
+                fprintf(stderr, "Failed to create worker thread %d\n", started);
+                keep_running = 0;
+                wake_workers();
+                failed = 1;
+                break;
+            }
+        }
+        pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+        for (int i = 0; i < started; i++) {
+            pthread_join(threads[i], NULL);
+            failed |= rms[i].port < 0;
+        }
+    }
+
+    if (restart_started) {
+        wake_workers();
+        pthread_join(restart_thread, NULL);
+        failed |= atomic_load(&takeover_failed);
     }
 
     printf("Shutting down server...\n");
-    cleanup_resources(&rm);
-    free(bufs);
-    free(buf_base);
-    return 0;
+    AdmissionStats overload;
+    admission_stats(&overload);
+    if (overload.rejected || overload.shed || overload.paused) {
+        printf("Overload: %llu connections rejected, %llu idle connections shed, %llu accept pauses\n",
+               (unsigned long long)overload.rejected, (unsigned long long)overload.shed,
+               (unsigned long long)overload.paused);
+    }
+    admission_destroy();
+    uint64_t deferred = atomic_load(&reads_deferred);
+    if (deferred) {
+        printf("Fair scheduling: %llu reads deferred over budget\n", (unsigned long long)deferred);
+    }
+    uint64_t grows = atomic_load(&buffer_grows);
+    uint64_t shrinks = atomic_load(&buffer_shrinks);
+    if (grows || shrinks) {
+        printf("Receive buffers: %llu moves to a larger class, %llu to a smaller class\n",
+               (unsigned long long)grows, (unsigned long long)shrinks);
+    }
+    uint64_t sampled = atomic_load(&accepts_sampled);
+    if (sampled) {
+        uint64_t cross = atomic_load(&accepts_cross_cpu);
+        printf("CPU locality: %llu of %llu accepted connections received on another CPU (%.1f%%)\n",
+               (unsigned long long)cross, (unsigned long long)sampled, 100.0 * (double)cross / (double)sampled);
+    }
+    if (pubsub_enabled) {
+        PubsubStats pubsub;
+        pubsub_stats(&pubsub);
+        printf("Pub/sub: %llu messages published, %llu delivered, %llu dropped, %llu slow subscribers disconnected\n",
+               (unsigned long long)pubsub.published, (unsigned long long)pubsub.delivered,
+               (unsigned long long)pubsub.dropped, (unsigned long long)pubsub.disconnected);
+        pubsub_destroy();
+    }
+    if (capture_path[0]) {
+        CaptureStats capture;
+        capture_stats(&capture);
+        printf("Traffic capture: %llu records (%llu dropped), %.1f MB written to %s\n",
+               (unsigned long long)capture.records, (unsigned long long)capture.dropped,
+               (double)capture.bytes / 1e6, capture_path);
+        capture_shutdown();
+    }
+    if (recorder_events > 0) {
+        install_recorder_signals(0);
+        recorder_destroy();
+    }
+    balancer_destroy();
+    close(shutdown_fd);
+    shutdown_fd = -1;
+    if (drain_fd >= 0) {
+        close(drain_fd);
+        drain_fd = -1;
+    }
+    if (unix_socket >= 0) {
+        close(unix_socket);
+        // 交接后套接字文件属于新进程，接管失败时仍属于旧进程
+        if (!atomic_load(&handed_off) && !atomic_load(&takeover_failed)) {
+            unlink(unix_path);
+        }
+        unix_socket = -1;
+    }
+    tls_context_destroy(tls_context);
+    tls_context = NULL;
+    free(worker_cpus);
+    worker_cpus = NULL;
+    free(threads);
+    free(rms);
+    free((void *)workers);
+    workers = NULL;
+    return failed ? 1 : 0;
 }
\ No newline at end of file
@@ -2,44 +2,207 @@
 #define IOURING_SERVER_H
 
 #include <netinet/in.h>
+#include <stdint.h>
 #include "ring_buffer.h"
 #include <liburing.h>
 
-#define MAX_CONNECTIONS 1000000
-#define QUEUE_DEPTH 32768
-#define BUFFER_SIZE 1024
-#define BUFFER_COUNT 5000
+// SQ/CQ 大小、固定缓冲区大小和数量、连接数上限在启动时配置，见 server_config.h
+#define CQ_RING_FACTOR 4  // 支持 IORING_SETUP_CQSIZE 且未配置 CQ 大小时，CQ 大小为 SQ 的倍数（由内核截断到上限）
+#define IO_BUFFER_SIZE 65536  // 文件 I/O 使用的大块固定缓冲区，按页对齐
+#define IO_BUFFER_COUNT 64
+#define FIXED_FILE_COUNT 1024  // 注册到 ring 的固定文件槽位数
+// 公平调度的默认预算：每个连接每轮事件循环最多读取的字节数和次数，见 set_fair_budgets
+#define SCHED_DEFAULT_BYTE_BUDGET 16384
+#define SCHED_DEFAULT_OP_BUDGET 4
 
 // 前向声明
 struct connection;
 struct ResourceManager;
+struct ServerConfig;
+struct Coroutine;
+struct PubsubSubscriber;
+struct PubsubConfig;
 
 // 连接状态枚举
 enum connection_state {
     CONN_STATE_READING,
-    CONN_STATE_WRITING
+    CONN_STATE_WRITING,
+    CONN_STATE_DEFERRED  // 超出本轮预算，在延后队列中等待重新读取，连接上没有进行中的操作
 };
 
-// 连接结构体
+// 连接结构体分为两部分：事件循环处理每个完成事件都会访问的字段放在热记录 struct connection 中，
+// 不超过一个缓存行，从工作线程按缓存行对齐的连接池分配；读写缓冲区、地址和上层模块的状态放在冷记录
+// struct connection_cold 中，从单独的池分配，经 conn->cold 访问
+
+// 连接的冷记录
+struct connection_cold {
+    RingBuffer write_buffer;  // 待发送的回复（第一次写入时才分配内存）
+    RingBuffer read_buffer;   // 处理器暂存的不完整请求（第一次写入时才分配内存）
+    uintptr_t user_data;  // 供上层协议模块保存的每连接状态
+    struct sockaddr_in addr;
+    struct PubsubSubscriber *subscriber;  // 发布订阅的发送队列和订阅，未使用发布订阅时为 NULL
+    struct connection *sched_prev;  // 延后读取队列
+    struct connection *sched_next;
+};
+
+// 连接的热记录
 struct connection {
     int fd;
-    struct sockaddr_in addr;
-    RingBuffer read_buffer;
-    RingBuffer write_buffer;
-    enum connection_state state;
+    uint8_t state;  // enum connection_state
+    uint8_t buffer_class;  // 下一次读取使用的接收缓冲区规格（BUFFER_CLASS_*）
+    uint16_t buffer_shrink;  // 连续能放进更小规格的读取次数
     int buffer_id;  // 用于零拷贝操作的缓冲区ID
+    int pending_jobs;  // 尚未完成的卸载任务数，大于 0 时连接暂停收发
+    int linked_send;  // 与下一次读取链接提交、尚未确认完成的发送字节数
+    uint32_t sched_round;  // 最近一次结算预算的事件循环轮次
+    uint32_t sched_ops;    // 该轮已处理的读取次数
+    uint32_t sched_bytes;  // 尚未抵扣的读取字节数，每经过一轮抵扣一轮的字节预算
+    uint64_t id;  // 连接唯一标识，用于识别已被复用的连接结构体
+    struct connection *lru_prev;  // 按最近活动排序的连接链表，过载时从最久未活动的一端关闭空闲连接
+    struct connection *lru_next;
+    struct connection_cold *cold;
 };
 
+_Static_assert(sizeof(struct connection) <= 64, "connection hot record must fit in one cache line");
+
+// 通用完成事件处理器
+// 以其地址（最低位置 1）作为 user_data 提交的请求完成后，由事件循环回调 on_complete
+struct completion_handler {
+    void (*on_complete)(struct completion_handler *handler, struct io_uring_cqe *cqe, struct ResourceManager *rm);
+};
+
+#define COMPLETION_HANDLER_TAG ((uintptr_t)1)
+
+// 将完成事件处理器设置为 SQE 的 user_data
+static inline void sqe_set_completion_handler(struct io_uring_sqe *sqe, struct completion_handler *handler) {
+    io_uring_sqe_set_data(sqe, (void*)((uintptr_t)handler | COMPLETION_HANDLER_TAG));
+}
+
 // 回调函数类型定义
 typedef void (*on_connect_cb)(struct sockaddr_in *);
 typedef void (*on_disconnect_cb)(struct sockaddr_in *);
 typedef void (*on_data_cb)(struct connection*, const char*, size_t, struct ResourceManager*);
+typedef void (*on_datagram_cb)(const struct sockaddr_in*, const char*, size_t, struct ResourceManager*);
+// 协程处理器，返回 CO_SUSPENDED 或 CO_DONE（见 coroutine.h）
+typedef int (*coroutine_fn)(struct Coroutine*);
 
 // 设置回调函数
 void set_on_connect(on_connect_cb cb);
 void set_on_disconnect(on_disconnect_cb cb);
 void set_on_data(on_data_cb cb);
 
+// 设置协程处理器：设置后每个连接就绪时启动一个协程（帧为 frame_size 字节，以 Coroutine 开头），
+// 由协程自行收发，不再调用 on_data；协程结束时关闭连接。见 coroutine.h
+void set_coroutine_handler(coroutine_fn fn, size_t frame_size);
+
+// 启用发布订阅（config 为 NULL 时关闭）：处理器通过 pubsub_subscribe/pubsub_publish 订阅和发布，
+// 消息只保存一份，按引用排入各订阅者的发送队列并在每轮事件处理结束时批量发送。见 pubsub.h
+void set_pubsub(const struct PubsubConfig *config);
+
+// 设置数据报回调：设置后每个工作线程在同一端口上额外监听 UDP，并在同一个 ring 上接收
+void set_on_datagram(on_datagram_cb cb);
+
+// 设置代理模式的上游地址（为 NULL 时关闭代理模式），connect_timeout_ms 为 0 表示不限制连接时间
+// 代理模式下每个连接都被转发到上游，不调用 on_data；copy 非 0 时经用户态缓冲区复制，而不是 splice
+void set_proxy_upstream(const struct sockaddr_in *upstream, unsigned connect_timeout_ms, int copy);
+
+// 设置 TLS 证书链和私钥（PEM）：TCP 连接先进行 TLS 1.3 握手，密钥装入内核 TLS 后，
+// 回调、零拷贝发送和 splice 都直接处理明文。需要以 OpenSSL 构建并加载内核 tls 模块
+void set_tls(const char *cert_file, const char *key_file);
+
+// 设置 Unix 域套接字监听路径（为 NULL 或空字符串时不监听），type 为 SOCK_STREAM 或 SOCK_SEQPACKET
+// 连接与 TCP 连接走相同的接收、发送流程和回调，回调中的地址族为 AF_UNIX
+// SOCK_SEQPACKET 每次读取得到一条消息，超过固定缓冲区大小（buffer_size）的部分被截断；
+// 此时接收缓冲区规格只在默认和较大规格之间调整
+void set_unix_listener(const char *path, int type);
+
+// 设置事件循环的等待策略：没有就绪的完成事件时，先在 CQ 上自旋最多 spin_us 微秒再阻塞
+// 自旋预算按最近观察到的完成事件间隔自动调整，间隔超过 spin_us 时直接阻塞（空闲时不消耗 CPU）
+// napi_busy_poll_us 非 0 时在 ring 上注册 NAPI 忙轮询；每次阻塞不超过 max_sleep_ms（0 表示不限制）
+void set_wait_strategy(unsigned spin_us, unsigned napi_busy_poll_us, unsigned max_sleep_ms);
+
+// 设置是否探测并使用新的 ring 设置标志（SINGLE_ISSUER、DEFER_TASKRUN、COOP_TASKRUN、SUBMIT_ALL、
+// 更大的 CQ），默认开启；关闭时以默认设置创建 ring
+void set_ring_flags_probe(int enabled);
+
+// 设置公平调度预算：一个连接在一轮事件循环中读取超过 byte_budget 字节或 op_budget 次后，不立即重新读取，
+// 而是进入延后队列，超出的字节按每轮 byte_budget 抵扣完后才继续读取，其间先处理其他连接。0 表示不限制该项，
+// 两项均为 0 时关闭（默认见 SCHED_DEFAULT_*）。只作用于回调处理器的读取，协程、代理和 TLS 握手不受影响
+void set_fair_budgets(unsigned byte_budget, unsigned op_budget);
+
+// 设置是否将回复的发送和下一次读取作为一条 SQE 链提交（默认关闭）：发送完成时读取已经挂起，
+// 每次请求-响应少一轮事件循环。短写由内核继续发送（MSG_WAITALL），需要内核支持 IOSQE_CQE_SKIP_SUCCESS
+void set_link_send_recv(int enabled);
+
+// 设置 ring 和缓冲区的大小（默认见 server_config.h），在 start_server 之前调用。
+// start_server 按工作线程数和主机资源确定自动项，连接数上限为 0 时由 RLIMIT_NOFILE 推导
+void set_server_config(const struct ServerConfig *config);
+
+// 设置注册缓冲区和连接池所在区域是否使用大页（默认启用）：依次尝试 2 MB hugetlb 大页和透明大页，
+// 都不可用时使用普通页。每个工作线程的区域绑定到其创建时所在 CPU 的 NUMA 节点
+void set_huge_pages(int enabled);
+
+// 设置事件记录器：每个工作线程在环形缓冲区中保留最近 events 个连接事件（接受、收发、关闭、错误等），
+// 0 表示关闭（默认 RECORDER_DEFAULT_EVENTS）。收到 SIGUSR1 或崩溃时转储到 path（为 NULL 或空时为
+// 当前目录下的 flight-<pid>.rec），用 flight_decode 解码
+void set_flight_recorder(unsigned events, const char *path);
+
+// 立即转储事件记录器，可在任意线程中调用
+// 返回: 成功返回 0，失败返回 -errno（未启用为 -ENOENT，已有转储正在进行为 -EBUSY）
+int dump_flight_recorder(void);
+
+// 设置热重启（零停机升级）：path 为控制套接字路径（为 NULL 或空时不启用）。启动时如果 path 上有正在运行的
+// 进程，从它接收监听套接字（SCM_RIGHTS）而不是重新创建，所有工作线程启动后通知其交接完成；
+// 之后在 path 上等待下一个新进程。交接后的旧进程停止接受连接，等待已有连接关闭（最多 drain_timeout 毫秒）后退出
+void set_hot_restart(const char *path, unsigned drain_timeout);
+
+// 设置流量捕获：path 为捕获文件（为 NULL 或空时不捕获，已存在时截断），记录每个连接的建立、关闭和 on_data 收到的
+// 每条消息的时间、大小及回调写入写缓冲区的回复大小；payload 非 0 时同时记录消息内容。用 traffic_replay 回放。
+// 协程、代理和发布订阅的消息不经过 on_data，不被记录
+void set_traffic_capture(const char *path, int payload);
+
+// 设置过载控制阈值：资源余量（固定缓冲区、连接数、SQ 空位和内存中剩余比例的最小值）不高于 reject_pct 时
+// 新连接接受后立即关闭；不高于 shed_pct 时暂停接受连接，并关闭最久未活动的空闲连接，已有连接的收发不受影响
+// memory_limit_mb 为进程已分配内存（malloc 统计）的上限，0 表示不检查内存
+void set_overload_limits(unsigned reject_pct, unsigned shed_pct, unsigned memory_limit_mb);
+
+// 设置整个进程卸载任务的线程数（0 表示不启用线程池）。每个工作线程有自己的线程池，
+// 分得 threads / 工作线程数 个线程，至少一个
+void set_offload_threads(int threads);
+
+// 设置工作线程数，每个工作线程运行独立的 ring 和 SO_REUSEPORT 监听套接字（默认 1）
+void set_worker_count(int count);
+
+// 工作线程的 CPU 绑定和新连接引导方式，见 set_cpu_steering
+typedef enum {
+    CPU_STEER_OFF,    // 不绑定 CPU，新连接由内核按四元组哈希分配到各工作线程的监听套接字
+    CPU_STEER_PIN,    // 工作线程 i 绑定到第 i 个可用 CPU，新连接仍按哈希分配
+    CPU_STEER_CBPF    // 绑定 CPU，并由 cBPF 程序把新连接交给绑定在接收该连接的 CPU 上的工作线程
+} CpuSteering;
+
+// 设置工作线程的 CPU 绑定和新连接引导（默认 CPU_STEER_OFF，只在多个工作线程时生效）。
+// CPU_STEER_CBPF 在 SO_REUSEPORT 组上挂载 SO_ATTACH_REUSEPORT_CBPF 程序，按处理 SYN 的 CPU 选择监听套接字，
+// 连接的软中断和工作线程的 ring 在同一个 CPU 上；工作线程数多于可用 CPU 时退回 CPU_STEER_PIN。
+// 卸载任务线程不绑定，仍可使用进程的所有 CPU
+void set_cpu_steering(CpuSteering mode);
+
+// 设置连接迁移阈值：工作线程每轮事件循环的平均待处理 CQE 数或处理耗时（微秒）
+// 持续超过阈值时，将连接迁移到负载较低的工作线程；两个阈值均为 0 时禁用迁移
+void set_migration_thresholds(unsigned backlog, unsigned latency_us);
+
+// 恢复被卸载任务暂停的连接：读缓冲区中还有数据时先以 len 为 0 调用 on_data 处理，
+// 然后发送写缓冲区中的数据并继续读取
+void resume_connection(struct ResourceManager *rm, struct connection *conn);
+
+// 连接就绪（例如 TLS 握手完成后）：代理模式下交给代理，否则开始读取；失败时关闭连接
+void connection_ready(struct ResourceManager *rm, struct connection *conn);
+
+// 关闭连接并释放其资源（用于在回调之外的异步流程中终止连接）
+void close_connection(struct ResourceManager *rm, struct connection *conn);
+
+// 判断异步操作发起时记录的连接（conn、fd、id）是否仍然存活，存活时返回 conn，否则返回 NULL
+struct connection* connection_alive(struct ResourceManager *rm, struct connection *conn, int fd, uint64_t id);
+
 // 启动服务器
 int start_server(int port);
 
@@ -0,0 +1,331 @@
+#include "logger.h"
+#include "resource_manager.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdatomic.h>
+
+// 调用点的限速状态
+typedef struct {
+    const char *site;
+    uint64_t window_start_ns;
+    unsigned count;             // 当前窗口内已输出的记录数
+    unsigned suppressed;        // 当前窗口内被丢弃的记录数
+} LogSite;
+
+struct Logger {
+    struct ResourceManager *rm;
+    int fd;
+    int async;                          // 是否通过 ring 写出
+    struct completion_handler write_handler;
+    char *buffers[2];
+    size_t used[2];
+    int active;                         // 接收新记录的缓冲区
+    int in_flight;                      // 另一个缓冲区是否正在写入
+    size_t written;                     // 在途缓冲区已写出的字节数（短写时续写）
+    uint64_t dropped;                   // 缓冲区已满而丢弃的记录数，下次写出时报告
+    LogSite sites[LOG_SITE_SLOTS];
+    unsigned suppressing;               // 有被丢弃记录的调用点数
+    // 连续的相同记录只输出一次，之后汇总重复次数
+    char last[LOG_MAX_RECORD];
+    size_t last_len;
+    LogLevel last_level;
+    unsigned repeats;
+    uint64_t repeat_since_ns;
+    // 时间前缀按秒缓存
+    time_t prefix_sec;
+    char prefix[32];
+};
+
+static atomic_int log_level = LOG_INFO;
+static __thread Logger *thread_logger = NULL;
+
+static const char *level_names[] = { "ERROR", "WARN", "INFO", "DEBUG" };
+
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// 写入全部数据
+static void write_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+}
+
+// 格式化记录前缀 "<本地时间>.<毫秒> <工作线程> <级别> "
+static int format_prefix(char *out, size_t size, Logger *lg, LogLevel level) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    char local[32];
+    const char *date = local;
+    if (lg && lg->prefix_sec == ts.tv_sec) {
+        date = lg->prefix;
+    } else {
+        struct tm tm;
+        localtime_r(&ts.tv_sec, &tm);
+        strftime(local, sizeof(local), "%Y-%m-%d %H:%M:%S", &tm);
+        if (lg) {
+            memcpy(lg->prefix, local, sizeof(local));
+            lg->prefix_sec = ts.tv_sec;
+        }
+    }
+    if (lg) {
+        return snprintf(out, size, "%s.%03ld W%d %s ", date, ts.tv_nsec / 1000000, lg->rm->worker_index,
+                        level_names[level]);
+    }
+    return snprintf(out, size, "%s.%03ld - %s ", date, ts.tv_nsec / 1000000, level_names[level]);
+}
+
+// 把一条完整的记录（前缀 + 正文 + 换行）追加到缓冲区，空间不足时丢弃
+static void append_record(Logger *lg, LogLevel level, const char *body, size_t len) {
+    char *buf = lg->buffers[lg->active];
+    size_t *used = &lg->used[lg->active];
+    // 预留报告丢弃数量的空间
+    if (*used + LOG_MAX_RECORD + 64 > LOG_BUFFER_SIZE) {
+        lg->dropped++;
+        return;
+    }
+    int n = format_prefix(buf + *used, LOG_MAX_RECORD, lg, level);
+    if (n < 0) return;
+    if (len > LOG_MAX_RECORD - (size_t)n - 1) len = LOG_MAX_RECORD - (size_t)n - 1;
+    memcpy(buf + *used + n, body, len);
+    *used += (size_t)n + len;
+    buf[(*used)++] = '\n';
+}
+
+// 输出重复记录的汇总
+static void report_repeats(Logger *lg) {
+    if (lg->repeats == 0) return;
+    char body[64];
+    int n = snprintf(body, sizeof(body), "last message repeated %u times", lg->repeats);
+    lg->repeats = 0;
+    append_record(lg, lg->last_level, body, (size_t)n);
+}
+
+// 输出调用点窗口内被限速丢弃的记录数，并开始新的窗口
+static void report_suppressed(Logger *lg, LogSite *slot, uint64_t now) {
+    if (slot->suppressed > 0) {
+        char body[LOG_MAX_RECORD];
+        int n = snprintf(body, sizeof(body), "%u similar messages suppressed: %s", slot->suppressed,
+                         slot->site);
+        append_record(lg, LOG_WARN, body, n < (int)sizeof(body) ? (size_t)n : sizeof(body) - 1);
+        slot->suppressed = 0;
+        lg->suppressing--;
+    }
+    slot->window_start_ns = now;
+    slot->count = 0;
+}
+
+// 输出记录
+void log_vwrite(LogLevel level, const char *site, const char *fmt, va_list ap) {
+    if ((int)level > atomic_load_explicit(&log_level, memory_order_relaxed)) return;
+
+    Logger *lg = thread_logger;
+    if (!lg) {
+        char record[LOG_MAX_RECORD];
+        int n = format_prefix(record, sizeof(record), NULL, level);
+        if (n < 0) return;
+        // 留出换行的位置
+        size_t room = sizeof(record) - (size_t)n - 1;
+        int m = vsnprintf(record + n, room, fmt, ap);
+        size_t len = (size_t)n + (m < 0 ? 0 : (size_t)m < room ? (size_t)m : room - 1);
+        record[len++] = '\n';
+        write_all(STDERR_FILENO, record, len);
+        return;
+    }
+
+    // 限速：同一调用点在窗口内超出配额的记录不格式化，只计数
+    uint64_t now = monotonic_ns();
+    LogSite *slot = &lg->sites[((uintptr_t)site >> 3) & (LOG_SITE_SLOTS - 1)];
+    if (slot->site != site) {
+        report_suppressed(lg, slot, now);
+        slot->site = site;
+    } else if (now - slot->window_start_ns >= (uint64_t)LOG_RATE_WINDOW_MS * 1000000ULL) {
+        report_suppressed(lg, slot, now);
+    }
+    if (slot->count >= LOG_RATE_BURST) {
+        if (slot->suppressed++ == 0) lg->suppressing++;
+        return;
+    }
+    slot->count++;
+
+    char body[LOG_MAX_RECORD];
+    int n = vsnprintf(body, sizeof(body), fmt, ap);
+    if (n < 0) return;
+    size_t len = (size_t)n < sizeof(body) ? (size_t)n : sizeof(body) - 1;
+
+    // 与上一条记录相同时只计数
+    if (level == lg->last_level && len == lg->last_len && memcmp(body, lg->last, len) == 0) {
+        if (lg->repeats++ == 0) lg->repeat_since_ns = now;
+        return;
+    }
+    report_repeats(lg);
+    append_record(lg, level, body, len);
+    memcpy(lg->last, body, len);
+    lg->last_len = len;
+    lg->last_level = level;
+}
+
+void log_write(LogLevel level, const char *site, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    log_vwrite(level, site, fmt, ap);
+    va_end(ap);
+}
+
+// 写请求完成：短写时续写剩余部分，写完后释放缓冲区
+static void on_log_written(struct completion_handler *handler, struct io_uring_cqe *cqe, ResourceManager *rm) {
+    (void)rm;
+    Logger *lg = (Logger *)((char *)handler - offsetof(Logger, write_handler));
+    int flight = lg->active ^ 1;
+    if (cqe->res > 0) {
+        lg->written += (size_t)cqe->res;
+    }
+    if (cqe->res > 0 && lg->written < lg->used[flight]) {
+        struct io_uring_sqe *sqe = io_uring_get_sqe(lg->rm->ring);
+        if (sqe) {
+            io_uring_prep_write(sqe, lg->fd, lg->buffers[flight] + lg->written,
+                                (unsigned)(lg->used[flight] - lg->written), (uint64_t)-1);
+            sqe_set_completion_handler(sqe, &lg->write_handler);
+            return;
+        }
+        write_all(lg->fd, lg->buffers[flight] + lg->written, lg->used[flight] - lg->written);
+    }
+    // 写入失败时丢弃这批记录，日志本身不再报错
+    lg->used[flight] = 0;
+    lg->written = 0;
+    lg->in_flight = 0;
+}
+
+// 提交缓冲区中的记录
+void log_flush(ResourceManager *rm) {
+    Logger *lg = rm->logger;
+    if (!lg) return;
+
+    // 到期的重复汇总和限速汇总
+    if (lg->repeats || lg->suppressing) {
+        uint64_t now = monotonic_ns();
+        uint64_t window = (uint64_t)LOG_RATE_WINDOW_MS * 1000000ULL;
+        if (lg->repeats && now - lg->repeat_since_ns >= window) {
+            report_repeats(lg);
+            lg->last_len = 0;
+        }
+        for (int i = 0; i < LOG_SITE_SLOTS && lg->suppressing; i++) {
+            LogSite *slot = &lg->sites[i];
+            if (slot->suppressed && now - slot->window_start_ns >= window) {
+                report_suppressed(lg, slot, now);
+            }
+        }
+    }
+
+    if (lg->in_flight || lg->used[lg->active] == 0) return;
+    if (lg->dropped) {
+        char body[64];
+        int n = snprintf(body, sizeof(body), "%llu log records dropped (buffer full)", (unsigned long long)lg->dropped);
+        lg->dropped = 0;
+        append_record(lg, LOG_WARN, body, (size_t)n);
+    }
+
+    int active = lg->active;
+    if (!lg->async) {
+        write_all(lg->fd, lg->buffers[active], lg->used[active]);
+        lg->used[active] = 0;
+        return;
+    }
+    struct io_uring_sqe *sqe = io_uring_get_sqe(rm->ring);
+    if (!sqe) return;
+    // 偏移为 -1 时从文件当前位置写入，与 write(2) 相同
+    io_uring_prep_write(sqe, lg->fd, lg->buffers[active], (unsigned)lg->used[active], (uint64_t)-1);
+    sqe_set_completion_handler(sqe, &lg->write_handler);
+    lg->in_flight = 1;
+    lg->written = 0;
+    lg->active = active ^ 1;
+}
+
+// 同步写出调用线程缓冲区中的记录
+void log_flush_sync(void) {
+    Logger *lg = thread_logger;
+    if (!lg) return;
+    report_repeats(lg);
+    write_all(lg->fd, lg->buffers[lg->active], lg->used[lg->active]);
+    lg->used[lg->active] = 0;
+}
+
+// 创建日志器
+Logger* logger_create(ResourceManager *rm) {
+    Logger *lg = calloc(1, sizeof(Logger));
+    if (!lg) return NULL;
+    lg->rm = rm;
+    lg->fd = STDERR_FILENO;
+    lg->async = (rm->ring->features & IORING_FEAT_RW_CUR_POS) != 0;
+    lg->write_handler.on_complete = on_log_written;
+    lg->buffers[0] = malloc(LOG_BUFFER_SIZE);
+    lg->buffers[1] = malloc(LOG_BUFFER_SIZE);
+    lg->last_level = LOG_ERROR;
+    lg->prefix_sec = (time_t)-1;
+    if (!lg->buffers[0] || !lg->buffers[1]) {
+        logger_destroy(lg);
+        return NULL;
+    }
+    thread_logger = lg;
+    return lg;
+}
+
+// 释放日志器。ring 退出时等待在途的写请求结束，之后只需写出正在接收记录的缓冲区
+void logger_destroy(Logger *lg) {
+    if (!lg) return;
+    if (thread_logger == lg) {
+        thread_logger = NULL;
+    }
+    if (lg->buffers[lg->active]) {
+        report_repeats(lg);
+        for (int i = 0; i < LOG_SITE_SLOTS && lg->suppressing; i++) {
+            if (lg->sites[i].suppressed) {
+                report_suppressed(lg, &lg->sites[i], 0);
+            }
+        }
+        write_all(lg->fd, lg->buffers[lg->active], lg->used[lg->active]);
+    }
+    free(lg->buffers[0]);
+    free(lg->buffers[1]);
+    free(lg);
+}
+
+// 设置当前级别
+void log_set_level(LogLevel level) {
+    atomic_store_explicit(&log_level, (int)level, memory_order_relaxed);
+}
+
+// 读取当前级别
+LogLevel log_get_level(void) {
+    return (LogLevel)atomic_load_explicit(&log_level, memory_order_relaxed);
+}
+
+// 解析级别名称
+int log_parse_level(const char *name) {
+    if (!name) return -1;
+    for (int i = LOG_ERROR; i <= LOG_DEBUG; i++) {
+        if (strcasecmp(name, level_names[i]) == 0) return i;
+    }
+    if (strcasecmp(name, "warning") == 0) return LOG_WARN;
+    if (name[0] >= '0' && name[0] <= '3' && name[1] == '\0') return name[0] - '0';
+    return -1;
+}
+
+// 级别名称
+const char* log_level_name(LogLevel level) {
+    return level >= LOG_ERROR && level <= LOG_DEBUG ? level_names[level] : "?";
+}
\ No newline at end of file
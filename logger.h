@@ -0,0 +1,64 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <stdarg.h>
+#include "iouring_server.h"
+
+// 每个工作线程的日志缓冲区大小（双缓冲，一个写入内核时另一个继续接收记录）
+#define LOG_BUFFER_SIZE (64 * 1024)
+// 单条记录的最大长度，超出部分被截断
+#define LOG_MAX_RECORD 512
+// 限速：同一调用点在每个窗口内最多输出的记录数，超出的记录只计数，窗口结束时汇总输出
+#define LOG_RATE_WINDOW_MS 1000
+#define LOG_RATE_BURST 10
+// 记录限速状态的调用点槽位数（2 的幂），哈希冲突时共用槽位
+#define LOG_SITE_SLOTS 64
+
+// 日志级别
+typedef enum {
+    LOG_ERROR,
+    LOG_WARN,
+    LOG_INFO,
+    LOG_DEBUG
+} LogLevel;
+
+// 日志器类型（每个工作线程一个）
+typedef struct Logger Logger;
+
+// 创建日志器并绑定到调用线程，之后该线程的日志写入缓冲区，由事件循环通过 ring 批量写出。
+// 必须在工作线程中调用；ring 不支持按文件当前位置写入（IORING_FEAT_RW_CUR_POS）时在 log_flush 中同步写出
+Logger* logger_create(struct ResourceManager *rm);
+
+// 释放日志器（在 ring 退出后调用），同步写出剩余的记录并解除与线程的绑定
+void logger_destroy(Logger *logger);
+
+// 提交缓冲区中的记录和到期的限速汇总（事件循环在每批完成事件处理后调用）。同一时间最多一个写请求在途
+void log_flush(struct ResourceManager *rm);
+
+// 同步写出调用线程缓冲区中的记录（进程即将退出时调用）
+void log_flush_sync(void);
+
+// 输出一条记录（不含换行）。未绑定日志器的线程直接写入 stderr。
+// site 标识调用点，用于限速和去重，须为常量字符串（通常为格式字符串），限速汇总时作为示例输出
+void log_vwrite(LogLevel level, const char *site, const char *fmt, va_list ap);
+void log_write(LogLevel level, const char *site, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+
+// 按级别输出，以格式字符串作为调用点
+#define log_error(...) log_at(LOG_ERROR, __VA_ARGS__)
+#define log_warn(...) log_at(LOG_WARN, __VA_ARGS__)
+#define log_info(...) log_at(LOG_INFO, __VA_ARGS__)
+#define log_debug(...) log_at(LOG_DEBUG, __VA_ARGS__)
+#define log_at(level, fmt, ...) log_write(level, fmt, fmt, ##__VA_ARGS__)
+
+// 设置和读取当前级别（所有线程共用，运行中可修改），高于当前级别的记录被丢弃
+void log_set_level(LogLevel level);
+LogLevel log_get_level(void);
+
+// 解析级别名称（error/warn/info/debug，或 0-3）
+// 返回: 成功返回级别，无法识别返回 -1
+int log_parse_level(const char *name);
+
+// 级别名称
+const char* log_level_name(LogLevel level);
+
+#endif // LOGGER_H
\ No newline at end of file
@@ -1,8 +1,28 @@
+#define _GNU_SOURCE
 #include "iouring_server.h"
+#include "resp.h"
+#include "offload.h"
+#include "file_server.h"
+#include "file_io.h"
+#include "udp.h"
+#include "proxy.h"
+#include "wait_strategy.h"
+#include "admission.h"
+#include "recorder.h"
+#include "logger.h"
+#include "hot_restart.h"
+#include "coroutine.h"
+#include "pubsub.h"
+#include "server_config.h"
+#include "resource_manager.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <arpa/inet.h>
 #include <ctype.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
 
 // 新连接建立时的回调函数
 void on_connect_handler(struct sockaddr_in *addr) {
@@ -23,20 +43,454 @@ void on_data_handler(struct connection* conn, const char *data, size_t len, stru
     (void)rm;  // 显式忽略 rm 参数，消除未使用参数的警告
 
     char ip[INET_ADDRSTRLEN];
-    inet_ntop(AF_INET, &(conn->addr.sin_addr), ip, INET_ADDRSTRLEN);
+    inet_ntop(AF_INET, &(conn->cold->addr.sin_addr), ip, INET_ADDRSTRLEN);
 
-    // printf("Received %zu bytes from %s:%d\n", len, ip, ntohs(conn->addr.sin_port));
+    // printf("Received %zu bytes from %s:%d\n", len, ip, ntohs(conn->cold->addr.sin_port));
 
     // Echo the data back
-    if (ring_buffer_write(&conn->write_buffer, data, len) != 0) {
+    if (ring_buffer_write(&conn->cold->write_buffer, data, len) != 0) {
         fprintf(stderr, "Failed to write data to buffer for echoing\n");
     }
 }
 
+// 卸载任务的参数：请求数据的副本
+struct offload_request {
+    size_t len;
+    char data[];
+};
+
+// 在工作线程中执行的示例任务：将数据转换为大写
+static void offload_work_handler(void *arg) {
+    struct offload_request *req = arg;
+    for (size_t i = 0; i < req->len; i++) {
+        req->data[i] = (char)toupper((unsigned char)req->data[i]);
+    }
+}
+
+// 任务完成后在事件循环中回写结果
+static void offload_done_handler(struct connection *conn, void *arg, struct ResourceManager *rm) {
+    (void)rm;
+    struct offload_request *req = arg;
+    if (conn && ring_buffer_write(&conn->cold->write_buffer, req->data, req->len) != 0) {
+        fprintf(stderr, "Failed to write offload result to buffer\n");
+    }
+    free(req);
+}
+
+// 将请求交给线程池处理的回调函数
+void on_data_offload_handler(struct connection* conn, const char *data, size_t len, struct ResourceManager* rm) {
+    struct offload_request *req = malloc(sizeof(*req) + len);
+    if (!req) {
+        fprintf(stderr, "Failed to allocate offload request\n");
+        return;
+    }
+    req->len = len;
+    memcpy(req->data, data, len);
+
+    if (offload_submit(rm, conn, offload_work_handler, offload_done_handler, req) != 0) {
+        // 线程池不可用时同步处理
+        offload_work_handler(req);
+        offload_done_handler(conn, req, rm);
+    }
+}
+
+// 查找 HTTP 请求头结束标记，返回请求头长度（含空行），不完整时返回 0
+static size_t http_header_length(const char *buf, size_t len) {
+    for (size_t i = 3; i < len; i++) {
+        if (buf[i] == '\n' && buf[i - 1] == '\r' && buf[i - 2] == '\n' && buf[i - 3] == '\r') {
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+static void http_reply_status(struct connection *conn, const char *status) {
+    char reply[128];
+    int n = snprintf(reply, sizeof(reply), "HTTP/1.1 %s\r\nContent-Length: 0\r\n\r\n", status);
+    if (ring_buffer_write(&conn->cold->write_buffer, reply, n) != 0) {
+        fprintf(stderr, "Failed to write HTTP reply to buffer\n");
+    }
+}
+
+// 丢弃写缓冲区末尾 len 字节（serve_file 失败时撤销已写入的响应头）
+static void http_drop_tail(struct connection *conn, size_t len) {
+    size_t used = ring_buffer_used_space(&conn->cold->write_buffer);
+    const char *data = ring_buffer_linearize(&conn->cold->write_buffer);
+    char *keep = used > len ? malloc(used - len) : NULL;
+    if (keep) memcpy(keep, data, used - len);
+    ring_buffer_skip(&conn->cold->write_buffer, used);
+    if (keep) {
+        ring_buffer_write(&conn->cold->write_buffer, keep, used - len);
+        free(keep);
+    }
+}
+
+// 静态文件模式：最小的 HTTP/1.1 GET 处理，从当前目录发送文件（长连接）
+// 文件由 serve_file 经 splice 直接发送；一次只处理到第一个文件请求，
+// 其后的管线化请求留在读缓冲区中，发送完成恢复连接时再以空数据调用本回调处理
+void on_data_static_handler(struct connection* conn, const char *data, size_t len, struct ResourceManager* rm) {
+    if (ring_buffer_write(&conn->cold->read_buffer, data, len) != 0) {
+        fprintf(stderr, "Failed to buffer HTTP request\n");
+        return;
+    }
+
+    for (;;) {
+        size_t used = ring_buffer_used_space(&conn->cold->read_buffer);
+        const char *req = used ? ring_buffer_linearize(&conn->cold->read_buffer) : NULL;
+        size_t header_len = req ? http_header_length(req, used) : 0;
+        if (header_len == 0) {
+            // 请求头不完整，继续读取；超长的请求头直接丢弃
+            if (used > 8192) {
+                ring_buffer_skip(&conn->cold->read_buffer, used);
+                http_reply_status(conn, "431 Request Header Fields Too Large");
+            }
+            return;
+        }
+
+        char method[8] = "", target[512] = "";
+        char line[600];
+        size_t line_len = 0;
+        while (line_len < header_len && line_len < sizeof(line) - 1 && req[line_len] != '\r') {
+            line[line_len] = req[line_len];
+            line_len++;
+        }
+        line[line_len] = '\0';
+        ring_buffer_skip(&conn->cold->read_buffer, header_len);
+
+        if (sscanf(line, "%7s %511s", method, target) != 2 || target[0] != '/') {
+            http_reply_status(conn, "400 Bad Request");
+            continue;
+        }
+        if (strcmp(method, "GET") != 0) {
+            http_reply_status(conn, "405 Method Not Allowed");
+            continue;
+        }
+        char *query = strchr(target, '?');
+        if (query) *query = '\0';
+        if (strstr(target, "..")) {
+            http_reply_status(conn, "403 Forbidden");
+            continue;
+        }
+        const char *path = target[1] ? target + 1 : "index.html";
+        // "//etc/passwd" 去掉一个 '/' 后仍是绝对路径
+        if (path[0] == '/') {
+            http_reply_status(conn, "403 Forbidden");
+            continue;
+        }
+
+        FileInfo info;
+        int err = file_server_stat(rm, path, &info);
+        if (err != 0) {
+            http_reply_status(conn, err == -EXDEV ? "403 Forbidden" : "404 Not Found");
+            continue;
+        }
+
+        char header[128];
+        int n = snprintf(header, sizeof(header), "HTTP/1.1 200 OK\r\nContent-Length: %lld\r\n\r\n",
+                         (long long)info.size);
+        if (ring_buffer_write(&conn->cold->write_buffer, header, n) != 0) {
+            fprintf(stderr, "Failed to write HTTP header to buffer\n");
+            return;
+        }
+        if (serve_file(rm, conn, path, 0, 0) != 0) {
+            http_drop_tail(conn, n);
+            http_reply_status(conn, "503 Service Unavailable");
+            continue;
+        }
+        if (conn->pending_jobs > 0) {
+            return;
+        }
+    }
+}
+
+// 日志模式下每个工作线程一个日志文件，首次使用时打开
+static _Thread_local AsyncFile *journal;
+
+static AsyncFile* journal_file(struct ResourceManager *rm) {
+    if (!journal) {
+        char path[64];
+        snprintf(path, sizeof(path), "journal-%d.log", rm->worker_index);
+        // 优先使用 O_DIRECT，文件系统不支持时（例如 tmpfs）退回页缓存
+        journal = async_file_open(rm, path, O_WRONLY | O_CREAT | O_DIRECT, 0644);
+        if (!journal && errno == EINVAL) {
+            journal = async_file_open(rm, path, O_WRONLY | O_CREAT, 0644);
+        }
+        if (!journal) {
+            fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+        }
+    }
+    return journal;
+}
+
+// 记录持久化后回复客户端
+static void journal_done_handler(struct connection *conn, ssize_t res, const char *data, void *arg,
+                                 struct ResourceManager *rm) {
+    (void)data;
+    (void)arg;
+    (void)rm;
+    if (conn) {
+        const char *reply = res < 0 ? "ERR\n" : "OK\n";
+        ring_buffer_write(&conn->cold->write_buffer, reply, strlen(reply));
+    }
+}
+
+// 日志模式：每一行作为一条记录组提交追加到日志文件，落盘后回复 OK
+void on_data_journal_handler(struct connection* conn, const char *data, size_t len, struct ResourceManager* rm) {
+    if (ring_buffer_write(&conn->cold->read_buffer, data, len) != 0) {
+        fprintf(stderr, "Failed to buffer journal record\n");
+        return;
+    }
+    AsyncFile *file = journal_file(rm);
+
+    size_t used = ring_buffer_used_space(&conn->cold->read_buffer);
+    const char *buf = used ? ring_buffer_linearize(&conn->cold->read_buffer) : NULL;
+    size_t consumed = 0;
+    for (size_t i = 0; i < used; i++) {
+        if (buf[i] != '\n') {
+            continue;
+        }
+        size_t record_len = i + 1 - consumed;
+        int ret = file ? async_file_append(rm, file, conn, buf + consumed, record_len, journal_done_handler, NULL)
+                       : -EBADF;
+        if (ret != 0) {
+            const char *reply = ret == -EAGAIN ? "BUSY\n" : "ERR\n";
+            ring_buffer_write(&conn->cold->write_buffer, reply, strlen(reply));
+        }
+        consumed = i + 1;
+    }
+    ring_buffer_skip(&conn->cold->read_buffer, consumed);
+}
+
+// 发布订阅模式的回复，经发送队列与推送的消息保持顺序
+static void pubsub_reply(struct connection *conn, struct ResourceManager *rm, const char *status,
+                         const char *topic, size_t topic_len) {
+    char reply[PUBSUB_MAX_TOPIC + 32];
+    int n = snprintf(reply, sizeof(reply), "%s %.*s\n", status, (int)topic_len, topic);
+    pubsub_send(rm, conn, reply, (size_t)n);
+}
+
+// 执行一行发布订阅命令（line 不含换行）
+static void pubsub_command(struct connection *conn, const char *line, size_t len, struct ResourceManager *rm) {
+    const char *space = memchr(line, ' ', len);
+    if (!space) {
+        pubsub_reply(conn, rm, "ERR", line, len);
+        return;
+    }
+    size_t cmd_len = (size_t)(space - line);
+    const char *topic = space + 1;
+    size_t rest = len - cmd_len - 1;
+    int ret;
+    if (cmd_len == 3 && memcmp(line, "PUB", 3) == 0) {
+        // 订阅者收到 PUB 之后的整行（主题、消息和换行）
+        const char *end = memchr(topic, ' ', rest);
+        size_t topic_len = end ? (size_t)(end - topic) : rest;
+        ret = pubsub_publish(rm, topic, topic_len, topic, rest + 1);
+        if (ret == 0) {
+            return;
+        }
+        pubsub_reply(conn, rm, "ERR", strerror(-ret), strlen(strerror(-ret)));
+        return;
+    } else if (cmd_len == 3 && memcmp(line, "SUB", 3) == 0) {
+        ret = pubsub_subscribe(rm, conn, topic, rest);
+        pubsub_reply(conn, rm, ret == 0 ? "SUBSCRIBED" : "ERR", topic, rest);
+    } else if (cmd_len == 5 && memcmp(line, "UNSUB", 5) == 0) {
+        ret = pubsub_unsubscribe(rm, conn, topic, rest);
+        pubsub_reply(conn, rm, ret == 0 ? "UNSUBSCRIBED" : "ERR", topic, rest);
+    } else {
+        pubsub_reply(conn, rm, "ERR", line, cmd_len);
+    }
+}
+
+// 发布订阅模式：按行处理 SUB <主题>、UNSUB <主题> 和 PUB <主题> <消息>，
+// 订阅者收到 "<主题> <消息>\n"，消息只复制一次，按引用排入所有订阅者的发送队列
+void on_data_pubsub_handler(struct connection* conn, const char *data, size_t len, struct ResourceManager* rm) {
+    if (ring_buffer_write(&conn->cold->read_buffer, data, len) != 0) {
+        fprintf(stderr, "Failed to buffer pub/sub command\n");
+        return;
+    }
+
+    size_t used = ring_buffer_used_space(&conn->cold->read_buffer);
+    const char *buf = used ? ring_buffer_linearize(&conn->cold->read_buffer) : NULL;
+    size_t consumed = 0;
+    for (size_t i = 0; i < used; i++) {
+        if (buf[i] != '\n') {
+            continue;
+        }
+        // 发布的数据包含换行，命令本身不含
+        pubsub_command(conn, buf + consumed, i - consumed, rm);
+        consumed = i + 1;
+    }
+    ring_buffer_skip(&conn->cold->read_buffer, consumed);
+}
+
+// 协程模式的空闲超时（毫秒），由 RINGMASTER_IDLE_TIMEOUT_MS 设置
+static unsigned coro_idle_timeout_ms = 60000;
+
+// 协程回显的帧：跨等待点保存的状态
+typedef struct {
+    Coroutine co;
+    char buf[256];
+} EchoFrame;
+
+// 协程模式：顺序写出的回显，空闲超时后通知客户端并关闭连接
+static int echo_coroutine(Coroutine *co) {
+    EchoFrame *f = (EchoFrame *)co;
+    CO_BEGIN(co);
+    for (;;) {
+        CO_AWAIT(co, co_recv_timeout(co, f->buf, sizeof(f->buf), coro_idle_timeout_ms));
+        if (co->result == -ETIMEDOUT) {
+            CO_AWAIT(co, co_send(co, "idle timeout\n", 13));
+            CO_RETURN(co);
+        }
+        if (co->result <= 0) {
+            CO_RETURN(co);
+        }
+        CO_AWAIT(co, co_send(co, f->buf, (size_t)co->result));
+        if (co->result < 0) {
+            CO_RETURN(co);
+        }
+    }
+    CO_END(co);
+}
+
+// 数据报回显：回复在本轮事件处理结束时批量发送
+void on_datagram_handler(const struct sockaddr_in *addr, const char *data, size_t len, struct ResourceManager* rm) {
+    udp_reply(rm, addr, data, len);
+}
+
+// INFO [section]：返回过载控制状态（Redis INFO 格式）
+static void cmd_info(RespContext *ctx, const RespSlice *argv, int argc) {
+    (void)argv;
+    (void)argc;
+    static const char *levels[] = { "normal", "reject", "shed" };
+    AdmissionStats stats;
+    admission_stats(&stats);
+    char info[512];
+    int n = snprintf(info, sizeof(info),
+                     "# Overload\r\n"
+                     "level:%s\r\n"
+                     "headroom_pct:%u\r\n"
+                     "connections:%u\r\n"
+                     "rejected_connections:%llu\r\n"
+                     "shed_connections:%llu\r\n"
+                     "accept_pauses:%llu\r\n",
+                     levels[stats.level], stats.headroom_pct, stats.connections,
+                     (unsigned long long)stats.rejected, (unsigned long long)stats.shed,
+                     (unsigned long long)stats.paused);
+    resp_reply_bulk(ctx, info, (size_t)n);
+}
+
+// FLIGHTDUMP：转储事件记录器，返回转储文件路径
+static void cmd_flightdump(RespContext *ctx, const RespSlice *argv, int argc) {
+    (void)argv;
+    (void)argc;
+    int ret = dump_flight_recorder();
+    if (ret != 0) {
+        char err[128];
+        snprintf(err, sizeof(err), "ERR flight recorder dump failed: %s", strerror(-ret));
+        resp_reply_error(ctx, err);
+        return;
+    }
+    const char *path = recorder_path();
+    resp_reply_bulk(ctx, path, strlen(path));
+}
+
+// LOGLEVEL [level]：读取或设置日志级别，立即对所有工作线程生效
+static void cmd_loglevel(RespContext *ctx, const RespSlice *argv, int argc) {
+    if (argc > 2) {
+        resp_reply_error(ctx, "ERR wrong number of arguments");
+        return;
+    }
+    if (argc == 2) {
+        char name[16];
+        size_t len = argv[1].len < sizeof(name) - 1 ? argv[1].len : sizeof(name) - 1;
+        memcpy(name, argv[1].ptr, len);
+        name[len] = '\0';
+        int level = log_parse_level(name);
+        if (level < 0) {
+            resp_reply_error(ctx, "ERR unknown log level, expected error, warn, info or debug");
+            return;
+        }
+        log_set_level((LogLevel)level);
+    }
+    resp_reply_simple(ctx, log_level_name(log_get_level()));
+}
+
+// 解析 "<host>:<port>" 形式的上游地址
+static int parse_upstream(const char *spec, struct sockaddr_in *addr) {
+    char host[INET_ADDRSTRLEN];
+    const char *colon = strrchr(spec, ':');
+    if (!colon || colon == spec || (size_t)(colon - spec) >= sizeof(host)) {
+        return -1;
+    }
+    memcpy(host, spec, colon - spec);
+    host[colon - spec] = '\0';
+    int port = atoi(colon + 1);
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_port = htons(port);
+    if (port <= 0 || port > 65535 || inet_pton(AF_INET, host, &addr->sin_addr) != 1) {
+        return -1;
+    }
+    return 0;
+}
+
+// 读取非负整数环境变量，未设置时返回默认值
+static unsigned env_unsigned(const char *name, unsigned def) {
+    const char *value = getenv(name);
+    return value && *value ? (unsigned)strtoul(value, NULL, 10) : def;
+}
+
+// 解析一个 "--" 选项：--config=<文件>、--auto 或 --<key>=<value>（见 server_config.h）
+static int parse_option(ServerConfig *sizing, const char *option) {
+    if (strcmp(option, "auto") == 0) {
+        sizing->auto_size = 1;
+        return 0;
+    }
+    const char *eq = strchr(option, '=');
+    if (!eq) {
+        return -1;
+    }
+    char key[64];
+    if ((size_t)(eq - option) >= sizeof(key)) {
+        return -1;
+    }
+    memcpy(key, option, eq - option);
+    key[eq - option] = '\0';
+    if (strcmp(key, "config") == 0) {
+        return server_config_load(sizing, eq + 1);
+    }
+    return server_config_set(sizing, key, eq + 1);
+}
+
 int main(int argc, char *argv[]) {
+    // 分离 "--" 选项（ring 和缓冲区大小），按出现顺序生效，其余为位置参数
+    ServerConfig sizing;
+    server_config_init(&sizing);
+    char *args[6];
+    int nargs = 0;
+    for (int i = 0; i < argc; i++) {
+        if (i > 0 && strncmp(argv[i], "--", 2) == 0) {
+            if (parse_option(&sizing, argv[i] + 2) < 0) {
+                fprintf(stderr, "Invalid option: %s\n", argv[i]);
+                return 1;
+            }
+        } else if (nargs < 6) {
+            args[nargs++] = argv[i];
+        } else {
+            nargs++;
+        }
+    }
+    argc = nargs;
+    argv = args;
+
     // 检查命令行参数
-    if (argc != 2) {
-        fprintf(stderr, "Usage: %s <port>\n", argv[0]);
+    if (argc < 2 || argc > 5) {
+        fprintf(stderr, "Usage: %s <port> [echo|resp|offload|static|journal|udp|coro|pubsub|proxy[-copy]:<host>:<port>] "
+                        "[workers] [[seqpacket:]unix-path] [--auto] [--config=<file>] [--<key>=<value>|auto]\n"
+                        "  keys: queue-depth cq-entries buffer-size buffer-count max-connections pool-size\n"
+                        "        small-buffer-size small-buffer-count large-buffer-size large-buffer-count\n",
+                argv[0]);
         return 1;
     }
 
@@ -47,10 +501,146 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
+    struct sockaddr_in upstream;
+
     // 设置回调函数
     set_on_connect(on_connect_handler);
     set_on_disconnect(on_disconnect_handler);
-    set_on_data(on_data_handler);
+    // 解析工作线程数
+    if (argc >= 4) {
+        int workers = atoi(argv[3]);
+        if (workers <= 0) {
+            fprintf(stderr, "Invalid worker count\n");
+            return 1;
+        }
+        set_worker_count(workers);
+    }
+    // 设置了证书和私钥时，TCP 连接使用 TLS
+    const char *tls_cert = getenv("RINGMASTER_TLS_CERT");
+    const char *tls_key = getenv("RINGMASTER_TLS_KEY");
+    if (tls_cert && tls_key) {
+        set_tls(tls_cert, tls_key);
+    }
+    set_server_config(&sizing);
+    // 自动模式按内核支持选择收发路径，环境变量仍可覆盖
+    unsigned link_default = 0;
+    if (sizing.auto_size) {
+        ServerProbe probe;
+        if (server_config_probe(&probe) == 0) {
+            server_config_print_probe(&probe);
+            link_default = (probe.features & IORING_FEAT_CQE_SKIP) != 0;
+        }
+        printf("Auto mode: linked send/recv %s\n", link_default ? "on" : "off");
+    }
+    // 事件循环的等待策略：自旋上限、NAPI 忙轮询时间和每次阻塞的上限
+    set_wait_strategy(env_unsigned("RINGMASTER_SPIN_US", WAIT_DEFAULT_SPIN_US),
+                      env_unsigned("RINGMASTER_NAPI_US", WAIT_DEFAULT_NAPI_US),
+                      env_unsigned("RINGMASTER_MAX_SLEEP_MS", WAIT_DEFAULT_MAX_SLEEP_MS));
+    // RINGMASTER_LINK_SEND_RECV=1 时回复的发送和下一次读取链接提交
+    set_link_send_recv(env_unsigned("RINGMASTER_LINK_SEND_RECV", link_default) != 0);
+    // 过载控制：资源余量低于拒绝阈值时拒绝新连接，低于关闭阈值时暂停接受并关闭空闲连接
+    set_overload_limits(env_unsigned("RINGMASTER_OVERLOAD_REJECT_PCT", ADMISSION_DEFAULT_REJECT_PCT),
+                        env_unsigned("RINGMASTER_OVERLOAD_SHED_PCT", ADMISSION_DEFAULT_SHED_PCT),
+                        env_unsigned("RINGMASTER_MEMORY_LIMIT_MB", ADMISSION_DEFAULT_MEMORY_MB));
+    // 公平调度：每个连接每轮事件循环最多读取的字节数和次数，超出后延后重新读取（0 表示不限制）
+    set_fair_budgets(env_unsigned("RINGMASTER_SCHED_BYTES", SCHED_DEFAULT_BYTE_BUDGET),
+                     env_unsigned("RINGMASTER_SCHED_OPS", SCHED_DEFAULT_OP_BUDGET));
+    // RINGMASTER_CAPTURE=<文件> 记录每个连接的消息时间和大小，RINGMASTER_CAPTURE_PAYLOAD=1 时同时记录内容
+    set_traffic_capture(getenv("RINGMASTER_CAPTURE"), env_unsigned("RINGMASTER_CAPTURE_PAYLOAD", 0) != 0);
+    // RINGMASTER_CPU_STEERING=1 把工作线程绑定到 CPU，=2 同时把新连接引导到接收 CPU 上的工作线程
+    unsigned steering = env_unsigned("RINGMASTER_CPU_STEERING", CPU_STEER_OFF);
+    set_cpu_steering(steering > CPU_STEER_CBPF ? CPU_STEER_CBPF : (CpuSteering)steering);
+    // RINGMASTER_HUGE_PAGES=0 时缓冲区区域只使用普通页
+    set_huge_pages(env_unsigned("RINGMASTER_HUGE_PAGES", 1) != 0);
+    // RINGMASTER_RING_PROBE=0 时以默认设置创建 ring
+    set_ring_flags_probe(env_unsigned("RINGMASTER_RING_PROBE", 1) != 0);
+    // 事件记录器：RINGMASTER_FLIGHT_RECORDER 为每个工作线程保留的事件数（0 关闭），
+    // RINGMASTER_FLIGHT_RECORDER_PATH 为转储文件
+    set_flight_recorder(env_unsigned("RINGMASTER_FLIGHT_RECORDER", RECORDER_DEFAULT_EVENTS),
+                        getenv("RINGMASTER_FLIGHT_RECORDER_PATH"));
+    // 热重启：RINGMASTER_HOT_RESTART 为控制套接字路径，以相同路径启动新进程时接管监听套接字，
+    // 旧进程等待已有连接关闭，最多 RINGMASTER_DRAIN_TIMEOUT_MS 毫秒
+    set_hot_restart(getenv("RINGMASTER_HOT_RESTART"),
+                    env_unsigned("RINGMASTER_DRAIN_TIMEOUT_MS", HOT_RESTART_DEFAULT_DRAIN_MS));
+    // 日志级别（error/warn/info/debug），运行中可通过 resp 模式的 LOGLEVEL 命令修改
+    const char *log_level = getenv("RINGMASTER_LOG_LEVEL");
+    if (log_level && *log_level) {
+        int level = log_parse_level(log_level);
+        if (level < 0) {
+            fprintf(stderr, "Invalid log level: %s\n", log_level);
+            return 1;
+        }
+        log_set_level((LogLevel)level);
+    }
+    // 同时在 Unix 域套接字上提供服务，"seqpacket:" 前缀选择 SOCK_SEQPACKET
+    if (argc == 5) {
+        const char *path = argv[4];
+        int type = SOCK_STREAM;
+        if (strncmp(path, "seqpacket:", 10) == 0) {
+            path += 10;
+            type = SOCK_SEQPACKET;
+        }
+        set_unix_listener(path, type);
+    }
+
+    if (argc >= 3 && strcmp(argv[2], "resp") == 0) {
+        // Redis 协议模式，内置 GET/SET 等命令
+        set_on_data(resp_on_data);
+        resp_register_command("INFO", -1, cmd_info);
+        resp_register_command("FLIGHTDUMP", 1, cmd_flightdump);
+        resp_register_command("LOGLEVEL", -1, cmd_loglevel);
+    } else if (argc >= 3 && strcmp(argv[2], "offload") == 0) {
+        // 在线程池中处理请求，每个 CPU 核心一个工作线程
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        set_offload_threads(cpus > 0 ? (int)cpus : 1);
+        set_on_data(on_data_offload_handler);
+    } else if (argc >= 3 && strcmp(argv[2], "static") == 0) {
+        // HTTP 静态文件模式，发送当前目录下的文件
+        set_on_data(on_data_static_handler);
+    } else if (argc >= 3 && strcmp(argv[2], "journal") == 0) {
+        // 追加日志模式，演示组提交
+        set_on_data(on_data_journal_handler);
+    } else if (argc >= 3 && strcmp(argv[2], "coro") == 0) {
+        // 协程回显，每个连接一个无栈协程
+        coro_idle_timeout_ms = env_unsigned("RINGMASTER_IDLE_TIMEOUT_MS", coro_idle_timeout_ms);
+        set_coroutine_handler(echo_coroutine, sizeof(EchoFrame));
+    } else if (argc >= 3 && strcmp(argv[2], "pubsub") == 0) {
+        // 发布订阅：RINGMASTER_PUBSUB_QUEUE 为每个订阅者最多排队的消息数，RINGMASTER_PUBSUB_BATCH 为一次发送
+        // 最多合并的消息数，RINGMASTER_PUBSUB_POLICY 为队列满时的策略（disconnect、drop 或 coalesce）
+        PubsubConfig pubsub = {
+            .queue_limit = env_unsigned("RINGMASTER_PUBSUB_QUEUE", PUBSUB_DEFAULT_QUEUE_LIMIT),
+            .batch_messages = env_unsigned("RINGMASTER_PUBSUB_BATCH", PUBSUB_DEFAULT_BATCH),
+            .slow_policy = PUBSUB_SLOW_DISCONNECT,
+        };
+        const char *policy = getenv("RINGMASTER_PUBSUB_POLICY");
+        if (policy && strcmp(policy, "drop") == 0) {
+            pubsub.slow_policy = PUBSUB_SLOW_DROP;
+        } else if (policy && strcmp(policy, "coalesce") == 0) {
+            pubsub.slow_policy = PUBSUB_SLOW_COALESCE;
+        } else if (policy && *policy && strcmp(policy, "disconnect") != 0) {
+            fprintf(stderr, "Invalid pub/sub policy: %s\n", policy);
+            return 1;
+        }
+        set_pubsub(&pubsub);
+        set_on_data(on_data_pubsub_handler);
+    } else if (argc >= 3 && strcmp(argv[2], "udp") == 0) {
+        // 在同一端口上同时提供 TCP 和 UDP 回显
+        set_on_data(on_data_handler);
+        set_on_datagram(on_datagram_handler);
+    } else if (argc >= 3 && (strncmp(argv[2], "proxy:", 6) == 0 || strncmp(argv[2], "proxy-copy:", 11) == 0)) {
+        // 四层代理模式：转发到上游，proxy-copy 经用户态缓冲区复制，用于与 splice 对比
+        int copy = argv[2][5] == '-';
+        if (parse_upstream(strchr(argv[2], ':') + 1, &upstream) != 0) {
+            fprintf(stderr, "Invalid upstream: %s\n", argv[2]);
+            return 1;
+        }
+        set_proxy_upstream(&upstream, PROXY_CONNECT_TIMEOUT_MS, copy);
+    } else if (argc >= 3 && strcmp(argv[2], "echo") != 0) {
+        fprintf(stderr, "Unknown mode: %s\n", argv[2]);
+        return 1;
+    } else {
+        set_on_data(on_data_handler);
+    }
 
     // 启动服务器
     return start_server(port);
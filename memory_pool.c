@@ -6,17 +6,27 @@
 
 #define MAX(a, b) ((a) > (b) ? (a) : (b))
 
-// 内存块结构
+// 内存池增长时一次分配的块数
+#define MEMORY_POOL_GROW_BLOCKS 64
+
+// 内存块结构（只在块空闲时使用）
 typedef struct MemoryBlock {
     struct MemoryBlock* next;
 } MemoryBlock;
 
+// 块从单独分配的内存段中连续切分，段头串成链表，销毁时逐段释放。
+// 段头与块分开，已分配的块被使用者覆盖后不影响释放
+typedef struct MemorySlab {
+    struct MemorySlab* next;
+} MemorySlab;
+
 // 内存池结构
 struct MemoryPool {
     size_t block_size;
     size_t alignment;
     MemoryBlock* free_blocks;
-    MemoryBlock* all_blocks;  // 跟踪所有分配的块
+    MemorySlab* slabs;        // 单独分配的内存段（不含 arena 中的初始块）
+    Arena* arena;             // 初始块所在的区域，为 NULL 表示全部单独分配
     pthread_mutex_t lock;
 };
 
@@ -25,8 +35,33 @@ static size_t align_size(size_t size, size_t alignment) {
     return (size + alignment - 1) & ~(alignment - 1);
 }
 
+// 把 count 个连续的块加入空闲列表
+static void push_blocks(MemoryPool* pool, char* base, size_t count) {
+    for (size_t i = count; i > 0; i--) {
+        MemoryBlock* mb = (MemoryBlock*)(base + (i - 1) * pool->block_size);
+        mb->next = pool->free_blocks;
+        pool->free_blocks = mb;
+    }
+}
+
+// 分配一个包含 count 个块的内存段，块加入空闲列表
+static int add_slab(MemoryPool* pool, size_t count) {
+    size_t header = align_size(sizeof(MemorySlab), pool->alignment);
+    MemorySlab* slab = aligned_alloc(pool->alignment, header + pool->block_size * count);
+    if (!slab) return -1;
+    slab->next = pool->slabs;
+    pool->slabs = slab;
+    push_blocks(pool, (char*)slab + header, count);
+    return 0;
+}
+
 // 创建内存池
 MemoryPool* memory_pool_create(size_t block_size, size_t initial_blocks, size_t alignment) {
+    return memory_pool_create_in(NULL, block_size, initial_blocks, alignment);
+}
+
+// 在区域中创建内存池
+MemoryPool* memory_pool_create_in(Arena* arena, size_t block_size, size_t initial_blocks, size_t alignment) {
     MemoryPool* pool = malloc(sizeof(MemoryPool));
     if (!pool) return NULL;
 
@@ -37,7 +72,8 @@ MemoryPool* memory_pool_create(size_t block_size, size_t initial_blocks, size_t
     pool->block_size = align_size(MAX(block_size, sizeof(MemoryBlock)), alignment);
     pool->alignment = alignment;
     pool->free_blocks = NULL;
-    pool->all_blocks = NULL;
+    pool->slabs = NULL;
+    pool->arena = arena;
 
     // 初始化互斥锁
     if (pthread_mutex_init(&pool->lock, NULL) != 0) {
@@ -45,21 +81,17 @@ MemoryPool* memory_pool_create(size_t block_size, size_t initial_blocks, size_t
         return NULL;
     }
 
-    // 预分配初始块
-    for (size_t i = 0; i < initial_blocks; i++) {
-        void* block = aligned_alloc(alignment, pool->block_size);
-        if (!block) {
-            memory_pool_destroy(pool);
-            return NULL;
-        }
-        MemoryBlock* mb = (MemoryBlock*)block;
-        mb->next = pool->free_blocks;
-        pool->free_blocks = mb;
+    // 初始块从区域中连续切分，由区域统一释放
+    char* base = arena ? arena_alloc(arena, pool->block_size * initial_blocks, alignment) : NULL;
+    if (base) {
+        push_blocks(pool, base, initial_blocks);
+        return pool;
+    }
 
-        // 添加到 all_blocks 列表
-        MemoryBlock* all_mb = (MemoryBlock*)block;
-        all_mb->next = pool->all_blocks;
-        pool->all_blocks = all_mb;
+    // 预分配初始块
+    if (initial_blocks > 0 && add_slab(pool, initial_blocks) != 0) {
+        memory_pool_destroy(pool);
+        return NULL;
     }
 
     return pool;
@@ -69,18 +101,10 @@ MemoryPool* memory_pool_create(size_t block_size, size_t initial_blocks, size_t
 void* memory_pool_alloc(MemoryPool* pool) {
     pthread_mutex_lock(&pool->lock);
 
-    if (!pool->free_blocks) {
-        // 如果没有空闲块，分配一个新的
-        void* new_block = aligned_alloc(pool->alignment, pool->block_size);
-        if (!new_block) {
-            pthread_mutex_unlock(&pool->lock);
-            return NULL;
-        }
-        MemoryBlock* mb = (MemoryBlock*)new_block;
-        mb->next = pool->all_blocks;  // 添加到 all_blocks 列表
-        pool->all_blocks = mb;
+    // 没有空闲块时分配一个新的内存段
+    if (!pool->free_blocks && add_slab(pool, MEMORY_POOL_GROW_BLOCKS) != 0) {
         pthread_mutex_unlock(&pool->lock);
-        return new_block;
+        return NULL;
     }
 
     // 从空闲列表中取出一个块
@@ -109,12 +133,12 @@ void memory_pool_free(MemoryPool* pool, void* ptr) {
 void memory_pool_destroy(MemoryPool* pool) {
     pthread_mutex_lock(&pool->lock);
 
-    // 释放所有分配的块
-    MemoryBlock* block = pool->all_blocks;
-    while (block) {
-        MemoryBlock* next = block->next;
-        free(block);
-        block = next;
+    // 释放所有内存段
+    MemorySlab* slab = pool->slabs;
+    while (slab) {
+        MemorySlab* next = slab->next;
+        free(slab);
+        slab = next;
     }
 
     pthread_mutex_unlock(&pool->lock);
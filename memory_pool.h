@@ -2,6 +2,7 @@
 #define MEMORY_POOL_H
 
 #include <stddef.h>
+#include "arena.h"
 
 // 内存池类型
 typedef struct MemoryPool MemoryPool;
@@ -9,6 +10,10 @@ typedef struct MemoryPool MemoryPool;
 // 创建内存池
 MemoryPool* memory_pool_create(size_t block_size, size_t initial_blocks, size_t alignment);
 
+// 创建内存池，初始块从 arena 中连续切分（arena 空间不足时单独分配），之后按段增长
+// arena 必须在内存池销毁之后才能销毁
+MemoryPool* memory_pool_create_in(Arena* arena, size_t block_size, size_t initial_blocks, size_t alignment);
+
 // 从内存池分配内存
 void* memory_pool_alloc(MemoryPool* pool);
 
@@ -0,0 +1,56 @@
+#include "mpsc_queue.h"
+
+// 初始化队列
+void mpsc_queue_init(MpscQueue* q) {
+    atomic_init(&q->stub.next, NULL);
+    atomic_init(&q->head, &q->stub);
+    q->tail = &q->stub;
+}
+
+// 入队：交换生产者端指针后再链接前驱，整个过程只有一次原子交换
+void mpsc_queue_push(MpscQueue* q, MpscNode* node) {
+    atomic_store_explicit(&node->next, NULL, memory_order_relaxed);
+    MpscNode* prev = atomic_exchange_explicit(&q->head, node, memory_order_acq_rel);
+    atomic_store_explicit(&prev->next, node, memory_order_release);
+}
+
+// 出队
+MpscNode* mpsc_queue_pop(MpscQueue* q) {
+    MpscNode* tail = q->tail;
+    MpscNode* next = atomic_load_explicit(&tail->next, memory_order_acquire);
+
+    // 跳过占位节点
+    if (tail == &q->stub) {
+        if (next == NULL) {
+            return NULL;
+        }
+        q->tail = next;
+        tail = next;
+        next = atomic_load_explicit(&tail->next, memory_order_acquire);
+    }
+
+    if (next != NULL) {
+        q->tail = next;
+        return tail;
+    }
+
+    // tail 是最后一个节点：若生产者尚未完成链接，稍后再取
+    if (tail != atomic_load_explicit(&q->head, memory_order_acquire)) {
+        return NULL;
+    }
+
+    // 重新放入占位节点，使 tail 可以被安全取出
+    mpsc_queue_push(q, &q->stub);
+    next = atomic_load_explicit(&tail->next, memory_order_acquire);
+    if (next != NULL) {
+        q->tail = next;
+        return tail;
+    }
+    return NULL;
+}
+
+// 判断队列是否为空
+int mpsc_queue_empty(MpscQueue* q) {
+    return q->tail == &q->stub &&
+           atomic_load_explicit(&q->stub.next, memory_order_acquire) == NULL;
+}
\ No newline at end of file
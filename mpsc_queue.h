@@ -0,0 +1,37 @@
+#ifndef MPSC_QUEUE_H
+#define MPSC_QUEUE_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+// 侵入式多生产者单消费者无锁队列节点，嵌入到元素结构体中使用
+typedef struct MpscNode {
+    _Atomic(struct MpscNode*) next;
+} MpscNode;
+
+// 多生产者单消费者无锁队列（Vyukov 算法）
+// 任意线程都可以 push，只有一个线程可以 pop
+typedef struct {
+    _Atomic(MpscNode*) head;  // 生产者端
+    MpscNode* tail;           // 消费者端
+    MpscNode stub;
+} MpscQueue;
+
+// 由节点指针得到所在元素的指针
+#define mpsc_entry(node, type, member) \
+    ((type*)((char*)(node) - offsetof(type, member)))
+
+// 初始化队列
+void mpsc_queue_init(MpscQueue* q);
+
+// 入队，可在任意线程调用
+void mpsc_queue_push(MpscQueue* q, MpscNode* node);
+
+// 出队，只能在消费者线程调用
+// 返回: 队首节点，队列为空（或生产者正在入队的中间状态）时返回 NULL
+MpscNode* mpsc_queue_pop(MpscQueue* q);
+
+// 判断队列是否为空，只能在消费者线程调用
+int mpsc_queue_empty(MpscQueue* q);
+
+#endif // MPSC_QUEUE_H
\ No newline at end of file
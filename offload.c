@@ -0,0 +1,268 @@
+#include "offload.h"
+#include "mpsc_queue.h"
+#include "memory_pool.h"
+#include "resource_manager.h"
+#include "error.h"
+#include "logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/eventfd.h>
+
+// 卸载任务
+typedef struct OffloadJob {
+    MpscNode node;
+    offload_work_fn work;
+    offload_done_fn done;
+    void *arg;
+    struct connection *conn;
+    uint64_t conn_id;
+    int fd;
+} OffloadJob;
+
+// 工作线程
+typedef struct {
+    pthread_t thread;
+    MpscQueue queue;       // 待执行任务，事件循环生产、本线程消费
+    int event_fd;          // 空闲时阻塞在此 eventfd 上
+    atomic_int sleeping;
+    OffloadPool *pool;
+    int started;
+} OffloadWorker;
+
+struct OffloadPool {
+    OffloadWorker *workers;
+    int worker_count;
+    unsigned next_worker;
+
+    MpscQueue done_queue;     // 已完成任务，工作线程生产、事件循环消费
+    int done_fd;              // 完成通知 eventfd，由 ring 上的读请求监听
+    atomic_int done_notified; // 已写入 eventfd 但事件循环尚未处理
+    uint64_t done_value;      // eventfd 读请求的目标缓冲区
+    struct completion_handler handler;
+
+    MemoryPool *job_pool;     // 任务只在事件循环线程中分配和释放
+    atomic_int stopping;
+    int armed;
+};
+
+static void notify_fd(int fd) {
+    uint64_t one = 1;
+    ssize_t ret;
+    do {
+        ret = write(fd, &one, sizeof(one));
+    } while (ret < 0 && errno == EINTR);
+}
+
+static void drain_fd(int fd) {
+    uint64_t value;
+    ssize_t ret;
+    do {
+        ret = read(fd, &value, sizeof(value));
+    } while (ret < 0 && errno == EINTR);
+}
+
+// 工作线程主循环
+static void* worker_main(void *arg) {
+    OffloadWorker *worker = arg;
+    OffloadPool *pool = worker->pool;
+
+    while (!atomic_load(&pool->stopping)) {
+        MpscNode *node = mpsc_queue_pop(&worker->queue);
+        if (!node) {
+            // 先声明进入睡眠再检查队列，避免与生产者的通知竞争
+            atomic_store(&worker->sleeping, 1);
+            if (!mpsc_queue_empty(&worker->queue) || atomic_load(&pool->stopping)) {
+                atomic_store(&worker->sleeping, 0);
+                continue;
+            }
+            drain_fd(worker->event_fd);
+            atomic_store(&worker->sleeping, 0);
+            continue;
+        }
+
+        OffloadJob *job = mpsc_entry(node, OffloadJob, node);
+        if (job->work) {
+            job->work(job->arg);
+        }
+
+        // 交回事件循环，连续完成的任务只通知一次
+        mpsc_queue_push(&pool->done_queue, &job->node);
+        if (!atomic_exchange(&pool->done_notified, 1)) {
+            notify_fd(pool->done_fd);
+        }
+    }
+    return NULL;
+}
+
+// 挂起 eventfd 读请求
+static int arm_done_fd(OffloadPool *pool, struct io_uring *ring) {
+    struct io_uring_sqe *sqe = io_uring_get_sqe(ring);
+    if (!sqe) {
+        handle_error(ERR_URING_QUEUE_FULL, "Could not get SQE for offload completion");
+        return -1;
+    }
+    io_uring_prep_read(sqe, pool->done_fd, &pool->done_value, sizeof(pool->done_value), 0);
+    sqe_set_completion_handler(sqe, &pool->handler);
+    pool->armed = 1;
+    return 0;
+}
+
+// 在事件循环线程中执行任务的完成回调
+static void complete_job(OffloadPool *pool, ResourceManager *rm, OffloadJob *job) {
+    struct connection *conn = job->conn ? connection_alive(rm, job->conn, job->fd, job->conn_id) : NULL;
+
+    if (job->done) {
+        job->done(conn, job->arg, rm);
+    }
+    memory_pool_free(pool->job_pool, job);
+
+    if (conn && --conn->pending_jobs == 0) {
+        resume_connection(rm, conn);
+    }
+}
+
+// eventfd 读请求完成：处理所有已完成的任务并重新挂起读请求
+static void on_done_fd_ready(struct completion_handler *handler, struct io_uring_cqe *cqe, ResourceManager *rm) {
+    OffloadPool *pool = (OffloadPool*)((char*)handler - offsetof(OffloadPool, handler));
+    pool->armed = 0;
+
+    if (cqe->res < 0 && cqe->res != -EINTR && cqe->res != -EAGAIN) {
+        log_error("Offload completion read failed: %s", strerror(-cqe->res));
+        if (cqe->res == -ECANCELED) {
+            return;
+        }
+    }
+
+    // 先清除通知标记再处理队列，之后完成的任务会重新写入 eventfd
+    atomic_store(&pool->done_notified, 0);
+
+    MpscNode *node;
+    while ((node = mpsc_queue_pop(&pool->done_queue)) != NULL) {
+        complete_job(pool, rm, mpsc_entry(node, OffloadJob, node));
+    }
+
+    if (!atomic_load(&pool->stopping)) {
+        arm_done_fd(pool, rm->ring);
+    }
+}
+
+// 创建线程池
+OffloadPool* offload_pool_create(int threads) {
+    if (threads <= 0) {
+        handle_error(ERR_INVALID_ARGUMENT, "Offload pool requires at least one thread");
+        return NULL;
+    }
+
+    OffloadPool *pool = calloc(1, sizeof(OffloadPool));
+    if (!pool) {
+        return NULL;
+    }
+
+    mpsc_queue_init(&pool->done_queue);
+    atomic_init(&pool->done_notified, 0);
+    atomic_init(&pool->stopping, 0);
+    pool->handler.on_complete = on_done_fd_ready;
+    pool->done_fd = eventfd(0, EFD_CLOEXEC);
+    pool->job_pool = memory_pool_create(sizeof(OffloadJob), 256, 64);
+    pool->workers = calloc(threads, sizeof(OffloadWorker));
+    if (pool->done_fd < 0 || !pool->job_pool || !pool->workers) {
+        offload_pool_destroy(pool, NULL);
+        return NULL;
+    }
+
+    for (int i = 0; i < threads; i++) {
+        OffloadWorker *worker = &pool->workers[i];
+        mpsc_queue_init(&worker->queue);
+        atomic_init(&worker->sleeping, 0);
+        worker->pool = pool;
+        worker->event_fd = eventfd(0, EFD_CLOEXEC);
+        if (worker->event_fd < 0) {
+            offload_pool_destroy(pool, NULL);
+            return NULL;
+        }
+        pool->worker_count++;
+        if (pthread_create(&worker->thread, NULL, worker_main, worker) != 0) {
+            offload_pool_destroy(pool, NULL);
+            return NULL;
+        }
+        worker->started = 1;
+    }
+
+    return pool;
+}
+
+// 挂起完成通知读请求
+int offload_pool_start(OffloadPool *pool, ResourceManager *rm) {
+    return arm_done_fd(pool, rm->ring);
+}
+
+// 停止并释放线程池
+void offload_pool_destroy(OffloadPool *pool, ResourceManager *rm) {
+    if (!pool) return;
+
+    atomic_store(&pool->stopping, 1);
+    for (int i = 0; i < pool->worker_count; i++) {
+        OffloadWorker *worker = &pool->workers[i];
+        if (worker->started) {
+            notify_fd(worker->event_fd);
+            pthread_join(worker->thread, NULL);
+        }
+    }
+
+    // 尚未执行或未交回的任务不再执行，仅回调 done 释放参数
+    for (int i = 0; i < pool->worker_count; i++) {
+        MpscNode *node;
+        while ((node = mpsc_queue_pop(&pool->workers[i].queue)) != NULL) {
+            mpsc_queue_push(&pool->done_queue, node);
+        }
+        close(pool->workers[i].event_fd);
+    }
+    MpscNode *node;
+    while ((node = mpsc_queue_pop(&pool->done_queue)) != NULL) {
+        OffloadJob *job = mpsc_entry(node, OffloadJob, node);
+        if (job->done) {
+            job->done(NULL, job->arg, rm);
+        }
+    }
+
+    if (pool->done_fd >= 0) close(pool->done_fd);
+    if (pool->job_pool) memory_pool_destroy(pool->job_pool);
+    free(pool->workers);
+    free(pool);
+}
+
+// 提交任务
+int offload_submit(ResourceManager *rm, struct connection *conn,
+                   offload_work_fn work, offload_done_fn done, void *arg) {
+    OffloadPool *pool = rm->offload_pool;
+    if (!pool) {
+        return -1;
+    }
+
+    OffloadJob *job = memory_pool_alloc(pool->job_pool);
+    if (!job) {
+        return -1;
+    }
+    job->work = work;
+    job->done = done;
+    job->arg = arg;
+    job->conn = conn;
+    job->conn_id = conn ? conn->id : 0;
+    job->fd = conn ? conn->fd : -1;
+
+    // 轮询选择工作线程，只在线程睡眠时才需要系统调用唤醒
+    OffloadWorker *worker = &pool->workers[pool->next_worker++ % (unsigned)pool->worker_count];
+    if (conn) {
+        conn->pending_jobs++;
+    }
+    mpsc_queue_push(&worker->queue, &job->node);
+    if (atomic_exchange(&worker->sleeping, 0)) {
+        notify_fd(worker->event_fd);
+    }
+    return 0;
+}
\ No newline at end of file
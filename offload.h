@@ -0,0 +1,33 @@
+#ifndef OFFLOAD_H
+#define OFFLOAD_H
+
+#include "iouring_server.h"
+
+// 卸载任务线程池类型
+typedef struct OffloadPool OffloadPool;
+
+// 在工作线程中执行的任务函数
+typedef void (*offload_work_fn)(void *arg);
+
+// 任务完成后在事件循环线程中执行的回调
+// conn 为 NULL 表示提交时未传入连接，或连接已在任务执行期间关闭（此时只需释放 arg）
+typedef void (*offload_done_fn)(struct connection *conn, void *arg, struct ResourceManager *rm);
+
+// 创建线程池并启动 threads 个工作线程
+OffloadPool* offload_pool_create(int threads);
+
+// 在事件循环的 ring 上挂起完成通知的 eventfd 读请求
+int offload_pool_start(OffloadPool *pool, struct ResourceManager *rm);
+
+// 停止工作线程并释放线程池，未完成的任务以 conn 为 NULL 回调 done
+void offload_pool_destroy(OffloadPool *pool, struct ResourceManager *rm);
+
+// 从 on_data 回调中提交任务
+// work 在工作线程中执行；done 在事件循环线程中执行，可向连接写缓冲区写入结果
+// conn 不为 NULL 时任务完成前连接暂停收发，完成后自动发送写缓冲区中的数据并继续读取
+// on_data 传入的数据缓冲区在返回后会被复用，任务需要的数据应复制到 arg 中
+// 返回: 成功返回 0，线程池未启用或内存不足返回 -1（调用者可改为同步处理）
+int offload_submit(struct ResourceManager *rm, struct connection *conn,
+                   offload_work_fn work, offload_done_fn done, void *arg);
+
+#endif // OFFLOAD_H
\ No newline at end of file
@@ -0,0 +1,451 @@
+#define _GNU_SOURCE
+#include "proxy.h"
+#include "resource_manager.h"
+#include "error.h"
+#include "logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+
+typedef struct ProxySession ProxySession;
+
+// 单向转发：from 套接字 -> 管道（复制模式下为用户态缓冲区）-> to 套接字
+typedef struct {
+    struct completion_handler ready_done;   // 等待可读/可写完成
+    struct completion_handler fill_done;    // from -> 管道完成
+    struct completion_handler drain_done;   // 管道 -> to 完成
+    ProxySession *session;
+    int from;
+    int to;
+    int pipe_fds[2];
+    char *buffer;          // 复制模式使用的缓冲区
+    size_t staged;         // 已读入但尚未发出的字节数
+    size_t staged_pos;     // 复制模式下待发送数据在缓冲区中的起点
+    int inflight;          // 尚未返回的请求数
+    int wait_readable;     // 套接字已读空，下次读取前先等待可读
+    int wait_writable;     // 上次 splice 到套接字返回 EAGAIN
+    int eof;               // from 已读到 EOF
+    int done;              // EOF 已转发给 to（半关闭），此方向结束
+} ProxyFlow;
+
+// 一个被代理的连接
+struct ProxySession {
+    struct completion_handler connect_done;
+    struct completion_handler timeout_done;
+    ProxyServer *proxy;
+    struct connection *conn;
+    int upstream;
+    int inflight;          // 连接阶段尚未返回的请求数
+    int connected;
+    int failed;
+    struct __kernel_timespec timeout;
+    ProxyFlow flows[2];    // [0] 客户端 -> 上游，[1] 上游 -> 客户端
+    ProxySession *prev;
+    ProxySession *next;
+};
+
+struct ProxyServer {
+    ResourceManager *rm;
+    ProxyConfig config;
+    int use_splice;
+    int pipes[PROXY_PIPE_POOL_SIZE][2];
+    int pipe_count;
+    ProxySession *sessions;   // 进行中的会话，销毁时释放
+};
+
+// 取得一个空管道，池为空时新建
+static int pipe_get(ProxyServer *proxy, int fds[2]) {
+    if (proxy->pipe_count > 0) {
+        proxy->pipe_count--;
+        fds[0] = proxy->pipes[proxy->pipe_count][0];
+        fds[1] = proxy->pipes[proxy->pipe_count][1];
+        return 0;
+    }
+    if (pipe2(fds, O_CLOEXEC) != 0) {
+        return -errno;
+    }
+    fcntl(fds[1], F_SETPIPE_SZ, PROXY_PIPE_SIZE);
+    return 0;
+}
+
+// 归还管道；管道中残留数据（会话出错时）或池已满时直接关闭
+static void pipe_put(ProxyServer *proxy, int fds[2], int dirty) {
+    if (dirty || proxy->pipe_count >= PROXY_PIPE_POOL_SIZE) {
+        close(fds[0]);
+        close(fds[1]);
+    } else {
+        proxy->pipes[proxy->pipe_count][0] = fds[0];
+        proxy->pipes[proxy->pipe_count][1] = fds[1];
+        proxy->pipe_count++;
+    }
+    fds[0] = fds[1] = -1;
+}
+
+// 释放会话占用的管道、缓冲区和上游套接字
+static void session_release(ProxySession *s) {
+    for (int i = 0; i < 2; i++) {
+        ProxyFlow *f = &s->flows[i];
+        if (f->pipe_fds[0] >= 0) {
+            pipe_put(s->proxy, f->pipe_fds, s->failed || f->staged > 0);
+        }
+        free(f->buffer);
+    }
+    if (s->upstream >= 0) {
+        close(s->upstream);
+    }
+}
+
+// 创建代理服务器
+ProxyServer* proxy_create(ResourceManager *rm, const ProxyConfig *config) {
+    ProxyServer *proxy = calloc(1, sizeof(ProxyServer));
+    if (!proxy) {
+        return NULL;
+    }
+    proxy->rm = rm;
+    proxy->config = *config;
+
+    // 探测 splice 支持，不支持时改用用户态复制
+    if (!config->copy) {
+        struct io_uring_probe *probe = io_uring_get_probe_ring(rm->ring);
+        if (probe) {
+            proxy->use_splice = io_uring_opcode_supported(probe, IORING_OP_SPLICE);
+            io_uring_free_probe(probe);
+        }
+    }
+    return proxy;
+}
+
+// 销毁代理服务器（客户端连接随连接表一起关闭）
+void proxy_destroy(ProxyServer *proxy) {
+    if (!proxy) return;
+
+    while (proxy->sessions) {
+        ProxySession *s = proxy->sessions;
+        proxy->sessions = s->next;
+        s->failed = 1;
+        session_release(s);
+        free(s);
+    }
+    for (int i = 0; i < proxy->pipe_count; i++) {
+        close(proxy->pipes[i][0]);
+        close(proxy->pipes[i][1]);
+    }
+    free(proxy);
+}
+
+// 结束会话：关闭上游和客户端连接
+static void finish_session(ProxySession *s) {
+    ProxyServer *proxy = s->proxy;
+    struct connection *conn = s->conn;
+
+    session_release(s);
+    if (s->prev) s->prev->next = s->next;
+    else proxy->sessions = s->next;
+    if (s->next) s->next->prev = s->prev;
+    free(s);
+
+    conn->pending_jobs--;
+    close_connection(proxy->rm, conn);
+}
+
+// 会话出错：关闭两端的读写方向，使挂起的等待和搬运请求尽快返回
+static void fail_session(ProxySession *s) {
+    if (s->failed) return;
+    s->failed = 1;
+    shutdown(s->conn->fd, SHUT_RDWR);
+    if (s->connected) {
+        shutdown(s->upstream, SHUT_RDWR);
+    }
+}
+
+// 所有请求都已返回、且两个方向都已结束（或会话出错）时结束会话
+static void check_session(ProxySession *s) {
+    if (s->inflight > 0 || s->flows[0].inflight > 0 || s->flows[1].inflight > 0) {
+        return;
+    }
+    if (s->failed || (s->flows[0].done && s->flows[1].done)) {
+        finish_session(s);
+    }
+}
+
+// 提交此方向的下一步：发出已读入的数据 -> 转发 EOF -> 读取下一块
+// 返回: 已提交返回 1，此方向结束返回 0，无法获取 SQE 返回 -1
+static int flow_submit(ProxyFlow *f) {
+    ProxyServer *proxy = f->session->proxy;
+    struct io_uring *ring = proxy->rm->ring;
+
+    // 等待和搬运以链接请求提交，需要一次取得两个 SQE
+    if (io_uring_sq_space_left(ring) < 2) {
+        io_uring_submit(ring);
+        if (io_uring_sq_space_left(ring) < 2) {
+            return -1;
+        }
+    }
+
+    if (f->staged > 0) {
+        struct io_uring_sqe *sqe;
+        f->inflight = 1;
+        if (proxy->use_splice) {
+            // 套接字是非阻塞的，splice 在发送缓冲区满时返回 EAGAIN，补发前先等待可写
+            if (f->wait_writable) {
+                sqe = io_uring_get_sqe(ring);
+                io_uring_prep_poll_add(sqe, f->to, POLLOUT);
+                sqe->flags |= IOSQE_IO_LINK;
+                sqe_set_completion_handler(sqe, &f->ready_done);
+                f->wait_writable = 0;
+                f->inflight = 2;
+            }
+            sqe = io_uring_get_sqe(ring);
+            io_uring_prep_splice(sqe, f->pipe_fds[0], -1, f->to, -1, (unsigned)f->staged, 0);
+        } else {
+            sqe = io_uring_get_sqe(ring);
+            io_uring_prep_send(sqe, f->to, f->buffer + f->staged_pos, f->staged, MSG_NOSIGNAL);
+        }
+        sqe_set_completion_handler(sqe, &f->drain_done);
+        return 1;
+    }
+
+    if (f->eof) {
+        // 半关闭：把 EOF 转发给另一端，反方向继续转发直到其也结束
+        shutdown(f->to, SHUT_WR);
+        return 0;
+    }
+
+    struct io_uring_sqe *sqe;
+    f->inflight = 1;
+    if (proxy->use_splice) {
+        // 上次已把套接字读空时先等待可读，避免 splice 立即返回 EAGAIN
+        if (f->wait_readable) {
+            sqe = io_uring_get_sqe(ring);
+            io_uring_prep_poll_add(sqe, f->from, POLLIN);
+            sqe->flags |= IOSQE_IO_LINK;
+            sqe_set_completion_handler(sqe, &f->ready_done);
+            f->inflight = 2;
+        }
+        sqe = io_uring_get_sqe(ring);
+        io_uring_prep_splice(sqe, f->from, -1, f->pipe_fds[1], -1, PROXY_CHUNK_SIZE, 0);
+    } else {
+        sqe = io_uring_get_sqe(ring);
+        io_uring_prep_recv(sqe, f->from, f->buffer, PROXY_CHUNK_SIZE, 0);
+    }
+    sqe_set_completion_handler(sqe, &f->fill_done);
+    return 1;
+}
+
+// 此方向的所有请求返回后推进转发
+static void flow_advance(ProxyFlow *f) {
+    ProxySession *s = f->session;
+    if (!s->failed && !f->done) {
+        int ret = flow_submit(f);
+        if (ret > 0) {
+            return;
+        }
+        if (ret < 0) {
+            handle_error(ERR_URING_QUEUE_FULL, "Could not get SQE for proxy");
+            fail_session(s);
+        } else {
+            f->done = 1;
+        }
+    }
+    check_session(s);
+}
+
+// 等待可读/可写完成，链接的搬运请求随后执行
+static void on_flow_ready(struct completion_handler *handler, struct io_uring_cqe *cqe, ResourceManager *rm) {
+    (void)rm;
+    ProxyFlow *f = (ProxyFlow*)((char*)handler - offsetof(ProxyFlow, ready_done));
+    f->inflight--;
+    if (cqe->res < 0) {
+        fail_session(f->session);
+    }
+    if (f->inflight == 0) {
+        flow_advance(f);
+    }
+}
+
+// 从 from 读入完成
+static void on_flow_fill(struct completion_handler *handler, struct io_uring_cqe *cqe, ResourceManager *rm) {
+    (void)rm;
+    ProxyFlow *f = (ProxyFlow*)((char*)handler - offsetof(ProxyFlow, fill_done));
+    f->inflight--;
+
+    if (cqe->res == -EAGAIN) {
+        f->wait_readable = 1;
+    } else if (cqe->res == -ECANCELED) {
+        // 链接的等待请求失败，由 on_flow_ready 处理
+    } else if (cqe->res == 0) {
+        f->eof = 1;
+    } else if (cqe->res < 0) {
+        fail_session(f->session);
+    } else {
+        f->staged = cqe->res;
+        f->staged_pos = 0;
+        // 未读满一块说明套接字已读空，下次先等待可读
+        f->wait_readable = cqe->res < PROXY_CHUNK_SIZE;
+    }
+
+    if (f->inflight == 0) {
+        flow_advance(f);
+    }
+}
+
+// 发送到 to 完成
+static void on_flow_drain(struct completion_handler *handler, struct io_uring_cqe *cqe, ResourceManager *rm) {
+    (void)rm;
+    ProxyFlow *f = (ProxyFlow*)((char*)handler - offsetof(ProxyFlow, drain_done));
+    f->inflight--;
+
+    if (cqe->res == -EAGAIN) {
+        f->wait_writable = 1;
+    } else if (cqe->res == -ECANCELED) {
+        // 链接的等待请求失败，由 on_flow_ready 处理
+    } else if (cqe->res <= 0) {
+        fail_session(f->session);
+    } else {
+        f->staged -= cqe->res;
+        f->staged_pos += cqe->res;
+    }
+
+    if (f->inflight == 0) {
+        flow_advance(f);
+    }
+}
+
+// 上游连接建立后开始双向转发
+static void start_flows(ProxySession *s) {
+    ProxyServer *proxy = s->proxy;
+    int ends[2][2] = { { s->conn->fd, s->upstream }, { s->upstream, s->conn->fd } };
+
+    s->connected = 1;
+    if (fcntl(s->upstream, F_SETFL, fcntl(s->upstream, F_GETFL, 0) | O_NONBLOCK) < 0) {
+        goto fail;
+    }
+    for (int i = 0; i < 2; i++) {
+        ProxyFlow *f = &s->flows[i];
+        f->from = ends[i][0];
+        f->to = ends[i][1];
+        f->wait_readable = 1;
+        int ret = 0;
+        if (proxy->use_splice) {
+            ret = pipe_get(proxy, f->pipe_fds);
+        } else if (!(f->buffer = malloc(PROXY_CHUNK_SIZE))) {
+            ret = -ENOMEM;
+        }
+        if (ret < 0) {
+            log_error("Failed to set up proxy flow: %s", strerror(-ret));
+            goto fail;
+        }
+    }
+    for (int i = 0; i < 2; i++) {
+        flow_advance(&s->flows[i]);
+    }
+    return;
+
+fail:
+    // 此时没有进行中的请求，不会再有完成事件结束会话，立即释放已取得的管道或缓冲区、上游和客户端连接
+    fail_session(s);
+    check_session(s);
+}
+
+// 上游连接完成
+static void on_connect_complete(struct completion_handler *handler, struct io_uring_cqe *cqe, ResourceManager *rm) {
+    (void)rm;
+    ProxySession *s = (ProxySession*)((char*)handler - offsetof(ProxySession, connect_done));
+    s->inflight--;
+    if (cqe->res < 0) {
+        // 被链接的超时取消时返回 ECANCELED
+        log_warn("Upstream connect failed: %s", cqe->res == -ECANCELED ? "timed out" : strerror(-cqe->res));
+        s->failed = 1;
+    }
+    if (s->inflight > 0) {
+        return;
+    }
+    if (s->failed) {
+        check_session(s);
+    } else {
+        start_flows(s);
+    }
+}
+
+// 连接超时请求完成（超时触发，或连接先完成而被取消）
+static void on_connect_timeout(struct completion_handler *handler, struct io_uring_cqe *cqe, ResourceManager *rm) {
+    (void)cqe;
+    (void)rm;
+    ProxySession *s = (ProxySession*)((char*)handler - offsetof(ProxySession, timeout_done));
+    s->inflight--;
+    if (s->inflight > 0) {
+        return;
+    }
+    if (s->failed) {
+        check_session(s);
+    } else {
+        start_flows(s);
+    }
+}
+
+// 接管新连接并连接上游
+int proxy_attach(ResourceManager *rm, struct connection *conn) {
+    ProxyServer *proxy = rm->proxy;
+    if (!proxy || !conn) {
+        return -EINVAL;
+    }
+    if (io_uring_sq_space_left(rm->ring) < 2) {
+        io_uring_submit(rm->ring);
+        if (io_uring_sq_space_left(rm->ring) < 2) {
+            return -EBUSY;
+        }
+    }
+
+    ProxySession *s = calloc(1, sizeof(ProxySession));
+    if (!s) {
+        return -ENOMEM;
+    }
+    s->upstream = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (s->upstream < 0) {
+        int ret = -errno;
+        free(s);
+        return ret;
+    }
+    s->connect_done.on_complete = on_connect_complete;
+    s->timeout_done.on_complete = on_connect_timeout;
+    s->proxy = proxy;
+    s->conn = conn;
+    for (int i = 0; i < 2; i++) {
+        ProxyFlow *f = &s->flows[i];
+        f->ready_done.on_complete = on_flow_ready;
+        f->fill_done.on_complete = on_flow_fill;
+        f->drain_done.on_complete = on_flow_drain;
+        f->session = s;
+        f->pipe_fds[0] = f->pipe_fds[1] = -1;
+    }
+
+    // 连接请求以 IOSQE_IO_LINK 链接超时请求，超时后内核取消连接
+    struct io_uring_sqe *sqe = io_uring_get_sqe(rm->ring);
+    io_uring_prep_connect(sqe, s->upstream, (struct sockaddr*)&proxy->config.upstream,
+                          sizeof(proxy->config.upstream));
+    sqe_set_completion_handler(sqe, &s->connect_done);
+    s->inflight = 1;
+    if (proxy->config.connect_timeout_ms > 0) {
+        sqe->flags |= IOSQE_IO_LINK;
+        s->timeout.tv_sec = proxy->config.connect_timeout_ms / 1000;
+        s->timeout.tv_nsec = (long long)(proxy->config.connect_timeout_ms % 1000) * 1000000;
+        sqe = io_uring_get_sqe(rm->ring);
+        io_uring_prep_link_timeout(sqe, &s->timeout, 0);
+        sqe_set_completion_handler(sqe, &s->timeout_done);
+        s->inflight = 2;
+    }
+
+    s->next = proxy->sessions;
+    if (proxy->sessions) proxy->sessions->prev = s;
+    proxy->sessions = s;
+
+    // 与文件发送相同，以 pending_jobs 暂停连接的常规收发，会话结束时关闭连接
+    conn->pending_jobs++;
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,38 @@
+#ifndef PROXY_H
+#define PROXY_H
+
+#include <netinet/in.h>
+#include "iouring_server.h"
+
+// 每个方向每次搬运的最大字节数（复制模式下为每个方向的缓冲区大小）
+#define PROXY_CHUNK_SIZE 65536
+// 管道容量：每个小报文段占用一个管道槽位，默认的 16 个槽位会限制每次 splice 搬运的字节数
+#define PROXY_PIPE_SIZE (256 * 1024)
+// 每个工作线程保留的空闲管道数
+#define PROXY_PIPE_POOL_SIZE 128
+// 默认的上游连接超时（毫秒）
+#define PROXY_CONNECT_TIMEOUT_MS 3000
+
+// 代理配置
+typedef struct ProxyConfig {
+    struct sockaddr_in upstream;   // 上游地址
+    unsigned connect_timeout_ms;   // 连接超时，0 表示不限制
+    int copy;                      // 以 recv/send 经用户态缓冲区转发，而不是 splice
+} ProxyConfig;
+
+// 代理服务器类型（每个工作线程一个）
+typedef struct ProxyServer ProxyServer;
+
+// 创建代理服务器，并探测内核是否支持 splice（不支持时改为用户态复制）
+ProxyServer* proxy_create(struct ResourceManager *rm, const ProxyConfig *config);
+
+// 销毁代理服务器，关闭上游连接和管道（在 ring 退出后调用）
+void proxy_destroy(ProxyServer *proxy);
+
+// 接管新接受的连接：以 io_uring connect 连接上游，连接成功后双向转发
+// 每个方向通过各自的管道 splice，数据不经过用户态；一个方向读到 EOF 后半关闭另一端的写方向，
+// 两个方向都结束或任一方出错时关闭两端。管道中有未发出的数据时不再读取，由 TCP 窗口向发送方施加背压
+// 返回: 成功返回 0，失败返回 -errno（连接状态不变，由调用者关闭）
+int proxy_attach(struct ResourceManager *rm, struct connection *conn);
+
+#endif // PROXY_H
\ No newline at end of file
@@ -0,0 +1,851 @@
+#define _GNU_SOURCE
+#include "pubsub.h"
+#include "mpsc_queue.h"
+#include "memory_pool.h"
+#include "resource_manager.h"
+#include "error.h"
+#include "logger.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+// 主题表的初始桶数（2 的幂），主题数超过桶数时加倍
+#define PUBSUB_INITIAL_BUCKETS 64
+// 订阅者发送队列的初始容量（2 的幂），满时加倍直到 queue_limit
+#define PUBSUB_INITIAL_QUEUE 4
+
+// 发布的消息：数据和主题只保存一份，每个排队的订阅者和每个在途的投递各持有一个引用
+typedef struct PubsubMessage {
+    atomic_uint refs;
+    uint32_t hash;         // 主题的哈希值
+    uint32_t topic_len;    // 为 0 表示 pubsub_send 发给单个连接的消息
+    uint32_t len;
+    char *data;            // 发送给订阅者的数据，主题紧随其后
+    MpscNode nodes[];      // 投递到各工作线程收件队列的节点，下标为工作线程编号
+} PubsubMessage;
+
+// 主题：本工作线程上的订阅者数组
+typedef struct Topic {
+    struct Topic *next;            // 同一哈希桶中的下一个主题
+    uint32_t hash;
+    uint32_t len;
+    struct PubsubSubscriber **subs;
+    unsigned count;
+    unsigned capacity;
+    char name[];
+} Topic;
+
+// 订阅关系：主题和订阅者在其订阅者数组中的位置，取消订阅时交换删除
+typedef struct {
+    Topic *topic;
+    unsigned index;
+} Membership;
+
+// 订阅者：每个有订阅或经 pubsub_send 发送过数据的连接一个
+typedef struct PubsubSubscriber {
+    struct completion_handler handler;  // 发送完成
+    struct PubsubWorker *worker;
+    struct connection *conn;            // 连接关闭后为 NULL，等在途的发送完成后释放
+    int fd;
+    unsigned batch;                     // 一次发送最多合并的消息数
+    PubsubMessage **queue;              // 循环发送队列，开头 inflight 条正在发送
+    unsigned head;
+    unsigned count;
+    unsigned capacity;
+    unsigned inflight;
+    size_t offset;                      // 队首消息已发送的字节数（短写后继续发送）
+    struct iovec *iov;
+    unsigned iov_capacity;
+    struct msghdr msg;
+    Membership *topics;
+    unsigned topic_count;
+    unsigned topic_capacity;
+    int sending;                        // 有在途的 sendmsg
+    int closing;                        // 已因发送失败或队列已满关闭连接，不再排队
+    int flush_queued;                   // 在待发送链表中
+    struct PubsubSubscriber *flush_next;
+    struct PubsubSubscriber *prev;      // 工作线程的所有订阅者，销毁时统一释放
+    struct PubsubSubscriber *next;
+} Subscriber;
+
+// 工作线程的收件队列，按缓存行对齐避免伪共享
+typedef struct {
+    MpscQueue inbox;       // 其他线程发布的消息，本工作线程消费
+    int event_fd;          // 收件通知 eventfd，由工作线程 ring 上的读请求监听
+    atomic_int notified;   // 已写入 eventfd 但工作线程尚未处理
+    atomic_int active;     // 工作线程正在运行，停止后不再投递
+} __attribute__((aligned(64))) PubsubSlot;
+
+struct PubsubWorker {
+    ResourceManager *rm;
+    PubsubSlot *slot;
+    int index;
+    Topic **buckets;
+    unsigned bucket_count;
+    unsigned topic_count;
+    MemoryPool *subscriber_pool;       // 订阅者只在事件循环线程中分配和释放
+    Subscriber *subscribers;
+    Subscriber *flush_head;            // 本轮有新消息、等待提交发送的订阅者
+    Subscriber *flush_tail;
+    uint64_t inbox_value;              // eventfd 读请求的目标缓冲区
+    struct completion_handler inbox_handler;
+    uint64_t published;
+    uint64_t delivered;
+    uint64_t dropped;
+    uint64_t disconnected;
+};
+
+static PubsubSlot* slots = NULL;
+static int slot_count = 0;
+static PubsubConfig pubsub_config;
+// 工作线程退出时并入的统计，以及在工作线程之外发布的消息数
+static atomic_uint_fast64_t total_published;
+static atomic_uint_fast64_t total_delivered;
+static atomic_uint_fast64_t total_dropped;
+static atomic_uint_fast64_t total_disconnected;
+
+// FNV-1a
+static uint32_t topic_hash(const char *name, size_t len) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ (unsigned char)name[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static PubsubMessage* message_create(const char *topic, size_t topic_len, const void *data, size_t len, int nodes) {
+    size_t header = sizeof(PubsubMessage) + (size_t)nodes * sizeof(MpscNode);
+    PubsubMessage *msg = malloc(header + len + topic_len);
+    if (!msg) {
+        return NULL;
+    }
+    atomic_init(&msg->refs, 1);
+    msg->hash = topic_hash(topic, topic_len);
+    msg->topic_len = (uint32_t)topic_len;
+    msg->len = (uint32_t)len;
+    msg->data = (char *)msg + header;
+    memcpy(msg->data, data, len);
+    if (topic_len) {
+        memcpy(msg->data + len, topic, topic_len);
+    }
+    return msg;
+}
+
+static const char* message_topic(const PubsubMessage *msg) {
+    return msg->data + msg->len;
+}
+
+static void message_release(PubsubMessage *msg) {
+    if (atomic_fetch_sub_explicit(&msg->refs, 1, memory_order_acq_rel) == 1) {
+        free(msg);
+    }
+}
+
+static int same_topic(const PubsubMessage *a, const PubsubMessage *b) {
+    return a->hash == b->hash && a->topic_len == b->topic_len &&
+           memcmp(message_topic(a), message_topic(b), a->topic_len) == 0;
+}
+
+static void notify_fd(int fd) {
+    uint64_t one = 1;
+    ssize_t ret;
+    do {
+        ret = write(fd, &one, sizeof(one));
+    } while (ret < 0 && errno == EINTR);
+}
+
+// 获取 SQE，SQ 已满时先提交
+static struct io_uring_sqe* get_sqe(struct io_uring *ring) {
+    struct io_uring_sqe *sqe = io_uring_get_sqe(ring);
+    if (!sqe) {
+        io_uring_submit(ring);
+        sqe = io_uring_get_sqe(ring);
+    }
+    return sqe;
+}
+
+// 初始化发布订阅
+int pubsub_init(int workers, const PubsubConfig *config) {
+    slots = aligned_alloc(64, sizeof(PubsubSlot) * (size_t)workers);
+    if (!slots) {
+        return -1;
+    }
+    for (int i = 0; i < workers; i++) {
+        mpsc_queue_init(&slots[i].inbox);
+        atomic_init(&slots[i].notified, 0);
+        atomic_init(&slots[i].active, 0);
+        slots[i].event_fd = eventfd(0, EFD_CLOEXEC);
+        if (slots[i].event_fd < 0) {
+            slot_count = i;
+            pubsub_destroy();
+            return -1;
+        }
+    }
+    slot_count = workers;
+    pubsub_config = *config;
+    if (pubsub_config.queue_limit == 0) {
+        pubsub_config.queue_limit = PUBSUB_DEFAULT_QUEUE_LIMIT;
+    }
+    if (pubsub_config.batch_messages == 0) {
+        pubsub_config.batch_messages = PUBSUB_DEFAULT_BATCH;
+    }
+    if (pubsub_config.batch_messages > IOV_MAX) {
+        pubsub_config.batch_messages = IOV_MAX;
+    }
+    atomic_init(&total_published, 0);
+    atomic_init(&total_delivered, 0);
+    atomic_init(&total_dropped, 0);
+    atomic_init(&total_disconnected, 0);
+    return 0;
+}
+
+// 释放发布订阅
+void pubsub_destroy(void) {
+    for (int i = 0; i < slot_count; i++) {
+        MpscNode *node;
+        while ((node = mpsc_queue_pop(&slots[i].inbox)) != NULL) {
+            message_release((PubsubMessage *)((char *)(node - i) - offsetof(PubsubMessage, nodes)));
+        }
+        close(slots[i].event_fd);
+    }
+    free(slots);
+    slots = NULL;
+    slot_count = 0;
+}
+
+// 汇总统计
+void pubsub_stats(PubsubStats *stats) {
+    stats->published = atomic_load(&total_published);
+    stats->delivered = atomic_load(&total_delivered);
+    stats->dropped = atomic_load(&total_dropped);
+    stats->disconnected = atomic_load(&total_disconnected);
+}
+
+static Topic* topic_find(PubsubWorker *worker, const char *name, size_t len, uint32_t hash) {
+    for (Topic *t = worker->buckets[hash & (worker->bucket_count - 1)]; t; t = t->next) {
+        if (t->hash == hash && t->len == len && memcmp(t->name, name, len) == 0) {
+            return t;
+        }
+    }
+    return NULL;
+}
+
+// 主题数超过桶数时加倍，失败时保持原表（只是链更长）
+static void topic_table_grow(PubsubWorker *worker) {
+    unsigned count = worker->bucket_count * 2;
+    Topic **buckets = calloc(count, sizeof(Topic *));
+    if (!buckets) {
+        return;
+    }
+    for (unsigned i = 0; i < worker->bucket_count; i++) {
+        Topic *t = worker->buckets[i];
+        while (t) {
+            Topic *next = t->next;
+            t->next = buckets[t->hash & (count - 1)];
+            buckets[t->hash & (count - 1)] = t;
+            t = next;
+        }
+    }
+    free(worker->buckets);
+    worker->buckets = buckets;
+    worker->bucket_count = count;
+}
+
+static Topic* topic_create(PubsubWorker *worker, const char *name, size_t len, uint32_t hash) {
+    Topic *t = calloc(1, sizeof(Topic) + len);
+    if (!t) {
+        return NULL;
+    }
+    t->hash = hash;
+    t->len = (uint32_t)len;
+    memcpy(t->name, name, len);
+    if (worker->topic_count >= worker->bucket_count) {
+        topic_table_grow(worker);
+    }
+    Topic **bucket = &worker->buckets[hash & (worker->bucket_count - 1)];
+    t->next = *bucket;
+    *bucket = t;
+    worker->topic_count++;
+    return t;
+}
+
+// 删除已没有订阅者的主题
+static void topic_remove(PubsubWorker *worker, Topic *topic) {
+    Topic **link = &worker->buckets[topic->hash & (worker->bucket_count - 1)];
+    while (*link != topic) {
+        link = &(*link)->next;
+    }
+    *link = topic->next;
+    worker->topic_count--;
+    free(topic->subs);
+    free(topic);
+}
+
+static PubsubMessage* queue_at(const Subscriber *sub, unsigned i) {
+    return sub->queue[(sub->head + i) & (sub->capacity - 1)];
+}
+
+static int queue_push(Subscriber *sub, PubsubMessage *msg) {
+    if (sub->count == sub->capacity) {
+        unsigned capacity = sub->capacity ? sub->capacity * 2 : PUBSUB_INITIAL_QUEUE;
+        PubsubMessage **queue = malloc(capacity * sizeof(PubsubMessage *));
+        if (!queue) {
+            return -1;
+        }
+        for (unsigned i = 0; i < sub->count; i++) {
+            queue[i] = queue_at(sub, i);
+        }
+        free(sub->queue);
+        sub->queue = queue;
+        sub->capacity = capacity;
+        sub->head = 0;
+    }
+    sub->queue[(sub->head + sub->count) & (sub->capacity - 1)] = msg;
+    sub->count++;
+    return 0;
+}
+
+static PubsubMessage* queue_pop(Subscriber *sub) {
+    PubsubMessage *msg = sub->queue[sub->head];
+    sub->head = (sub->head + 1) & (sub->capacity - 1);
+    sub->count--;
+    return msg;
+}
+
+// 从队列中间删除第 i 条，之后的消息前移
+static PubsubMessage* queue_remove(Subscriber *sub, unsigned i) {
+    PubsubMessage *msg = queue_at(sub, i);
+    for (; i + 1 < sub->count; i++) {
+        sub->queue[(sub->head + i) & (sub->capacity - 1)] = queue_at(sub, i + 1);
+    }
+    sub->count--;
+    return msg;
+}
+
+// 加入待发送链表，本轮事件处理结束时提交发送
+static void schedule_flush(PubsubWorker *worker, Subscriber *sub) {
+    if (sub->flush_queued) {
+        return;
+    }
+    sub->flush_queued = 1;
+    sub->flush_next = NULL;
+    if (worker->flush_tail) {
+        worker->flush_tail->flush_next = sub;
+    } else {
+        worker->flush_head = sub;
+    }
+    worker->flush_tail = sub;
+}
+
+// 关闭订阅者的连接：挂起的读取以 0 完成后连接按正常路径关闭，关闭时取消订阅
+static void subscriber_shutdown(Subscriber *sub) {
+    if (!sub->closing) {
+        sub->closing = 1;
+        shutdown(sub->fd, SHUT_RDWR);
+    }
+}
+
+// 发送队列已满时按慢订阅者策略腾出空间
+// 返回: 腾出了一个位置返回 0，新消息不排队返回 -1
+static int make_room(PubsubWorker *worker, Subscriber *sub, const PubsubMessage *msg) {
+    worker->dropped++;
+    if (pubsub_config.slow_policy == PUBSUB_SLOW_DISCONNECT) {
+        worker->disconnected++;
+        subscriber_shutdown(sub);
+        return -1;
+    }
+    if (pubsub_config.slow_policy == PUBSUB_SLOW_DROP) {
+        return -1;
+    }
+
+    // 合并：在途和已部分发送的消息不能删除，发给单个连接的消息不合并
+    unsigned first = sub->inflight > 0 ? sub->inflight : (sub->offset > 0 ? 1 : 0);
+    int victim = -1;
+    for (unsigned i = first; i < sub->count; i++) {
+        const PubsubMessage *queued = queue_at(sub, i);
+        if (queued->topic_len == 0) {
+            continue;
+        }
+        if (victim < 0) {
+            victim = (int)i;
+        }
+        if (msg->topic_len && same_topic(queued, msg)) {
+            victim = (int)i;
+            break;
+        }
+    }
+    if (victim < 0) {
+        return -1;
+    }
+    message_release(queue_remove(sub, (unsigned)victim));
+    return 0;
+}
+
+// 把消息排入订阅者的发送队列（调用者已为其增加引用）
+// 返回: 已排队返回 0；未排队返回 -1，调用者释放引用
+static int subscriber_enqueue(PubsubWorker *worker, Subscriber *sub, PubsubMessage *msg) {
+    if (sub->closing || !sub->conn) {
+        return -1;
+    }
+    if (sub->count >= pubsub_config.queue_limit && make_room(worker, sub, msg) != 0) {
+        return -1;
+    }
+    if (queue_push(sub, msg) != 0) {
+        worker->dropped++;
+        return -1;
+    }
+    schedule_flush(worker, sub);
+    return 0;
+}
+
+static void subscriber_free(PubsubWorker *worker, Subscriber *sub) {
+    while (sub->count > 0) {
+        message_release(queue_pop(sub));
+    }
+    free(sub->queue);
+    free(sub->iov);
+    free(sub->topics);
+    if (sub->prev) sub->prev->next = sub->next;
+    else worker->subscribers = sub->next;
+    if (sub->next) sub->next->prev = sub->prev;
+    memory_pool_free(worker->subscriber_pool, sub);
+}
+
+// 连接已关闭的订阅者在没有在途的发送、也不在待发送链表中时释放
+static void subscriber_release_if_idle(PubsubWorker *worker, Subscriber *sub) {
+    if (!sub->conn && !sub->sending && !sub->flush_queued) {
+        subscriber_free(worker, sub);
+    }
+}
+
+// 发送完成：释放已完整发送的消息，剩余的消息在本轮结束时继续发送
+static void on_send_complete(struct completion_handler *handler, struct io_uring_cqe *cqe, ResourceManager *rm) {
+    (void)rm;
+    Subscriber *sub = (Subscriber *)((char *)handler - offsetof(Subscriber, handler));
+    PubsubWorker *worker = sub->worker;
+    sub->sending = 0;
+
+    size_t sent = sub->offset + (cqe->res > 0 ? (size_t)cqe->res : 0);
+    while (sub->inflight > 0 && sent >= queue_at(sub, 0)->len) {
+        PubsubMessage *msg = queue_pop(sub);
+        sent -= msg->len;
+        worker->delivered += msg->topic_len > 0;
+        message_release(msg);
+        sub->inflight--;
+    }
+    sub->offset = sub->inflight > 0 ? sent : 0;
+    sub->inflight = 0;
+
+    if (!sub->conn) {
+        subscriber_release_if_idle(worker, sub);
+        return;
+    }
+    if (cqe->res <= 0) {
+        log_warn("Pub/sub send failed: %s", strerror(cqe->res < 0 ? -cqe->res : EPIPE));
+        subscriber_shutdown(sub);
+        return;
+    }
+    if (sub->count > 0) {
+        schedule_flush(worker, sub);
+    }
+}
+
+// 把队首最多 batch 条消息合并为一次 sendmsg
+// 返回: 已提交返回 0，没有可用的 SQE 返回 -1
+static int start_send(PubsubWorker *worker, Subscriber *sub) {
+    unsigned n = sub->count < sub->batch ? sub->count : sub->batch;
+    if (n > sub->iov_capacity) {
+        unsigned capacity = sub->iov_capacity ? sub->iov_capacity : 1;
+        while (capacity < n) {
+            capacity *= 2;
+        }
+        struct iovec *iov = realloc(sub->iov, capacity * sizeof(struct iovec));
+        if (iov) {
+            sub->iov = iov;
+            sub->iov_capacity = capacity;
+        } else if (sub->iov_capacity == 0) {
+            log_error("Failed to allocate pub/sub send vector");
+            subscriber_shutdown(sub);
+            return 0;
+        }
+        if (n > sub->iov_capacity) {
+            n = sub->iov_capacity;
+        }
+    }
+
+    struct io_uring_sqe *sqe = get_sqe(worker->rm->ring);
+    if (!sqe) {
+        return -1;
+    }
+    for (unsigned i = 0; i < n; i++) {
+        const PubsubMessage *msg = queue_at(sub, i);
+        sub->iov[i].iov_base = msg->data;
+        sub->iov[i].iov_len = msg->len;
+    }
+    sub->iov[0].iov_base = (char *)sub->iov[0].iov_base + sub->offset;
+    sub->iov[0].iov_len -= sub->offset;
+    memset(&sub->msg, 0, sizeof(sub->msg));
+    sub->msg.msg_iov = sub->iov;
+    sub->msg.msg_iovlen = n;
+
+    // MSG_WAITALL：短写由内核继续发送，只有出错才提前完成
+    io_uring_prep_sendmsg(sqe, sub->fd, &sub->msg, MSG_WAITALL | MSG_NOSIGNAL);
+    sqe_set_completion_handler(sqe, &sub->handler);
+    sub->inflight = n;
+    sub->sending = 1;
+    return 0;
+}
+
+// 为有待发送消息的订阅者提交发送
+void pubsub_flush(ResourceManager *rm) {
+    PubsubWorker *worker = rm->pubsub;
+    if (!worker) {
+        return;
+    }
+    while (worker->flush_head) {
+        Subscriber *sub = worker->flush_head;
+        if (sub->conn && !sub->closing && !sub->sending && sub->count > 0 && start_send(worker, sub) != 0) {
+            // 没有可用的 SQE：已提交的发送完成后继续
+            break;
+        }
+        worker->flush_head = sub->flush_next;
+        if (!worker->flush_head) {
+            worker->flush_tail = NULL;
+        }
+        sub->flush_queued = 0;
+        sub->flush_next = NULL;
+        subscriber_release_if_idle(worker, sub);
+    }
+}
+
+// 把消息排入本工作线程上主题的所有订阅者
+static void deliver(PubsubWorker *worker, PubsubMessage *msg) {
+    Topic *topic = topic_find(worker, message_topic(msg), msg->topic_len, msg->hash);
+    if (!topic) {
+        return;
+    }
+    // 一次加上所有订阅者的引用，未排队的再逐个释放
+    atomic_fetch_add_explicit(&msg->refs, topic->count, memory_order_relaxed);
+    for (unsigned i = 0; i < topic->count; i++) {
+        if (subscriber_enqueue(worker, topic->subs[i], msg) != 0) {
+            message_release(msg);
+        }
+    }
+}
+
+// 挂起收件通知的 eventfd 读请求
+static int arm_inbox(PubsubWorker *worker) {
+    struct io_uring_sqe *sqe = get_sqe(worker->rm->ring);
+    if (!sqe) {
+        handle_error(ERR_URING_QUEUE_FULL, "Could not get SQE for pub/sub inbox");
+        return -1;
+    }
+    io_uring_prep_read(sqe, worker->slot->event_fd, &worker->inbox_value, sizeof(worker->inbox_value), 0);
+    sqe_set_completion_handler(sqe, &worker->inbox_handler);
+    return 0;
+}
+
+// eventfd 读请求完成：投递收件队列中的所有消息并重新挂起读请求
+static void on_inbox_ready(struct completion_handler *handler, struct io_uring_cqe *cqe, ResourceManager *rm) {
+    (void)rm;
+    PubsubWorker *worker = (PubsubWorker *)((char *)handler - offsetof(PubsubWorker, inbox_handler));
+    if (cqe->res == -ECANCELED) {
+        return;
+    }
+    if (cqe->res < 0 && cqe->res != -EINTR && cqe->res != -EAGAIN) {
+        log_error("Pub/sub inbox read failed: %s", strerror(-cqe->res));
+    }
+
+    // 先清除通知标记再处理队列，之后投递的消息会重新写入 eventfd
+    atomic_store(&worker->slot->notified, 0);
+
+    MpscNode *node;
+    while ((node = mpsc_queue_pop(&worker->slot->inbox)) != NULL) {
+        PubsubMessage *msg = (PubsubMessage *)((char *)(node - worker->index) - offsetof(PubsubMessage, nodes));
+        deliver(worker, msg);
+        message_release(msg);
+    }
+    arm_inbox(worker);
+}
+
+// 创建工作线程的发布订阅状态
+PubsubWorker* pubsub_worker_create(ResourceManager *rm) {
+    if (!slots || rm->worker_index >= slot_count) {
+        return NULL;
+    }
+    PubsubWorker *worker = calloc(1, sizeof(PubsubWorker));
+    if (!worker) {
+        return NULL;
+    }
+    worker->rm = rm;
+    worker->index = rm->worker_index;
+    worker->slot = &slots[rm->worker_index];
+    worker->bucket_count = PUBSUB_INITIAL_BUCKETS;
+    worker->buckets = calloc(worker->bucket_count, sizeof(Topic *));
+    worker->subscriber_pool = memory_pool_create(sizeof(Subscriber), 64, 64);
+    worker->inbox_handler.on_complete = on_inbox_ready;
+    if (!worker->buckets || !worker->subscriber_pool || arm_inbox(worker) != 0) {
+        free(worker->buckets);
+        if (worker->subscriber_pool) memory_pool_destroy(worker->subscriber_pool);
+        free(worker);
+        return NULL;
+    }
+    atomic_store(&worker->slot->active, 1);
+    return worker;
+}
+
+// 释放工作线程的发布订阅状态
+void pubsub_worker_destroy(PubsubWorker *worker) {
+    if (!worker) return;
+
+    atomic_store(&worker->slot->active, 0);
+    MpscNode *node;
+    while ((node = mpsc_queue_pop(&worker->slot->inbox)) != NULL) {
+        message_release((PubsubMessage *)((char *)(node - worker->index) - offsetof(PubsubMessage, nodes)));
+    }
+
+    // 关闭时仍打开的连接不再使用订阅者
+    while (worker->subscribers) {
+        Subscriber *sub = worker->subscribers;
+        if (sub->conn) {
+            sub->conn->cold->subscriber = NULL;
+        }
+        subscriber_free(worker, sub);
+    }
+    for (unsigned i = 0; i < worker->bucket_count; i++) {
+        Topic *t = worker->buckets[i];
+        while (t) {
+            Topic *next = t->next;
+            free(t->subs);
+            free(t);
+            t = next;
+        }
+    }
+
+    atomic_fetch_add(&total_published, worker->published);
+    atomic_fetch_add(&total_delivered, worker->delivered);
+    atomic_fetch_add(&total_dropped, worker->dropped);
+    atomic_fetch_add(&total_disconnected, worker->disconnected);
+    free(worker->buckets);
+    memory_pool_destroy(worker->subscriber_pool);
+    free(worker);
+}
+
+// 获取连接的订阅者，没有时创建
+static Subscriber* subscriber_get(PubsubWorker *worker, struct connection *conn) {
+    if (conn->cold->subscriber) {
+        return conn->cold->subscriber;
+    }
+    Subscriber *sub = memory_pool_alloc(worker->subscriber_pool);
+    if (!sub) {
+        return NULL;
+    }
+    memset(sub, 0, sizeof(Subscriber));
+    sub->handler.on_complete = on_send_complete;
+    sub->worker = worker;
+    sub->conn = conn;
+    sub->fd = conn->fd;
+
+    // 有消息边界的连接（SOCK_SEQPACKET）每次发送一条，合并会把多条消息变成一条
+    int type = SOCK_STREAM;
+    socklen_t type_len = sizeof(type);
+    getsockopt(conn->fd, SOL_SOCKET, SO_TYPE, &type, &type_len);
+    sub->batch = type == SOCK_STREAM ? pubsub_config.batch_messages : 1;
+
+    sub->next = worker->subscribers;
+    if (worker->subscribers) {
+        worker->subscribers->prev = sub;
+    }
+    worker->subscribers = sub;
+    conn->cold->subscriber = sub;
+    return sub;
+}
+
+// 取消订阅者的第 k 个订阅：主题的订阅者数组和订阅者的订阅数组都交换删除
+static void membership_remove(PubsubWorker *worker, Subscriber *sub, unsigned k) {
+    Topic *topic = sub->topics[k].topic;
+    unsigned index = sub->topics[k].index;
+
+    Subscriber *moved = topic->subs[--topic->count];
+    if (index != topic->count) {
+        topic->subs[index] = moved;
+        for (unsigned i = 0; i < moved->topic_count; i++) {
+            if (moved->topics[i].topic == topic) {
+                moved->topics[i].index = index;
+                break;
+            }
+        }
+    }
+    sub->topics[k] = sub->topics[--sub->topic_count];
+    if (topic->count == 0) {
+        topic_remove(worker, topic);
+    }
+}
+
+// 订阅主题
+int pubsub_subscribe(ResourceManager *rm, struct connection *conn, const char *topic, size_t topic_len) {
+    PubsubWorker *worker = rm->pubsub;
+    if (!worker) {
+        return -ENOSYS;
+    }
+    if (topic_len == 0 || topic_len > PUBSUB_MAX_TOPIC) {
+        return -EINVAL;
+    }
+    Subscriber *sub = subscriber_get(worker, conn);
+    if (!sub) {
+        return -ENOMEM;
+    }
+
+    uint32_t hash = topic_hash(topic, topic_len);
+    Topic *t = topic_find(worker, topic, topic_len, hash);
+    if (t) {
+        for (unsigned i = 0; i < sub->topic_count; i++) {
+            if (sub->topics[i].topic == t) {
+                return 0;
+            }
+        }
+    } else {
+        t = topic_create(worker, topic, topic_len, hash);
+        if (!t) {
+            return -ENOMEM;
+        }
+    }
+
+    if (t->count == t->capacity) {
+        unsigned capacity = t->capacity ? t->capacity * 2 : 4;
+        Subscriber **subs = realloc(t->subs, capacity * sizeof(Subscriber *));
+        if (subs) {
+            t->subs = subs;
+            t->capacity = capacity;
+        }
+    }
+    if (sub->topic_count == sub->topic_capacity) {
+        unsigned capacity = sub->topic_capacity ? sub->topic_capacity * 2 : 2;
+        Membership *topics = realloc(sub->topics, capacity * sizeof(Membership));
+        if (topics) {
+            sub->topics = topics;
+            sub->topic_capacity = capacity;
+        }
+    }
+    if (t->count == t->capacity || sub->topic_count == sub->topic_capacity) {
+        if (t->count == 0) {
+            topic_remove(worker, t);
+        }
+        return -ENOMEM;
+    }
+
+    t->subs[t->count] = sub;
+    sub->topics[sub->topic_count].topic = t;
+    sub->topics[sub->topic_count].index = t->count;
+    sub->topic_count++;
+    t->count++;
+    return 0;
+}
+
+// 取消订阅主题
+int pubsub_unsubscribe(ResourceManager *rm, struct connection *conn, const char *topic, size_t topic_len) {
+    PubsubWorker *worker = rm->pubsub;
+    if (!worker) {
+        return -ENOSYS;
+    }
+    Subscriber *sub = conn->cold->subscriber;
+    Topic *t = topic_find(worker, topic, topic_len, topic_hash(topic, topic_len));
+    if (sub && t) {
+        for (unsigned i = 0; i < sub->topic_count; i++) {
+            if (sub->topics[i].topic == t) {
+                membership_remove(worker, sub, i);
+                return 0;
+            }
+        }
+    }
+    return -ENOENT;
+}
+
+// 发布消息
+int pubsub_publish(ResourceManager *rm, const char *topic, size_t topic_len, const void *data, size_t len) {
+    if (!slots) {
+        return -ENOSYS;
+    }
+    if (topic_len == 0 || topic_len > PUBSUB_MAX_TOPIC) {
+        return -EINVAL;
+    }
+    if (len == 0 || len > PUBSUB_MAX_MESSAGE) {
+        return -EMSGSIZE;
+    }
+    PubsubMessage *msg = message_create(topic, topic_len, data, len, slot_count);
+    if (!msg) {
+        return -ENOMEM;
+    }
+
+    // 其他工作线程经收件队列投递，连续投递只在对方尚未被通知时写一次 eventfd
+    PubsubWorker *local = rm ? rm->pubsub : NULL;
+    for (int i = 0; i < slot_count; i++) {
+        PubsubSlot *slot = &slots[i];
+        if ((local && i == local->index) || !atomic_load(&slot->active)) {
+            continue;
+        }
+        atomic_fetch_add_explicit(&msg->refs, 1, memory_order_relaxed);
+        mpsc_queue_push(&slot->inbox, &msg->nodes[i]);
+        if (!atomic_exchange(&slot->notified, 1)) {
+            notify_fd(slot->event_fd);
+        }
+    }
+
+    if (local) {
+        deliver(local, msg);
+        local->published++;
+    } else {
+        atomic_fetch_add(&total_published, 1);
+    }
+    message_release(msg);
+    return 0;
+}
+
+// 向单个连接发送数据
+int pubsub_send(ResourceManager *rm, struct connection *conn, const void *data, size_t len) {
+    PubsubWorker *worker = rm->pubsub;
+    if (!worker) {
+        return -ENOSYS;
+    }
+    if (len == 0) {
+        return 0;
+    }
+    if (len > PUBSUB_MAX_MESSAGE) {
+        return -EMSGSIZE;
+    }
+    Subscriber *sub = subscriber_get(worker, conn);
+    if (!sub) {
+        return -ENOMEM;
+    }
+    PubsubMessage *msg = message_create(NULL, 0, data, len, 0);
+    if (!msg) {
+        return -ENOMEM;
+    }
+    if (subscriber_enqueue(worker, sub, msg) != 0) {
+        message_release(msg);
+        return -ENOBUFS;
+    }
+    return 0;
+}
+
+// 连接关闭时取消其所有订阅
+void pubsub_connection_closed(ResourceManager *rm, struct connection *conn) {
+    (void)rm;
+    Subscriber *sub = conn->cold->subscriber;
+    if (!sub) {
+        return;
+    }
+    conn->cold->subscriber = NULL;
+    PubsubWorker *worker = sub->worker;
+    while (sub->topic_count > 0) {
+        membership_remove(worker, sub, sub->topic_count - 1);
+    }
+    sub->conn = NULL;
+    subscriber_release_if_idle(worker, sub);
+}
\ No newline at end of file
@@ -0,0 +1,86 @@
+#ifndef PUBSUB_H
+#define PUBSUB_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "iouring_server.h"
+
+// 发布订阅：发布的消息只保存一份（引用计数），按引用排入每个订阅者的发送队列，
+// 不复制到连接的写缓冲区。每个工作线程维护自己的主题表和订阅者，发布到其他工作线程的消息
+// 经该线程的收件队列投递。每轮事件处理结束时，每个有待发送消息的订阅者合并为一次 sendmsg，
+// 所有订阅者的发送随同一次提交进入内核
+
+// 慢订阅者策略：订阅者的发送队列已满（queue_limit 条）时如何处理新消息
+typedef enum {
+    PUBSUB_SLOW_DISCONNECT,  // 断开订阅者的连接
+    PUBSUB_SLOW_DROP,        // 丢弃新消息
+    PUBSUB_SLOW_COALESCE     // 丢弃队列中同一主题最早的未发送消息（没有时丢弃最早的未发送消息），只保留较新的
+} PubsubSlowPolicy;
+
+// 发布订阅配置
+typedef struct PubsubConfig {
+    unsigned queue_limit;        // 每个订阅者最多排队的消息数
+    unsigned batch_messages;     // 一次 sendmsg 最多合并的消息数（SOCK_SEQPACKET 连接每次一条）
+    PubsubSlowPolicy slow_policy;
+} PubsubConfig;
+
+// 默认配置
+#define PUBSUB_DEFAULT_QUEUE_LIMIT 1024
+#define PUBSUB_DEFAULT_BATCH 64
+// 主题名和单条消息的最大长度
+#define PUBSUB_MAX_TOPIC 256
+#define PUBSUB_MAX_MESSAGE (16 * 1024 * 1024)
+
+// 统计
+typedef struct {
+    uint64_t published;      // 发布的消息数
+    uint64_t delivered;      // 发送给订阅者的消息数
+    uint64_t dropped;        // 因发送队列已满被丢弃或合并的消息数
+    uint64_t disconnected;   // 因发送队列已满被断开的订阅者数
+} PubsubStats;
+
+// 每个工作线程的发布订阅状态
+typedef struct PubsubWorker PubsubWorker;
+
+// 初始化发布订阅，workers 为工作线程数
+int pubsub_init(int workers, const PubsubConfig *config);
+
+// 释放发布订阅（所有工作线程退出后调用），丢弃尚未投递的消息
+void pubsub_destroy(void);
+
+// 汇总统计（工作线程退出后完整）
+void pubsub_stats(PubsubStats *stats);
+
+// 为工作线程创建发布订阅状态并开始接收其他工作线程投递的消息
+PubsubWorker* pubsub_worker_create(struct ResourceManager *rm);
+
+// 释放工作线程的发布订阅状态和所有订阅者（在 ring 退出后调用）
+void pubsub_worker_destroy(PubsubWorker *worker);
+
+// 以下函数在未启用发布订阅时返回 -ENOSYS
+
+// 订阅主题（重复订阅无效果）
+// 返回: 成功返回 0，主题为空或过长返回 -EINVAL，内存不足返回 -ENOMEM
+int pubsub_subscribe(struct ResourceManager *rm, struct connection *conn, const char *topic, size_t topic_len);
+
+// 取消订阅主题
+// 返回: 成功返回 0，未订阅返回 -ENOENT
+int pubsub_unsubscribe(struct ResourceManager *rm, struct connection *conn, const char *topic, size_t topic_len);
+
+// 向主题的所有订阅者（所有工作线程）发布 data，数据被复制一次，调用返回后即可复用。
+// rm 为当前工作线程时本线程的订阅者直接入队；在工作线程之外调用时 rm 为 NULL
+// 返回: 成功返回 0，主题为空或过长返回 -EINVAL，数据为空或过长返回 -EMSGSIZE，内存不足返回 -ENOMEM
+int pubsub_publish(struct ResourceManager *rm, const char *topic, size_t topic_len, const void *data, size_t len);
+
+// 向连接发送 data，与发布的消息按顺序排在同一个发送队列中（订阅者的回复应使用此函数，
+// 而不是连接的写缓冲区，否则两者的数据可能交错）
+// 返回: 成功返回 0，失败返回 -errno（队列已满时按慢订阅者策略处理，返回 -ENOBUFS）
+int pubsub_send(struct ResourceManager *rm, struct connection *conn, const void *data, size_t len);
+
+// 连接关闭时取消其所有订阅（由连接关闭流程调用）
+void pubsub_connection_closed(struct ResourceManager *rm, struct connection *conn);
+
+// 为有待发送消息的订阅者提交发送（事件循环在每批完成事件处理后调用）
+void pubsub_flush(struct ResourceManager *rm);
+
+#endif // PUBSUB_H
\ No newline at end of file
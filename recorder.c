@@ -0,0 +1,162 @@
+#include "recorder.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+static FlightRecorder* recorders = NULL;
+static int recorder_count = 0;
+static uint32_t recorder_capacity = 0;
+// 转储路径和临时文件路径在初始化时确定，信号处理函数中不再格式化字符串
+static char dump_path[4096];
+static char dump_tmp_path[4096 + 8];
+static atomic_flag dumping = ATOMIC_FLAG_INIT;
+
+static const char* event_names[RECORDER_EVENT_TYPES] = {
+    "?", "ACCEPT", "ACCEPT_ERROR", "READ", "WRITE", "LINKED_SEND", "CLOSE",
+    "REJECT", "SHED", "MIGRATE_OUT", "MIGRATE_IN", "MIGRATE_FAILED"
+};
+
+static uint32_t next_pow2(uint32_t value) {
+    uint32_t n = 1;
+    while (n < value) n <<= 1;
+    return n;
+}
+
+// 创建记录器
+int recorder_init(int workers, unsigned events, const char* path) {
+    if (events > RECORDER_MAX_EVENTS) events = RECORDER_MAX_EVENTS;
+    recorder_capacity = next_pow2(events ? events : 1);
+
+    if (path && *path) {
+        snprintf(dump_path, sizeof(dump_path), "%s", path);
+    } else {
+        snprintf(dump_path, sizeof(dump_path), "flight-%d.rec", (int)getpid());
+    }
+    snprintf(dump_tmp_path, sizeof(dump_tmp_path), "%s.tmp", dump_path);
+
+    recorders = aligned_alloc(64, sizeof(FlightRecorder) * (size_t)workers);
+    if (!recorders) {
+        return -1;
+    }
+    for (int i = 0; i < workers; i++) {
+        recorders[i].events = calloc(recorder_capacity, sizeof(RecorderEvent));
+        recorders[i].mask = recorder_capacity - 1;
+        recorders[i].now_ns = 0;
+        atomic_init(&recorders[i].head, 0);
+        if (!recorders[i].events) {
+            recorder_count = i;
+            recorder_destroy();
+            return -1;
+        }
+    }
+    recorder_count = workers;
+    return 0;
+}
+
+// 释放记录器
+void recorder_destroy(void) {
+    for (int i = 0; i < recorder_count; i++) {
+        free(recorders[i].events);
+    }
+    free(recorders);
+    recorders = NULL;
+    recorder_count = 0;
+}
+
+// 工作线程的记录器
+FlightRecorder* recorder_get(int worker) {
+    if (!recorders || worker < 0 || worker >= recorder_count) return NULL;
+    return &recorders[worker];
+}
+
+// 转储文件路径
+const char* recorder_path(void) {
+    return dump_path;
+}
+
+// 写入全部数据，被信号中断时继续
+static int write_all(int fd, const void* data, size_t len) {
+    const char* p = data;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -errno;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static uint64_t clock_ns(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// 转储所有工作线程的事件
+int recorder_dump(int reason) {
+    if (!recorders) return -ENOENT;
+    if (atomic_flag_test_and_set(&dumping)) return -EBUSY;
+    int saved_errno = errno;
+
+    int ret = 0;
+    int fd = open(dump_tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        ret = -errno;
+    } else {
+        RecorderFileHeader header;
+        memset(&header, 0, sizeof(header));
+        header.magic = RECORDER_MAGIC;
+        header.version = RECORDER_VERSION;
+        header.event_size = sizeof(RecorderEvent);
+        header.workers = (uint32_t)recorder_count;
+        header.capacity = recorder_capacity;
+        header.monotonic_ns = clock_ns(CLOCK_MONOTONIC);
+        header.realtime_ns = clock_ns(CLOCK_REALTIME);
+        header.pid = (int32_t)getpid();
+        header.reason = reason;
+        ret = write_all(fd, &header, sizeof(header));
+
+        // 工作线程在复制期间继续写入，复制前后各读取一次 head，由解码器丢弃可能被覆盖的事件
+        for (int i = 0; i < recorder_count && ret == 0; i++) {
+            FlightRecorder* rec = &recorders[i];
+            RecorderWorkerHeader worker;
+            memset(&worker, 0, sizeof(worker));
+            worker.worker = (uint32_t)i;
+            worker.capacity = recorder_capacity;
+            worker.head_before = atomic_load_explicit(&rec->head, memory_order_acquire);
+            off_t at = lseek(fd, 0, SEEK_CUR);
+            ret = write_all(fd, &worker, sizeof(worker));
+            if (ret == 0) {
+                ret = write_all(fd, rec->events, sizeof(RecorderEvent) * recorder_capacity);
+            }
+            atomic_thread_fence(memory_order_acquire);
+            worker.head_after = atomic_load_explicit(&rec->head, memory_order_relaxed);
+            if (ret == 0 && pwrite(fd, &worker, sizeof(worker), at) != (ssize_t)sizeof(worker)) {
+                ret = -errno;
+            }
+        }
+        close(fd);
+        if (ret == 0 && rename(dump_tmp_path, dump_path) != 0) {
+            ret = -errno;
+        }
+        if (ret != 0) {
+            unlink(dump_tmp_path);
+        }
+    }
+
+    errno = saved_errno;
+    atomic_flag_clear(&dumping);
+    return ret;
+}
+
+// 事件类型名称
+const char* recorder_event_name(unsigned type) {
+    return type < RECORDER_EVENT_TYPES ? event_names[type] : "?";
+}
\ No newline at end of file
@@ -0,0 +1,118 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+// 事件记录器：每个工作线程一个环形缓冲区，只由该线程写入，写满后覆盖最旧的事件。
+// 转储时（收到 SIGUSR1、崩溃或调用 recorder_dump）把各工作线程的缓冲区原样写入文件，
+// 由 flight_decode 离线解码
+
+// 默认配置
+#define RECORDER_DEFAULT_EVENTS 65536   // 每个工作线程保留的事件数（向上取整到 2 的幂）
+#define RECORDER_MAX_EVENTS (1u << 24)
+
+// 转储文件格式
+#define RECORDER_MAGIC 0x52464d52u      // "RMFR"
+#define RECORDER_VERSION 1
+
+// 事件类型
+typedef enum {
+    RECORDER_ACCEPT = 1,        // 接受连接，res 为文件描述符
+    RECORDER_ACCEPT_ERROR,      // 接受失败，res 为 -errno
+    RECORDER_READ,              // 读取完成，res 为 CQE 的结果
+    RECORDER_WRITE,             // 发送完成，res 为 CQE 的结果
+    RECORDER_LINKED_SEND,       // 链接发送未完整完成，res 为 CQE 的结果
+    RECORDER_CLOSE,             // 关闭连接
+    RECORDER_REJECT,            // 过载时拒绝新连接，aux 为压力等级
+    RECORDER_SHED,              // 过载时关闭空闲连接
+    RECORDER_MIGRATE_OUT,       // 连接迁出，aux 为目标工作线程
+    RECORDER_MIGRATE_IN,        // 连接迁入
+    RECORDER_MIGRATE_FAILED,    // 迁移消息投递失败，res 为 -errno
+    RECORDER_EVENT_TYPES
+} RecorderEventType;
+
+// 事件（32 字节）
+typedef struct {
+    uint64_t ts_ns;             // CLOCK_MONOTONIC，取所在批次开始处理的时间
+    uint64_t conn_id;           // 连接标识（struct connection 的 id），0 表示无连接
+    int32_t fd;
+    int32_t res;
+    uint32_t seq;               // 事件序号的低 32 位，用于识别转储时被覆盖的事件
+    uint16_t type;              // RecorderEventType
+    uint16_t aux;
+} RecorderEvent;
+
+// 每个工作线程的记录器，按缓存行对齐避免伪共享
+typedef struct FlightRecorder {
+    RecorderEvent* events;
+    uint32_t mask;
+    atomic_uint_fast64_t head;  // 已写入的事件数，写入事件后以 release 语义更新
+    uint64_t now_ns;            // 当前批次的时间戳
+} __attribute__((aligned(64))) FlightRecorder;
+
+// 转储文件头
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t event_size;
+    uint32_t workers;
+    uint32_t capacity;          // 每个工作线程的事件数
+    uint64_t monotonic_ns;      // 转储时的 CLOCK_MONOTONIC
+    uint64_t realtime_ns;       // 转储时的 CLOCK_REALTIME
+    int32_t pid;
+    int32_t reason;             // 触发转储的信号，0 表示主动请求
+} RecorderFileHeader;
+
+// 每个工作线程的数据头，之后是 capacity 个事件（环形缓冲区原样写出）
+// 序号在 (head_after - capacity, head_before) 范围内的事件有效，其余可能在复制期间被覆盖
+typedef struct {
+    uint32_t worker;
+    uint32_t capacity;
+    uint64_t head_before;       // 复制前的 head
+    uint64_t head_after;        // 复制后的 head
+} RecorderWorkerHeader;
+
+// 记录一个事件（只能由所属工作线程调用），rec 为 NULL 时无操作
+static inline void recorder_record(FlightRecorder* rec, RecorderEventType type, uint64_t conn_id,
+                                   int fd, int res, unsigned aux) {
+    if (!rec) return;
+    uint64_t seq = atomic_load_explicit(&rec->head, memory_order_relaxed);
+    RecorderEvent* e = &rec->events[seq & rec->mask];
+    e->ts_ns = rec->now_ns;
+    e->conn_id = conn_id;
+    e->fd = fd;
+    e->res = res;
+    e->seq = (uint32_t)seq;
+    e->type = (uint16_t)type;
+    e->aux = (uint16_t)aux;
+    atomic_store_explicit(&rec->head, seq + 1, memory_order_release);
+}
+
+// 设置当前批次的时间戳，之后记录的事件使用该时间
+static inline void recorder_set_time(FlightRecorder* rec, uint64_t now_ns) {
+    if (rec) rec->now_ns = now_ns;
+}
+
+// 为 workers 个工作线程创建记录器，每个保留 events 个事件；path 为转储文件，为空时使用 flight-<pid>.rec
+// 返回: 成功返回 0，内存不足返回 -1
+int recorder_init(int workers, unsigned events, const char* path);
+
+// 释放记录器
+void recorder_destroy(void);
+
+// 工作线程的记录器，未启用时返回 NULL
+FlightRecorder* recorder_get(int worker);
+
+// 转储文件路径
+const char* recorder_path(void);
+
+// 把所有工作线程的事件写入转储文件（先写临时文件再改名），只使用异步信号安全的函数，
+// 可在信号处理函数中调用。reason 为触发的信号，0 表示主动请求
+// 返回: 成功返回 0，已有转储正在进行返回 -EBUSY，未启用返回 -ENOENT，写入失败返回 -errno
+int recorder_dump(int reason);
+
+// 事件类型名称
+const char* recorder_event_name(unsigned type);
+
+#endif // RECORDER_H
\ No newline at end of file
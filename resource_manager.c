@@ -1,18 +1,32 @@
 #include "resource_manager.h"
 #include "error.h"
+#include "file_server.h"
+#include "file_io.h"
+#include "udp.h"
+#include "proxy.h"
+#include "tls.h"
+#include "logger.h"
+#include "coroutine.h"
+#include "pubsub.h"
+#include "capture.h"
+#include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <errno.h>
 #include <string.h>
+#include <limits.h>
 
 // 在文件开头添加以下宏定义
 #ifndef SO_REUSEPORT
 #define SO_REUSEPORT 15
 #endif
 
-static int setup_listening_socket(int port) {
-    int sock = socket(AF_INET, SOCK_STREAM, 0);
+static int setup_listening_socket(int port, int type) {
+    int sock = socket(AF_INET, type, 0);
     if (sock == -1) {
         handle_error(ERR_SOCKET_CREATE_FAILED, "Failed to create server socket");
         return -1;
@@ -45,7 +59,8 @@ static int setup_listening_socket(int port) {
         return -1;
     }
 
-    if (listen(sock, SOMAXCONN) < 0) {
+    // 数据报套接字绑定后即可接收
+    if (type == SOCK_STREAM && listen(sock, SOMAXCONN) < 0) {
         handle_error(ERR_SOCKET_LISTEN_FAILED, "Failed to listen on server socket");
         close(sock);
         return -1;
@@ -54,14 +69,447 @@ static int setup_listening_socket(int port) {
     return sock;
 }
 
+_Static_assert(IO_BUFFER_COUNT <= 64, "io buffer bitmap holds at most 64 buffers");
+
+// 初始化各规格的接收缓冲区：注册表中依次为默认、较小、较大规格（默认规格的ID与只有一种规格时相同）
+static void init_buffer_classes(ResourceManager* rm) {
+    static const int order[BUFFER_CLASS_COUNT] = { BUFFER_CLASS_DEFAULT, BUFFER_CLASS_SMALL, BUFFER_CLASS_LARGE };
+    BufferClass* classes = rm->buffer_classes;
+    classes[BUFFER_CLASS_SMALL].size = rm->config.small_buffer_size;
+    classes[BUFFER_CLASS_SMALL].count = rm->config.small_buffer_count;
+    classes[BUFFER_CLASS_DEFAULT].size = rm->config.buffer_size;
+    classes[BUFFER_CLASS_DEFAULT].count = rm->config.buffer_count;
+    classes[BUFFER_CLASS_LARGE].size = rm->config.large_buffer_size;
+    classes[BUFFER_CLASS_LARGE].count = rm->config.large_buffer_count;
+    unsigned first = 0;
+    for (int i = 0; i < BUFFER_CLASS_COUNT; i++) {
+        BufferClass* cls = &classes[order[i]];
+        cls->first = first;
+        cls->free_ids = NULL;
+        cls->free_count = 0;
+        first += cls->count;
+    }
+    rm->receive_buffer_count = first;
+}
+
+// 初始化缓冲区池
+static int init_buffer_pool(ResourceManager* rm, int size) {
+    rm->buffer_pool = calloc(size, sizeof(BufferPoolItem));
+    if (!rm->buffer_pool) {
+        return -1;
+    }
+    rm->buffer_pool_size = size;
+    // 每种规格的缓冲区从工作线程的区域中连续切分，区域空间不足时退回单独分配
+    for (int c = 0; c < BUFFER_CLASS_COUNT; c++) {
+        const BufferClass* cls = &rm->buffer_classes[c];
+        size_t buffer_size = cls->size;
+        char* slab = cls->count ? arena_alloc(&rm->arena, (size_t)cls->count * buffer_size, 64) : NULL;
+        for (unsigned k = 0; k < cls->count; k++) {
+            BufferPoolItem* item = &rm->buffer_pool[cls->first + k];
+            item->buffer = slab ? slab + (size_t)k * buffer_size : malloc(buffer_size);
+            if (!item->buffer) {
+                // 已分配的缓冲区由 cleanup_buffers 释放
+                return -1;
+            }
+            item->is_used = 0;
+        }
+    }
+    return 0;
+}
+
+// 从缓冲区池获取缓冲区
+static char* get_buffer_from_pool(ResourceManager* rm) {
+    for (int i = 0; i < rm->buffer_pool_size; i++) {
+        if (!rm->buffer_pool[i].is_used) {
+            rm->buffer_pool[i].is_used = 1;
+            return rm->buffer_pool[i].buffer;
+        }
+    }
+    return NULL;
+}
+
+// 每个工作线程区域的大小：各规格的接收缓冲区、文件 I/O 缓冲区和连接池的初始块，加上对齐余量
+static size_t worker_arena_size(const ResourceManager* rm) {
+    size_t connection_block = ((sizeof(struct connection) + 63) & ~(size_t)63) +
+                              ((sizeof(struct connection_cold) + 15) & ~(size_t)15);
+    return (size_t)rm->config.buffer_count * rm->config.buffer_size +
+           (size_t)rm->config.small_buffer_count * rm->config.small_buffer_size +
+           (size_t)rm->config.large_buffer_count * rm->config.large_buffer_size +
+           (size_t)IO_BUFFER_COUNT * IO_BUFFER_SIZE + 4096 + (size_t)rm->config.pool_blocks * connection_block +
+           3 * 64 + 128;
+}
+
+// 清理缓冲区池及固定缓冲区
+static void cleanup_buffers(ResourceManager* rm) {
+    if (rm->buffer_pool) {
+        for (int i = 0; i < rm->buffer_pool_size; i++) {
+            if (!arena_contains(&rm->arena, rm->buffer_pool[i].buffer)) {
+                free(rm->buffer_pool[i].buffer);
+            }
+        }
+        free(rm->buffer_pool);
+        rm->buffer_pool = NULL;
+        rm->buffer_pool_size = 0;
+    }
+    for (int c = 0; c < BUFFER_CLASS_COUNT; c++) {
+        free(rm->buffer_classes[c].free_ids);
+        rm->buffer_classes[c].free_ids = NULL;
+        rm->buffer_classes[c].free_count = 0;
+    }
+    free(rm->buffers);
+    rm->buffers = NULL;
+    free(rm->buffer_bitmap);
+    rm->buffer_bitmap = NULL;
+    if (!arena_contains(&rm->arena, rm->io_buffer_memory)) {
+        free(rm->io_buffer_memory);
+    }
+    rm->io_buffer_memory = NULL;
+    rm->io_buffer_bitmap = 0;
+}
+
+// 设置 io_uring 固定缓冲区
+static int setup_buffers(ResourceManager* rm) {
+    init_buffer_classes(rm);
+    unsigned buffer_count = rm->receive_buffer_count;
+    if (init_buffer_pool(rm, (int)buffer_count) < 0) {
+        handle_error(ERR_MEMORY_ALLOC_FAILED, "Failed to initialize buffer pool");
+        return -1;
+    }
+
+    // 分配 iovec 数组、占用位图和各规格的空闲栈，文件 I/O 缓冲区按页对齐以支持 O_DIRECT
+    rm->buffers = calloc(buffer_count + IO_BUFFER_COUNT, sizeof(struct iovec));
+    rm->buffer_bitmap = calloc((buffer_count + CHAR_BIT - 1) / CHAR_BIT, 1);
+    rm->io_buffer_memory = arena_alloc(&rm->arena, (size_t)IO_BUFFER_COUNT * IO_BUFFER_SIZE, 4096);
+    if (!rm->io_buffer_memory) {
+        rm->io_buffer_memory = aligned_alloc(4096, (size_t)IO_BUFFER_COUNT * IO_BUFFER_SIZE);
+    }
+    if (!rm->buffers || !rm->buffer_bitmap || !rm->io_buffer_memory) {
+        handle_error(ERR_MEMORY_ALLOC_FAILED, "Failed to allocate buffers");
+        return -1;
+    }
+    for (int c = 0; c < BUFFER_CLASS_COUNT; c++) {
+        BufferClass* cls = &rm->buffer_classes[c];
+        if (cls->count == 0) continue;
+        cls->free_ids = malloc(cls->count * sizeof(int));
+        if (!cls->free_ids) {
+            handle_error(ERR_MEMORY_ALLOC_FAILED, "Failed to allocate buffers");
+            return -1;
+        }
+        // 栈顶为编号最小的缓冲区
+        for (unsigned k = 0; k < cls->count; k++) {
+            cls->free_ids[k] = (int)(cls->first + cls->count - 1 - k);
+        }
+        cls->free_count = cls->count;
+    }
+
+    // 从缓冲区池中获取缓冲区并初始化 iovec
+    for (int c = 0; c < BUFFER_CLASS_COUNT; c++) {
+        const BufferClass* cls = &rm->buffer_classes[c];
+        for (unsigned i = cls->first; i < cls->first + cls->count; i++) {
+            rm->buffers[i].iov_base = get_buffer_from_pool(rm);
+            if (!rm->buffers[i].iov_base) {
+                handle_error(ERR_MEMORY_ALLOC_FAILED, "Failed to get buffer from pool");
+                return -1;
+            }
+            rm->buffers[i].iov_len = cls->size;
+        }
+    }
+    for (int i = 0; i < IO_BUFFER_COUNT; i++) {
+        rm->buffers[buffer_count + i].iov_base = rm->io_buffer_memory + (size_t)i * IO_BUFFER_SIZE;
+        rm->buffers[buffer_count + i].iov_len = IO_BUFFER_SIZE;
+    }
+    rm->io_buffer_bitmap = 0;
+
+    // 注册缓冲区到 io_uring
+    int ret = io_uring_register_buffers(rm->ring, rm->buffers, buffer_count + IO_BUFFER_COUNT);
+    if (ret) {
+        handle_error(ERR_URING_INIT_FAILED, "Failed to register buffers");
+        return -1;
+    }
+
+    return 0;
+}
+
+// 获取指定规格的空闲接收缓冲区ID
+int acquire_buffer_in_class(ResourceManager* rm, int cls) {
+    BufferClass* bc = &rm->buffer_classes[cls];
+    if (bc->free_count == 0) {
+        return -1;
+    }
+    int id = bc->free_ids[--bc->free_count];
+    rm->buffer_bitmap[id / CHAR_BIT] |= (1 << (id % CHAR_BIT));
+    rm->buffers_in_use++;
+    return id;
+}
+
+// 获取空闲缓冲区ID
+int acquire_buffer_id(ResourceManager* rm) {
+    int id = acquire_buffer_in_class(rm, BUFFER_CLASS_DEFAULT);
+    if (id == -1) id = acquire_buffer_in_class(rm, BUFFER_CLASS_SMALL);
+    if (id == -1) id = acquire_buffer_in_class(rm, BUFFER_CLASS_LARGE);
+    return id;
+}
+
+// 缓冲区ID所属的规格
+int buffer_class_of(const ResourceManager* rm, int id) {
+    for (int c = 0; c < BUFFER_CLASS_COUNT; c++) {
+        const BufferClass* cls = &rm->buffer_classes[c];
+        if ((unsigned)id - cls->first < cls->count) {
+            return c;
+        }
+    }
+    return BUFFER_CLASS_DEFAULT;
+}
+
+// 释放缓冲区ID
+void release_buffer_id(ResourceManager* rm, int id) {
+    if (id >= 0 && id < (int)rm->receive_buffer_count) {
+        int byte_index = id / CHAR_BIT;
+        int bit_index = id % CHAR_BIT;
+        if (rm->buffer_bitmap[byte_index] & (1 << bit_index)) {
+            rm->buffer_bitmap[byte_index] &= ~(1 << bit_index);
+            rm->buffers_in_use--;
+            BufferClass* cls = &rm->buffer_classes[buffer_class_of(rm, id)];
+            cls->free_ids[cls->free_count++] = id;
+        }
+    }
+}
+
+// 获取空闲的文件 I/O 缓冲区
+int acquire_io_buffer(ResourceManager* rm) {
+    uint64_t free_bits = ~rm->io_buffer_bitmap & (~0ULL >> (64 - IO_BUFFER_COUNT));
+    if (free_bits == 0) {
+        return -1;
+    }
+    int i = __builtin_ctzll(free_bits);
+    rm->io_buffer_bitmap |= 1ULL << i;
+    return (int)rm->receive_buffer_count + i;
+}
+
+// 释放文件 I/O 缓冲区
+void release_io_buffer(ResourceManager* rm, int index) {
+    int i = index - (int)rm->receive_buffer_count;
+    if (i >= 0 && i < IO_BUFFER_COUNT) {
+        rm->io_buffer_bitmap &= ~(1ULL << i);
+    }
+}
+
+// 创建 Unix 域监听套接字
+// 删除上次运行遗留的套接字文件：路径上不是套接字，或仍有进程在监听时不删除
+// 返回: 路径可以绑定返回 0，否则返回 -1
+static int remove_stale_socket(const struct sockaddr_un *addr, int type) {
+    struct stat st;
+    if (lstat(addr->sun_path, &st) < 0) {
+        return errno == ENOENT ? 0 : -1;
+    }
+    if (!S_ISSOCK(st.st_mode)) {
+        log_error("Unix socket path %s exists and is not a socket", addr->sun_path);
+        return -1;
+    }
+    // 只有连接被拒绝才说明没有进程在监听；连接成功或类型不同（EPROTOTYPE）都说明路径仍在使用
+    int probe = socket(AF_UNIX, type | SOCK_CLOEXEC, 0);
+    if (probe < 0) {
+        return -1;
+    }
+    int ret = connect(probe, (const struct sockaddr *)addr, sizeof(*addr));
+    int err = errno;
+    close(probe);
+    if (ret == 0 || err != ECONNREFUSED) {
+        log_error("Unix socket %s is in use by another process", addr->sun_path);
+        return -1;
+    }
+    unlink(addr->sun_path);
+    return 0;
+}
+
+int setup_unix_socket(const char *path, int type) {
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        handle_error(ERR_INVALID_ARGUMENT, "Unix socket path too long");
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    int sock = socket(AF_UNIX, type | SOCK_CLOEXEC, 0);
+    if (sock == -1) {
+        handle_error(ERR_SOCKET_CREATE_FAILED, "Failed to create unix socket");
+        return -1;
+    }
+
+    // 上次运行遗留的套接字文件会导致 bind 失败
+    if (remove_stale_socket(&addr, type) < 0) {
+        handle_error(ERR_SOCKET_BIND_FAILED, "Failed to bind unix socket");
+        close(sock);
+        return -1;
+    }
+    if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        handle_error(ERR_SOCKET_BIND_FAILED, "Failed to bind unix socket");
+        close(sock);
+        return -1;
+    }
+
+    if (listen(sock, SOMAXCONN) < 0) {
+        handle_error(ERR_SOCKET_LISTEN_FAILED, "Failed to listen on unix socket");
+        // 刚绑定的文件属于本进程，仍是套接字时删除
+        struct stat st;
+        if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+            unlink(path);
+        }
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+// 注册稀疏的固定文件表，旧内核不支持稀疏注册时改为注册全 -1 的数组
+static int setup_fixed_files(ResourceManager* rm) {
+    int ret = io_uring_register_files_sparse(rm->ring, FIXED_FILE_COUNT);
+    if (ret < 0) {
+        int* fds = malloc(sizeof(int) * FIXED_FILE_COUNT);
+        if (!fds) {
+            return -1;
+        }
+        for (int i = 0; i < FIXED_FILE_COUNT; i++) {
+            fds[i] = -1;
+        }
+        ret = io_uring_register_files(rm->ring, fds, FIXED_FILE_COUNT);
+        free(fds);
+        if (ret < 0) {
+            return -1;
+        }
+    }
+
+    rm->file_slot_bitmap = calloc((FIXED_FILE_COUNT + 63) / 64, sizeof(uint64_t));
+    if (!rm->file_slot_bitmap) {
+        io_uring_unregister_files(rm->ring);
+        return -1;
+    }
+    return 0;
+}
+
+// 将 fd 放入空闲的固定文件槽位
+int acquire_file_slot(ResourceManager* rm, int fd) {
+    if (!rm->file_slot_bitmap) {
+        return -1;
+    }
+    for (int word = 0; word < (FIXED_FILE_COUNT + 63) / 64; word++) {
+        uint64_t free_bits = ~rm->file_slot_bitmap[word];
+        if (free_bits == 0) {
+            continue;
+        }
+        int slot = word * 64 + __builtin_ctzll(free_bits);
+        if (slot >= FIXED_FILE_COUNT) {
+            return -1;
+        }
+        if (io_uring_register_files_update(rm->ring, (unsigned)slot, &fd, 1) != 1) {
+            return -1;
+        }
+        rm->file_slot_bitmap[word] |= 1ULL << (slot % 64);
+        return slot;
+    }
+    return -1;
+}
+
+// 释放固定文件槽位
+void release_file_slot(ResourceManager* rm, int slot) {
+    if (!rm->file_slot_bitmap || slot < 0 || slot >= FIXED_FILE_COUNT) {
+        return;
+    }
+    int empty = -1;
+    io_uring_register_files_update(rm->ring, (unsigned)slot, &empty, 1);
+    rm->file_slot_bitmap[slot / 64] &= ~(1ULL << (slot % 64));
+}
+
+// 按优先顺序尝试的 ring 设置标志组合：
+// SINGLE_ISSUER | DEFER_TASKRUN 时完成任务只在工作线程等待完成事件时运行，不再以 IPI 打断事件循环；
+// COOP_TASKRUN 在内核不支持延迟运行时同样避免 IPI；SUBMIT_ALL 使一个 SQE 出错时不中断其后的提交
+static const unsigned ring_flag_candidates[] = {
+    IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN | IORING_SETUP_COOP_TASKRUN |
+        IORING_SETUP_TASKRUN_FLAG | IORING_SETUP_SUBMIT_ALL | IORING_SETUP_CQSIZE | IORING_SETUP_CLAMP,
+    IORING_SETUP_COOP_TASKRUN | IORING_SETUP_TASKRUN_FLAG | IORING_SETUP_SUBMIT_ALL |
+        IORING_SETUP_CQSIZE | IORING_SETUP_CLAMP,
+    IORING_SETUP_SUBMIT_ALL | IORING_SETUP_CQSIZE | IORING_SETUP_CLAMP,
+    IORING_SETUP_CQSIZE | IORING_SETUP_CLAMP,
+};
+
+// 以给定的设置标志创建 ring
+static int init_ring(struct io_uring *ring, unsigned entries, unsigned cq_entries, unsigned flags) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = flags;
+    if (flags & IORING_SETUP_CQSIZE) {
+        params.cq_entries = cq_entries ? cq_entries : entries * CQ_RING_FACTOR;
+    }
+    return io_uring_queue_init_params(entries, ring, &params);
+}
+
+// 探测内核支持的 ring 设置标志
+unsigned probe_ring_flags(void) {
+    // 设置标志无法从操作码探测结果得知，内核对不认识的标志返回 -EINVAL，因此逐个尝试创建小 ring
+    for (size_t i = 0; i < sizeof(ring_flag_candidates) / sizeof(ring_flag_candidates[0]); i++) {
+        struct io_uring ring;
+        if (init_ring(&ring, 2, 0, ring_flag_candidates[i]) == 0) {
+            io_uring_queue_exit(&ring);
+            return ring_flag_candidates[i];
+        }
+    }
+    return 0;
+}
+
 // 初始化资源管理器
 void init_resource_manager(ResourceManager* rm, int port, int max_connections) {
     rm->server_socket = -1;
+    rm->udp_socket = -1;
     rm->ring = NULL;
     rm->connection_pool = NULL;
+    rm->connection_cold_pool = NULL;
     rm->connections = NULL;
+    rm->offload_pool = NULL;
+    rm->buffers = NULL;
+    rm->buffer_pool = NULL;
+    rm->buffer_pool_size = 0;
+    rm->buffer_bitmap = NULL;
+    memset(rm->buffer_classes, 0, sizeof(rm->buffer_classes));
+    rm->receive_buffer_count = 0;
+    rm->io_buffer_memory = NULL;
+    rm->io_buffer_bitmap = 0;
+    rm->file_slot_bitmap = NULL;
+    rm->file_server = NULL;
+    rm->async_files = NULL;
+    rm->udp_server = NULL;
+    rm->on_datagram = NULL;
+    rm->proxy = NULL;
+    rm->proxy_config = NULL;
+    rm->tls = NULL;
+    rm->tls_context = NULL;
     rm->port = port;
     rm->max_connections = max_connections;
+    rm->offload_threads = 0;
+    rm->worker_index = 0;
+    rm->ring_flags = 0;
+    rm->link_send_recv = 0;
+    rm->buffers_in_use = 0;
+    rm->accepts_paused = 0;
+    rm->accept_resume_ns = 0;
+    rm->accept_timer_armed = 0;
+    rm->shed_next_ns = 0;
+    rm->draining = 0;
+    rm->lru_head = NULL;
+    rm->lru_tail = NULL;
+    rm->sched_round = 0;
+    rm->deferred_head = NULL;
+    rm->deferred_tail = NULL;
+    rm->huge_pages = 0;
+    memset(&rm->arena, 0, sizeof(rm->arena));
+    rm->arena.node = -1;
+    server_config_init(&rm->config);
+    rm->recorder = NULL;
+    rm->logger = NULL;
+    rm->coroutines = NULL;
+    rm->coroutine_fn = NULL;
+    rm->coroutine_frame_size = 0;
+    rm->pubsub = NULL;
+    rm->capture = NULL;
 }
 
 // 清理资源管理器
@@ -69,23 +517,68 @@ void cleanup_resource_manager(ResourceManager* rm) {
     if (rm->server_socket >= 0) {
         close(rm->server_socket);
     }
+    if (rm->udp_socket >= 0) {
+        close(rm->udp_socket);
+    }
+    if (rm->file_server) {
+        file_server_destroy(rm->file_server);
+    }
+    // ring 退出后的清理回调（文件操作取消、卸载任务丢弃）不再恢复协程
+    if (rm->coroutines) {
+        coroutine_scheduler_stop(rm->coroutines);
+    }
     if (rm->ring) {
         io_uring_queue_exit(rm->ring);
         free(rm->ring);
     }
+    async_file_cleanup(rm);
+    // 接收缓冲区环和发送批次可能仍被内核使用，在 ring 退出后释放
+    if (rm->udp_server) {
+        udp_server_destroy(rm->udp_server);
+    }
+    // 复制模式的缓冲区可能仍被内核写入，同样在 ring 退出后释放
+    if (rm->proxy) {
+        proxy_destroy(rm->proxy);
+    }
+    if (rm->tls) {
+        tls_server_destroy(rm->tls);
+    }
+    // 在途的日志写请求在 ring 退出时结束，之后同步写出剩余记录
+    if (rm->logger) {
+        logger_destroy(rm->logger);
+    }
+    capture_worker_destroy(rm->capture);
+    free(rm->file_slot_bitmap);
+    // 在途的发送引用订阅者的发送队列，在 ring 退出后释放
+    pubsub_worker_destroy(rm->pubsub);
+    // 在 ring 退出后销毁线程池，确保内核不再写入 eventfd 读缓冲区
+    if (rm->offload_pool) {
+        offload_pool_destroy(rm->offload_pool, rm);
+    }
+    coroutine_scheduler_destroy(rm->coroutines);
     if (rm->connection_pool) {
         memory_pool_destroy(rm->connection_pool);
     }
+    if (rm->connection_cold_pool) {
+        memory_pool_destroy(rm->connection_cold_pool);
+    }
     if (rm->connections) {
         free(rm->connections);
     }
+    cleanup_buffers(rm);
+    // 注册缓冲区和连接池的初始块都在区域中，最后解除映射
+    arena_destroy(&rm->arena);
 }
 
 // 分配资源
 int allocate_resource(ResourceManager* rm, ResourceType type) {
     switch (type) {
         case RESOURCE_SERVER_SOCKET:
-            rm->server_socket = setup_listening_socket(rm->port);
+            // 热重启时使用旧进程交接的监听套接字，内核队列中的连接不会丢失
+            if (rm->server_socket >= 0) {
+                break;
+            }
+            rm->server_socket = setup_listening_socket(rm->port, SOCK_STREAM);
             if (rm->server_socket < 0) {
                 handle_error(ERR_RESOURCE_INIT_FAILED, "Failed to set up server socket");
                 return -1;
@@ -98,7 +591,12 @@ int allocate_resource(ResourceManager* rm, ResourceType type) {
                 handle_error(ERR_MEMORY_ALLOC_FAILED, "Failed to allocate memory for io_uring");
                 return -1;
             }
-            if (io_uring_queue_init(QUEUE_DEPTH, rm->ring, 0) < 0) {
+            int ret = init_ring(rm->ring, rm->config.queue_depth, rm->config.cq_entries, rm->ring_flags);
+            if (ret < 0 && rm->ring_flags) {
+                // 探测用的小 ring 能创建而正式的 ring 失败时（如锁定内存不足），退回默认设置
+                ret = init_ring(rm->ring, rm->config.queue_depth, 0, 0);
+            }
+            if (ret < 0) {
                 handle_error(ERR_URING_INIT_FAILED, "Failed to initialize io_uring");
                 free(rm->ring);
                 rm->ring = NULL;
@@ -106,9 +604,20 @@ int allocate_resource(ResourceManager* rm, ResourceType type) {
             }
             break;
 
+        case RESOURCE_ARENA:
+            if (arena_init(&rm->arena, worker_arena_size(rm), rm->huge_pages) < 0) {
+                handle_error(ERR_MEMORY_ALLOC_FAILED, "Failed to map buffer arena");
+                return -1;
+            }
+            break;
+
         case RESOURCE_CONNECTION_POOL:
-            rm->connection_pool = memory_pool_create(sizeof(struct connection), 1000, 64);
-            if (!rm->connection_pool) {
+            // 热记录按缓存行对齐，每条独占一行；冷记录单独成池，不占用热记录所在的缓存行
+            rm->connection_pool = memory_pool_create_in(&rm->arena, sizeof(struct connection),
+                                                        rm->config.pool_blocks, 64);
+            rm->connection_cold_pool = memory_pool_create_in(&rm->arena, sizeof(struct connection_cold),
+                                                             rm->config.pool_blocks, 16);
+            if (!rm->connection_pool || !rm->connection_cold_pool) {
                 handle_error(ERR_MEMORY_ALLOC_FAILED, "Failed to create connection memory pool");
                 return -1;
             }
@@ -122,6 +631,102 @@ int allocate_resource(ResourceManager* rm, ResourceType type) {
             }
             break;
 
+        case RESOURCE_OFFLOAD_POOL:
+            rm->offload_pool = offload_pool_create(rm->offload_threads);
+            if (!rm->offload_pool) {
+                handle_error(ERR_RESOURCE_INIT_FAILED, "Failed to create offload thread pool");
+                return -1;
+            }
+            if (offload_pool_start(rm->offload_pool, rm) < 0) {
+                return -1;
+            }
+            break;
+
+        case RESOURCE_FIXED_BUFFERS:
+            if (setup_buffers(rm) < 0) {
+                cleanup_buffers(rm);
+                return -1;
+            }
+            break;
+
+        case RESOURCE_FIXED_FILES:
+            // 固定文件表是可选的优化，注册失败时退回普通 fd
+            if (setup_fixed_files(rm) < 0) {
+                log_warn("Failed to register fixed file table, using plain fds");
+            }
+            break;
+
+        case RESOURCE_FILE_SERVER:
+            rm->file_server = file_server_create(rm);
+            if (!rm->file_server) {
+                handle_error(ERR_MEMORY_ALLOC_FAILED, "Failed to create file server");
+                return -1;
+            }
+            break;
+
+        case RESOURCE_UDP_SERVER: {
+            int sock = rm->udp_socket >= 0 ? rm->udp_socket : setup_listening_socket(rm->port, SOCK_DGRAM);
+            rm->udp_socket = -1;
+            if (sock < 0) {
+                handle_error(ERR_RESOURCE_INIT_FAILED, "Failed to set up UDP socket");
+                return -1;
+            }
+            rm->udp_server = udp_server_create(rm, sock, rm->on_datagram);
+            if (!rm->udp_server) {
+                handle_error(ERR_RESOURCE_INIT_FAILED, "Failed to create UDP server");
+                return -1;
+            }
+            break;
+        }
+
+        case RESOURCE_PROXY:
+            rm->proxy = proxy_create(rm, rm->proxy_config);
+            if (!rm->proxy) {
+                handle_error(ERR_MEMORY_ALLOC_FAILED, "Failed to create proxy");
+                return -1;
+            }
+            break;
+
+        case RESOURCE_TLS:
+            rm->tls = tls_server_create(rm, rm->tls_context);
+            if (!rm->tls) {
+                handle_error(ERR_MEMORY_ALLOC_FAILED, "Failed to create TLS server");
+                return -1;
+            }
+            break;
+
+        case RESOURCE_LOGGER:
+            rm->logger = logger_create(rm);
+            if (!rm->logger) {
+                handle_error(ERR_MEMORY_ALLOC_FAILED, "Failed to create logger");
+                return -1;
+            }
+            break;
+
+        case RESOURCE_COROUTINES:
+            rm->coroutines = coroutine_scheduler_create(rm->coroutine_fn, rm->coroutine_frame_size);
+            if (!rm->coroutines) {
+                handle_error(ERR_MEMORY_ALLOC_FAILED, "Failed to create coroutine scheduler");
+                return -1;
+            }
+            break;
+
+        case RESOURCE_PUBSUB:
+            rm->pubsub = pubsub_worker_create(rm);
+            if (!rm->pubsub) {
+                handle_error(ERR_MEMORY_ALLOC_FAILED, "Failed to create pub/sub worker");
+                return -1;
+            }
+            break;
+
+        case RESOURCE_CAPTURE:
+            rm->capture = capture_worker_create(rm);
+            if (!rm->capture) {
+                handle_error(ERR_MEMORY_ALLOC_FAILED, "Failed to create traffic capture buffers");
+                return -1;
+            }
+            break;
+
         default:
             handle_error(ERR_INVALID_ARGUMENT, "Invalid resource type requested");
             return -1;
@@ -148,11 +753,19 @@ void free_resource(ResourceManager* rm, ResourceType type) {
             }
             break;
 
+        case RESOURCE_ARENA:
+            arena_destroy(&rm->arena);
+            break;
+
         case RESOURCE_CONNECTION_POOL:
             if (rm->connection_pool) {
                 memory_pool_destroy(rm->connection_pool);
                 rm->connection_pool = NULL;
             }
+            if (rm->connection_cold_pool) {
+                memory_pool_destroy(rm->connection_cold_pool);
+                rm->connection_cold_pool = NULL;
+            }
             break;
 
         case RESOURCE_CONNECTIONS_ARRAY:
@@ -162,6 +775,87 @@ void free_resource(ResourceManager* rm, ResourceType type) {
             }
             break;
 
+        case RESOURCE_OFFLOAD_POOL:
+            if (rm->offload_pool) {
+                offload_pool_destroy(rm->offload_pool, rm);
+                rm->offload_pool = NULL;
+            }
+            break;
+
+        case RESOURCE_FIXED_BUFFERS:
+            if (rm->ring && rm->buffers) {
+                io_uring_unregister_buffers(rm->ring);
+            }
+            cleanup_buffers(rm);
+            break;
+
+        case RESOURCE_FIXED_FILES:
+            if (rm->ring && rm->file_slot_bitmap) {
+                io_uring_unregister_files(rm->ring);
+            }
+            free(rm->file_slot_bitmap);
+            rm->file_slot_bitmap = NULL;
+            break;
+
+        case RESOURCE_FILE_SERVER:
+            if (rm->file_server) {
+                file_server_destroy(rm->file_server);
+                rm->file_server = NULL;
+            }
+            break;
+
+        case RESOURCE_UDP_SERVER:
+            if (rm->udp_server) {
+                if (rm->ring) {
+                    io_uring_unregister_buf_ring(rm->ring, UDP_BUFFER_GROUP);
+                }
+                udp_server_destroy(rm->udp_server);
+                rm->udp_server = NULL;
+            }
+            break;
+
+        case RESOURCE_PROXY:
+            if (rm->proxy) {
+                proxy_destroy(rm->proxy);
+                rm->proxy = NULL;
+            }
+            break;
+
+        case RESOURCE_TLS:
+            if (rm->tls) {
+                tls_server_destroy(rm->tls);
+                rm->tls = NULL;
+            }
+            break;
+
+        case RESOURCE_LOGGER:
+            // 写请求可能仍在途，须在 ring 退出后释放
+            if (rm->logger) {
+                logger_destroy(rm->logger);
+                rm->logger = NULL;
+            }
+            break;
+
+        case RESOURCE_COROUTINES:
+            // 挂起的协程仍被 ring 上的请求引用，须在 ring 退出后释放
+            if (rm->coroutines) {
+                coroutine_scheduler_destroy(rm->coroutines);
+                rm->coroutines = NULL;
+            }
+            break;
+
+        case RESOURCE_PUBSUB:
+            // 在途的发送引用订阅者，须在 ring 退出后释放
+            pubsub_worker_destroy(rm->pubsub);
+            rm->pubsub = NULL;
+            break;
+
+        case RESOURCE_CAPTURE:
+            // 写请求可能仍在途，须在 ring 退出后释放
+            capture_worker_destroy(rm->capture);
+            rm->capture = NULL;
+            break;
+
         default:
             handle_error(ERR_INVALID_ARGUMENT, "Attempt to free invalid resource type");
             break;
@@ -3,26 +3,120 @@
 
 #include <liburing.h>
 #include "memory_pool.h"
+#include "arena.h"
+#include "server_config.h"
+#include "recorder.h"
 #include "iouring_server.h"
+#include "offload.h"
 
 // 资源类型枚举
 typedef enum {
     RESOURCE_SERVER_SOCKET,
     RESOURCE_IO_URING,
+    RESOURCE_ARENA,
     RESOURCE_CONNECTION_POOL,
-    RESOURCE_CONNECTIONS_ARRAY
+    RESOURCE_CONNECTIONS_ARRAY,
+    RESOURCE_OFFLOAD_POOL,
+    RESOURCE_FIXED_BUFFERS,
+    RESOURCE_FIXED_FILES,
+    RESOURCE_FILE_SERVER,
+    RESOURCE_UDP_SERVER,
+    RESOURCE_PROXY,
+    RESOURCE_TLS,
+    RESOURCE_LOGGER,
+    RESOURCE_COROUTINES,
+    RESOURCE_PUBSUB,
+    RESOURCE_CAPTURE
 } ResourceType;
 
+// 缓冲区池项
+typedef struct {
+    char* buffer;
+    int is_used;
+} BufferPoolItem;
+
+// 接收缓冲区规格，按大小排列。默认规格即 buffer_size，新连接从默认规格开始，
+// 按最近的读取大小在相邻规格之间调整（见 iouring_server.c 的 adapt_buffer_class）
+typedef enum {
+    BUFFER_CLASS_SMALL,
+    BUFFER_CLASS_DEFAULT,
+    BUFFER_CLASS_LARGE,
+    BUFFER_CLASS_COUNT
+} BufferClassId;
+
+// 一种规格的接收缓冲区，在注册表中占据 [first, first + count)
+typedef struct {
+    unsigned size;
+    unsigned first;
+    unsigned count;                  // 为 0 表示未启用
+    int* free_ids;                   // 空闲缓冲区ID栈
+    unsigned free_count;
+} BufferClass;
+
 // 资源管理器结构体
 typedef struct ResourceManager {
-    int server_socket;
+    int server_socket;               // 启动前已设置（热重启接收的套接字）时直接使用
+    int udp_socket;                  // 热重启接收的数据报套接字，创建 UDP 服务器时接管
     struct io_uring* ring;
-    MemoryPool* connection_pool;
+    MemoryPool* connection_pool;     // 连接的热记录（按缓存行对齐）
+    MemoryPool* connection_cold_pool;  // 连接的冷记录
     struct connection** connections;
+    OffloadPool* offload_pool;
+    struct iovec* buffers;           // 注册到 io_uring 的固定缓冲区
+    BufferPoolItem* buffer_pool;
+    int buffer_pool_size;
+    unsigned char* buffer_bitmap;    // 接收缓冲区占用位图
+    BufferClass buffer_classes[BUFFER_CLASS_COUNT];
+    unsigned receive_buffer_count;   // 各规格接收缓冲区的总数
+    char* io_buffer_memory;          // 文件 I/O 固定缓冲区，注册在接收缓冲区之后
+    uint64_t io_buffer_bitmap;
+    uint64_t* file_slot_bitmap;      // 固定文件槽位占用位图，为 NULL 表示未注册固定文件表
+    struct FileServer* file_server;
+    struct AsyncFile* async_files;   // 处理器打开的异步文件，ring 退出后统一释放
+    struct UdpServer* udp_server;    // 数据报模式，未设置 on_datagram 时为 NULL
+    on_datagram_cb on_datagram;
+    struct ProxyServer* proxy;       // 代理模式，未设置上游时为 NULL
+    const struct ProxyConfig* proxy_config;
+    struct TlsServer* tls;           // TLS 握手，未设置证书时为 NULL
+    struct TlsContext* tls_context;
     int port;
     int max_connections;
+    int offload_threads;
+    int worker_index;                // 所属工作线程编号
+    unsigned ring_flags;             // 创建 ring 使用的设置标志，见 probe_ring_flags
+    int link_send_recv;              // 发送和下一次读取链接提交，见 set_link_send_recv
+    unsigned buffers_in_use;         // 已占用的接收缓冲区数（所有规格）
+    int accepts_paused;              // 过载时暂停的接受请求（ACCEPT_PAUSED_*）
+    uint64_t accept_resume_ns;       // 接受失败（如文件描述符耗尽）后，最早重新接受连接的时间
+    struct __kernel_timespec accept_timeout;  // 暂停接受期间唤醒事件循环的定时器时长
+    int accept_timer_armed;          // 该定时器是否已提交且尚未完成
+    uint64_t shed_next_ns;           // 下一批关闭空闲连接的最早时间
+    int draining;                    // 监听套接字已交给新进程，不再接受连接，等待已有连接结束
+    struct connection* lru_head;     // 最久未活动的连接
+    struct connection* lru_tail;     // 最近活动的连接
+    uint32_t sched_round;            // 事件循环轮次，公平调度按轮次结算每个连接的预算
+    struct connection* deferred_head;  // 超出预算、等待重新读取的连接（先进先出）
+    struct connection* deferred_tail;
+    int huge_pages;                  // 区域是否使用大页，见 set_huge_pages
+    ServerConfig config;             // ring 和缓冲区的大小（所有工作线程相同）
+    Arena arena;                     // 注册缓冲区和连接池初始块所在的区域，绑定到工作线程的 NUMA 节点
+    FlightRecorder* recorder;        // 事件记录器，未启用时为 NULL
+    struct Logger* logger;           // 日志缓冲区，经 ring 批量写出
+    struct CoroutineScheduler* coroutines;  // 协程处理器，未设置时为 NULL
+    coroutine_fn coroutine_fn;
+    size_t coroutine_frame_size;
+    struct PubsubWorker* pubsub;     // 发布订阅的主题表和订阅者，未启用时为 NULL
+    struct Capture* capture;         // 流量捕获缓冲区，未启用时为 NULL
 } ResourceManager;
 
+// 创建 Unix 域监听套接字，失败时返回 -1。路径上遗留的套接字文件在没有进程监听时被替换；
+// 路径上是其他文件或仍有进程在监听时失败
+int setup_unix_socket(const char *path, int type);
+
+// 探测内核支持的 ring 设置标志：优先 SINGLE_ISSUER | DEFER_TASKRUN，其次 COOP_TASKRUN，
+// 并尽量加上 SUBMIT_ALL 和更大的 CQ；全部不支持时返回 0。只需在启动时调用一次
+unsigned probe_ring_flags(void);
+
 // 初始化资源管理器
 void init_resource_manager(ResourceManager* rm, int port, int max_connections);
 
@@ -35,4 +129,28 @@ int allocate_resource(ResourceManager* rm, ResourceType type);
 // 释放资源
 void free_resource(ResourceManager* rm, ResourceType type);
 
+// 获取空闲的接收缓冲区ID：优先默认规格，其次较小、较大的规格，无可用缓冲区时返回 -1
+int acquire_buffer_id(ResourceManager* rm);
+
+// 获取指定规格的空闲接收缓冲区ID，该规格无可用缓冲区时返回 -1
+int acquire_buffer_in_class(ResourceManager* rm, int cls);
+
+// 接收缓冲区ID所属的规格（BUFFER_CLASS_*）
+int buffer_class_of(const ResourceManager* rm, int id);
+
+// 释放固定缓冲区ID
+void release_buffer_id(ResourceManager* rm, int id);
+
+// 获取空闲的文件 I/O 固定缓冲区，返回其在注册表中的索引，无可用缓冲区时返回 -1
+int acquire_io_buffer(ResourceManager* rm);
+
+// 释放文件 I/O 固定缓冲区
+void release_io_buffer(ResourceManager* rm, int index);
+
+// 将 fd 放入空闲的固定文件槽位，返回槽位号；未注册固定文件表或无空闲槽位时返回 -1
+int acquire_file_slot(ResourceManager* rm, int fd);
+
+// 清空并释放固定文件槽位（不关闭原 fd）
+void release_file_slot(ResourceManager* rm, int slot);
+
 #endif // RESOURCE_MANAGER_H
\ No newline at end of file
@@ -0,0 +1,627 @@
+#include "resp.h"
+#include "ring_buffer.h"
+#include "logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <limits.h>
+#include <pthread.h>
+
+#define MAX_COMMANDS 64
+#define STORE_INITIAL_BUCKETS 1024
+
+// 解析结果
+#define PARSE_OK 1
+#define PARSE_INCOMPLETE 0
+#define PARSE_ERROR -1
+#define PARSE_NO_ROOM -2
+
+// 命令表项
+typedef struct {
+    const char *name;
+    size_t name_len;
+    int arity;
+    resp_command_fn fn;
+} RespCommandEntry;
+
+// 一批已解析的命令
+typedef struct {
+    RespSlice args[RESP_MAX_ARGS];
+    int argc[RESP_BATCH_COMMANDS];
+    int offset[RESP_BATCH_COMMANDS];
+    int commands;
+    int used_args;
+} RespBatch;
+
+// 键值存储项，键和值紧跟在结构体之后
+typedef struct StoreEntry {
+    struct StoreEntry *next;
+    size_t hash;
+    size_t key_len;
+    size_t value_len;
+    char data[];
+} StoreEntry;
+
+// 内置的内存键值存储
+typedef struct {
+    StoreEntry **buckets;
+    size_t bucket_count;
+    size_t size;
+    pthread_mutex_t lock;
+} Store;
+
+static RespCommandEntry command_table[MAX_COMMANDS];
+static int command_count = 0;
+static pthread_once_t builtins_once = PTHREAD_ONCE_INIT;
+
+static Store store = { NULL, 0, 0, PTHREAD_MUTEX_INITIALIZER };
+
+static void register_builtin_commands(void);
+
+// ---------------- 回复构造 ----------------
+
+static void reply_init(RespReply *reply) {
+    reply->data = reply->inline_buf;
+    reply->len = 0;
+    reply->capacity = sizeof(reply->inline_buf);
+    reply->oom = 0;
+}
+
+static void reply_free(RespReply *reply) {
+    if (reply->data != reply->inline_buf) {
+        free(reply->data);
+    }
+    reply_init(reply);
+}
+
+static int reply_reserve(RespReply *reply, size_t extra) {
+    if (reply->oom) return -1;
+    if (reply->len + extra <= reply->capacity) return 0;
+
+    size_t new_capacity = reply->capacity;
+    while (new_capacity < reply->len + extra) {
+        new_capacity *= 2;
+    }
+
+    char *new_data;
+    if (reply->data == reply->inline_buf) {
+        new_data = malloc(new_capacity);
+        if (new_data) memcpy(new_data, reply->data, reply->len);
+    } else {
+        new_data = realloc(reply->data, new_capacity);
+    }
+    if (!new_data) {
+        reply->oom = 1;
+        return -1;
+    }
+    reply->data = new_data;
+    reply->capacity = new_capacity;
+    return 0;
+}
+
+static void reply_append(RespReply *reply, const char *data, size_t len) {
+    if (reply_reserve(reply, len) < 0) return;
+    memcpy(reply->data + reply->len, data, len);
+    reply->len += len;
+}
+
+// 写入 "<prefix><value>\r\n" 形式的头部
+static void reply_header(RespReply *reply, char prefix, long long value) {
+    char header[32];
+    int n = snprintf(header, sizeof(header), "%c%lld\r\n", prefix, value);
+    reply_append(reply, header, (size_t)n);
+}
+
+void resp_reply_simple(RespContext *ctx, const char *str) {
+    reply_append(ctx->reply, "+", 1);
+    reply_append(ctx->reply, str, strlen(str));
+    reply_append(ctx->reply, "\r\n", 2);
+}
+
+void resp_reply_error(RespContext *ctx, const char *str) {
+    reply_append(ctx->reply, "-", 1);
+    reply_append(ctx->reply, str, strlen(str));
+    reply_append(ctx->reply, "\r\n", 2);
+}
+
+void resp_reply_integer(RespContext *ctx, long long value) {
+    reply_header(ctx->reply, ':', value);
+}
+
+void resp_reply_bulk(RespContext *ctx, const char *data, size_t len) {
+    reply_header(ctx->reply, '$', (long long)len);
+    reply_append(ctx->reply, data, len);
+    reply_append(ctx->reply, "\r\n", 2);
+}
+
+void resp_reply_null(RespContext *ctx) {
+    if (ctx->proto == 3) {
+        reply_append(ctx->reply, "_\r\n", 3);
+    } else {
+        reply_append(ctx->reply, "$-1\r\n", 5);
+    }
+}
+
+void resp_reply_array(RespContext *ctx, long long count) {
+    reply_header(ctx->reply, '*', count);
+}
+
+void resp_reply_map(RespContext *ctx, long long count) {
+    if (ctx->proto == 3) {
+        reply_header(ctx->reply, '%', count);
+    } else {
+        reply_header(ctx->reply, '*', count * 2);
+    }
+}
+
+// ---------------- 协议解析 ----------------
+
+// 解析以 \r\n 结尾的整数行，p 指向类型字符之后
+static int parse_line_integer(const char *p, const char *end, long long *value, const char **next) {
+    const char *cr = memchr(p, '\r', (size_t)(end - p));
+    if (!cr || cr + 1 >= end) return PARSE_INCOMPLETE;
+    if (cr[1] != '\n' || cr == p) return PARSE_ERROR;
+
+    int negative = 0;
+    if (*p == '-') {
+        negative = 1;
+        p++;
+    }
+    long long v = 0;
+    for (; p < cr; p++) {
+        if (*p < '0' || *p > '9' || v > (LLONG_MAX - 9) / 10) return PARSE_ERROR;
+        v = v * 10 + (*p - '0');
+    }
+    *value = negative ? -v : v;
+    *next = cr + 2;
+    return PARSE_OK;
+}
+
+// 解析内联命令（以空白分隔的一行）
+static int parse_inline(const char *p, const char *end, RespSlice *argv, int room, int *argc, size_t *used) {
+    const char *nl = memchr(p, '\n', (size_t)(end - p));
+    if (!nl) {
+        return (end - p) > RESP_MAX_PENDING ? PARSE_ERROR : PARSE_INCOMPLETE;
+    }
+    const char *line_end = (nl > p && nl[-1] == '\r') ? nl - 1 : nl;
+
+    int n = 0;
+    const char *s = p;
+    while (s < line_end) {
+        while (s < line_end && (*s == ' ' || *s == '\t')) s++;
+        if (s == line_end) break;
+        const char *token = s;
+        while (s < line_end && *s != ' ' && *s != '\t') s++;
+        if (n == room) return n == RESP_MAX_ARGS ? PARSE_ERROR : PARSE_NO_ROOM;
+        argv[n].ptr = token;
+        argv[n].len = (size_t)(s - token);
+        n++;
+    }
+
+    *argc = n;
+    *used = (size_t)(nl + 1 - p);
+    return PARSE_OK;
+}
+
+// 解析一条完整命令，参数切片直接指向输入数据
+static int parse_command(const char *p, const char *end, RespSlice *argv, int room, int *argc, size_t *used) {
+    if (*p != '*') {
+        return parse_inline(p, end, argv, room, argc, used);
+    }
+
+    const char *start = p;
+    long long count;
+    int ret = parse_line_integer(p + 1, end, &count, &p);
+    if (ret != PARSE_OK) return ret;
+    if (count > RESP_MAX_ARGS) return PARSE_ERROR;
+    if (count > room) return PARSE_NO_ROOM;
+
+    for (long long i = 0; i < count; i++) {
+        if (p >= end) return PARSE_INCOMPLETE;
+        if (*p != '$') return PARSE_ERROR;
+
+        long long len;
+        ret = parse_line_integer(p + 1, end, &len, &p);
+        if (ret != PARSE_OK) return ret;
+        if (len < 0 || len > RESP_MAX_PENDING) return PARSE_ERROR;
+        if (end - p < len + 2) return PARSE_INCOMPLETE;
+        if (p[len] != '\r' || p[len + 1] != '\n') return PARSE_ERROR;
+
+        argv[i].ptr = p;
+        argv[i].len = (size_t)len;
+        p += len + 2;
+    }
+
+    *argc = count > 0 ? (int)count : 0;
+    *used = (size_t)(p - start);
+    return PARSE_OK;
+}
+
+// ---------------- 命令派发 ----------------
+
+static const RespCommandEntry *lookup_command(const RespSlice *name) {
+    for (int i = 0; i < command_count; i++) {
+        const RespCommandEntry *entry = &command_table[i];
+        if (entry->name_len == name->len && strncasecmp(entry->name, name->ptr, name->len) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static void dispatch_command(RespContext *ctx, const RespSlice *argv, int argc) {
+    const RespCommandEntry *entry = lookup_command(&argv[0]);
+    if (!entry) {
+        resp_reply_error(ctx, "ERR unknown command");
+        return;
+    }
+    if ((entry->arity > 0 && argc != entry->arity) || (entry->arity < 0 && argc < -entry->arity)) {
+        resp_reply_error(ctx, "ERR wrong number of arguments");
+        return;
+    }
+    entry->fn(ctx, argv, argc);
+}
+
+// 一次性派发整批命令，回复按顺序追加到回复缓冲区
+static void dispatch_batch(RespContext *ctx, RespBatch *batch) {
+    for (int i = 0; i < batch->commands; i++) {
+        dispatch_command(ctx, &batch->args[batch->offset[i]], batch->argc[i]);
+    }
+    batch->commands = 0;
+    batch->used_args = 0;
+}
+
+// 解析并执行 data 中所有完整的命令，返回已消费的字节数
+static size_t process_input(RespContext *ctx, RespBatch *batch, const char *data, size_t len) {
+    size_t pos = 0;
+    batch->commands = 0;
+    batch->used_args = 0;
+
+    while (pos < len) {
+        int argc = 0;
+        size_t used = 0;
+        int ret = parse_command(data + pos, data + len, &batch->args[batch->used_args],
+                                RESP_MAX_ARGS - batch->used_args, &argc, &used);
+        if (ret == PARSE_INCOMPLETE) {
+            break;
+        }
+        if (ret == PARSE_NO_ROOM) {
+            dispatch_batch(ctx, batch);
+            continue;
+        }
+        if (ret == PARSE_ERROR) {
+            // 协议错误时丢弃剩余输入
+            dispatch_batch(ctx, batch);
+            resp_reply_error(ctx, "ERR Protocol error");
+            return len;
+        }
+
+        if (argc > 0) {
+            batch->offset[batch->commands] = batch->used_args;
+            batch->argc[batch->commands] = argc;
+            batch->used_args += argc;
+            batch->commands++;
+            if (batch->commands == RESP_BATCH_COMMANDS) {
+                dispatch_batch(ctx, batch);
+            }
+        }
+        pos += used;
+    }
+
+    dispatch_batch(ctx, batch);
+    return pos;
+}
+
+int resp_register_command(const char *name, int arity, resp_command_fn fn) {
+    if (command_count >= MAX_COMMANDS || !name || !fn) {
+        return -1;
+    }
+    command_table[command_count].name = name;
+    command_table[command_count].name_len = strlen(name);
+    command_table[command_count].arity = arity;
+    command_table[command_count].fn = fn;
+    command_count++;
+    return 0;
+}
+
+// RESP 协议的 on_data 回调
+void resp_on_data(struct connection *conn, const char *data, size_t len, struct ResourceManager *rm) {
+    (void)rm;
+
+    pthread_once(&builtins_once, register_builtin_commands);
+
+    // 每个工作线程一份批次缓冲区
+    static _Thread_local RespBatch batch;
+    RespReply reply;
+    reply_init(&reply);
+
+    RespContext ctx = {
+        .conn = conn,
+        .reply = &reply,
+        .proto = conn->cold->user_data == 3 ? 3 : 2
+    };
+
+    RingBuffer *pending = &conn->cold->read_buffer;
+    size_t pending_len = ring_buffer_used_space(pending);
+
+    if (pending_len == 0) {
+        // 快速路径：直接在接收缓冲区上解析，不完整的尾部暂存到读缓冲区
+        size_t consumed = process_input(&ctx, &batch, data, len);
+        if (consumed < len && ring_buffer_write(pending, data + consumed, len - consumed) != 0) {
+            resp_reply_error(&ctx, "ERR out of memory");
+        }
+    } else if (pending_len + len > RESP_MAX_PENDING) {
+        ring_buffer_skip(pending, pending_len);
+        resp_reply_error(&ctx, "ERR Protocol error: request too large");
+    } else {
+        // 慢速路径：与上次剩余的数据拼接后再解析
+        const char *buf = NULL;
+        if (ring_buffer_write(pending, data, len) == 0) {
+            buf = ring_buffer_linearize(pending);
+        }
+        if (buf) {
+            size_t consumed = process_input(&ctx, &batch, buf, pending_len + len);
+            ring_buffer_skip(pending, consumed);
+        } else {
+            ring_buffer_skip(pending, ring_buffer_used_space(pending));
+            resp_reply_error(&ctx, "ERR out of memory");
+        }
+    }
+
+    conn->cold->user_data = (uintptr_t)ctx.proto;
+
+    // 整批回复一次性写入写缓冲区，由服务器统一发送
+    if (reply.len > 0 && !reply.oom) {
+        if (ring_buffer_write(&conn->cold->write_buffer, reply.data, reply.len) != 0) {
+            log_error("Failed to write RESP replies to buffer");
+        }
+    }
+    reply_free(&reply);
+}
+
+// ---------------- 内置键值存储 ----------------
+
+static size_t hash_key(const char *key, size_t len) {
+    // FNV-1a
+    size_t hash = (size_t)14695981039346656037ULL;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)key[i];
+        hash *= (size_t)1099511628211ULL;
+    }
+    return hash;
+}
+
+static int store_grow(void) {
+    size_t new_count = store.bucket_count ? store.bucket_count * 2 : STORE_INITIAL_BUCKETS;
+    StoreEntry **new_buckets = calloc(new_count, sizeof(StoreEntry*));
+    if (!new_buckets) return -1;
+
+    for (size_t i = 0; i < store.bucket_count; i++) {
+        StoreEntry *entry = store.buckets[i];
+        while (entry) {
+            StoreEntry *next = entry->next;
+            size_t index = entry->hash & (new_count - 1);
+            entry->next = new_buckets[index];
+            new_buckets[index] = entry;
+            entry = next;
+        }
+    }
+
+    free(store.buckets);
+    store.buckets = new_buckets;
+    store.bucket_count = new_count;
+    return 0;
+}
+
+// 查找键，返回指向链表中该项指针的位置，调用者需持有锁
+static StoreEntry **store_find(const RespSlice *key, size_t hash) {
+    if (store.bucket_count == 0) return NULL;
+    StoreEntry **link = &store.buckets[hash & (store.bucket_count - 1)];
+    while (*link) {
+        StoreEntry *entry = *link;
+        if (entry->hash == hash && entry->key_len == key->len &&
+            memcmp(entry->data, key->ptr, key->len) == 0) {
+            return link;
+        }
+        link = &entry->next;
+    }
+    return NULL;
+}
+
+// 写入键值，调用者需持有锁
+static int store_put_locked(const RespSlice *key, size_t hash, const char *value, size_t value_len) {
+    StoreEntry *entry = malloc(sizeof(StoreEntry) + key->len + value_len);
+    if (!entry) return -1;
+    entry->hash = hash;
+    entry->key_len = key->len;
+    entry->value_len = value_len;
+    memcpy(entry->data, key->ptr, key->len);
+    memcpy(entry->data + key->len, value, value_len);
+
+    StoreEntry **link = store_find(key, hash);
+    if (link) {
+        // 替换旧值
+        StoreEntry *old = *link;
+        entry->next = old->next;
+        *link = entry;
+        free(old);
+        return 0;
+    }
+
+    if (store.size >= store.bucket_count && store_grow() < 0) {
+        free(entry);
+        return -1;
+    }
+    size_t index = hash & (store.bucket_count - 1);
+    entry->next = store.buckets[index];
+    store.buckets[index] = entry;
+    store.size++;
+    return 0;
+}
+
+static int store_set(const RespSlice *key, const char *value, size_t value_len) {
+    size_t hash = hash_key(key->ptr, key->len);
+    pthread_mutex_lock(&store.lock);
+    int ret = store_put_locked(key, hash, value, value_len);
+    pthread_mutex_unlock(&store.lock);
+    return ret;
+}
+
+static int store_delete(const RespSlice *key) {
+    pthread_mutex_lock(&store.lock);
+    StoreEntry **link = store_find(key, hash_key(key->ptr, key->len));
+    if (!link) {
+        pthread_mutex_unlock(&store.lock);
+        return 0;
+    }
+    StoreEntry *entry = *link;
+    *link = entry->next;
+    store.size--;
+    pthread_mutex_unlock(&store.lock);
+    free(entry);
+    return 1;
+}
+
+// ---------------- 内置命令 ----------------
+
+static void cmd_ping(RespContext *ctx, const RespSlice *argv, int argc) {
+    if (argc > 1) {
+        resp_reply_bulk(ctx, argv[1].ptr, argv[1].len);
+    } else {
+        resp_reply_simple(ctx, "PONG");
+    }
+}
+
+static void cmd_echo(RespContext *ctx, const RespSlice *argv, int argc) {
+    (void)argc;
+    resp_reply_bulk(ctx, argv[1].ptr, argv[1].len);
+}
+
+static void cmd_get(RespContext *ctx, const RespSlice *argv, int argc) {
+    (void)argc;
+    pthread_mutex_lock(&store.lock);
+    StoreEntry **link = store_find(&argv[1], hash_key(argv[1].ptr, argv[1].len));
+    if (link) {
+        resp_reply_bulk(ctx, (*link)->data + (*link)->key_len, (*link)->value_len);
+    } else {
+        resp_reply_null(ctx);
+    }
+    pthread_mutex_unlock(&store.lock);
+}
+
+static void cmd_set(RespContext *ctx, const RespSlice *argv, int argc) {
+    if (argc != 3) {
+        resp_reply_error(ctx, "ERR syntax error");
+        return;
+    }
+    if (store_set(&argv[1], argv[2].ptr, argv[2].len) < 0) {
+        resp_reply_error(ctx, "ERR out of memory");
+        return;
+    }
+    resp_reply_simple(ctx, "OK");
+}
+
+static void cmd_del(RespContext *ctx, const RespSlice *argv, int argc) {
+    long long removed = 0;
+    for (int i = 1; i < argc; i++) {
+        removed += store_delete(&argv[i]);
+    }
+    resp_reply_integer(ctx, removed);
+}
+
+static void cmd_exists(RespContext *ctx, const RespSlice *argv, int argc) {
+    long long found = 0;
+    pthread_mutex_lock(&store.lock);
+    for (int i = 1; i < argc; i++) {
+        if (store_find(&argv[i], hash_key(argv[i].ptr, argv[i].len))) {
+            found++;
+        }
+    }
+    pthread_mutex_unlock(&store.lock);
+    resp_reply_integer(ctx, found);
+}
+
+static void cmd_incr(RespContext *ctx, const RespSlice *argv, int argc) {
+    (void)argc;
+    long long value = 0;
+    char digits[32];
+    size_t hash = hash_key(argv[1].ptr, argv[1].len);
+
+    pthread_mutex_lock(&store.lock);
+    StoreEntry **link = store_find(&argv[1], hash);
+    if (link) {
+        size_t n = (*link)->value_len;
+        char *end;
+        if (n == 0 || n >= sizeof(digits)) {
+            pthread_mutex_unlock(&store.lock);
+            resp_reply_error(ctx, "ERR value is not an integer or out of range");
+            return;
+        }
+        memcpy(digits, (*link)->data + (*link)->key_len, n);
+        digits[n] = '\0';
+        value = strtoll(digits, &end, 10);
+        if (*end != '\0' || value == LLONG_MAX) {
+            pthread_mutex_unlock(&store.lock);
+            resp_reply_error(ctx, "ERR value is not an integer or out of range");
+            return;
+        }
+    }
+
+    value++;
+    int n = snprintf(digits, sizeof(digits), "%lld", value);
+    int ret = store_put_locked(&argv[1], hash, digits, (size_t)n);
+    pthread_mutex_unlock(&store.lock);
+
+    if (ret < 0) {
+        resp_reply_error(ctx, "ERR out of memory");
+        return;
+    }
+    resp_reply_integer(ctx, value);
+}
+
+// HELLO [protover]：协商协议版本
+static void cmd_hello(RespContext *ctx, const RespSlice *argv, int argc) {
+    if (argc > 1) {
+        if (argv[1].len != 1 || (argv[1].ptr[0] != '2' && argv[1].ptr[0] != '3')) {
+            resp_reply_error(ctx, "NOPROTO unsupported protocol version");
+            return;
+        }
+        ctx->proto = argv[1].ptr[0] - '0';
+    }
+
+    resp_reply_map(ctx, 3);
+    resp_reply_bulk(ctx, "server", 6);
+    resp_reply_bulk(ctx, "ringmaster", 10);
+    resp_reply_bulk(ctx, "proto", 5);
+    resp_reply_integer(ctx, ctx->proto);
+    resp_reply_bulk(ctx, "mode", 4);
+    resp_reply_bulk(ctx, "standalone", 10);
+}
+
+// CONFIG / COMMAND 等管理命令仅返回空结果，满足 redis-benchmark 等客户端的握手
+static void cmd_empty_array(RespContext *ctx, const RespSlice *argv, int argc) {
+    (void)argv;
+    (void)argc;
+    resp_reply_array(ctx, 0);
+}
+
+static void cmd_ok(RespContext *ctx, const RespSlice *argv, int argc) {
+    (void)argv;
+    (void)argc;
+    resp_reply_simple(ctx, "OK");
+}
+
+static void register_builtin_commands(void) {
+    resp_register_command("PING", -1, cmd_ping);
+    resp_register_command("ECHO", 2, cmd_echo);
+    resp_register_command("GET", 2, cmd_get);
+    resp_register_command("SET", -3, cmd_set);
+    resp_register_command("DEL", -2, cmd_del);
+    resp_register_command("EXISTS", -2, cmd_exists);
+    resp_register_command("INCR", 2, cmd_incr);
+    resp_register_command("HELLO", -1, cmd_hello);
+    resp_register_command("CONFIG", -1, cmd_empty_array);
+    resp_register_command("COMMAND", -1, cmd_empty_array);
+    resp_register_command("SELECT", 2, cmd_ok);
+}
\ No newline at end of file
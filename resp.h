@@ -0,0 +1,56 @@
+#ifndef RESP_H
+#define RESP_H
+
+#include <stddef.h>
+#include "iouring_server.h"
+
+// 单个命令允许的最大参数个数
+#define RESP_MAX_ARGS 1024
+// 每批次最多缓存的命令数，达到后立即派发
+#define RESP_BATCH_COMMANDS 256
+// 未解析完成的请求数据的最大长度
+#define RESP_MAX_PENDING (64 * 1024 * 1024)
+
+// 指向接收缓冲区的零拷贝参数切片
+typedef struct {
+    const char *ptr;
+    size_t len;
+} RespSlice;
+
+// 回复缓冲区，整批命令的回复汇总后一次性写入连接的写缓冲区
+typedef struct {
+    char *data;
+    size_t len;
+    size_t capacity;
+    int oom;
+    char inline_buf[4096];
+} RespReply;
+
+// 命令执行上下文
+typedef struct {
+    struct connection *conn;
+    RespReply *reply;
+    int proto;  // 协议版本，2 或 3
+} RespContext;
+
+// 命令处理函数类型，argv[0] 为命令名
+typedef void (*resp_command_fn)(RespContext *ctx, const RespSlice *argv, int argc);
+
+// 注册命令处理函数
+// arity: 参数个数（含命令名），负数表示至少 -arity 个
+// 返回: 成功返回 0，命令表已满返回 -1
+int resp_register_command(const char *name, int arity, resp_command_fn fn);
+
+// RESP 协议的 on_data 回调，可直接传给 set_on_data
+void resp_on_data(struct connection *conn, const char *data, size_t len, struct ResourceManager *rm);
+
+// 回复构造函数
+void resp_reply_simple(RespContext *ctx, const char *str);
+void resp_reply_error(RespContext *ctx, const char *str);
+void resp_reply_integer(RespContext *ctx, long long value);
+void resp_reply_bulk(RespContext *ctx, const char *data, size_t len);
+void resp_reply_null(RespContext *ctx);
+void resp_reply_array(RespContext *ctx, long long count);
+void resp_reply_map(RespContext *ctx, long long count);
+
+#endif // RESP_H
\ No newline at end of file
@@ -7,6 +7,7 @@
 #define MAX_BUFFER_SIZE ((size_t)-1 >> 1)  // 最大缓冲区大小为 SIZE_MAX / 2
 
 // 调整环形缓冲区大小
+// 新缓冲区中的数据总是从 0 开始连续存放，读写索引随之归一化
 static int ring_buffer_resize(RingBuffer* rb, size_t new_size) {
     if (new_size <= rb->capacity) {
         return -1;  // 新大小必须大于当前容量
@@ -16,31 +17,33 @@ static int ring_buffer_resize(RingBuffer* rb, size_t new_size) {
         return -1;  // 防止溢出
     }
 
-    char* new_buffer = realloc(rb->buffer, new_size);
+    char* new_buffer = malloc(new_size);
     if (new_buffer == NULL) {
         return -1;  // 调整大小失败
     }
 
-    // 如果数据在旧缓冲区中环绕，需要重新排列
+    // 按读取顺序拷贝已有数据，消除环绕
     size_t used = ring_buffer_used_space(rb);
-    size_t read_index = atomic_load(&rb->read_index) % rb->capacity;
-    size_t write_index = atomic_load(&rb->write_index) % rb->capacity;
-
-    if (write_index < read_index) {
-        // 数据环绕，需要使其连续
-        memmove(new_buffer + rb->capacity, new_buffer, write_index);
-        atomic_store(&rb->write_index, read_index + used);
-    }
+    ring_buffer_peek(rb, new_buffer, used);
 
+    free(rb->buffer);
     rb->buffer = new_buffer;
     rb->capacity = new_size;
-    atomic_store(&rb->read_index, read_index);
+    atomic_store(&rb->read_index, 0);
+    atomic_store(&rb->write_index, used);
 
     return 0;
 }
 
 // 初始化环形缓冲区
 void ring_buffer_init(RingBuffer* rb, size_t initial_size) {
+    if (initial_size == 0) {
+        rb->buffer = NULL;
+        rb->capacity = 0;
+        atomic_init(&rb->read_index, 0);
+        atomic_init(&rb->write_index, 0);
+        return;
+    }
     if (initial_size < MIN_BUFFER_SIZE) {
         initial_size = MIN_BUFFER_SIZE;
     }
@@ -60,15 +63,6 @@ void ring_buffer_init(RingBuffer* rb, size_t initial_size) {
     rb->capacity = initial_size;
     atomic_init(&rb->read_index, 0);
     atomic_init(&rb->write_index, 0);
-
-    // 初始化互斥锁
-    if (pthread_mutex_init(&rb->mutex, NULL) != 0) {
-        // 处理互斥锁初始化失败
-        free(rb->buffer);
-        rb->buffer = NULL;
-        rb->capacity = 0;
-        return;
-    }
 }
 
 // 销毁环形缓冲区
@@ -79,9 +73,6 @@ void ring_buffer_destroy(RingBuffer* rb) {
         rb->capacity = 0;
         atomic_store(&rb->read_index, 0);
         atomic_store(&rb->write_index, 0);
-
-        // 销毁互斥锁
-        pthread_mutex_destroy(&rb->mutex);
     }
 }
 
@@ -100,20 +91,21 @@ size_t ring_buffer_used_space(const RingBuffer* rb) {
 
 // 写入数据到环形缓冲区
 int ring_buffer_write(RingBuffer* rb, const char* data, size_t len) {
-    pthread_mutex_lock(&rb->mutex);
+    if (len == 0) {
+        return 0;
+    }
 
     if (ring_buffer_free_space(rb) < len) {
-        size_t new_size = rb->capacity;
+        // 尚未分配时从最小大小开始
+        size_t new_size = rb->capacity ? rb->capacity : MIN_BUFFER_SIZE;
         size_t required_size = ring_buffer_used_space(rb) + len;
         while (new_size < required_size) {
             if (new_size > MAX_BUFFER_SIZE / 2) {
-                pthread_mutex_unlock(&rb->mutex);
                 return -1;  // 防止溢出
             }
             new_size = new_size * 3 / 2;  // 每次增长50%
         }
         if (ring_buffer_resize(rb, new_size) != 0) {
-            pthread_mutex_unlock(&rb->mutex);
             return -1;  // 调整大小失败
         }
     }
@@ -130,8 +122,6 @@ int ring_buffer_write(RingBuffer* rb, const char* data, size_t len) {
     }
 
     atomic_fetch_add_explicit(&rb->write_index, len, memory_order_release);
-
-    pthread_mutex_unlock(&rb->mutex);
     return 0;
 }
 
@@ -144,8 +134,6 @@ size_t ring_buffer_read(RingBuffer* rb, char* data, size_t len) {
         return 0;
     }
 
-    pthread_mutex_lock(&rb->mutex);
-
     size_t read_index = atomic_load_explicit(&rb->read_index, memory_order_relaxed) % rb->capacity;
     size_t end = (read_index + read_size) % rb->capacity;
 
@@ -166,7 +154,6 @@ size_t ring_buffer_read(RingBuffer* rb, char* data, size_t len) {
         atomic_store_explicit(&rb->write_index, 0, memory_order_relaxed);
     }
 
-    pthread_mutex_unlock(&rb->mutex);
     return read_size;
 }
 
@@ -191,4 +178,59 @@ int ring_buffer_peek(const RingBuffer* rb, char* data, size_t len) {
     }
 
     return peek_size;
+}
+
+// 丢弃环形缓冲区头部的数据
+size_t ring_buffer_skip(RingBuffer* rb, size_t len) {
+    size_t available = ring_buffer_used_space(rb);
+    size_t skip_size = (len < available) ? len : available;
+
+    atomic_fetch_add_explicit(&rb->read_index, skip_size, memory_order_release);
+
+    // 缓冲区清空后重置索引，使后续写入从头部连续存放
+    if (atomic_load_explicit(&rb->read_index, memory_order_acquire) ==
+        atomic_load_explicit(&rb->write_index, memory_order_acquire)) {
+        atomic_store_explicit(&rb->read_index, 0, memory_order_relaxed);
+        atomic_store_explicit(&rb->write_index, 0, memory_order_relaxed);
+    }
+
+    return skip_size;
+}
+
+// 使环形缓冲区中的数据连续存放，返回数据起始地址
+const char* ring_buffer_linearize(RingBuffer* rb) {
+    size_t used = ring_buffer_used_space(rb);
+    if (used == 0 || rb->buffer == NULL) {
+        return rb->buffer;
+    }
+
+    size_t read_index = atomic_load_explicit(&rb->read_index, memory_order_relaxed) % rb->capacity;
+    if (read_index + used > rb->capacity) {
+        // 数据环绕，借助临时缓冲区重新排列
+        char* tmp = malloc(rb->capacity);
+        if (tmp == NULL) {
+            return NULL;
+        }
+        ring_buffer_peek(rb, tmp, used);
+        free(rb->buffer);
+        rb->buffer = tmp;
+        read_index = 0;
+    }
+    atomic_store_explicit(&rb->read_index, read_index, memory_order_relaxed);
+    atomic_store_explicit(&rb->write_index, read_index + used, memory_order_release);
+    return rb->buffer + read_index;
+}
+
+// 转移环形缓冲区的数据
+int ring_buffer_move(RingBuffer* dst, RingBuffer* src) {
+    dst->buffer = src->buffer;
+    dst->capacity = src->capacity;
+    atomic_init(&dst->read_index, atomic_load(&src->read_index));
+    atomic_init(&dst->write_index, atomic_load(&src->write_index));
+
+    src->buffer = NULL;
+    src->capacity = 0;
+    atomic_store(&src->read_index, 0);
+    atomic_store(&src->write_index, 0);
+    return 0;
 }
\ No newline at end of file
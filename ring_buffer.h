@@ -3,18 +3,16 @@
 
 #include <stdatomic.h>
 #include <stddef.h>
-#include <pthread.h>
 
-// 环形缓冲区结构体
+// 环形缓冲区结构体。不加锁：每个缓冲区只能由一个线程访问（连接的缓冲区属于其所在的工作线程）
 typedef struct {
     char *buffer;
     size_t capacity;
     atomic_size_t read_index;
     atomic_size_t write_index;
-    pthread_mutex_t mutex;
 } RingBuffer;
 
-// 初始化环形缓冲区
+// 初始化环形缓冲区。initial_size 为 0 时不分配内存，第一次写入时按需分配
 void ring_buffer_init(RingBuffer* rb, size_t initial_size);
 
 // 销毁环形缓冲区
@@ -35,4 +33,14 @@ size_t ring_buffer_read(RingBuffer* rb, char* data, size_t len);
 // 查看环形缓冲区中的数据而不移除
 int ring_buffer_peek(const RingBuffer* rb, char* data, size_t len);
 
+// 丢弃环形缓冲区头部最多 len 字节的数据，返回实际丢弃的字节数
+size_t ring_buffer_skip(RingBuffer* rb, size_t len);
+
+// 使环形缓冲区中的数据连续存放，返回数据起始地址（失败返回 NULL）
+const char* ring_buffer_linearize(RingBuffer* rb);
+
+// 将 src 的数据转移到未初始化的 dst 中，转移后 src 不再持有数据
+// 用于连接在线程间迁移
+int ring_buffer_move(RingBuffer* dst, RingBuffer* src);
+
 #endif // RING_BUFFER_H
\ No newline at end of file
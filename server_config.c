@@ -0,0 +1,304 @@
+#include "server_config.h"
+#include "iouring_server.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <liburing.h>
+
+// 自动模式下固定接收缓冲区最多使用物理内存的比例（1/N，所有工作线程合计）
+#define SERVER_AUTO_MEMORY_SHARE 8
+// 自动模式下 SQ 的下限
+#define SERVER_AUTO_MIN_QUEUE_DEPTH 1024
+// 为监听套接字、ring、日志文件等保留的文件描述符数
+#define SERVER_RESERVED_FDS 1000
+
+// 配置项名称
+static const struct {
+    const char* name;
+    unsigned bit;
+    size_t offset;
+} config_keys[] = {
+    { "queue_depth", SERVER_CONFIG_QUEUE_DEPTH, offsetof(ServerConfig, queue_depth) },
+    { "cq_entries", SERVER_CONFIG_CQ_ENTRIES, offsetof(ServerConfig, cq_entries) },
+    { "buffer_size", SERVER_CONFIG_BUFFER_SIZE, offsetof(ServerConfig, buffer_size) },
+    { "buffer_count", SERVER_CONFIG_BUFFER_COUNT, offsetof(ServerConfig, buffer_count) },
+    { "max_connections", SERVER_CONFIG_MAX_CONNECTIONS, offsetof(ServerConfig, max_connections) },
+    { "pool_size", SERVER_CONFIG_POOL_BLOCKS, offsetof(ServerConfig, pool_blocks) },
+    { "small_buffer_size", SERVER_CONFIG_SMALL_BUFFER_SIZE, offsetof(ServerConfig, small_buffer_size) },
+    { "small_buffer_count", SERVER_CONFIG_SMALL_BUFFER_COUNT, offsetof(ServerConfig, small_buffer_count) },
+    { "large_buffer_size", SERVER_CONFIG_LARGE_BUFFER_SIZE, offsetof(ServerConfig, large_buffer_size) },
+    { "large_buffer_count", SERVER_CONFIG_LARGE_BUFFER_COUNT, offsetof(ServerConfig, large_buffer_count) },
+};
+
+#define CONFIG_KEY_COUNT (sizeof(config_keys) / sizeof(config_keys[0]))
+
+// 以默认值初始化
+void server_config_init(ServerConfig* config) {
+    config->queue_depth = SERVER_DEFAULT_QUEUE_DEPTH;
+    config->cq_entries = 0;
+    config->buffer_size = SERVER_DEFAULT_BUFFER_SIZE;
+    config->buffer_count = SERVER_DEFAULT_BUFFER_COUNT;
+    config->small_buffer_size = SERVER_DEFAULT_SMALL_BUFFER_SIZE;
+    config->small_buffer_count = SERVER_DEFAULT_SMALL_BUFFER_COUNT;
+    config->large_buffer_size = SERVER_DEFAULT_LARGE_BUFFER_SIZE;
+    config->large_buffer_count = SERVER_DEFAULT_LARGE_BUFFER_COUNT;
+    config->max_connections = 0;
+    config->pool_blocks = SERVER_DEFAULT_POOL_BLOCKS;
+    config->auto_size = 0;
+    config->auto_mask = 0;
+    config->explicit_mask = 0;
+}
+
+// 比较配置项名称，'-' 与 '_' 等价
+static int key_equals(const char* key, const char* name) {
+    for (; *key && *name; key++, name++) {
+        char c = *key == '-' ? '_' : *key;
+        if (c != *name) return 0;
+    }
+    return *key == '\0' && *name == '\0';
+}
+
+// 解析非负整数
+static int parse_unsigned(const char* value, unsigned* out) {
+    char* end;
+    errno = 0;
+    unsigned long v = strtoul(value, &end, 10);
+    if (end == value || *end != '\0' || errno != 0 || v > 0xffffffffUL || value[0] == '-') {
+        return -1;
+    }
+    *out = (unsigned)v;
+    return 0;
+}
+
+// 设置一项配置
+int server_config_set(ServerConfig* config, const char* key, const char* value) {
+    if (key_equals(key, "auto")) {
+        unsigned enabled;
+        if (parse_unsigned(value, &enabled) < 0) return -1;
+        config->auto_size = enabled != 0;
+        return 0;
+    }
+    for (size_t i = 0; i < CONFIG_KEY_COUNT; i++) {
+        if (!key_equals(key, config_keys[i].name)) continue;
+        if (strcmp(value, "auto") == 0) {
+            config->auto_mask |= config_keys[i].bit;
+            config->explicit_mask &= ~config_keys[i].bit;
+            return 0;
+        }
+        unsigned v;
+        if (parse_unsigned(value, &v) < 0) return -1;
+        *(unsigned*)((char*)config + config_keys[i].offset) = v;
+        config->explicit_mask |= config_keys[i].bit;
+        config->auto_mask &= ~config_keys[i].bit;
+        return 0;
+    }
+    return -1;
+}
+
+// 去掉首尾空白
+static char* trim(char* s) {
+    while (isspace((unsigned char)*s)) s++;
+    char* end = s + strlen(s);
+    while (end > s && isspace((unsigned char)end[-1])) end--;
+    *end = '\0';
+    return s;
+}
+
+// 从配置文件读取
+int server_config_load(ServerConfig* config, const char* path) {
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "Cannot open config file %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    char line[256];
+    int lineno = 0, ret = 0;
+    while (fgets(line, sizeof(line), f)) {
+        lineno++;
+        char* comment = strchr(line, '#');
+        if (comment) *comment = '\0';
+        char* key = trim(line);
+        if (*key == '\0') continue;
+        char* eq = strchr(key, '=');
+        if (!eq) {
+            fprintf(stderr, "%s:%d: expected key = value\n", path, lineno);
+            ret = -1;
+            continue;
+        }
+        *eq = '\0';
+        char* value = trim(eq + 1);
+        key = trim(key);
+        if (server_config_set(config, key, value) < 0) {
+            fprintf(stderr, "%s:%d: invalid setting %s = %s\n", path, lineno, key, value);
+            ret = -1;
+        }
+    }
+    fclose(f);
+    return ret;
+}
+
+// 不小于 v 的最小 2 的幂
+static unsigned next_pow2(unsigned v) {
+    unsigned p = 1;
+    while (p < v && p < 0x80000000u) p <<= 1;
+    return p;
+}
+
+static unsigned clamp(unsigned v, unsigned lo, unsigned hi) {
+    return v < lo ? lo : v > hi ? hi : v;
+}
+
+// 由文件描述符上限推导连接数上限：连接按文件描述符编号索引，保留一部分给其他用途
+static unsigned connections_from_nofile(int raise) {
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) != 0) {
+        fprintf(stderr, "Unable to get file descriptor limit\n");
+        return SERVER_DEFAULT_POOL_BLOCKS;
+    }
+    if (raise && rl.rlim_cur < rl.rlim_max) {
+        rlim_t previous = rl.rlim_cur;
+        rl.rlim_cur = rl.rlim_max;
+        if (setrlimit(RLIMIT_NOFILE, &rl) != 0) {
+            rl.rlim_cur = previous;
+        }
+    }
+    printf("Current file descriptor limit: %llu\n", (unsigned long long)rl.rlim_cur);
+    unsigned long long limit = rl.rlim_cur > 2 * SERVER_RESERVED_FDS ? rl.rlim_cur - SERVER_RESERVED_FDS
+                                                                      : rl.rlim_cur / 2;
+    return limit > SERVER_MAX_CONNECTIONS ? SERVER_MAX_CONNECTIONS : (unsigned)limit;
+}
+
+// 每个工作线程可用于固定接收缓冲区的内存（字节）
+static unsigned long long buffer_memory_budget(int workers) {
+    long pages = sysconf(_SC_PHYS_PAGES);
+    long page_size = sysconf(_SC_PAGESIZE);
+    unsigned long long budget = pages > 0 && page_size > 0
+        ? (unsigned long long)pages * (unsigned long long)page_size / SERVER_AUTO_MEMORY_SHARE
+        : 64ULL << 20;
+    // 非特权进程注册的缓冲区计入 RLIMIT_MEMLOCK
+    struct rlimit rl;
+    if (geteuid() != 0 && getrlimit(RLIMIT_MEMLOCK, &rl) == 0 && rl.rlim_cur != RLIM_INFINITY) {
+        unsigned long long io = (unsigned long long)IO_BUFFER_COUNT * IO_BUFFER_SIZE * (unsigned)workers;
+        unsigned long long memlock = rl.rlim_cur > io ? rl.rlim_cur - io : 0;
+        if (memlock < budget) budget = memlock;
+    }
+    return budget / (unsigned)workers;
+}
+
+// 确定最终的配置
+void server_config_resolve(ServerConfig* config, int workers) {
+    if (workers < 1) workers = 1;
+    unsigned autos = config->auto_mask | (config->auto_size ? ~config->explicit_mask : 0);
+
+    if (config->max_connections == 0 || (autos & SERVER_CONFIG_MAX_CONNECTIONS)) {
+        config->max_connections = connections_from_nofile((autos & SERVER_CONFIG_MAX_CONNECTIONS) != 0);
+    }
+    config->max_connections = clamp(config->max_connections, 1, SERVER_MAX_CONNECTIONS);
+    config->buffer_size = clamp(config->buffer_size, SERVER_MIN_BUFFER_SIZE, SERVER_MAX_BUFFER_SIZE);
+    config->small_buffer_size = clamp(config->small_buffer_size, SERVER_MIN_BUFFER_SIZE, SERVER_MAX_BUFFER_SIZE);
+    config->large_buffer_size = clamp(config->large_buffer_size, SERVER_MIN_BUFFER_SIZE, SERVER_MAX_BUFFER_SIZE);
+    // 规格按大小严格递增，不满足时不启用该规格
+    if (config->small_buffer_size >= config->buffer_size) config->small_buffer_count = 0;
+    if (config->large_buffer_size <= config->buffer_size) config->large_buffer_count = 0;
+
+    // 新连接按负载分配到各工作线程，每个工作线程按平均连接数准备缓冲区和连接池
+    unsigned per_worker = (config->max_connections + (unsigned)workers - 1) / (unsigned)workers;
+    unsigned max_buffers = SERVER_MAX_REG_BUFFERS - IO_BUFFER_COUNT;
+
+    if (autos & SERVER_CONFIG_BUFFER_COUNT) {
+        // 较小、较大规格的缓冲区先从内存预算和注册上限中扣除
+        unsigned long long classes = (unsigned long long)config->small_buffer_count * config->small_buffer_size +
+                                     (unsigned long long)config->large_buffer_count * config->large_buffer_size;
+        unsigned long long budget = buffer_memory_budget(workers);
+        unsigned long long by_memory = (budget > classes ? budget - classes : 0) / config->buffer_size;
+        unsigned others = config->small_buffer_count + config->large_buffer_count;
+        unsigned room = others < max_buffers - 64 ? max_buffers - others : 64;
+        unsigned count = per_worker < by_memory ? per_worker : (unsigned)by_memory;
+        config->buffer_count = clamp(count, 64, room);
+    }
+    config->buffer_count = clamp(config->buffer_count, 1, max_buffers);
+    unsigned left = max_buffers - config->buffer_count;
+    if (config->large_buffer_count > left) config->large_buffer_count = left;
+    left -= config->large_buffer_count;
+    if (config->small_buffer_count > left) config->small_buffer_count = left;
+    unsigned receive_buffers = config->buffer_count + config->small_buffer_count + config->large_buffer_count;
+
+    if (autos & SERVER_CONFIG_QUEUE_DEPTH) {
+        config->queue_depth = next_pow2(receive_buffers);
+        config->queue_depth = clamp(config->queue_depth, SERVER_AUTO_MIN_QUEUE_DEPTH, SERVER_MAX_QUEUE_DEPTH);
+    }
+    config->queue_depth = clamp(config->queue_depth, 1, SERVER_MAX_QUEUE_DEPTH);
+
+    // 每个持有缓冲区的连接最多同时有一个读取和一个发送在途，CQ 容纳全部完成事件和一轮提交
+    if (autos & SERVER_CONFIG_CQ_ENTRIES) {
+        config->cq_entries = next_pow2(2 * receive_buffers + config->queue_depth);
+    }
+    if (config->cq_entries) {
+        config->cq_entries = clamp(config->cq_entries, config->queue_depth, SERVER_MAX_CQ_ENTRIES);
+    }
+
+    if (autos & SERVER_CONFIG_POOL_BLOCKS) {
+        config->pool_blocks = per_worker < receive_buffers ? per_worker : receive_buffers;
+    }
+}
+
+// 打印最终的配置
+void server_config_print(const ServerConfig* config) {
+    printf("Sizing%s: queue_depth %u, cq_entries %u, buffer_size %u, buffer_count %u, "
+           "max_connections %u, pool_size %u\n",
+           config->auto_size || config->auto_mask ? " (auto)" : "", config->queue_depth,
+           config->cq_entries ? config->cq_entries : clamp(config->queue_depth * CQ_RING_FACTOR, 1, SERVER_MAX_CQ_ENTRIES),
+           config->buffer_size, config->buffer_count, config->max_connections, config->pool_blocks);
+    printf("Receive buffer classes: %u x %u B, %u x %u B (default), %u x %u B\n",
+           config->small_buffer_count, config->small_buffer_size, config->buffer_count, config->buffer_size,
+           config->large_buffer_count, config->large_buffer_size);
+    printf("Setting max connections to: %u\n", config->max_connections);
+}
+
+// 探测内核支持的特性和操作码
+int server_config_probe(ServerProbe* probe) {
+    memset(probe, 0, sizeof(*probe));
+    struct io_uring ring;
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int ret = io_uring_queue_init_params(2, &ring, &params);
+    if (ret < 0) {
+        return ret;
+    }
+    probe->features = params.features;
+    struct io_uring_probe* ops = io_uring_get_probe_ring(&ring);
+    if (ops) {
+        probe->ops_supported = 1;
+        probe->read_fixed = io_uring_opcode_supported(ops, IORING_OP_READ_FIXED);
+        probe->send_recv = io_uring_opcode_supported(ops, IORING_OP_SEND) &&
+                           io_uring_opcode_supported(ops, IORING_OP_RECV);
+        probe->splice = io_uring_opcode_supported(ops, IORING_OP_SPLICE);
+        probe->msg_ring = io_uring_opcode_supported(ops, IORING_OP_MSG_RING);
+        probe->send_zc = io_uring_opcode_supported(ops, IORING_OP_SEND_ZC);
+        io_uring_free_probe(ops);
+    }
+    io_uring_queue_exit(&ring);
+    return 0;
+}
+
+// 打印探测结果
+void server_config_print_probe(const ServerProbe* probe) {
+    printf("io_uring features:%s%s%s%s%s\n",
+           probe->features & IORING_FEAT_FAST_POLL ? " FAST_POLL" : "",
+           probe->features & IORING_FEAT_NODROP ? " NODROP" : "",
+           probe->features & IORING_FEAT_EXT_ARG ? " EXT_ARG" : "",
+           probe->features & IORING_FEAT_CQE_SKIP ? " CQE_SKIP" : "",
+           probe->features & IORING_FEAT_LINKED_FILE ? " LINKED_FILE" : "");
+    if (!probe->ops_supported) {
+        printf("io_uring opcodes: probe not supported\n");
+        return;
+    }
+    printf("io_uring opcodes: READ_FIXED %s, SEND/RECV %s, SPLICE %s, MSG_RING %s, SEND_ZC %s\n",
+           probe->read_fixed ? "yes" : "no", probe->send_recv ? "yes" : "no", probe->splice ? "yes" : "no",
+           probe->msg_ring ? "yes" : "no", probe->send_zc ? "yes" : "no");
+}
\ No newline at end of file
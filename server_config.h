@@ -0,0 +1,93 @@
+#ifndef SERVER_CONFIG_H
+#define SERVER_CONFIG_H
+
+// 默认配置
+#define SERVER_DEFAULT_QUEUE_DEPTH 32768
+#define SERVER_DEFAULT_BUFFER_SIZE 1024
+#define SERVER_DEFAULT_BUFFER_COUNT 5000
+#define SERVER_DEFAULT_POOL_BLOCKS 1000
+// 较小和较大的接收缓冲区规格：发送小消息的连接改用小缓冲区，大块传输改用大缓冲区以减少完成事件
+#define SERVER_DEFAULT_SMALL_BUFFER_SIZE 512
+#define SERVER_DEFAULT_SMALL_BUFFER_COUNT 4096
+#define SERVER_DEFAULT_LARGE_BUFFER_SIZE 65536
+#define SERVER_DEFAULT_LARGE_BUFFER_COUNT 32
+
+// 内核限制：SQ 最大 32768 项，CQ 最大为其两倍；每个 ring 最多注册 16384 个固定缓冲区
+#define SERVER_MAX_QUEUE_DEPTH 32768
+#define SERVER_MAX_CQ_ENTRIES 65536
+#define SERVER_MAX_REG_BUFFERS 16384
+// 连接数上限的上限
+#define SERVER_MAX_CONNECTIONS 1000000
+// 固定接收缓冲区大小的范围
+#define SERVER_MIN_BUFFER_SIZE 64
+#define SERVER_MAX_BUFFER_SIZE (1 << 20)
+
+// 可配置项，用于 auto_mask 和 explicit_mask
+#define SERVER_CONFIG_QUEUE_DEPTH     (1u << 0)
+#define SERVER_CONFIG_CQ_ENTRIES      (1u << 1)
+#define SERVER_CONFIG_BUFFER_SIZE     (1u << 2)
+#define SERVER_CONFIG_BUFFER_COUNT    (1u << 3)
+#define SERVER_CONFIG_MAX_CONNECTIONS (1u << 4)
+#define SERVER_CONFIG_POOL_BLOCKS     (1u << 5)
+#define SERVER_CONFIG_SMALL_BUFFER_SIZE  (1u << 6)
+#define SERVER_CONFIG_SMALL_BUFFER_COUNT (1u << 7)
+#define SERVER_CONFIG_LARGE_BUFFER_SIZE  (1u << 8)
+#define SERVER_CONFIG_LARGE_BUFFER_COUNT (1u << 9)
+
+// ring 和缓冲区的大小配置，启动时从命令行参数或配置文件读取，各工作线程共用
+typedef struct ServerConfig {
+    unsigned queue_depth;       // 每个 ring 的 SQ 大小
+    unsigned cq_entries;        // 每个 ring 的 CQ 大小，0 表示 SQ 的 CQ_RING_FACTOR 倍
+    unsigned buffer_size;       // 每个固定接收缓冲区的大小
+    unsigned buffer_count;      // 每个工作线程的固定接收缓冲区数
+    unsigned small_buffer_size; // 较小规格的接收缓冲区大小，须小于 buffer_size，否则不启用
+    unsigned small_buffer_count;  // 每个工作线程较小规格的缓冲区数，0 表示不启用
+    unsigned large_buffer_size; // 较大规格的接收缓冲区大小，须大于 buffer_size，否则不启用
+    unsigned large_buffer_count;  // 每个工作线程较大规格的缓冲区数，0 表示不启用
+    unsigned max_connections;   // 整个进程的连接数上限，0 表示由 RLIMIT_NOFILE 推导
+    unsigned pool_blocks;       // 每个工作线程连接池预先分配的连接数
+    int auto_size;              // 自动模式：未显式设置的项按主机资源确定，并按内核支持选择收发路径
+    unsigned auto_mask;         // 设置为 auto 的项（SERVER_CONFIG_*）
+    unsigned explicit_mask;     // 显式设置了数值的项，自动模式不覆盖
+} ServerConfig;
+
+// 内核对 io_uring 的支持情况
+typedef struct {
+    unsigned features;          // io_uring_params.features
+    int ops_supported;          // 是否能够获取操作码探测结果（内核 5.6 起）
+    int read_fixed;
+    int send_recv;
+    int splice;
+    int msg_ring;
+    int send_zc;
+} ServerProbe;
+
+// 以默认值初始化
+void server_config_init(ServerConfig* config);
+
+// 设置一项配置，key 中的 '-' 和 '_' 等价，value 为非负整数或 "auto"；
+// key 为 "auto" 时 value 为 0/1，开启或关闭自动模式
+// 返回: 成功返回 0，未知的 key 或无效的值返回 -1
+int server_config_set(ServerConfig* config, const char* key, const char* value);
+
+// 从配置文件读取，每行 "key = value"，'#' 之后为注释
+// 返回: 成功返回 0，文件无法打开或有无效的行返回 -1（已打印出错的行号）
+int server_config_load(ServerConfig* config, const char* path);
+
+// 确定最终的配置：计算自动项和由 RLIMIT_NOFILE 推导的连接数上限，把超出内核限制的值截断到范围内。
+// 三种规格的接收缓冲区合计不超过注册上限，超出时依次减少较大、较小规格的数量。
+// 较小、较大规格的大小和数量没有自动值，设为 auto 时保持当前值。
+// 自动模式会把 RLIMIT_NOFILE 的软限制提高到硬限制。workers 为工作线程数
+void server_config_resolve(ServerConfig* config, int workers);
+
+// 打印最终的配置
+void server_config_print(const ServerConfig* config);
+
+// 探测内核支持的 io_uring 特性和服务器用到的操作码
+// 返回: 成功返回 0，无法创建 ring 时返回 -errno
+int server_config_probe(ServerProbe* probe);
+
+// 打印探测结果
+void server_config_print_probe(const ServerProbe* probe);
+
+#endif // SERVER_CONFIG_H
\ No newline at end of file
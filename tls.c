@@ -0,0 +1,543 @@
+#define _GNU_SOURCE
+#include "tls.h"
+#include "resource_manager.h"
+#include "error.h"
+#include "logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#ifdef HAVE_OPENSSL
+
+#include <stddef.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <linux/tls.h>
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/kdf.h>
+#include <openssl/core_names.h>
+
+struct TlsContext {
+    SSL_CTX *ssl_ctx;
+};
+
+// 一次进行中的握手
+typedef struct TlsHandshake {
+    struct completion_handler recv_done;
+    struct completion_handler timeout_done;
+    struct completion_handler send_done;
+    struct TlsServer *server;
+    struct connection *conn;
+    SSL *ssl;
+    BIO *rbio;              // 收到的握手记录，交给 OpenSSL 处理
+    BIO *wbio;              // OpenSSL 产生的待发送数据
+    unsigned char record[TLS_RECORD_HEADER_SIZE + TLS_MAX_RECORD_SIZE];
+    size_t record_len;      // 当前记录的总长度，读到记录头之前为记录头长度
+    size_t received;
+    char *out;              // 正在发送的握手数据
+    size_t out_len;
+    size_t out_sent;
+    struct __kernel_timespec timeout;
+    unsigned char client_secret[EVP_MAX_MD_SIZE];  // 由 keylog 回调取得的应用数据密钥
+    unsigned char server_secret[EVP_MAX_MD_SIZE];
+    size_t secret_len;
+    int inflight;           // 尚未返回的请求数
+    int complete;           // OpenSSL 握手已完成，发送完剩余数据后装入密钥
+    int failed;
+    struct TlsHandshake *prev;
+    struct TlsHandshake *next;
+} TlsHandshake;
+
+struct TlsServer {
+    ResourceManager *rm;
+    TlsContext *ctx;
+    TlsHandshake *handshakes;   // 进行中的握手，销毁时释放
+};
+
+static int hex_decode(const char *hex, unsigned char *out, size_t max) {
+    size_t len = strlen(hex);
+    if (len % 2 != 0 || len / 2 > max) {
+        return -1;
+    }
+    for (size_t i = 0; i < len / 2; i++) {
+        unsigned int byte;
+        if (sscanf(hex + 2 * i, "%2x", &byte) != 1) {
+            return -1;
+        }
+        out[i] = (unsigned char)byte;
+    }
+    return (int)(len / 2);
+}
+
+// OpenSSL 没有直接导出 TLS 1.3 流量密钥的接口，从 keylog 回调中取得应用数据阶段的密钥
+static void keylog_callback(const SSL *ssl, const char *line) {
+    TlsHandshake *h = SSL_get_app_data(ssl);
+    char label[64], random[160], secret[2 * EVP_MAX_MD_SIZE + 1];
+    if (!h || sscanf(line, "%63s %159s %128s", label, random, secret) != 3) {
+        return;
+    }
+    unsigned char *dest = NULL;
+    if (strcmp(label, "CLIENT_TRAFFIC_SECRET_0") == 0) {
+        dest = h->client_secret;
+    } else if (strcmp(label, "SERVER_TRAFFIC_SECRET_0") == 0) {
+        dest = h->server_secret;
+    }
+    if (dest) {
+        int len = hex_decode(secret, dest, EVP_MAX_MD_SIZE);
+        if (len > 0) {
+            h->secret_len = (size_t)len;
+        }
+    }
+}
+
+// 加载证书和私钥，并检查内核是否支持 TLS
+TlsContext* tls_context_create(const char *cert_file, const char *key_file) {
+    // 在未连接的套接字上设置 tls ULP：模块可用时返回 ENOTCONN，没有模块时返回 ENOENT
+    int probe = socket(AF_INET, SOCK_STREAM, 0);
+    if (probe >= 0) {
+        int ret = setsockopt(probe, SOL_TCP, TCP_ULP, "tls", sizeof("tls"));
+        int err = errno;
+        close(probe);
+        if (ret < 0 && err == ENOENT) {
+            log_error("Kernel TLS is not available (tls module not loaded)");
+            return NULL;
+        }
+    }
+
+    TlsContext *ctx = calloc(1, sizeof(TlsContext));
+    if (!ctx) {
+        return NULL;
+    }
+    ctx->ssl_ctx = SSL_CTX_new(TLS_server_method());
+    if (!ctx->ssl_ctx) {
+        free(ctx);
+        return NULL;
+    }
+
+    // 只使用 TLS 1.3，其三个密码套件内核都支持；不发送会话票据，
+    // 这样握手完成后服务器一侧没有用应用数据密钥加密过的记录，内核从序号 0 开始
+    SSL_CTX_set_min_proto_version(ctx->ssl_ctx, TLS1_3_VERSION);
+    SSL_CTX_set_ciphersuites(ctx->ssl_ctx,
+                             "TLS_AES_128_GCM_SHA256:TLS_AES_256_GCM_SHA384:TLS_CHACHA20_POLY1305_SHA256");
+    SSL_CTX_set_num_tickets(ctx->ssl_ctx, 0);
+    SSL_CTX_set_keylog_callback(ctx->ssl_ctx, keylog_callback);
+
+    if (SSL_CTX_use_certificate_chain_file(ctx->ssl_ctx, cert_file) != 1 ||
+        SSL_CTX_use_PrivateKey_file(ctx->ssl_ctx, key_file, SSL_FILETYPE_PEM) != 1 ||
+        SSL_CTX_check_private_key(ctx->ssl_ctx) != 1) {
+        log_error("Failed to load TLS certificate or key: %s", ERR_reason_error_string(ERR_get_error()));
+        SSL_CTX_free(ctx->ssl_ctx);
+        free(ctx);
+        return NULL;
+    }
+    return ctx;
+}
+
+// 释放 TLS 配置
+void tls_context_destroy(TlsContext *ctx) {
+    if (!ctx) return;
+    SSL_CTX_free(ctx->ssl_ctx);
+    free(ctx);
+}
+
+// 创建握手管理器
+TlsServer* tls_server_create(ResourceManager *rm, TlsContext *ctx) {
+    TlsServer *server = calloc(1, sizeof(TlsServer));
+    if (!server) {
+        return NULL;
+    }
+    server->rm = rm;
+    server->ctx = ctx;
+    return server;
+}
+
+// 销毁握手管理器（客户端连接随连接表一起关闭）
+void tls_server_destroy(TlsServer *server) {
+    if (!server) return;
+
+    while (server->handshakes) {
+        TlsHandshake *h = server->handshakes;
+        server->handshakes = h->next;
+        SSL_free(h->ssl);
+        free(h->out);
+        free(h);
+    }
+    free(server);
+}
+
+// TLS 1.3 的 HKDF-Expand-Label(secret, label, "", length)
+static int hkdf_expand_label(const EVP_MD *md, const unsigned char *secret, size_t secret_len,
+                             const char *label, unsigned char *out, size_t out_len) {
+    unsigned char info[64];
+    size_t label_len = strlen("tls13 ") + strlen(label);
+    size_t info_len = 0;
+    info[info_len++] = (unsigned char)(out_len >> 8);
+    info[info_len++] = (unsigned char)out_len;
+    info[info_len++] = (unsigned char)label_len;
+    memcpy(info + info_len, "tls13 ", 6);
+    memcpy(info + info_len + 6, label, strlen(label));
+    info_len += label_len;
+    info[info_len++] = 0;  // 空的上下文
+
+    EVP_KDF *kdf = EVP_KDF_fetch(NULL, "HKDF", NULL);
+    EVP_KDF_CTX *kctx = kdf ? EVP_KDF_CTX_new(kdf) : NULL;
+    EVP_KDF_free(kdf);
+    if (!kctx) {
+        return -1;
+    }
+    int mode = EVP_KDF_HKDF_MODE_EXPAND_ONLY;
+    OSSL_PARAM params[] = {
+        OSSL_PARAM_construct_utf8_string(OSSL_KDF_PARAM_DIGEST, (char*)EVP_MD_get0_name(md), 0),
+        OSSL_PARAM_construct_int(OSSL_KDF_PARAM_MODE, &mode),
+        OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_KEY, (void*)secret, secret_len),
+        OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_INFO, info, info_len),
+        OSSL_PARAM_construct_end()
+    };
+    int ret = EVP_KDF_derive(kctx, out, out_len, params) == 1 ? 0 : -1;
+    EVP_KDF_CTX_free(kctx);
+    return ret;
+}
+
+// 内核 TLS 的密钥参数
+typedef union {
+    struct tls_crypto_info info;
+    struct tls12_crypto_info_aes_gcm_128 aes_gcm_128;
+    struct tls12_crypto_info_aes_gcm_256 aes_gcm_256;
+    struct tls12_crypto_info_chacha20_poly1305 chacha20_poly1305;
+} TlsCryptoInfo;
+
+// 由流量密钥推导记录密钥和 IV，填写内核的密钥参数（序号从 0 开始）
+static int build_crypto_info(const SSL *ssl, const unsigned char *secret, size_t secret_len,
+                             TlsCryptoInfo *ci, socklen_t *ci_len) {
+    const SSL_CIPHER *cipher = SSL_get_current_cipher(ssl);
+    const EVP_MD *md = cipher ? SSL_CIPHER_get_handshake_digest(cipher) : NULL;
+    if (!md) {
+        return -1;
+    }
+    unsigned char key[32], iv[12];
+    size_t key_len;
+    memset(ci, 0, sizeof(*ci));
+    ci->info.version = TLS_1_3_VERSION;
+
+    switch (SSL_CIPHER_get_id(cipher)) {
+        case TLS1_3_CK_AES_128_GCM_SHA256:
+            ci->info.cipher_type = TLS_CIPHER_AES_GCM_128;
+            key_len = TLS_CIPHER_AES_GCM_128_KEY_SIZE;
+            *ci_len = sizeof(ci->aes_gcm_128);
+            break;
+        case TLS1_3_CK_AES_256_GCM_SHA384:
+            ci->info.cipher_type = TLS_CIPHER_AES_GCM_256;
+            key_len = TLS_CIPHER_AES_GCM_256_KEY_SIZE;
+            *ci_len = sizeof(ci->aes_gcm_256);
+            break;
+        case TLS1_3_CK_CHACHA20_POLY1305_SHA256:
+            ci->info.cipher_type = TLS_CIPHER_CHACHA20_POLY1305;
+            key_len = TLS_CIPHER_CHACHA20_POLY1305_KEY_SIZE;
+            *ci_len = sizeof(ci->chacha20_poly1305);
+            break;
+        default:
+            return -1;
+    }
+    if (hkdf_expand_label(md, secret, secret_len, "key", key, key_len) < 0 ||
+        hkdf_expand_label(md, secret, secret_len, "iv", iv, sizeof(iv)) < 0) {
+        return -1;
+    }
+
+    // AES-GCM 的 12 字节 nonce 分为 4 字节 salt 和 8 字节 iv，ChaCha20-Poly1305 整个作为 iv
+    switch (ci->info.cipher_type) {
+        case TLS_CIPHER_AES_GCM_128:
+            memcpy(ci->aes_gcm_128.key, key, key_len);
+            memcpy(ci->aes_gcm_128.salt, iv, 4);
+            memcpy(ci->aes_gcm_128.iv, iv + 4, 8);
+            break;
+        case TLS_CIPHER_AES_GCM_256:
+            memcpy(ci->aes_gcm_256.key, key, key_len);
+            memcpy(ci->aes_gcm_256.salt, iv, 4);
+            memcpy(ci->aes_gcm_256.iv, iv + 4, 8);
+            break;
+        default:
+            memcpy(ci->chacha20_poly1305.key, key, key_len);
+            memcpy(ci->chacha20_poly1305.iv, iv, sizeof(iv));
+            break;
+    }
+    OPENSSL_cleanse(key, sizeof(key));
+    return 0;
+}
+
+// 把会话密钥装入内核，之后套接字上的收发都是明文
+static int install_keys(TlsHandshake *h) {
+    if (h->secret_len == 0) {
+        return -EINVAL;
+    }
+    int fd = h->conn->fd;
+    TlsCryptoInfo tx, rx;
+    socklen_t tx_len, rx_len;
+    int ret = 0;
+    if (build_crypto_info(h->ssl, h->server_secret, h->secret_len, &tx, &tx_len) < 0 ||
+        build_crypto_info(h->ssl, h->client_secret, h->secret_len, &rx, &rx_len) < 0) {
+        ret = -EINVAL;
+    } else if (setsockopt(fd, SOL_TCP, TCP_ULP, "tls", sizeof("tls")) < 0 ||
+               setsockopt(fd, SOL_TLS, TLS_TX, &tx, tx_len) < 0 ||
+               setsockopt(fd, SOL_TLS, TLS_RX, &rx, rx_len) < 0) {
+        ret = -errno;
+    }
+    OPENSSL_cleanse(&tx, sizeof(tx));
+    OPENSSL_cleanse(&rx, sizeof(rx));
+    return ret;
+}
+
+// 结束握手：成功时装入密钥并进入常规流程，失败时关闭连接
+static void finish_handshake(TlsHandshake *h) {
+    TlsServer *server = h->server;
+    ResourceManager *rm = server->rm;
+    struct connection *conn = h->conn;
+
+    int failed = h->failed;
+    if (!failed) {
+        int ret = install_keys(h);
+        if (ret < 0) {
+            log_error("Failed to install TLS keys: %s", strerror(-ret));
+            failed = 1;
+        }
+    }
+
+    SSL_free(h->ssl);
+    OPENSSL_cleanse(h->client_secret, sizeof(h->client_secret));
+    OPENSSL_cleanse(h->server_secret, sizeof(h->server_secret));
+    free(h->out);
+    if (h->prev) h->prev->next = h->next;
+    else server->handshakes = h->next;
+    if (h->next) h->next->prev = h->prev;
+    free(h);
+
+    conn->pending_jobs--;
+    if (failed) {
+        close_connection(rm, conn);
+    } else {
+        connection_ready(rm, conn);
+    }
+}
+
+// 读取当前记录的剩余部分，链接超时请求防止客户端停在握手中途
+static int submit_recv(TlsHandshake *h) {
+    struct io_uring *ring = h->server->rm->ring;
+    if (io_uring_sq_space_left(ring) < 2) {
+        io_uring_submit(ring);
+        if (io_uring_sq_space_left(ring) < 2) {
+            return -1;
+        }
+    }
+    struct io_uring_sqe *sqe = io_uring_get_sqe(ring);
+    io_uring_prep_recv(sqe, h->conn->fd, h->record + h->received, h->record_len - h->received, 0);
+    sqe->flags |= IOSQE_IO_LINK;
+    sqe_set_completion_handler(sqe, &h->recv_done);
+
+    h->timeout.tv_sec = TLS_HANDSHAKE_TIMEOUT_MS / 1000;
+    h->timeout.tv_nsec = (long long)(TLS_HANDSHAKE_TIMEOUT_MS % 1000) * 1000000;
+    sqe = io_uring_get_sqe(ring);
+    io_uring_prep_link_timeout(sqe, &h->timeout, 0);
+    sqe_set_completion_handler(sqe, &h->timeout_done);
+    h->inflight = 2;
+    return 0;
+}
+
+// 发送 OpenSSL 产生的握手数据
+static int submit_send(TlsHandshake *h) {
+    struct io_uring_sqe *sqe = io_uring_get_sqe(h->server->rm->ring);
+    if (!sqe) {
+        return -1;
+    }
+    io_uring_prep_send(sqe, h->conn->fd, h->out + h->out_sent, h->out_len - h->out_sent, MSG_NOSIGNAL);
+    sqe_set_completion_handler(sqe, &h->send_done);
+    h->inflight = 1;
+    return 0;
+}
+
+// 把一条完整的记录交给 OpenSSL，并取出需要发送的数据
+static int process_record(TlsHandshake *h) {
+    if (BIO_write(h->rbio, h->record, (int)h->record_len) != (int)h->record_len) {
+        return -1;
+    }
+    h->record_len = TLS_RECORD_HEADER_SIZE;
+    h->received = 0;
+
+    int ret = SSL_do_handshake(h->ssl);
+    if (ret == 1) {
+        h->complete = 1;
+    } else if (SSL_get_error(h->ssl, ret) != SSL_ERROR_WANT_READ) {
+        unsigned long err = ERR_get_error();
+        log_warn("TLS handshake failed: %s", err ? ERR_reason_error_string(err) : "protocol error");
+        ERR_clear_error();
+        return -1;
+    }
+
+    size_t pending = BIO_ctrl_pending(h->wbio);
+    if (pending > 0) {
+        char *out = realloc(h->out, pending);
+        if (!out) {
+            return -1;
+        }
+        h->out = out;
+        h->out_len = (size_t)BIO_read(h->wbio, h->out, (int)pending);
+        h->out_sent = 0;
+    }
+    return 0;
+}
+
+// 所有请求返回后推进握手：发送待发数据 -> 读完当前记录 -> 处理记录
+// 每次只读取一条记录，握手结束时套接字中尚未读取的数据恰好从第一条应用数据记录开始，可以直接交给内核
+static void advance_handshake(TlsHandshake *h) {
+    while (!h->failed) {
+        if (h->out_sent < h->out_len) {
+            if (submit_send(h) == 0) return;
+            h->failed = 1;
+            break;
+        }
+        if (h->complete) {
+            break;
+        }
+        if (h->received < h->record_len) {
+            if (submit_recv(h) == 0) return;
+            h->failed = 1;
+            break;
+        }
+        if (h->record_len == TLS_RECORD_HEADER_SIZE) {
+            // 记录类型只能是 change_cipher_spec(20) 到 application_data(23)，主版本号为 3
+            size_t len = ((size_t)h->record[3] << 8) | h->record[4];
+            if (h->record[0] < 20 || h->record[0] > 23 || h->record[1] != 3 || len > TLS_MAX_RECORD_SIZE) {
+                h->failed = 1;
+                break;
+            }
+            h->record_len += len;
+            if (len > 0) {
+                continue;
+            }
+        }
+        if (process_record(h) < 0) {
+            h->failed = 1;
+        }
+    }
+    finish_handshake(h);
+}
+
+static void on_handshake_recv(struct completion_handler *handler, struct io_uring_cqe *cqe, ResourceManager *rm) {
+    (void)rm;
+    TlsHandshake *h = (TlsHandshake*)((char*)handler - offsetof(TlsHandshake, recv_done));
+    h->inflight--;
+    if (cqe->res <= 0) {
+        // 客户端在握手中途关闭，或链接的超时触发（ECANCELED）
+        h->failed = 1;
+    } else {
+        h->received += cqe->res;
+    }
+    if (h->inflight == 0) {
+        advance_handshake(h);
+    }
+}
+
+static void on_handshake_timeout(struct completion_handler *handler, struct io_uring_cqe *cqe, ResourceManager *rm) {
+    (void)cqe;
+    (void)rm;
+    TlsHandshake *h = (TlsHandshake*)((char*)handler - offsetof(TlsHandshake, timeout_done));
+    h->inflight--;
+    if (h->inflight == 0) {
+        advance_handshake(h);
+    }
+}
+
+static void on_handshake_send(struct completion_handler *handler, struct io_uring_cqe *cqe, ResourceManager *rm) {
+    (void)rm;
+    TlsHandshake *h = (TlsHandshake*)((char*)handler - offsetof(TlsHandshake, send_done));
+    h->inflight--;
+    if (cqe->res <= 0) {
+        h->failed = 1;
+    } else {
+        h->out_sent += cqe->res;
+    }
+    if (h->inflight == 0) {
+        advance_handshake(h);
+    }
+}
+
+// 接管新连接并开始握手
+int tls_attach(ResourceManager *rm, struct connection *conn) {
+    TlsServer *server = rm->tls;
+    if (!server || !conn) {
+        return -EINVAL;
+    }
+
+    TlsHandshake *h = calloc(1, sizeof(TlsHandshake));
+    if (!h) {
+        return -ENOMEM;
+    }
+    h->ssl = SSL_new(server->ctx->ssl_ctx);
+    h->rbio = BIO_new(BIO_s_mem());
+    h->wbio = BIO_new(BIO_s_mem());
+    if (!h->ssl || !h->rbio || !h->wbio) {
+        BIO_free(h->rbio);
+        BIO_free(h->wbio);
+        SSL_free(h->ssl);
+        free(h);
+        return -ENOMEM;
+    }
+    SSL_set_bio(h->ssl, h->rbio, h->wbio);
+    SSL_set_accept_state(h->ssl);
+    SSL_set_app_data(h->ssl, h);
+    h->recv_done.on_complete = on_handshake_recv;
+    h->timeout_done.on_complete = on_handshake_timeout;
+    h->send_done.on_complete = on_handshake_send;
+    h->server = server;
+    h->conn = conn;
+    h->record_len = TLS_RECORD_HEADER_SIZE;
+
+    // 在暂停连接前提交第一步，失败时连接状态保持不变
+    if (submit_recv(h) < 0) {
+        SSL_free(h->ssl);
+        free(h);
+        return -EBUSY;
+    }
+
+    h->next = server->handshakes;
+    if (server->handshakes) server->handshakes->prev = h;
+    server->handshakes = h;
+
+    // 与文件发送相同，以 pending_jobs 暂停连接的常规收发，握手完成后恢复
+    conn->pending_jobs++;
+    return 0;
+}
+
+#else // !HAVE_OPENSSL
+
+TlsContext* tls_context_create(const char *cert_file, const char *key_file) {
+    (void)cert_file;
+    (void)key_file;
+    log_error("TLS support requires building with OpenSSL");
+    return NULL;
+}
+
+void tls_context_destroy(TlsContext *ctx) {
+    (void)ctx;
+}
+
+TlsServer* tls_server_create(ResourceManager *rm, TlsContext *ctx) {
+    (void)rm;
+    (void)ctx;
+    return NULL;
+}
+
+void tls_server_destroy(TlsServer *server) {
+    (void)server;
+}
+
+int tls_attach(ResourceManager *rm, struct connection *conn) {
+    (void)rm;
+    (void)conn;
+    return -ENOTSUP;
+}
+
+#endif // HAVE_OPENSSL
\ No newline at end of file
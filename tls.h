@@ -0,0 +1,37 @@
+#ifndef TLS_H
+#define TLS_H
+
+#include "iouring_server.h"
+
+// 握手期间每次等待客户端数据的超时（毫秒）
+#define TLS_HANDSHAKE_TIMEOUT_MS 10000
+// TLS 记录头长度和最大记录长度（含加密开销）
+#define TLS_RECORD_HEADER_SIZE 5
+#define TLS_MAX_RECORD_SIZE (16384 + 256)
+
+// TLS 配置（证书和私钥，所有工作线程共用）
+typedef struct TlsContext TlsContext;
+
+// 每个工作线程进行中的握手
+typedef struct TlsServer TlsServer;
+
+// 加载证书和私钥，并检查内核是否支持 TLS（kTLS）
+// 未使用 OpenSSL 构建或内核没有 tls 模块时返回 NULL
+TlsContext* tls_context_create(const char *cert_file, const char *key_file);
+
+// 释放 TLS 配置（所有工作线程退出后调用）
+void tls_context_destroy(TlsContext *ctx);
+
+// 创建工作线程的握手管理器
+TlsServer* tls_server_create(struct ResourceManager *rm, TlsContext *ctx);
+
+// 销毁握手管理器，丢弃进行中的握手（在 ring 退出后调用）
+void tls_server_destroy(TlsServer *server);
+
+// 接管新接受的连接并进行 TLS 1.3 握手。握手记录经 io_uring 逐条收发，由 OpenSSL 处理；
+// 握手完成后把会话密钥装入内核（TLS_TX/TLS_RX），之后连接上的收发、splice 和 sendfile 都是明文，
+// 由 connection_ready 进入常规流程。握手失败或超时时关闭连接
+// 返回: 成功返回 0，失败返回 -errno（连接状态不变，由调用者关闭）
+int tls_attach(struct ResourceManager *rm, struct connection *conn);
+
+#endif // TLS_H
\ No newline at end of file
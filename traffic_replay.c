@@ -0,0 +1,629 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include "capture.h"
+
+// 延迟直方图：按微秒分桶，超出范围的计入最后一个桶
+#define REPLAY_LATENCY_BUCKETS 1000000
+// 所有消息发送完后等待未完成回复的时间（秒）
+#define REPLAY_DRAIN_SECONDS 2.0
+#define REPLAY_DEFAULT_THREADS 4
+
+// 一条要回放的消息
+typedef struct {
+    uint64_t ts_ns;             // 相对于捕获中第一条记录的时间
+    uint32_t len;
+    uint32_t reply_len;
+    const char *payload;        // 捕获的内容，未记录时为 NULL（发送填充字节）
+} ReplayMessage;
+
+// 一个连接的回放脚本和运行状态
+typedef struct {
+    uint64_t conn_id;
+    uint64_t open_ns;           // 建立连接的时间（捕获开始前已建立的连接取第一条消息的时间）
+    uint64_t close_ns;          // 关闭连接的时间，UINT64_MAX 表示捕获结束时仍未关闭
+    ReplayMessage *messages;
+    uint32_t count;
+    // 运行状态
+    int fd;
+    int connecting;
+    int done;
+    uint32_t next;              // 下一条要发送的消息
+    uint32_t acked;             // 已收到完整回复的消息数
+    size_t sent;                // 当前消息已发送的字节数
+    uint64_t due_ns;            // 下一个定时动作的时间（相对于回放开始），UINT64_MAX 表示没有
+    uint64_t *sent_at;          // 每条消息开始发送的时间
+    uint64_t reply_total;       // 已收到的回复字节数
+    uint64_t *reply_end;        // 前 i+1 条消息的回复字节数之和
+} ReplayConn;
+
+// 定时堆的元素
+typedef struct {
+    uint64_t due_ns;
+    ReplayConn *conn;
+} ReplayTimer;
+
+typedef struct {
+    pthread_t thread;
+    ReplayConn **conns;
+    int count;
+    unsigned long long sent, answered, failed;
+    unsigned *latency;          // 回复延迟直方图
+    unsigned *lag;              // 发送相对计划时间的滞后直方图
+} ReplayThread;
+
+static struct sockaddr_in server_addr;
+static double replay_speed = 1.0;
+static uint64_t replay_start_ns;
+static const char *filler;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// 捕获时间换算为回放时间
+static uint64_t scaled(uint64_t ts_ns) {
+    return (uint64_t)((double)ts_ns / replay_speed);
+}
+
+static void histogram_add(unsigned *histogram, uint64_t ns) {
+    uint64_t us = ns / 1000;
+    histogram[us < REPLAY_LATENCY_BUCKETS ? us : REPLAY_LATENCY_BUCKETS - 1]++;
+}
+
+static uint64_t histogram_percentile(const unsigned long long *histogram, unsigned long long count, double p) {
+    unsigned long long target = (unsigned long long)(count * p), seen = 0;
+    if (target >= count) target = count - 1;
+    for (size_t i = 0; i < REPLAY_LATENCY_BUCKETS; i++) {
+        seen += histogram[i];
+        if (seen > target) return i;
+    }
+    return REPLAY_LATENCY_BUCKETS - 1;
+}
+
+// 定时堆（按 due_ns 的最小堆）。连接重新定时后旧元素留在堆中，弹出时与连接的 due_ns 不符即丢弃
+typedef struct {
+    ReplayTimer *items;
+    size_t count, capacity;
+} TimerHeap;
+
+static void heap_push(TimerHeap *heap, ReplayConn *conn) {
+    if (conn->due_ns == UINT64_MAX) return;
+    if (heap->count == heap->capacity) {
+        heap->capacity = heap->capacity ? heap->capacity * 2 : 64;
+        heap->items = realloc(heap->items, heap->capacity * sizeof(ReplayTimer));
+    }
+    size_t i = heap->count++;
+    while (i > 0 && heap->items[(i - 1) / 2].due_ns > conn->due_ns) {
+        heap->items[i] = heap->items[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    heap->items[i] = (ReplayTimer){ conn->due_ns, conn };
+}
+
+static ReplayTimer heap_pop(TimerHeap *heap) {
+    ReplayTimer top = heap->items[0];
+    ReplayTimer last = heap->items[--heap->count];
+    size_t i = 0;
+    for (;;) {
+        size_t child = 2 * i + 1;
+        if (child >= heap->count) break;
+        if (child + 1 < heap->count && heap->items[child + 1].due_ns < heap->items[child].due_ns) child++;
+        if (heap->items[child].due_ns >= last.due_ns) break;
+        heap->items[i] = heap->items[child];
+        i = child;
+    }
+    if (heap->count > 0) heap->items[i] = last;
+    return top;
+}
+
+// 下一个定时动作：建立连接、发送下一条消息或关闭连接（须先收到全部回复）
+static void schedule(ReplayConn *c) {
+    if (c->done) {
+        c->due_ns = UINT64_MAX;
+    } else if (c->fd < 0) {
+        c->due_ns = scaled(c->open_ns);
+    } else if (c->connecting || c->sent > 0) {
+        c->due_ns = UINT64_MAX;
+    } else if (c->next < c->count) {
+        c->due_ns = scaled(c->messages[c->next].ts_ns);
+    } else if (c->close_ns != UINT64_MAX && c->acked == c->count) {
+        c->due_ns = scaled(c->close_ns);
+    } else {
+        c->due_ns = UINT64_MAX;
+    }
+}
+
+static void update_events(int ep, ReplayConn *c) {
+    struct epoll_event ev = { .events = EPOLLIN | (c->connecting || c->sent > 0 ? EPOLLOUT : 0), .data.ptr = c };
+    epoll_ctl(ep, EPOLL_CTL_MOD, c->fd, &ev);
+}
+
+static void finish(ReplayThread *t, ReplayConn *c, int failed) {
+    if (c->fd >= 0) {
+        close(c->fd);
+    }
+    if (failed) {
+        t->failed++;
+    }
+    c->done = 1;
+}
+
+// 发送当前消息的剩余部分，返回 0 继续，-1 连接失败
+static int send_current(ReplayThread *t, ReplayConn *c) {
+    while (c->next < c->count) {
+        const ReplayMessage *m = &c->messages[c->next];
+        if (c->sent == 0) {
+            uint64_t now = now_ns() - replay_start_ns;
+            uint64_t planned = scaled(m->ts_ns);
+            if (now < planned) return 0;
+            histogram_add(t->lag, now - planned);
+            c->sent_at[c->next] = now;
+        }
+        const char *data = m->payload ? m->payload : filler;
+        ssize_t n = send(c->fd, data + c->sent, m->len - c->sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0) {
+            return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+        }
+        c->sent += (size_t)n;
+        if (c->sent < m->len) return 0;
+        c->sent = 0;
+        c->next++;
+        t->sent++;
+        // 没有回复的消息直接确认
+        while (c->acked < c->next && c->reply_total >= c->reply_end[c->acked] &&
+               c->messages[c->acked].reply_len == 0) {
+            c->acked++;
+        }
+    }
+    return 0;
+}
+
+// 接收回复，按累计字节数确认已完成的消息
+static int receive(ReplayThread *t, ReplayConn *c, char *buf, size_t size) {
+    for (;;) {
+        ssize_t n = recv(c->fd, buf, size, MSG_DONTWAIT);
+        if (n > 0) {
+            c->reply_total += (uint64_t)n;
+            continue;
+        }
+        if (n == 0) return -1;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+        if (errno != EINTR) return -1;
+    }
+    uint64_t now = now_ns() - replay_start_ns;
+    while (c->acked < c->next && c->reply_total >= c->reply_end[c->acked]) {
+        if (c->messages[c->acked].reply_len > 0) {
+            histogram_add(t->latency, now - c->sent_at[c->acked]);
+            t->answered++;
+        }
+        c->acked++;
+    }
+    return 0;
+}
+
+static void open_connection(ReplayThread *t, int ep, ReplayConn *c) {
+    c->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (c->fd < 0) {
+        finish(t, c, 1);
+        return;
+    }
+    int one = 1;
+    setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (connect(c->fd, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0 && errno != EINPROGRESS) {
+        finish(t, c, 1);
+        return;
+    }
+    c->connecting = 1;
+    struct epoll_event ev = { .events = EPOLLIN | EPOLLOUT, .data.ptr = c };
+    epoll_ctl(ep, EPOLL_CTL_ADD, c->fd, &ev);
+}
+
+// 回放线程：按时间建立连接、发送消息和关闭连接，用 epoll 接收回复
+static void* replay_thread(void *arg) {
+    ReplayThread *t = arg;
+    int ep = epoll_create1(0);
+    TimerHeap heap = { 0 };
+    size_t buf_size = 65536;
+    char *buf = malloc(buf_size);
+    uint64_t last_ns = 0;
+    for (int i = 0; i < t->count; i++) {
+        ReplayConn *c = t->conns[i];
+        schedule(c);
+        heap_push(&heap, c);
+        uint64_t end = c->close_ns != UINT64_MAX ? c->close_ns : c->count ? c->messages[c->count - 1].ts_ns : c->open_ns;
+        if (scaled(end) > last_ns) last_ns = scaled(end);
+    }
+    uint64_t deadline = last_ns + (uint64_t)(REPLAY_DRAIN_SECONDS * 1e9);
+    int remaining = t->count;
+
+    struct epoll_event events[256];
+    while (remaining > 0) {
+        uint64_t now = now_ns() - replay_start_ns;
+        if (now >= deadline) break;
+        // 等到最近的定时动作（最多 100ms），epoll_pwait2 的超时精确到纳秒，不支持时退回毫秒
+        uint64_t wait = 100000000ULL;
+        if (heap.count > 0) {
+            uint64_t due = heap.items[0].due_ns;
+            wait = due <= now ? 0 : due - now < wait ? due - now : wait;
+        }
+        struct timespec timeout = { .tv_sec = 0, .tv_nsec = (long)wait };
+        int n = epoll_pwait2(ep, events, 256, &timeout, NULL);
+        if (n < 0 && errno == ENOSYS) {
+            n = epoll_wait(ep, events, 256, (int)((wait + 999999) / 1000000));
+        }
+        for (int i = 0; i < n; i++) {
+            ReplayConn *c = events[i].data.ptr;
+            if (c->done) continue;
+            if (c->connecting && (events[i].events & (EPOLLOUT | EPOLLERR | EPOLLHUP))) {
+                int err = 0;
+                socklen_t len = sizeof(err);
+                getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &err, &len);
+                if (err) {
+                    finish(t, c, 1);
+                    remaining--;
+                    continue;
+                }
+                c->connecting = 0;
+            }
+            if ((events[i].events & EPOLLIN) && receive(t, c, buf, buf_size) < 0) {
+                // 服务器关闭了连接，捕获中连接在此之后才关闭的按失败计
+                finish(t, c, c->next < c->count || c->acked < c->count);
+                remaining--;
+                continue;
+            }
+            if (send_current(t, c) < 0) {
+                finish(t, c, 1);
+                remaining--;
+                continue;
+            }
+            update_events(ep, c);
+            uint64_t due = c->due_ns;
+            schedule(c);
+            if (c->due_ns != due) heap_push(&heap, c);
+        }
+
+        now = now_ns() - replay_start_ns;
+        while (heap.count > 0 && heap.items[0].due_ns <= now) {
+            ReplayTimer timer = heap_pop(&heap);
+            ReplayConn *c = timer.conn;
+            if (c->done || timer.due_ns != c->due_ns) continue;
+            if (c->fd < 0) {
+                open_connection(t, ep, c);
+            } else if (c->next < c->count) {
+                if (send_current(t, c) < 0) {
+                    finish(t, c, 1);
+                } else {
+                    update_events(ep, c);
+                }
+            } else {
+                finish(t, c, 0);
+            }
+            if (c->done) {
+                remaining--;
+            }
+            schedule(c);
+            heap_push(&heap, c);
+        }
+    }
+
+    // 截止时仍未完成的连接：未发送完或未收到全部回复的按失败计
+    for (int i = 0; i < t->count; i++) {
+        ReplayConn *c = t->conns[i];
+        if (!c->done) {
+            finish(t, c, c->fd < 0 || c->next < c->count || c->acked < c->count);
+        }
+    }
+    free(heap.items);
+    free(buf);
+    close(ep);
+    return NULL;
+}
+
+// 连接标识到连接的哈希表（开放寻址）
+typedef struct {
+    ReplayConn *conns;
+    size_t count;
+    size_t *slots;              // 连接下标 + 1，0 表示空
+    size_t mask;
+} ConnTable;
+
+static ReplayConn* conn_lookup(ConnTable *table, uint64_t conn_id, int create) {
+    size_t i = (size_t)(conn_id * 0x9e3779b97f4a7c15ULL) & table->mask;
+    while (table->slots[i]) {
+        ReplayConn *c = &table->conns[table->slots[i] - 1];
+        if (c->conn_id == conn_id) return c;
+        i = (i + 1) & table->mask;
+    }
+    if (!create) return NULL;
+    ReplayConn *c = &table->conns[table->count++];
+    memset(c, 0, sizeof(*c));
+    c->conn_id = conn_id;
+    c->open_ns = UINT64_MAX;
+    c->close_ns = UINT64_MAX;
+    c->fd = -1;
+    table->slots[i] = table->count;
+    return c;
+}
+
+// 解码后的记录及其在文件中的顺序
+typedef struct {
+    const CaptureRecord *record;
+    size_t order;
+} LoadedRecord;
+
+static int compare_records(const void *a, const void *b) {
+    const LoadedRecord *x = a, *y = b;
+    if (x->record->ts_ns != y->record->ts_ns) return x->record->ts_ns < y->record->ts_ns ? -1 : 1;
+    return x->order < y->order ? -1 : (x->order > y->order);
+}
+
+static int compare_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : (x > y);
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s <capture-file>                          (summary)\n"
+                    "       %s <capture-file> <host> <port> [--speed=<x>] [--threads=<n>] [--histogram=<file>]\n",
+            prog, prog);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 2 && argc < 4) {
+        usage(argv[0]);
+        return 1;
+    }
+    int threads = REPLAY_DEFAULT_THREADS;
+    const char *histogram_path = NULL;
+    for (int i = 4; i < argc; i++) {
+        if (strncmp(argv[i], "--speed=", 8) == 0) {
+            replay_speed = strtod(argv[i] + 8, NULL);
+        } else if (strncmp(argv[i], "--threads=", 10) == 0) {
+            threads = atoi(argv[i] + 10);
+        } else if (strncmp(argv[i], "--histogram=", 12) == 0) {
+            histogram_path = argv[i] + 12;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (replay_speed <= 0 || threads <= 0) {
+        fprintf(stderr, "Invalid replay parameters\n");
+        return 1;
+    }
+    if (argc >= 4) {
+        server_addr.sin_family = AF_INET;
+        server_addr.sin_port = htons(atoi(argv[3]));
+        if (inet_pton(AF_INET, argv[2], &server_addr.sin_addr) != 1) {
+            fprintf(stderr, "Invalid host: %s\n", argv[2]);
+            return 1;
+        }
+    }
+
+    // 读入整个文件，记录和内容直接引用文件数据
+    FILE *f = fopen(argv[1], "rb");
+    if (!f) {
+        perror(argv[1]);
+        return 1;
+    }
+    fseek(f, 0, SEEK_END);
+    long file_size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *data = malloc(file_size > 0 ? (size_t)file_size : 1);
+    if (!data || fread(data, 1, (size_t)file_size, f) != (size_t)file_size) {
+        fprintf(stderr, "%s: read failed\n", argv[1]);
+        fclose(f);
+        return 1;
+    }
+    fclose(f);
+    const CaptureFileHeader *header = (const CaptureFileHeader *)data;
+    if ((size_t)file_size < sizeof(*header) || header->magic != CAPTURE_MAGIC) {
+        fprintf(stderr, "%s: not a traffic capture\n", argv[1]);
+        return 1;
+    }
+    if (header->version != CAPTURE_VERSION || header->record_size != sizeof(CaptureRecord)) {
+        fprintf(stderr, "%s: unsupported version %u (record size %u)\n", argv[1], header->version,
+                header->record_size);
+        return 1;
+    }
+
+    // 逐块解析，不完整或损坏的块之后的数据被忽略
+    size_t capacity = 1024, total = 0;
+    LoadedRecord *records = malloc(capacity * sizeof(LoadedRecord));
+    size_t pos = sizeof(*header);
+    while (pos + sizeof(CaptureBlockHeader) <= (size_t)file_size) {
+        const CaptureBlockHeader *block = (const CaptureBlockHeader *)(data + pos);
+        if (block->magic != CAPTURE_BLOCK_MAGIC || pos + sizeof(*block) + block->bytes > (size_t)file_size) {
+            fprintf(stderr, "%s: damaged block at offset %zu, ignoring the rest\n", argv[1], pos);
+            break;
+        }
+        size_t at = pos + sizeof(*block), end = at + block->bytes;
+        while (at + sizeof(CaptureRecord) <= end) {
+            const CaptureRecord *r = (const CaptureRecord *)(data + at);
+            at += sizeof(CaptureRecord) + (r->flags & CAPTURE_FLAG_PAYLOAD ? ((size_t)r->len + 7) & ~(size_t)7 : 0);
+            if (at > end) break;
+            if (total == capacity) {
+                capacity *= 2;
+                records = realloc(records, capacity * sizeof(LoadedRecord));
+            }
+            records[total].record = r;
+            records[total].order = total;
+            total++;
+        }
+        pos = end;
+    }
+    qsort(records, total, sizeof(LoadedRecord), compare_records);
+
+    // 按连接整理：先统计每个连接的消息数，再填入消息
+    ConnTable table = { 0 };
+    size_t slots = 64;
+    while (slots < total * 2) slots <<= 1;
+    table.conns = malloc((total ? total : 1) * sizeof(ReplayConn));
+    table.slots = calloc(slots, sizeof(size_t));
+    table.mask = slots - 1;
+    uint64_t first_ns = total ? records[0].record->ts_ns : 0;
+    unsigned long long messages = 0, bytes_in = 0, bytes_out = 0;
+    for (size_t i = 0; i < total; i++) {
+        const CaptureRecord *r = records[i].record;
+        ReplayConn *c = conn_lookup(&table, r->conn_id, 1);
+        uint64_t ts = r->ts_ns - first_ns;
+        if (c->open_ns == UINT64_MAX) c->open_ns = ts;
+        if (r->type == CAPTURE_DATA) {
+            c->count++;
+            messages++;
+            bytes_in += r->len;
+            bytes_out += r->reply_len;
+        } else if (r->type == CAPTURE_CLOSE) {
+            c->close_ns = ts;
+        }
+    }
+    uint32_t *sizes = malloc((messages ? messages : 1) * sizeof(uint32_t));
+    uint32_t max_len = 1;
+    for (size_t i = 0; i < table.count; i++) {
+        ReplayConn *c = &table.conns[i];
+        c->messages = malloc((c->count ? c->count : 1) * sizeof(ReplayMessage));
+        c->sent_at = calloc(c->count ? c->count : 1, sizeof(uint64_t));
+        c->reply_end = malloc((c->count ? c->count : 1) * sizeof(uint64_t));
+        c->count = 0;
+    }
+    messages = 0;
+    for (size_t i = 0; i < total; i++) {
+        const CaptureRecord *r = records[i].record;
+        if (r->type != CAPTURE_DATA) continue;
+        ReplayConn *c = conn_lookup(&table, r->conn_id, 0);
+        ReplayMessage *m = &c->messages[c->count];
+        m->ts_ns = r->ts_ns - first_ns;
+        m->len = r->len;
+        m->reply_len = r->reply_len;
+        m->payload = r->flags & CAPTURE_FLAG_PAYLOAD ? (const char *)(r + 1) : NULL;
+        c->reply_end[c->count] = (c->count ? c->reply_end[c->count - 1] : 0) + r->reply_len;
+        c->count++;
+        sizes[messages++] = r->len;
+        if (r->len > max_len) max_len = r->len;
+    }
+    uint64_t duration = total ? records[total - 1].record->ts_ns - first_ns : 0;
+    free(records);
+
+    qsort(sizes, messages, sizeof(uint32_t), compare_u32);
+    printf("%s: %zu connections, %llu messages (%.1f MB in, %.1f MB out) over %.3f s, %s\n", argv[1], table.count,
+           messages, bytes_in / 1e6, bytes_out / 1e6, duration / 1e9,
+           header->flags & CAPTURE_FLAG_PAYLOAD ? "with contents" : "sizes only");
+    if (messages > 0) {
+        printf("  message size p50 %u B, p99 %u B, max %u B\n", sizes[messages / 2],
+               sizes[(size_t)(messages * 0.99)], sizes[messages - 1]);
+    }
+    free(sizes);
+    if (argc == 2) {
+        return 0;
+    }
+
+    // 每个连接一个文件描述符
+    struct rlimit limit;
+    getrlimit(RLIMIT_NOFILE, &limit);
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+
+    char *fill = malloc(max_len);
+    memset(fill, 'x', max_len);
+    filler = fill;
+
+    if ((size_t)threads > table.count) threads = table.count ? (int)table.count : 1;
+    ReplayThread *workers = calloc((size_t)threads, sizeof(ReplayThread));
+    for (int i = 0; i < threads; i++) {
+        workers[i].conns = malloc((table.count / threads + 1) * sizeof(ReplayConn *));
+        workers[i].latency = calloc(REPLAY_LATENCY_BUCKETS, sizeof(unsigned));
+        workers[i].lag = calloc(REPLAY_LATENCY_BUCKETS, sizeof(unsigned));
+    }
+    for (size_t i = 0; i < table.count; i++) {
+        ReplayThread *t = &workers[i % (size_t)threads];
+        t->conns[t->count++] = &table.conns[i];
+    }
+
+    replay_start_ns = now_ns();
+    for (int i = 0; i < threads; i++) {
+        pthread_create(&workers[i].thread, NULL, replay_thread, &workers[i]);
+    }
+    unsigned long long sent = 0, answered = 0, failed = 0;
+    unsigned long long *latency = calloc(REPLAY_LATENCY_BUCKETS, sizeof(unsigned long long));
+    unsigned long long *lag = calloc(REPLAY_LATENCY_BUCKETS, sizeof(unsigned long long));
+    for (int i = 0; i < threads; i++) {
+        pthread_join(workers[i].thread, NULL);
+        sent += workers[i].sent;
+        answered += workers[i].answered;
+        failed += workers[i].failed;
+        for (size_t b = 0; b < REPLAY_LATENCY_BUCKETS; b++) {
+            latency[b] += workers[i].latency[b];
+            lag[b] += workers[i].lag[b];
+        }
+    }
+    double elapsed = (now_ns() - replay_start_ns) / 1e9;
+
+    unsigned long long expected = 0;
+    for (size_t i = 0; i < table.count; i++) {
+        for (uint32_t m = 0; m < table.conns[i].count; m++) {
+            expected += table.conns[i].messages[m].reply_len > 0;
+        }
+    }
+    printf("replay at %gx: %.3f s, %llu of %llu messages sent, %llu of %llu replies received, %llu connections failed\n",
+           replay_speed, elapsed, sent, messages, answered, expected, failed);
+    if (answered > 0) {
+        printf("  reply latency p50 %llu us, p90 %llu us, p99 %llu us, p99.9 %llu us, max %llu us\n",
+               (unsigned long long)histogram_percentile(latency, answered, 0.5),
+               (unsigned long long)histogram_percentile(latency, answered, 0.9),
+               (unsigned long long)histogram_percentile(latency, answered, 0.99),
+               (unsigned long long)histogram_percentile(latency, answered, 0.999),
+               (unsigned long long)histogram_percentile(latency, answered, 1.0));
+    }
+    if (sent > 0) {
+        // 客户端自身跟不上计划时滞后增大，此时延迟结果不能代表服务器
+        printf("  send lag behind schedule p50 %llu us, p99 %llu us\n",
+               (unsigned long long)histogram_percentile(lag, sent, 0.5),
+               (unsigned long long)histogram_percentile(lag, sent, 0.99));
+    }
+    if (histogram_path) {
+        FILE *out = fopen(histogram_path, "w");
+        if (!out) {
+            perror(histogram_path);
+            return 1;
+        }
+        fprintf(out, "# latency_us count\n");
+        for (size_t b = 0; b < REPLAY_LATENCY_BUCKETS; b++) {
+            if (latency[b]) fprintf(out, "%zu %llu\n", b, latency[b]);
+        }
+        fclose(out);
+    }
+
+    for (int i = 0; i < threads; i++) {
+        free(workers[i].conns);
+        free(workers[i].latency);
+        free(workers[i].lag);
+    }
+    free(workers);
+    for (size_t i = 0; i < table.count; i++) {
+        free(table.conns[i].messages);
+        free(table.conns[i].sent_at);
+        free(table.conns[i].reply_end);
+    }
+    free(table.conns);
+    free(table.slots);
+    free(latency);
+    free(lag);
+    free(fill);
+    free(data);
+    return failed > 0;
+}
\ No newline at end of file
@@ -0,0 +1,363 @@
+#include "udp.h"
+#include "resource_manager.h"
+#include "error.h"
+#include "logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <netinet/udp.h>
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+
+// 一条待发送的消息，GSO 时包含多个等长分段（最后一段可以较短）
+typedef struct {
+    struct msghdr msg;
+    struct iovec iov;
+    struct sockaddr_in addr;
+    union {
+        char buf[CMSG_SPACE(sizeof(uint16_t))];
+        struct cmsghdr align;
+    } control;
+    size_t segment_size;
+    int segments;
+    int sealed;   // 已有较短的分段，不能再合并
+} UdpMessage;
+
+// 回复批次，发送完成前数据区和消息头必须保持有效
+typedef struct {
+    struct completion_handler handler;
+    struct UdpServer *server;
+    UdpMessage messages[UDP_SEND_MESSAGES];
+    int count;
+    size_t used;
+    int pending;  // 尚未返回的 sendmsg 数
+    char *arena;
+} UdpSendBatch;
+
+struct UdpServer {
+    ResourceManager *rm;
+    int fd;
+    on_datagram_cb on_datagram;
+    struct io_uring_buf_ring *buf_ring;
+    size_t buf_ring_size;
+    char *buffers;
+    struct msghdr recv_msg;   // multishot recvmsg 只使用其中的 namelen/controllen 作为布局
+    struct completion_handler recv_handler;
+    int gso;                  // 内核支持 UDP_SEGMENT
+    int stopped;              // 已停止接收，请求终止后不再挂起
+    UdpSendBatch *batches;
+    UdpSendBatch *current;    // 正在填充的批次
+    unsigned long dropped;
+};
+
+// 将缓冲区交还内核
+static void recycle_buffer(UdpServer *server, int bid) {
+    io_uring_buf_ring_add(server->buf_ring, server->buffers + (size_t)bid * UDP_BUFFER_SIZE, UDP_BUFFER_SIZE,
+                          (unsigned short)bid, io_uring_buf_ring_mask(UDP_BUFFER_COUNT), 0);
+    io_uring_buf_ring_advance(server->buf_ring, 1);
+}
+
+// 挂起 multishot recvmsg，每个数据报产生一个 CQE，直到缓冲区耗尽或出错
+static int arm_recv(UdpServer *server) {
+    struct io_uring_sqe *sqe = io_uring_get_sqe(server->rm->ring);
+    if (!sqe) {
+        io_uring_submit(server->rm->ring);
+        sqe = io_uring_get_sqe(server->rm->ring);
+    }
+    if (!sqe) {
+        handle_error(ERR_URING_QUEUE_FULL, "Could not get SQE for UDP receive");
+        return -1;
+    }
+    io_uring_prep_recvmsg_multishot(sqe, server->fd, &server->recv_msg, 0);
+    sqe->flags |= IOSQE_BUFFER_SELECT;
+    sqe->buf_group = UDP_BUFFER_GROUP;
+    sqe_set_completion_handler(sqe, &server->recv_handler);
+    return 0;
+}
+
+// 数据报到达
+static void on_datagram_received(struct completion_handler *handler, struct io_uring_cqe *cqe, ResourceManager *rm) {
+    UdpServer *server = (UdpServer*)((char*)handler - offsetof(UdpServer, recv_handler));
+
+    if (cqe->flags & IORING_CQE_F_BUFFER) {
+        int bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+        char *buf = server->buffers + (size_t)bid * UDP_BUFFER_SIZE;
+        if (cqe->res >= 0) {
+            struct io_uring_recvmsg_out *out = io_uring_recvmsg_validate(buf, cqe->res, &server->recv_msg);
+            // 超过缓冲区的数据报被截断，直接丢弃
+            if (out && !(out->flags & MSG_TRUNC) && out->namelen >= sizeof(struct sockaddr_in)) {
+                const struct sockaddr_in *addr = io_uring_recvmsg_name(out);
+                const char *payload = io_uring_recvmsg_payload(out, &server->recv_msg);
+                size_t len = io_uring_recvmsg_payload_length(out, cqe->res, &server->recv_msg);
+                server->on_datagram(addr, payload, len, rm);
+            } else {
+                server->dropped++;
+            }
+        }
+        recycle_buffer(server, bid);
+    } else if (cqe->res < 0 && cqe->res != -ENOBUFS && cqe->res != -ECANCELED) {
+        log_warn("UDP receive failed: %s", strerror(-cqe->res));
+    }
+
+    // 缓冲区耗尽（ENOBUFS）等情况下请求终止，缓冲区已归还，重新挂起
+    if (!(cqe->flags & IORING_CQE_F_MORE) && !server->stopped && cqe->res != -ECANCELED && cqe->res != -EBADF) {
+        arm_recv(server);
+    }
+}
+
+// 批次中的 sendmsg 完成
+static void on_batch_sent(struct completion_handler *handler, struct io_uring_cqe *cqe, ResourceManager *rm) {
+    (void)rm;
+    UdpSendBatch *batch = (UdpSendBatch*)((char*)handler - offsetof(UdpSendBatch, handler));
+    if (cqe->res < 0) {
+        // 对端不可达等错误只影响这一条消息，UDP 不重试
+        if (cqe->res == -EIO && batch->server->gso) {
+            // 网卡或路径不支持分段卸载，之后不再合并
+            batch->server->gso = 0;
+        }
+        batch->server->dropped++;
+    }
+    if (--batch->pending == 0) {
+        batch->count = 0;
+        batch->used = 0;
+    }
+}
+
+// 取得正在填充的批次，没有时选取一个空闲批次
+static UdpSendBatch* current_batch(UdpServer *server) {
+    if (!server->current) {
+        for (int i = 0; i < UDP_SEND_BATCHES; i++) {
+            UdpSendBatch *batch = &server->batches[i];
+            if (batch->pending == 0 && batch->count == 0) {
+                server->current = batch;
+                break;
+            }
+        }
+    }
+    return server->current;
+}
+
+// 提交正在填充的批次
+static void flush_batch(UdpServer *server) {
+    UdpSendBatch *batch = server->current;
+    if (!batch || batch->count == 0) {
+        return;
+    }
+    struct io_uring *ring = server->rm->ring;
+
+    int submitted = 0;
+    for (int i = 0; i < batch->count; i++) {
+        UdpMessage *m = &batch->messages[i];
+        struct io_uring_sqe *sqe = io_uring_get_sqe(ring);
+        if (!sqe) {
+            io_uring_submit(ring);
+            sqe = io_uring_get_sqe(ring);
+        }
+        if (!sqe) {
+            server->dropped += batch->count - i;
+            break;
+        }
+
+        memset(&m->msg, 0, sizeof(m->msg));
+        m->msg.msg_name = &m->addr;
+        m->msg.msg_namelen = sizeof(m->addr);
+        m->msg.msg_iov = &m->iov;
+        m->msg.msg_iovlen = 1;
+        if (m->segments > 1) {
+            // 一次发送多个数据报，由内核（或网卡）按 segment_size 切分
+            m->msg.msg_control = m->control.buf;
+            m->msg.msg_controllen = sizeof(m->control.buf);
+            struct cmsghdr *cm = CMSG_FIRSTHDR(&m->msg);
+            cm->cmsg_level = SOL_UDP;
+            cm->cmsg_type = UDP_SEGMENT;
+            cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+            uint16_t segment = (uint16_t)m->segment_size;
+            memcpy(CMSG_DATA(cm), &segment, sizeof(segment));
+        }
+        io_uring_prep_sendmsg(sqe, server->fd, &m->msg, 0);
+        sqe_set_completion_handler(sqe, &batch->handler);
+        submitted++;
+    }
+
+    batch->pending = submitted;
+    if (submitted == 0) {
+        batch->count = 0;
+        batch->used = 0;
+    }
+    server->current = NULL;
+}
+
+// 创建 UDP 服务器
+UdpServer* udp_server_create(ResourceManager *rm, int fd, on_datagram_cb on_datagram) {
+    UdpServer *server = calloc(1, sizeof(UdpServer));
+    if (!server) {
+        close(fd);
+        return NULL;
+    }
+    server->rm = rm;
+    server->fd = fd;
+    server->on_datagram = on_datagram;
+    server->recv_handler.on_complete = on_datagram_received;
+    server->recv_msg.msg_namelen = sizeof(struct sockaddr_in);
+
+    // 突发流量下避免在套接字层丢包
+    int rcvbuf = 4 << 20;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    // 设置 UDP_SEGMENT 为 0 不影响发送，只用于探测内核是否支持 GSO
+    int zero = 0;
+    server->gso = setsockopt(fd, SOL_UDP, UDP_SEGMENT, &zero, sizeof(zero)) == 0;
+
+    server->batches = calloc(UDP_SEND_BATCHES, sizeof(UdpSendBatch));
+    server->buffers = aligned_alloc(4096, (size_t)UDP_BUFFER_COUNT * UDP_BUFFER_SIZE);
+    server->buf_ring_size = UDP_BUFFER_COUNT * sizeof(struct io_uring_buf);
+    void *ring_mem = mmap(NULL, server->buf_ring_size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    server->buf_ring = ring_mem == MAP_FAILED ? NULL : ring_mem;
+    if (!server->batches || !server->buffers || !server->buf_ring) {
+        udp_server_destroy(server);
+        return NULL;
+    }
+    for (int i = 0; i < UDP_SEND_BATCHES; i++) {
+        server->batches[i].handler.on_complete = on_batch_sent;
+        server->batches[i].server = server;
+        server->batches[i].arena = malloc(UDP_SEND_ARENA_SIZE);
+        if (!server->batches[i].arena) {
+            udp_server_destroy(server);
+            return NULL;
+        }
+    }
+
+    // 缓冲区环的内存由本模块分配，ring 退出后即可直接释放
+    struct io_uring_buf_reg reg = {
+        .ring_addr = (unsigned long)server->buf_ring,
+        .ring_entries = UDP_BUFFER_COUNT,
+        .bgid = UDP_BUFFER_GROUP
+    };
+    io_uring_buf_ring_init(server->buf_ring);
+    int ret = io_uring_register_buf_ring(rm->ring, &reg, 0);
+    if (ret < 0) {
+        log_error("Failed to register UDP buffer ring: %s", strerror(-ret));
+        udp_server_destroy(server);
+        return NULL;
+    }
+    for (int i = 0; i < UDP_BUFFER_COUNT; i++) {
+        io_uring_buf_ring_add(server->buf_ring, server->buffers + (size_t)i * UDP_BUFFER_SIZE, UDP_BUFFER_SIZE,
+                              (unsigned short)i, io_uring_buf_ring_mask(UDP_BUFFER_COUNT), i);
+    }
+    io_uring_buf_ring_advance(server->buf_ring, UDP_BUFFER_COUNT);
+    return server;
+}
+
+int udp_server_start(UdpServer *server) {
+    return arm_recv(server);
+}
+
+// 取消请求的结果无需处理：recvmsg 以 -ECANCELED 完成，或已经终止（-ENOENT）
+static void on_recv_cancelled(struct completion_handler *handler, struct io_uring_cqe *cqe, ResourceManager *rm) {
+    (void)handler;
+    (void)cqe;
+    (void)rm;
+}
+
+static struct completion_handler recv_cancel_handler = { on_recv_cancelled };
+
+// 停止接收
+void udp_server_stop(UdpServer *server) {
+    if (server->stopped) return;
+    server->stopped = 1;
+    struct io_uring_sqe *sqe = io_uring_get_sqe(server->rm->ring);
+    if (!sqe) {
+        io_uring_submit(server->rm->ring);
+        sqe = io_uring_get_sqe(server->rm->ring);
+    }
+    if (!sqe) {
+        handle_error(ERR_URING_QUEUE_FULL, "Could not get SQE for UDP receive cancel");
+        return;
+    }
+    io_uring_prep_cancel(sqe, (void*)((uintptr_t)&server->recv_handler | COMPLETION_HANDLER_TAG), 0);
+    sqe_set_completion_handler(sqe, &recv_cancel_handler);
+}
+
+int udp_server_fd(const UdpServer *server) {
+    return server->fd;
+}
+
+// 释放 UDP 服务器
+void udp_server_destroy(UdpServer *server) {
+    if (!server) return;
+
+    if (server->fd >= 0) close(server->fd);
+    if (server->batches) {
+        for (int i = 0; i < UDP_SEND_BATCHES; i++) {
+            free(server->batches[i].arena);
+        }
+        free(server->batches);
+    }
+    if (server->buf_ring) munmap(server->buf_ring, server->buf_ring_size);
+    free(server->buffers);
+    if (server->dropped > 0) {
+        printf("UDP worker dropped %lu datagram(s)\n", server->dropped);
+    }
+    free(server);
+}
+
+// 排队一条回复
+int udp_reply(ResourceManager *rm, const struct sockaddr_in *addr, const void *data, size_t len) {
+    UdpServer *server = rm->udp_server;
+    if (!server || !addr) {
+        return -EINVAL;
+    }
+    if (len > UDP_GSO_MAX_BYTES) {
+        return -EMSGSIZE;
+    }
+
+    UdpSendBatch *batch = current_batch(server);
+    if (batch && (batch->used + len > UDP_SEND_ARENA_SIZE || batch->count == UDP_SEND_MESSAGES)) {
+        // 当前批次已满，提交后换用下一个批次
+        flush_batch(server);
+        batch = current_batch(server);
+    }
+    if (!batch) {
+        server->dropped++;
+        return -EAGAIN;
+    }
+
+    // 与上一条消息发往同一地址且长度不超过其分段长度时，作为新的分段合并（数据区连续）
+    UdpMessage *last = batch->count > 0 ? &batch->messages[batch->count - 1] : NULL;
+    if (server->gso && last && !last->sealed && len > 0 && len <= last->segment_size &&
+        last->segments < UDP_GSO_MAX_SEGMENTS && last->iov.iov_len + len <= UDP_GSO_MAX_BYTES &&
+        last->addr.sin_addr.s_addr == addr->sin_addr.s_addr && last->addr.sin_port == addr->sin_port) {
+        memcpy(batch->arena + batch->used, data, len);
+        batch->used += len;
+        last->iov.iov_len += len;
+        last->segments++;
+        if (len < last->segment_size) {
+            last->sealed = 1;
+        }
+        return 0;
+    }
+
+    UdpMessage *m = &batch->messages[batch->count++];
+    memcpy(batch->arena + batch->used, data, len);
+    m->iov.iov_base = batch->arena + batch->used;
+    m->iov.iov_len = len;
+    m->addr = *addr;
+    m->segment_size = len;
+    m->segments = 1;
+    m->sealed = 0;
+    batch->used += len;
+    return 0;
+}
+
+void udp_flush(ResourceManager *rm) {
+    if (rm->udp_server) {
+        flush_batch(rm->udp_server);
+    }
+}
\ No newline at end of file
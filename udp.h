@@ -0,0 +1,44 @@
+#ifndef UDP_H
+#define UDP_H
+
+#include "iouring_server.h"
+
+// 接收缓冲区（提供给内核的缓冲区环），每个缓冲区容纳 recvmsg 头、对端地址和数据
+#define UDP_BUFFER_SIZE 2048
+#define UDP_BUFFER_COUNT 4096   // 必须是 2 的幂
+#define UDP_BUFFER_GROUP 1
+// 回复批次：每批最多的消息数和数据量，同时在途的批次数
+#define UDP_SEND_MESSAGES 256
+#define UDP_SEND_ARENA_SIZE (256 * 1024)
+#define UDP_SEND_BATCHES 8
+// 一次 GSO 发送最多合并的分段数和字节数
+#define UDP_GSO_MAX_SEGMENTS 64
+#define UDP_GSO_MAX_BYTES 65000
+
+// UDP 服务器类型（每个工作线程一个）
+typedef struct UdpServer UdpServer;
+
+// 创建 UDP 服务器，接管已绑定的数据报套接字 fd（失败时也会关闭），并注册接收缓冲区环
+UdpServer* udp_server_create(struct ResourceManager *rm, int fd, on_datagram_cb on_datagram);
+
+// 挂起多次触发（multishot）的 recvmsg 请求
+int udp_server_start(UdpServer *server);
+
+// 停止接收：取消 recvmsg 请求且不再挂起，套接字保持打开（热重启后由新进程接收）
+void udp_server_stop(UdpServer *server);
+
+// 数据报套接字
+int udp_server_fd(const UdpServer *server);
+
+// 释放 UDP 服务器（在 ring 退出后调用）
+void udp_server_destroy(UdpServer *server);
+
+// 从 on_datagram 回调中向 addr 发送回复，数据被复制，调用返回后即可复用
+// 回复在本轮事件处理结束时批量发送，发往同一地址的连续回复通过 UDP_SEGMENT（GSO）合并为一次发送
+// 返回: 成功返回 0，没有空闲的发送批次返回 -EAGAIN（回复被丢弃），数据过长返回 -EMSGSIZE
+int udp_reply(struct ResourceManager *rm, const struct sockaddr_in *addr, const void *data, size_t len);
+
+// 发送已排队的回复（事件循环在每批完成事件处理后调用）
+void udp_flush(struct ResourceManager *rm);
+
+#endif // UDP_H
\ No newline at end of file
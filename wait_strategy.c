@@ -0,0 +1,121 @@
+#include "wait_strategy.h"
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+// 间隔平均值的平滑系数为 1/2^WAIT_EWMA_SHIFT
+#define WAIT_EWMA_SHIFT 3
+// 记录的间隔不超过自旋上限的倍数，空闲后恢复负载时平均值能很快回落
+#define WAIT_GAP_CLAMP 4
+
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// 自旋等待时让出流水线资源给同一物理核上的超线程
+static inline void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+// 初始化等待状态
+void wait_state_init(WaitState *ws, const WaitConfig *config, const struct io_uring *ring) {
+    ws->spin_limit_ns = (uint64_t)config->spin_us * 1000;
+    // 初始视为空闲，观察到密集的完成事件后才开始自旋
+    ws->gap_ewma_ns = ws->spin_limit_ns * WAIT_GAP_CLAMP;
+    ws->sleep_ns = (ring->features & IORING_FEAT_EXT_ARG) ? (uint64_t)config->max_sleep_ms * 1000000 : 0;
+}
+
+// 按配置注册 NAPI 忙轮询
+int wait_register_napi(struct io_uring *ring, const WaitConfig *config) {
+    if (config->napi_busy_poll_us == 0) {
+        return 0;
+    }
+#ifdef IORING_REGISTER_NAPI
+    struct io_uring_napi napi;
+    memset(&napi, 0, sizeof(napi));
+    napi.busy_poll_to = config->napi_busy_poll_us;
+    napi.prefer_busy_poll = 1;
+    int ret = io_uring_register_napi(ring, &napi);
+    return ret < 0 ? ret : 0;
+#else
+    (void)ring;
+    return -EOPNOTSUPP;
+#endif
+}
+
+// 记录一次空闲间隔
+static void record_gap(WaitState *ws, uint64_t gap_ns) {
+    uint64_t clamp = ws->spin_limit_ns * WAIT_GAP_CLAMP;
+    if (gap_ns > clamp) {
+        gap_ns = clamp;
+    }
+    int64_t delta = (int64_t)gap_ns - (int64_t)ws->gap_ewma_ns;
+    ws->gap_ewma_ns = (uint64_t)((int64_t)ws->gap_ewma_ns + delta / (1 << WAIT_EWMA_SHIFT));
+}
+
+// 根据最近的间隔计算本次的自旋预算
+static uint64_t spin_budget(const WaitState *ws) {
+    if (ws->gap_ewma_ns > ws->spin_limit_ns) {
+        return 0;
+    }
+    uint64_t budget = ws->gap_ewma_ns * 2 + 1000;
+    return budget < ws->spin_limit_ns ? budget : ws->spin_limit_ns;
+}
+
+// 阻塞等待 CQE，不超过 max_sleep_ms
+static int block_for_completion(struct io_uring *ring, const WaitState *ws) {
+    struct io_uring_cqe *cqe;
+    if (ws->sleep_ns == 0) {
+        return io_uring_wait_cqe(ring, &cqe);
+    }
+    struct __kernel_timespec ts = {
+        .tv_sec = (long long)(ws->sleep_ns / 1000000000ULL),
+        .tv_nsec = (long long)(ws->sleep_ns % 1000000000ULL),
+    };
+    return io_uring_wait_cqe_timeout(ring, &cqe, &ts);
+}
+
+// 等待至少一个 CQE 就绪
+int wait_for_completion(struct io_uring *ring, WaitState *ws) {
+    if (ws->spin_limit_ns == 0) {
+        return block_for_completion(ring, ws);
+    }
+
+    if (io_uring_cq_ready(ring)) {
+        record_gap(ws, 0);
+        return 0;
+    }
+
+    // 默认设置下内核在返回用户态时运行完成任务，完成事件直接出现在 CQ 上；
+    // COOP_TASKRUN 和 DEFER_TASKRUN 的 ring 中任务需要进入内核才运行，内核以 IORING_SQ_TASKRUN 提示，
+    // 此时才调用 io_uring_get_events，自旋期间其余时间不需要系统调用
+    int taskrun = (ring->flags & IORING_SETUP_TASKRUN_FLAG) != 0;
+    uint64_t start = monotonic_ns();
+    uint64_t budget = spin_budget(ws);
+    if (budget) {
+        uint64_t now = start;
+        while (now - start < budget) {
+            if (taskrun && (IO_URING_READ_ONCE(*ring->sq.kflags) & IORING_SQ_TASKRUN)) {
+                io_uring_get_events(ring);
+            }
+            if (io_uring_cq_ready(ring)) {
+                record_gap(ws, now - start);
+                return 0;
+            }
+            cpu_relax();
+            now = monotonic_ns();
+        }
+    }
+
+    int ret = block_for_completion(ring, ws);
+    if (ret == 0 || ret == -ETIME) {
+        record_gap(ws, monotonic_ns() - start);
+    }
+    return ret;
+}
\ No newline at end of file
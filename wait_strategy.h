@@ -0,0 +1,39 @@
+#ifndef WAIT_STRATEGY_H
+#define WAIT_STRATEGY_H
+
+#include <stdint.h>
+#include <liburing.h>
+
+// 等待策略配置
+typedef struct {
+    unsigned spin_us;            // 阻塞前最多在 CQ 上自旋的时间（微秒），0 表示不自旋
+    unsigned napi_busy_poll_us;  // 注册到 ring 的 NAPI 忙轮询时间（微秒），0 表示不注册
+    unsigned max_sleep_ms;       // 每次阻塞等待的上限（毫秒），0 表示不限制
+} WaitConfig;
+
+// 默认配置
+#define WAIT_DEFAULT_SPIN_US 50
+#define WAIT_DEFAULT_NAPI_US 0
+#define WAIT_DEFAULT_MAX_SLEEP_MS 1000
+
+// 每个工作线程的等待状态，只能由所属工作线程访问
+typedef struct {
+    uint64_t spin_limit_ns;   // 自旋预算上限
+    uint64_t gap_ewma_ns;     // 最近空闲间隔（开始等待到 CQE 就绪）的指数移动平均
+    uint64_t sleep_ns;        // 每次阻塞等待的上限，0 表示不限制
+} WaitState;
+
+// 初始化等待状态。内核不支持 IORING_FEAT_EXT_ARG 时不限制阻塞时间
+// （否则 liburing 要提交内部的超时 SQE，其完成事件会混入事件循环）
+void wait_state_init(WaitState *ws, const WaitConfig *config, const struct io_uring *ring);
+
+// 按配置在 ring 上注册 NAPI 忙轮询：阻塞等待期间由内核轮询网卡队列，而不是等待中断
+// 返回: 成功或未启用返回 0，内核或 liburing 不支持时返回 -errno（不影响正常运行）
+int wait_register_napi(struct io_uring *ring, const WaitConfig *config);
+
+// 等待至少一个 CQE 就绪：最近的完成事件间隔较短时先在 CQ 上自旋，预算为平均间隔的两倍
+// （不超过 spin_us），间隔超过 spin_us 时不自旋，直接阻塞，空闲时不消耗 CPU
+// 返回: CQE 就绪返回 0，阻塞达到 max_sleep_ms 返回 -ETIME，失败返回 -errno
+int wait_for_completion(struct io_uring *ring, WaitState *ws);
+
+#endif // WAIT_STRATEGY_H
\ No newline at end of file